@@ -403,6 +403,16 @@ int main(int argc, char const *argv[])
 			COPY_POS(message.cmdMsg.position, p13);
 			write(sock, &message, sizeof(message));
 		}
+		else if ('9' == keyPress)
+		{
+			// survey the area in survey.txt on the rover, master
+			// plans the lanes and queues every waypoint at once
+			message.messageType = CommandMessage;
+			message.destination = TX2Master;
+			message.cmdMsg.commandType = PositionCommand;
+			message.cmdMsg.commandOperation = Survey;
+			write(sock, &message, sizeof(message));
+		}
 		else
 		{
 			// tell tx2 we are disconnecting
@@ -0,0 +1,231 @@
+/**
+ * @file gpsReplay.c
+ * @brief gpsReplay tool.
+ * @details The gpsReplay tool runs a recording of XA1110 output, made by tx2_gps_node.c with
+ * 	    RECORD_NMEA defined, through both the old 5 fix moving average and the GpsEstimator
+ * 	    library, and reports the noise and lag of each. There is no surveyed ground truth in a
+ * 	    recording, so the reference is a centered (non causal) average of the raw fixes around
+ * 	    each fix. Noise is the RMS distance between an output and the reference for the same
+ * 	    fix. Lag is the number of fixes k for which the output best matches the reference k
+ * 	    fixes earlier.
+ * 	    <br>
+ * 	    <br>
+ * 	    Usage: ./gpsReplay gps_record.nmea
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "include/Messages.h"
+#include "include/I2CGPS.h"
+#include "include/GpsEstimator.h"
+#include "include/Profile.h"
+
+#define MAX_FIXES 100000
+#define MAX_BURST 4096
+#define REFERENCE_HALF_WIDTH 2
+#define MAX_LAG 10
+
+/**
+ * @brief Meters per degree of latitude, same earth radius as LatLonTrig.h.
+**/
+#define METERS_PER_DEGREE 111194.93
+
+/**
+ * @brief Raw fixes, as parsed from the recording.
+**/
+GpsMsg fixes[MAX_FIXES];
+
+/**
+ * @brief Output of the old moving average for each fix, valid once 5 fixes are in.
+**/
+Position legacy[MAX_FIXES];
+
+/**
+ * @brief Output of the estimator for each fix, the last estimate if the fix was rejected.
+**/
+PositionEstimate estimates[MAX_FIXES];
+
+/**
+ * @brief Centered average of the raw fixes around each fix.
+**/
+Position reference[MAX_FIXES];
+
+int fixCount = 0;
+
+/**
+ * @brief Returns the distance in meters between two nearby positions.
+**/
+double Distance(Position * p1, Position * p2)
+{
+	double north, east;
+
+	north = (p1->latitude - p2->latitude) * METERS_PER_DEGREE;
+	east = (p1->longitude - p2->longitude) * METERS_PER_DEGREE * cos(p1->latitude * (M_PI / 180.0));
+
+	return sqrt((north * north) + (east * east));
+}
+
+/**
+ * @brief Parses one burst and adds the fix, if any, to #fixes.
+**/
+void ParseBurst(char * burst, int length)
+{
+	if (length > 0 && fixCount < MAX_FIXES) {
+		if (GPS_READ_FIX == I2CGPSParse(burst, length, &fixes[fixCount])) {
+			fixCount++;
+		}
+	}
+}
+
+/**
+ * @brief Reads the recording, a '#' line separates each drain of the module.
+**/
+int ReadRecording(char * fileName)
+{
+	FILE * file;
+	char line[256];
+	char burst[MAX_BURST];
+	int length = 0;
+	int lineLength;
+
+	file = fopen(fileName, "r");
+	if (NULL == file) {
+		printf("Failed to open %s\n", fileName);
+		return -1;
+	}
+
+	while (NULL != fgets(line, sizeof(line), file)) {
+		if ('#' == line[0]) {
+			ParseBurst(burst, length);
+			length = 0;
+			continue;
+		}
+
+		lineLength = strlen(line);
+		if (length + lineLength < MAX_BURST) {
+			memcpy(burst + length, line, lineLength);
+			length += lineLength;
+		}
+	}
+	ParseBurst(burst, length);
+
+	fclose(file);
+	return 0;
+}
+
+/**
+ * @brief Computes the centered reference for each fix.
+**/
+void BuildReference()
+{
+	int i, j, first, last;
+
+	for (i = 0; i < fixCount; i++) {
+		first = (i - REFERENCE_HALF_WIDTH < 0)?(0):(i - REFERENCE_HALF_WIDTH);
+		last = (i + REFERENCE_HALF_WIDTH >= fixCount)?(fixCount - 1):(i + REFERENCE_HALF_WIDTH);
+
+		reference[i].latitude = reference[i].longitude = 0.0f;
+		for (j = first; j <= last; j++) {
+			reference[i].latitude += fixes[j].position.latitude;
+			reference[i].longitude += fixes[j].position.longitude;
+		}
+		reference[i].latitude /= (last - first + 1);
+		reference[i].longitude /= (last - first + 1);
+	}
+}
+
+/**
+ * @brief Returns the RMS distance between outputs from start on and the reference lag fixes earlier.
+**/
+double RmsAtLag(Position * outputs, int stride, int start, int lag)
+{
+	double sum = 0.0;
+	double distance;
+	int i, count = 0;
+
+	for (i = start + lag; i < fixCount; i++) {
+		distance = Distance((Position *)((char *)outputs + (i * stride)), &reference[i - lag]);
+		sum += distance * distance;
+		count++;
+	}
+
+	return (count)?(sqrt(sum / count)):(0.0);
+}
+
+/**
+ * @brief Prints the noise and lag of one set of outputs.
+**/
+void Report(char * name, Position * outputs, int stride, int start)
+{
+	double rms, best;
+	int lag, bestLag = 0;
+
+	best = RmsAtLag(outputs, stride, start, 0);
+	for (lag = 1; lag <= MAX_LAG; lag++) {
+		rms = RmsAtLag(outputs, stride, start, lag);
+		if (rms < best) {
+			best = rms;
+			bestLag = lag;
+		}
+	}
+
+	printf("%-10s noise %6.2f m   lag %2d fixes (%6.2f m at that lag)\n",
+		name, RmsAtLag(outputs, stride, start, 0), bestLag, best);
+}
+
+int main(int argc, char * argv[])
+{
+	Positions positions = { .head = 0, .positionCount = 0 };
+	GpsEstimator estimator;
+	double accuracy = 0.0;
+	int accepted = 0;
+	int i;
+
+	if (argc != 2) {
+		printf("Usage: %s <recorded nmea file>\n", argv[0]);
+		return -1;
+	}
+
+	// TX2_PROFILE=gpsReplay counts the NMEA parsing
+	ProfileInit("gpsReplay");
+
+	if (ReadRecording(argv[1]) < 0) {
+		return -1;
+	}
+
+	if (fixCount <= GPS_AVERAGE_COUNT) {
+		printf("Only %d fixes in %s\n", fixCount, argv[1]);
+		return -1;
+	}
+
+	InitEstimator(&estimator);
+	memset(&estimates[0], 0, sizeof(PositionEstimate));
+
+	// run both on the same fixes
+	for (i = 0; i < fixCount; i++) {
+		AddPosition(&positions, &fixes[i].position);
+		if (positions.positionCount == GPS_AVERAGE_COUNT) {
+			GetPositionAverage(&positions, &legacy[i]);
+		}
+
+		if (i > 0) {
+			memcpy(&estimates[i], &estimates[i - 1], sizeof(PositionEstimate));
+		}
+		if (UpdateEstimator(&estimator, &fixes[i], &estimates[i])) {
+			accepted++;
+			accuracy += estimates[i].accuracy;
+		}
+	}
+
+	BuildReference();
+
+	printf("%d fixes, %d accepted by the estimator, mean reported accuracy %.2f m\n",
+		fixCount, accepted, (accepted)?(accuracy / accepted):(0.0));
+	Report("raw", &fixes[0].position, sizeof(GpsMsg), GPS_AVERAGE_COUNT - 1);
+	Report("average", &legacy[0], sizeof(Position), GPS_AVERAGE_COUNT - 1);
+	Report("estimator", &estimates[0].position, sizeof(PositionEstimate), GPS_AVERAGE_COUNT - 1);
+
+	return 0;
+}
@@ -0,0 +1,141 @@
+/**
+ * @file i2cBench.c
+ * @brief i2cBench tool.
+ * @details The i2cBench tool runs the GPS and gyro drivers together, the way tx2_gps_node.c and
+ * 	    tx2_gyro_node.c use them, with a magnetometer read per FIFO read, and reports bus and
+ * 	    CPU use. Unless I2C_BACKEND is set in
+ * 	    the environment it uses the mock backend, so it runs without hardware. With "single"
+ * 	    the gyro is read one sample per transaction at 238 Hz, the way it was read before the
+ * 	    FIFO was used, for comparison. See I2CMock.h for the other environment variables.
+ * 	    <br>
+ * 	    <br>
+ * 	    Usage: ./i2cBench [seconds] [single]
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "include/Messages.h"
+#include "include/I2CGPS.h"
+#include "include/I2CGyro.h"
+
+#define GPS_POLL_NS 100000000LL		/**< GPS drained every 100 ms. */
+#define SINGLE_PERIOD_NS 4202000LL	/**< 238 Hz, one gyro sample per transaction. */
+
+/**
+ * @brief Returns CLOCK_MONOTONIC in nanoseconds.
+**/
+long long NowNs()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((long long)now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
+
+/**
+ * @brief Sleeps until an absolute CLOCK_MONOTONIC time.
+**/
+void SleepUntil(long long when)
+{
+	struct timespec wake;
+
+	wake.tv_sec = when / 1000000000LL;
+	wake.tv_nsec = when % 1000000000LL;
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL);
+}
+
+/**
+ * @brief Prints the bus statistics of a device.
+**/
+void PrintBus(char * name, I2CDeviceStats * stats, double seconds)
+{
+	unsigned long attempts = stats->transactions + stats->failures;
+
+	printf("%-8s %8lu transactions (%.1f/s) %8lu B read %6lu B written %5lu retries %3lu failures avg %.1f us max %.1f us\n",
+		name, stats->transactions, stats->transactions / seconds, stats->bytesRead, stats->bytesWritten,
+		stats->retries, stats->failures,
+		(attempts)?((stats->busyNs / 1000.0) / attempts):(0.0), stats->maxNs / 1000.0);
+}
+
+int main(int argc, char * argv[])
+{
+	Message message;
+	GyroSample samples[GYRO_FIFO_DEPTH];
+	MagSample mag;
+	I2CGPSStats gpsStats;
+	GyroStats gyroStats;
+	struct rusage usage;
+	double seconds = 10.0;
+	double cpu;
+	long long start, end, nextGps, nextGyro;
+	unsigned long fixes = 0;
+	unsigned long gyroSamples = 0;
+	int single = 0;
+	int count;
+
+	if (argc > 1) {
+		seconds = atof(argv[1]);
+	}
+	if (argc > 2 && 0 == strcmp(argv[2], "single")) {
+		single = 1;
+	}
+
+	// no hardware unless asked for
+	setenv(I2C_BACKEND_ENV, "mock", 0);
+
+	if (I2CGPSOpen() < 0 || I2CGyroOpen() < 0) {
+		return -1;
+	}
+
+	start = NowNs();
+	end = start + (long long)(seconds * 1000000000.0);
+	nextGps = start + GPS_POLL_NS;
+	nextGyro = start + ((single)?(SINGLE_PERIOD_NS):(GyroFifoPeriodNs()));
+
+	while (NowNs() < end) {
+		SleepUntil((nextGps < nextGyro)?(nextGps):(nextGyro));
+
+		if (NowNs() >= nextGyro) {
+			if (single) {
+				GetAngularVelocity();
+				gyroSamples++;
+				nextGyro += SINGLE_PERIOD_NS;
+			} else {
+				count = GyroFifoRead(samples, GYRO_FIFO_DEPTH);
+				gyroSamples += (count > 0)?(count):(0);
+				MagRead(&mag);
+				nextGyro += GyroFifoPeriodNs();
+			}
+		}
+
+		if (NowNs() >= nextGps) {
+			if (GPS_READ_FIX == I2CGPSRead(&message)) {
+				fixes++;
+			}
+			nextGps += GPS_POLL_NS;
+		}
+	}
+
+	seconds = (NowNs() - start) / 1000000000.0;
+	getrusage(RUSAGE_SELF, &usage);
+	cpu = usage.ru_utime.tv_sec + (usage.ru_utime.tv_usec / 1000000.0) +
+	      usage.ru_stime.tv_sec + (usage.ru_stime.tv_usec / 1000000.0);
+
+	I2CGPSGetStats(&gpsStats);
+	GyroGetStats(&gyroStats);
+
+	printf("%.1f s, gyro %s: %lu samples (%.1f/s), %lu overruns, GPS: %lu fixes\n",
+		seconds, (single)?("single sample reads"):("FIFO bursts"), gyroSamples, gyroSamples / seconds,
+		gyroStats.overruns, fixes);
+	PrintBus("XA1110", &gpsStats.bus, seconds);
+	PrintBus("LSM9DS1", &gyroStats.bus, seconds);
+	PrintBus("mag", &gyroStats.magBus, seconds);
+	printf("CPU %.3f s (%.2f%%)\n", cpu, (cpu * 100.0) / seconds);
+
+	I2CGyroClose();
+	I2CGPSClose();
+
+	return 0;
+}
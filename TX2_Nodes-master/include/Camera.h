@@ -0,0 +1,139 @@
+/**
+ * @file Camera.h
+ * @brief Header file for the Camera library.
+ * @details Header file for the Camera library, the camera backends of tx2_host_cam_node.c, which
+ *	    stands in for tx2_cam_node.cpp on machines without the Jetson camera, CUDA or
+ *	    jetson-inference. It produces the same segmentation mask, one byte per pixel, for
+ *	    tx2_nav_node.c:
+ *	    <br>
+ *	    <br>
+ *	    #CameraReplay plays a mask recording (#CAMERA_REPLAY_FILE), looping at the end. A
+ *	    recording is a "MASK width height" line followed by the masks, width * height bytes
+ *	    each, the format tx2_cam_node.cpp writes with RECORD_MASKS defined, see
+ *	    #CameraRecordOpen(). Without a recording every mask is #CAMERA_CLEAR_LABEL, an open
+ *	    walkway, at #CAMERA_WIDTH x #CAMERA_HEIGHT.
+ *	    <br>
+ *	    <br>
+ *	    #CameraV4L2 captures YUYV frames from #CAMERA_V4L2_DEVICE through memory mapped
+ *	    buffers. There is no segmentation network, so the mask is only a stand-in: pixels whose
+ *	    brightness is more than #CAMERA_V4L2_CONTRAST from that of the ground right in front of
+ *	    the rover (the bottom #CAMERA_V4L2_GROUND_ROWS rows) are #CAMERA_OBSTACLE_LABEL, the
+ *	    rest #CAMERA_CLEAR_LABEL. It keeps capture, the data path and its timing real.
+ *	    <br>
+ *	    <br>
+ *	    #CameraSim renders #SIM_CAMERA_WIDTH x #SIM_CAMERA_HEIGHT masks of the map of roverSim.c
+ *	    as seen from the simulated rover, at most #SIM_CAMERA_FPS a simulated second, see
+ *	    #SimulationRender().
+ *	    <br>
+ *	    <br>
+ *	    All can save a picture for the controller, a PPM of the frame or a PGM of the mask.
+**/
+
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/videodev2.h>
+#include "Hal.h"
+
+#define CAMERA_REPLAY_FILE "../masks.rec"	/**< Masks played by #CameraReplay. */
+#define CAMERA_V4L2_DEVICE "/dev/video0"	/**< Camera used by #CameraV4L2. */
+#define CAMERA_WIDTH 1280			/**< Mask width without a recording, and the width asked of V4L2, gstCamera's default. */
+#define CAMERA_HEIGHT 720			/**< Mask height without a recording, and the height asked of V4L2. */
+#define CAMERA_BUFFERS 4			/**< V4L2 capture buffers. */
+#define CAMERA_CLEAR_LABEL 0			/**< Mask value of open ground, low values are safe to the nav node. */
+#define CAMERA_OBSTACLE_LABEL 20		/**< Mask value of anything else. */
+#define CAMERA_V4L2_CONTRAST 40			/**< Brightness difference from the ground that makes an obstacle, 0-255. */
+#define CAMERA_V4L2_GROUND_ROWS 32		/**< Rows at the bottom of the frame taken as the ground. */
+
+/**
+ * @brief Capture statistics.
+**/
+typedef struct _CameraStats {
+	unsigned long frames;		// masks produced
+	unsigned long failures;		// captures that failed
+	long long captureNs;		// total time from request to mask
+	long long maxNs;		// longest of those
+} CameraStats;
+
+/**
+ * @brief An open camera backend.
+**/
+typedef struct _Camera {
+	int backend;			// #CameraV4L2, #CameraReplay or #CameraSim
+	int width;
+	int height;
+	int stride;			// bytes per V4L2 frame row
+	int fd;				// V4L2 device, -1 for a replay
+	void * buffers[CAMERA_BUFFERS];	// V4L2 capture buffers, or the mapped recording in buffers[0]
+	size_t lengths[CAMERA_BUFFERS];
+	int bufferCount;
+	uint8_t * masks;		// first mask of the recording, NULL without one
+	long maskCount;
+	long next;			// mask played next
+	struct _SimShared * sim;	// world rendered by #CameraSim, see Simulation.h
+	long long nextFrame;		// #ClockNowNs() of the next paced mask, #CameraSim or a replay on the virtual clock
+	CameraStats stats;
+} Camera;
+
+/**
+ * @brief Opens a camera backend.
+ * @param camera The #Camera being opened.
+ * @param backend #CameraV4L2, #CameraReplay or #CameraSim.
+ * @return 0 on success, -1 on error.
+ * @post camera width and height are the size of the masks.
+**/
+int CameraOpen(Camera * camera, int backend);
+
+/**
+ * @brief Produces the next mask.
+ * @param camera The #Camera.
+ * @param mask Output, width * height bytes.
+ * @return 0 on success, -1 if the capture failed, mask is left untouched then.
+**/
+int CameraMask(Camera * camera, uint8_t * mask);
+
+/**
+ * @brief Saves a picture, a new frame for #CameraV4L2 (PPM), the next mask for the others (PGM).
+ * @param camera The #Camera.
+ * @param fileName Where to save it.
+ * @return 0 on success, -1 on error.
+**/
+int CameraSaveImage(Camera * camera, char * fileName);
+
+/**
+ * @brief Copies out the capture statistics.
+**/
+void CameraGetStats(Camera * camera, CameraStats * stats);
+
+/**
+ * @brief Closes a camera opened with #CameraOpen().
+**/
+void CameraClose(Camera * camera);
+
+/**
+ * @brief Starts a mask recording for #CameraReplay.
+ * @param fileName The recording, replaced if it exists.
+ * @param width Mask width.
+ * @param height Mask height.
+ * @return A file descriptor for #CameraRecordMask(), -1 on error.
+**/
+int CameraRecordOpen(char * fileName, int width, int height);
+
+/**
+ * @brief Appends a mask to a recording started with #CameraRecordOpen().
+ * @return 0 on success, -1 on error.
+**/
+int CameraRecordMask(int fd, uint8_t * mask, int size);
+
+#endif
@@ -3,7 +3,11 @@
  * @author Patrick Henz
  * @date 4-17-2019
  * @brief Header file for CanController.c. This implements all CAN functionality.
- * @details After calling #InitializeCan(), all other functions are ready to use.
+ * @details After calling #InitializeCan(), all other functions are ready to use. The CAN
+ *	    backend (Hal.h) decides where frames go: the TX2's #HAL_CAN_INTERFACE, a virtual
+ *	    #HAL_VCAN_INTERFACE on a Linux host, the simulated rover of roverSim.c (#CanSim), or
+ *	    nowhere (#CanNone), in which case writes are counted and dropped. There is nothing to
+ *	    read without a socket.
  *
  * 	    --------------------
  *          ---USEFUL HEADERS---
@@ -30,6 +34,8 @@
 #define DEBUG
 
 #include "Messages.h"
+#include "Hal.h"
+#include "Simulation.h"
 #include <linux/can.h>
 #include <linux/can/raw.h>
 #include <net/if.h> 
@@ -56,13 +62,16 @@
 
 /**
  * @brief Function initializes a CAN socket.
- * @details Function initializes a CAN socket that can be read/written from/to.
- * @return Returns the file descriptor for the CAN socket.
+ * @details Function initializes a CAN socket that can be read/written from/to. For
+ *	    #CanSocketCan the tegra CAN modules are loaded and can0 is set up first, for #CanVirtual
+ *	    the vcan module is loaded and vcan0 created if it does not exist yet (both need root).
+ * @param backend The #CanBackend to use.
+ * @return Returns the file descriptor for the CAN socket, 0 for #CanNone and #CanSim, -1 on error.
  * @pre Assumes that proper CAN modules have been loaded into OS kernel.
  * @post CAN functionality is initialized and messages can be sent
  *	     and received on the CAN bus.
  */
-int InitializeCan();
+int InitializeCan(int backend);
 
 /**
  * @breif Function reads message that was sent over CAN bus.
@@ -90,6 +99,11 @@ int CanRead(Message * message);
 **/
 int CanWrite(Message * message);
 
+/**
+ * @brief Returns the number of frames dropped by the #CanNone backend, or lost by a full #CanSim ring.
+**/
+unsigned long CanDropped();
+
 /**
  * @brief Function closes CAN socket.
  * @details Function closes CAN socket.
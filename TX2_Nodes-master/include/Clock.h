@@ -0,0 +1,209 @@
+/**
+ * @file Clock.h
+ * @brief Header file for the Clock library.
+ * @details Header file for the Clock library, the clock every node takes its timestamps from
+ *	    and does its timed waits on: #SetAndWait(), sleeps, the pacing of the gyro, GPS and
+ *	    camera loops and the timeouts of tx2_comm_node.c. There are three kinds of clock:
+ *	    <br>
+ *	    <br>
+ *	    Real (#ClockUseReal()): a kernel clock, CLOCK_MONOTONIC unless #HalInit() chooses
+ *	    another. This is the default.
+ *	    <br>
+ *	    Scaled (#ClockUseScaled()): real time sped up by a constant factor from an epoch, the
+ *	    simulated time of roverSim.c.
+ *	    <br>
+ *	    Virtual (#ClockUseVirtual()): time that only moves once there is nothing left to do.
+ *	    Every thread of every node is a participant of the #SHARED_CLOCK_NAME shared memory,
+ *	    either running or waiting, for a time, a message or both, and every #Message written
+ *	    to a pipe is counted until it is read (#SendMessage(), #ReceiveMessage()). When the
+ *	    last running participant starts to wait and no message is in flight, it acts as the
+ *	    coordinator: it moves the clock to the earliest wake time and wakes the participant
+ *	    waiting for it, the lowest slot first if several are due at once. Nothing waits in
+ *	    real time, so a run goes as fast as the CPU allows and a 5 minute timeout costs no
+ *	    more than a 5 ms one, and every wait ends at the same virtual time however loaded
+ *	    the host is, which makes runs repeatable.
+ *	    <br>
+ *	    <br>
+ *	    The clock of a process is chosen by #HalInit(), which tx2_master.c and
+ *	    tx2_comm_node.c call as well as the nodes with hardware, or by #CLOCK_ENV: a process
+ *	    that finds "virtual" there joins the virtual clock on its first call into the library,
+ *	    before it gets to #HalInit(). A participant
+ *	    that blocks outside the library, in accept() or pthread_join() for example, must
+ *	    bracket the call with #ClockIdle() and #ClockBusy(), or virtual time stops until it
+ *	    returns. Once a process has joined the virtual clock it keeps it.
+**/
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/select.h>
+
+#define CLOCK_ENV "TX2_CLOCK"		/**< Environment variable, "virtual" to join the virtual clock. */
+#define CLOCK_MAX_PARTICIPANTS 32	/**< Most threads on one virtual clock. */
+#define CLOCK_NEVER LLONG_MAX		/**< Wake time of a wait without a timeout. */
+#define CLOCK_SECOND 1000000000LL	/**< Nanoseconds in a second. */
+#define CLOCK_MILLISECOND 1000000LL	/**< Nanoseconds in a millisecond. */
+
+/**
+ * @brief A thread on the virtual clock.
+**/
+typedef struct _ClockParticipant {
+	volatile pid_t process;		// 0 for a free slot
+	volatile pid_t thread;		// 0 while the slot is reserved for a thread not yet started
+	volatile int waiting;
+	volatile long long wake;	// virtual time the wait ends, #CLOCK_NEVER if only a message ends it
+} ClockParticipant;
+
+/**
+ * @brief Data area of the #SHARED_CLOCK_NAME shared memory.
+**/
+typedef struct _ClockShared {
+	volatile long long now;		// virtual time, ns, starts at CLOCK_MONOTONIC
+	volatile int lock;		// spin lock over the rest
+	volatile int running;		// participants not waiting, reserved slots included
+	volatile int inFlight;		// messages written to a pipe and not read yet
+	volatile int external;		// connections and socket messages not picked up yet
+	volatile int released;		// set by #ClockRelease()
+	volatile unsigned long advances;// times the clock was moved
+	ClockParticipant participants[CLOCK_MAX_PARTICIPANTS];
+} ClockShared;
+
+/**
+ * @brief Uses a kernel clock, CLOCK_MONOTONIC until this is called.
+ * @details Ignored once the process has joined the virtual clock.
+**/
+void ClockUseReal(clockid_t clock);
+
+/**
+ * @brief Uses CLOCK_MONOTONIC sped up scale times from epoch, a CLOCK_MONOTONIC time in ns.
+ * @details Ignored once the process has joined the virtual clock.
+**/
+void ClockUseScaled(long long epoch, double scale);
+
+/**
+ * @brief Joins the calling thread to the virtual clock.
+ * @details The children of the process follow it, #CLOCK_ENV is set.
+ * @param create 1 to start a new virtual time, replacing whatever is left of an old one, 0
+ *	  to join the one in use, which is started if there is none.
+ * @return 0 on success, -1 if the shared memory could not be opened.
+**/
+int ClockUseVirtual(int create);
+
+/**
+ * @brief Leaves the virtual clock, and removes it if this process started it.
+ * @details The process is back on CLOCK_MONOTONIC and can start a new virtual time.
+**/
+void ClockClose();
+
+/**
+ * @brief Returns 1 if the process is on the virtual clock, else 0.
+**/
+int ClockIsVirtual();
+
+/**
+ * @brief Returns the time in nanoseconds.
+ * @details Every timestamp the nodes publish (gyro samples, headings, orientations, GPS
+ *	    latencies, I2C statistics, mock device models) comes from here, so they can be
+ *	    compared with each other whichever clock is in use.
+**/
+long long ClockNowNs();
+
+/**
+ * @brief Returns CLOCK_MONOTONIC in nanoseconds, whichever clock #ClockNowNs() is on.
+ * @details The time the nodes spend on their work (mask cleanup, obstacles, filters and the
+ *	    like) is taken from here. It is a cost, paid in real time, and means nothing in the
+ *	    scaled or virtual time of a simulated run.
+**/
+long long ClockMonotonicNs();
+
+/**
+ * @brief Sleeps until an absolute #ClockNowNs() time.
+**/
+void ClockSleepUntil(long long when);
+
+/**
+ * @brief Sleeps for ns nanoseconds of the clock.
+**/
+void ClockSleep(long long ns);
+
+/**
+ * @brief pselect() on the clock.
+ * @param maxFd The largest file descriptor in rdfs, -1 for none.
+ * @param rdfs In, the file descriptors to wait for. Out, those that are readable. May be NULL.
+ * @param when Absolute #ClockNowNs() time to give up at, #CLOCK_NEVER to wait for a file
+ *	  descriptor only.
+ * @return As pselect(): the number of readable file descriptors, 0 at the timeout, -1 on error.
+**/
+int ClockWait(int maxFd, fd_set * rdfs, long long when);
+
+/**
+ * @brief Reserves a virtual clock slot for a thread or child process that is about to start.
+ * @details Until it joins, the new participant counts as running, so virtual time cannot
+ *	    move on while it is still starting up. Does nothing off the virtual clock.
+ * @param process The pid of the child just forked, or 0 for a thread about to be created
+ *	  by the caller.
+**/
+void ClockExpect(pid_t process);
+
+/**
+ * @brief Frees the virtual clock slots of a child process that died without leaving.
+ * @details A process killed by a signal never takes itself off the clock, and the messages
+ *	    left in its pipes are never read, either would keep virtual time from moving on.
+ *	    Does nothing off the virtual clock.
+ * @param process The pid of the child, already waited for.
+ * @param unread Messages written to it that it will never read.
+**/
+void ClockReap(pid_t process, int unread);
+
+/**
+ * @brief Takes the calling thread off the virtual clock, before it returns.
+**/
+void ClockLeave();
+
+/**
+ * @brief Tells the virtual clock the calling thread is about to block outside the library.
+**/
+void ClockIdle();
+
+/**
+ * @brief Tells the virtual clock the calling thread is back from #ClockIdle().
+**/
+void ClockBusy();
+
+/**
+ * @brief Counts a #Message written to a pipe, see #SendMessage().
+**/
+void ClockMessageSent();
+
+/**
+ * @brief Counts a #Message read from a pipe, see #ReceiveMessage().
+**/
+void ClockMessageReceived();
+
+/**
+ * @brief Counts a connection or socket message a participant has sent to tx2_comm_node.c.
+ * @details A controller that is not on the clock sends nothing here, so
+ *	    #ClockExternalReceived() does not count below zero.
+**/
+void ClockExternalSent();
+
+/**
+ * @brief Counts a connection or socket message tx2_comm_node.c has picked up.
+**/
+void ClockExternalReceived();
+
+/**
+ * @brief Lets virtual time run free, for shutting down.
+ * @details Nodes stop reading their pipes once they are told to exit, so messages stay in
+ *	    flight forever and the clock could not move again. After this a timed wait moves
+ *	    the clock to its own wake time and returns.
+**/
+void ClockRelease();
+
+#endif
@@ -66,6 +66,18 @@ struct _CommandNode {
 **/
 int InsertCommand(CmdMsg * cmdMsg, Message * message);
 
+/**
+ * @brief Appends a batch of commands to the command queue.
+ * @details InsertCommands() puts the commands after the last one in the queue, in order, walking
+ *	    the queue once however many there are. Used for the waypoints of a survey, which can
+ *	    number in the thousands.
+ * @param cmdMsgs The commands, in the order they are to be executed.
+ * @param count Number of cmdMsgs.
+ * @param message Output, filled as by #InsertCommand() if the queue was empty.
+ * @return #HEAD_INSERT if the queue was empty, #NON_HEAD_INSERT if not.
+**/
+int InsertCommands(CmdMsg * cmdMsgs, int count, Message * message);
+
 /**
  * @brief Function gets the next command in the command queue.
  * @details GetNextCommand() gets the next command in the queue. As the node at the head of the queue
@@ -101,4 +113,9 @@ void FlushCommands();
 // function used for prototyping. No real purpose apart from testing.
 void PrintCommands();
 
+/**
+ * @brief Returns the number of commands in the queue, the one in execution included.
+**/
+int CountCommands();
+
 #endif
@@ -0,0 +1,108 @@
+/**
+ * @file Coverage.h
+ * @brief Header file for the Coverage library.
+ * @details Header file for the Coverage library. A survey images all of an area, a lawn or a
+ *	    parking lot, and the waypoints used to be queued by hand. This library plans them:
+ *	    back and forth lanes (boustrophedon) #CoverageArea spacing meters apart, running along
+ *	    the heading, over a polygon with holes given in meters from an origin.
+ *	    <br>
+ *	    <br>
+ *	    The polygon is turned so the lanes run along u, and each lane is crossed with the edges
+ *	    it meets, kept sorted by where they start like a polygon fill, so the crossings of one
+ *	    lane are found without looking at every edge. Between pairs of crossings the lane is
+ *	    inside (even-odd, so holes take care of themselves). Where a lane splits around a hole
+ *	    or two parts join again a new cell starts, and each cell, one piece of lane per lane, is
+ *	    swept back and forth on its own before going to the nearest end of the next one.
+ *	    A move to the next lane or the next cell that would cut across a hole or a bend of the
+ *	    outside goes around instead, the shortest way over the corners of the area, which runs
+ *	    along the edges in the way. Along a lane a waypoint is put every photoSpacing meters
+ *	    with a picture taken there.
+ *	    <br>
+ *	    <br>
+ *	    tx2_master.c plans #SURVEY_FILE when a #Survey command comes in and queues the whole
+ *	    plan at once, surveyPlan.c prints a plan and how long it took. The file has "origin lat
+ *	    lon", "spacing", "heading" and "photoSpacing" lines, then "outer" followed by "x y"
+ *	    lines, east and north meters of the origin, and "hole" followed by the same for each
+ *	    hole.
+**/
+
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define SURVEY_FILE "../survey.txt"		/**< Area surveyed by tx2_master.c, see Coverage.h. */
+#define SURVEY_ENV "TX2_SURVEY"			/**< Environment variable, another file than #SURVEY_FILE. */
+#define COVERAGE_MAX_POINTS 1024		/**< Corners of an area, holes included. */
+#define COVERAGE_MAX_RINGS 64			/**< The outside and the holes. */
+#define COVERAGE_MAX_LANES 100000		/**< Lanes planned at most. */
+#define SURVEY_MAX_WAYPOINTS 100000		/**< Waypoints tx2_master.c queues at most. */
+#define SURVEY_CAPTURE_TIMEOUT 10000000000LL	/**< ns tx2_master.c waits for a picture before going on to the next waypoint. */
+
+/**
+ * @brief A point of an area, meters from the origin.
+**/
+typedef struct _CoveragePoint {
+	double x;			// east
+	double y;			// north
+} CoveragePoint;
+
+/**
+ * @brief The area to cover, as read from a survey file.
+**/
+typedef struct _CoverageArea {
+	double latitude;			// of the origin
+	double longitude;
+	double spacing;				// meters between lanes
+	double heading;				// degrees from north the lanes run along
+	double photoSpacing;			// meters between pictures along a lane, 0 for none
+	int ringCount;				// the outside first, then the holes
+	int ringStart[COVERAGE_MAX_RINGS + 1];	// first point of each ring, and one past the last
+	CoveragePoint points[COVERAGE_MAX_POINTS];
+} CoverageArea;
+
+/**
+ * @brief A waypoint of a plan.
+**/
+typedef struct _CoverageWaypoint {
+	double x;
+	double y;
+	int photo;			// take a picture once there
+} CoverageWaypoint;
+
+/**
+ * @brief What a plan came to.
+**/
+typedef struct _CoverageStats {
+	int lanes;			// lanes across the area
+	int segments;			// pieces of lane inside it
+	int cells;			// parts swept on their own
+	int waypoints;
+	int photos;
+	double length;			// meters driven, lanes and the moves between them, around what is in the way
+} CoverageStats;
+
+/**
+ * @brief Reads a survey file.
+ * @return 0 on success, -1 if it is missing or unusable.
+**/
+int CoverageReadArea(char * fileName, CoverageArea * area);
+
+/**
+ * @brief Plans the lanes of an area.
+ * @param waypoints Output, in the order they are driven.
+ * @param max Size of waypoints.
+ * @param stats Output, may be NULL.
+ * @return The number of waypoints, -1 if the area has too many lanes or waypoints.
+**/
+int CoveragePlan(CoverageArea * area, CoverageWaypoint * waypoints, int max, CoverageStats * stats);
+
+/**
+ * @brief The latitude and longitude of a point of an area.
+**/
+void CoverageLatLon(CoverageArea * area, double x, double y, double * latitude, double * longitude);
+
+#endif
@@ -0,0 +1,128 @@
+/**
+ * @file GnssAssist.h
+ * @brief Header file for the GnssAssist library.
+ * @details Header file for the GnssAssist library, hot-start assistance for the XA1110. Started
+ *	    knowing nothing, the module searches every satellite at every Doppler and waits for the
+ *	    ephemeris of each to be broadcast, 30 to 60 s before the first fix, and a mission cannot
+ *	    start before then. Told where it is, what time it is and where the satellites will be,
+ *	    it only has to search the few satellites above it.
+ *	    <br>
+ *	    <br>
+ *	    tx2_gps_node.c keeps the last fix, its altitude and the UTC time it was taken in
+ *	    #GNSS_ASSIST_STATE_FILE, every #GNSS_ASSIST_SAVE_NS while it has fixes and when it is
+ *	    killed. At the next start, before the first read, it gives the module what still holds:
+ *	    <br>
+ *	    <br>
+ *	    time, PMTK740, from the system clock, if the clock agreed with the fixes when the state
+ *	    was saved and has not gone back since, a wrong time is worse than none<br>
+ *	    position, PMTK741 with the time, if the state is at most #GNSS_ASSIST_MAX_AGE_S old<br>
+ *	    EPO, PMTK721 per satellite, the set of #GNSS_ASSIST_EPO_FILE that covers the time.
+ *	    The file is MediaTek's predicted orbits (MTK14.EPO), copied onto the rover from a
+ *	    machine with a network, the rover never downloads it
+ *	    <br>
+ *	    <br>
+ *	    The almanac and ephemeris the module has itself stay in its backup RAM while it has
+ *	    backup power, it hot starts on them by itself, so no restart command is sent. The time
+ *	    from the start of the node to the first fix is printed on every start and appended to
+ *	    #GNSS_ASSIST_TTFF_FILE with the assistance given, to compare starts.
+**/
+
+#ifndef GNSS_ASSIST_H
+#define GNSS_ASSIST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "Messages.h"
+
+#define GNSS_ASSIST_STATE_FILE "../gps_assist.txt"	/**< Last fix, relative to build/. */
+#define GNSS_ASSIST_EPO_FILE "../gps_epo.dat"		/**< EPO data, relative to build/. */
+#define GNSS_ASSIST_TTFF_FILE "../gps_ttff.txt"		/**< Time to first fix of every start, relative to build/. */
+#define GNSS_ASSIST_VERSION 1				/**< Of the state file, another version is not used. */
+#define GNSS_ASSIST_SAVE_NS 60000000000LL		/**< The state is saved this often while there are fixes. */
+#define GNSS_ASSIST_MAX_AGE_S (7 * 86400LL)		/**< Oldest state whose position is given. */
+#define GNSS_ASSIST_CLOCK_MS 2000			/**< Most the system clock may differ from a fix to be trusted. */
+#define GNSS_ASSIST_EPO_RECORD 72			/**< Bytes of EPO per satellite, 18 words of a PMTK721. */
+#define GNSS_ASSIST_EPO_SATELLITES 32			/**< Satellites in an EPO set, 2304 bytes. */
+#define GNSS_ASSIST_EPO_HOURS 6				/**< Hours an EPO set is used for. */
+#define GNSS_ASSIST_GPS_EPOCH 315964800LL		/**< GPS time 0, 1980-01-06, in Unix seconds. */
+#define GNSS_ASSIST_LEAP_SECONDS 18LL			/**< GPS time ahead of UTC. */
+
+/**
+ * @brief Assistance given, #GnssAssistInject() flags.
+**/
+#define GNSS_ASSIST_TIME 1
+#define GNSS_ASSIST_POSITION 2
+#define GNSS_ASSIST_EPO 4
+
+/**
+ * @brief What is kept of the last fix.
+**/
+typedef struct _GnssAssistState {
+	int valid;			// loaded or taken from a fix
+	long long utc;			// Unix seconds of the fix, system clock
+	int clockAgreed;		// the system clock was within #GNSS_ASSIST_CLOCK_MS of the fix
+	double latitude;		// degrees
+	double longitude;
+	float altitude;			// meters above mean sea level
+} GnssAssistState;
+
+/**
+ * @brief The assistance given at a start.
+**/
+typedef struct _GnssAssistReport {
+	int flags;			// #GNSS_ASSIST_TIME, ...
+	long long age;			// seconds since the state was saved, -1 if there was none
+	int epoSatellites;		// records of the EPO set sent
+	char reason[64];		// why the time was not given, "" if it was
+} GnssAssistReport;
+
+/**
+ * @brief Returns the UTC time in ns, CLOCK_REALTIME moved along with #ClockNowNs().
+ * @details On the virtual clock the time runs with it, as the fixes of the simulated XA1110 do.
+**/
+long long GnssAssistUtcNs();
+
+/**
+ * @brief Reads the state.
+ * @param state Output, not valid if the file could not be used.
+ * @return 0 on success, -1 if there is no state or it is of another version.
+**/
+int GnssAssistLoad(GnssAssistState * state, char * fileName);
+
+/**
+ * @brief Writes the state, to fileName.new and renamed over fileName.
+ * @return 0 on success, -1 on error.
+**/
+int GnssAssistSave(GnssAssistState * state, char * fileName);
+
+/**
+ * @brief Takes the state from a fix.
+ * @param position The position published with it.
+ * @param utcNs #GnssAssistUtcNs() it was read at.
+**/
+void GnssAssistUpdate(GnssAssistState * state, GpsMsg * fix, Position * position, long long utcNs);
+
+/**
+ * @brief Gives the XA1110 the assistance that still holds, with #I2CGPSWrite().
+ * @param epoFile EPO data, NULL for none.
+ * @param utcNs #GnssAssistUtcNs().
+ * @param report Output, what was given.
+ * @return The #GNSS_ASSIST_TIME, ... flags given.
+**/
+int GnssAssistInject(GnssAssistState * state, char * epoFile, long long utcNs, GnssAssistReport * report);
+
+/**
+ * @brief Appends a start's time to first fix, "utc ttffMs flags".
+ * @return 0 on success, -1 on error.
+**/
+int GnssAssistRecordTtff(char * fileName, long long utcNs, long long ttffNs, int flags);
+
+/**
+ * @brief Writes the names of the flags, "time position epo", "none" if there are none.
+**/
+void GnssAssistFlagNames(int flags, char * names, int size);
+
+#endif
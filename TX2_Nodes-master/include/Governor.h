@@ -0,0 +1,199 @@
+/**
+ * @file Governor.h
+ * @brief Header file for the Governor library.
+ * @details Header file for the Governor library. tx2_nav_node.c used to ask for the next mask
+ *	    as soon as it was done with one, so the camera node segmented as fast as it could
+ *	    whether the rover was stopped or driving, and on a hot day the TX2 throttled its
+ *	    clocks and everything slowed down at once. The governor picks the mask rate instead:
+ *	    <br>
+ *	    <br>
+ *	    Stopped or waiting, minHz. Turning, maxHz, a turn is stopped on a mask.
+ *	    Driving, a mask every metersPerMask meters at the speed of the rover, and faster near
+ *	    an obstacle, #GOVERNOR_OBSTACLE_MASKS masks before getting to the nearest one. The
+ *	    speed is the one driving forward is commanded at, or estimated from the GPS positions
+ *	    if that is not known (a speed of 0). The rate is kept between minHz and maxHz.
+ *	    <br>
+ *	    <br>
+ *	    The temperatures of the SoC thermal zones (#GOVERNOR_THERMAL_DIR) are read every
+ *	    #GOVERNOR_THERMAL_NS. Once the hottest gets to throttleC the rate is held below a cap
+ *	    falling from maxHz to minHz at criticalC, so the camera node backs off before the
+ *	    kernel throttles it and how long a mask takes stays the same. Each time that starts
+ *	    is a throttle event, it ends #GOVERNOR_HYSTERESIS degrees below throttleC.
+ *	    <br>
+ *	    <br>
+ *	    Once it is known how long one forward command drives the rover (motorMoveMs in
+ *	    Parameters.txt, measured on the rover), nav drives forward #GovernorForwardCount()
+ *	    commands per mask, so the rover keeps its speed at a lower rate and slows down only
+ *	    when the cap holds the rate below the one it wants. Until then it is one command per
+ *	    mask, as before. The rate, why it was picked and the throttle events are published to
+ *	    #GovernorData shared memory.
+**/
+
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <math.h>
+#include "Messages.h"
+
+#define GOVERNOR_THERMAL_DIR "/sys/class/thermal"	/**< Where the thermal zones are. */
+#define GOVERNOR_THERMAL_ENV "TX2_THERMAL"		/**< Environment variable, another directory than #GOVERNOR_THERMAL_DIR. */
+#define GOVERNOR_THERMAL_NS 1000000000LL		/**< Temperatures are read this often, ns. */
+#define GOVERNOR_MAX_ZONES 16				/**< Thermal zones read at most. */
+#define GOVERNOR_HYSTERESIS 3				/**< Degrees below throttleC a throttle event ends. */
+#define GOVERNOR_OBSTACLE_MASKS 20			/**< Masks wanted before getting to the nearest obstacle. */
+#define GOVERNOR_STOPPED 0.05				/**< Meters/sec, slower is stopped. */
+#define GOVERNOR_MAX_HZ 30				/**< Largest rate parameter. */
+
+/**
+ * @brief What the rover is doing.
+**/
+typedef enum _GovernorMotion {
+	GovernorStill,			// stopped, waiting or not driven by nav
+	GovernorForward,
+	GovernorTurning
+} GovernorMotion;
+
+/**
+ * @brief Why the rate was picked.
+**/
+typedef enum _GovernorReason {
+	GovernorIdle,			// minHz, stopped
+	GovernorSpeed,			// metersPerMask
+	GovernorObstacle,		// #GOVERNOR_OBSTACLE_MASKS before the nearest obstacle
+	GovernorTurn,			// maxHz
+	GovernorOff,			// maxHz, metersPerMask is 0
+	GovernorReasons
+} GovernorReason;
+
+/**
+ * @brief The rate published, data area of the #GovernorData shared memory.
+**/
+typedef struct _GovernorState {
+	long long time;			// #ClockNowNs() of the newest update
+	float rate;			// masks/sec asked for
+	float wanted;			// masks/sec before the thermal cap
+	int reason;			// #GovernorReason of wanted
+	float speed;			// meters/sec used
+	float nearest;			// meters to the nearest obstacle, negative for none
+	float temperature;		// hottest thermal zone, degrees C, 0 if there are none
+	int throttled;			// held below wanted by the temperature
+	unsigned long throttleEvents;	// times throttling started
+} GovernorState;
+
+/**
+ * @brief Data area of the #GovernorData shared memory, written by tx2_nav_node.c.
+**/
+typedef struct _GovernorShared {
+	volatile unsigned int sequence;	// odd while the state is being written
+	GovernorState state;
+} GovernorShared;
+
+/**
+ * @brief What the governor has asked for.
+**/
+typedef struct _GovernorStats {
+	unsigned long updates;
+	unsigned long reasons[GovernorReasons];	// updates for each reason
+	unsigned long throttled;		// updates held below wanted
+	unsigned long throttleEvents;
+	double rateSum;				// of the rates, for the average
+	float maxTemperature;
+} GovernorStats;
+
+/**
+ * @brief The limits, temperatures and speed estimate.
+**/
+typedef struct _Governor {
+	float minHz;
+	float maxHz;
+	float metersPerMask;			// 0 for always maxHz
+	float speed;				// meters/sec driving forward, 0 to estimate it
+	int moveMs;				// ms one forward command drives, 0 if not known
+	int throttleC;
+	int criticalC;
+	int zones[GOVERNOR_MAX_ZONES];		// open temp files of the thermal zones
+	int zoneCount;
+	long long nextThermal;			// #ClockNowNs() the temperatures are read again
+	Position lastPosition;			// newest GPS position fed
+	long long lastPositionTime;
+	float estimate;				// meters/sec from the GPS positions, smoothed
+	GovernorState state;
+	GovernorStats stats;
+} Governor;
+
+/**
+ * @brief Starts the governor and opens the thermal zones, there may be none.
+ * @param now #ClockNowNs().
+ * @return The number of thermal zones.
+**/
+int GovernorInit(Governor * governor, long long now);
+
+/**
+ * @brief Sets the limits.
+ * @param minHz Masks/sec while stopped, and the least driving.
+ * @param maxHz Masks/sec at most.
+ * @param metersPerMask Meters driven per mask, 0 for always maxHz.
+ * @param speed Meters/sec of the rover driving forward, 0 to estimate it from the GPS positions.
+ * @param throttleC Degrees C the rate starts to be held down at.
+ * @param criticalC Degrees C the rate is down to minHz at.
+ * @param moveMs Milliseconds one forward command drives the rover for, 0 if not known.
+**/
+void GovernorSetLimits(Governor * governor, float minHz, float maxHz, float metersPerMask, float speed,
+		       int throttleC, int criticalC, int moveMs);
+
+/**
+ * @brief Feeds the governor a GPS position for the speed estimate.
+ * @param accuracy Meters, moves within it are not counted as driving.
+ * @param now #ClockNowNs() it was received.
+**/
+void GovernorFeedPosition(Governor * governor, Position position, float accuracy, long long now);
+
+/**
+ * @brief Picks the rate of the next mask.
+ * @param motion What the rover is doing.
+ * @param nearest Meters to the nearest obstacle, negative for none.
+ * @param now #ClockNowNs().
+ * @return Ns until the mask after it should be asked for, 0 for right away.
+**/
+long long GovernorUpdate(Governor * governor, GovernorMotion motion, float nearest, long long now);
+
+/**
+ * @brief Returns how many forward commands to drive per mask, from the rate wanted before the cap.
+ * @details 1 if how long a command drives is not known.
+**/
+int GovernorForwardCount(Governor * governor);
+
+/**
+ * @brief Returns the name of a #GovernorReason, for logging.
+**/
+char * GovernorReasonName(int reason);
+
+/**
+ * @brief Copies out the statistics.
+**/
+void GovernorGetStats(Governor * governor, GovernorStats * stats);
+
+/**
+ * @brief Closes the thermal zones.
+**/
+void GovernorClose(Governor * governor);
+
+/**
+ * @brief Publishes the newest #GovernorState to #GovernorData shared memory.
+**/
+void PublishGovernor(GovernorShared * shared, GovernorState * state);
+
+/**
+ * @brief Reads the #GovernorState without blocking the writer.
+ * @details Copied until it was copied with an even, unchanged sequence, as #GetObstacles().
+ * @return 0 on success, -1 if nothing has been published.
+**/
+int GetGovernor(GovernorShared * shared, GovernorState * state);
+
+#endif
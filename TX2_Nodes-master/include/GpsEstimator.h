@@ -0,0 +1,118 @@
+/**
+ * @file GpsEstimator.h
+ * @brief Header file for the GpsEstimator library.
+ * @details Header file for the GpsEstimator library. This library turns the stream of fixes read
+ *	    by tx2_gps_node.c into a position estimate. Fixes are weighted by the quality the XA1110
+ *	    reports for them (HDOP, satellites in use, SBAS correction), fixes that disagree with the
+ *	    median of the recent ones are rejected, and the number of fixes averaged shrinks as the
+ *	    rover speeds up so the estimate does not lag behind it. The estimate is published with
+ *	    an accuracy figure in a #PositionEstimate.
+ *	    <br>
+ *	    <br>
+ *	    The equal weight moving average the GPS node used before is kept here as well
+ *	    (#AddPosition(), #GetPositionAverage()) so gpsReplay.c can compare the two on recorded data.
+**/
+
+#ifndef GPS_ESTIMATOR_H
+#define GPS_ESTIMATOR_H
+
+#include <string.h>
+#include <math.h>
+#include "Messages.h"
+
+#define GPS_AVERAGE_COUNT 5 		/**< Fixes averaged by the legacy moving average. */
+
+#define GPS_ESTIMATOR_WINDOW 10		/**< Most fixes the estimator will average. */
+#define GPS_UERE 2.5f			/**< User equivalent range error, meters. sigma = UERE * HDOP */
+#define GPS_DEFAULT_HDOP 2.0f		/**< HDOP assumed when the module did not report one (GLL only). */
+#define GPS_DGPS_FACTOR 0.6f		/**< Scales sigma of differential (SBAS) fixes. */
+#define GPS_FEW_SATELLITES 5		/**< Below this many satellites sigma is doubled. */
+#define GPS_GATE_SIGMAS 3.0f		/**< Innovation gate, in combined sigmas. */
+#define GPS_MAX_REJECTS 3		/**< Consecutive rejections before the window is restarted. */
+#define GPS_TURN_RESET 30.0f		/**< Course change (degrees) that drops fixes from before a turn. */
+#define GPS_MIN_COURSE_SPEED 0.5f	/**< Speed (m/s) below which the reported course is ignored. */
+
+/**
+ * @brief Internal struct used to keep track of a moving #Position average.
+**/
+typedef struct _Positions {
+	Position position[GPS_AVERAGE_COUNT];
+	int head;
+	int positionCount;
+} Positions;
+
+/**
+ * @brief A fix held by the estimator, in meters east/north of the estimator's reference point.
+**/
+typedef struct _EstimatorFix {
+	double east;
+	double north;
+	double sigma;			// 1 sigma horizontal error of this fix, meters
+	unsigned int time;		// UTC ms since midnight
+} EstimatorFix;
+
+/**
+ * @brief State of the fix-quality-weighted position estimator.
+ * @details The window is a ring buffer of the newest accepted fixes. Positions are kept in a local
+ *	    east/north plane around the first fix to keep the arithmetic in meters.
+**/
+typedef struct _GpsEstimator {
+	EstimatorFix fixes[GPS_ESTIMATOR_WINDOW];
+	int head;
+	int count;
+	int rejects;			// consecutive rejected fixes
+	double referenceLatitude;
+	double referenceLongitude;
+	double metersPerDegreeLon;
+	int referenceSet;
+	float lastCourse;
+	int courseValid;
+	unsigned int lastTime;
+	unsigned long accepted;
+	unsigned long rejected;
+} GpsEstimator;
+
+/**
+ * @brief Function adds a new position to the #Positions struct.
+ * @details Function adds a new position to the #Positions struct. The #Position array  witin
+ * 	    #Positions is used as a ring buffer, each new #Position overwrites the oldest value
+ * 	    in the array.
+ * @param positions A pointer to the #Positions struct being modified.
+ * @param p1 The new #Position being added to the array in #Positions.
+**/
+void AddPosition(Positions * positions, Position * p1);
+
+/**
+ * @brief Function calculates the moving average for the positions in #Positions struct.
+ * @details Function calculates the moving average for the positions in #Positions struct.
+ * 	    It should be noted that this function assumes that the positions array is full
+ * 	    of current values. If there arent #GPS_AVERAGE_COUNT values in the array, the
+ * 	    behavior of this function is unpredictable.
+**/
+void GetPositionAverage(Positions * positions, Position * average);
+
+/**
+ * @brief Resets a #GpsEstimator.
+ * @post The estimator holds no fixes and will take its reference point from the next fix.
+**/
+void InitEstimator(GpsEstimator * estimator);
+
+/**
+ * @brief Feeds a new fix to the estimator and produces an updated estimate.
+ * @details The fix is given a sigma from its HDOP, fix quality and satellite count. It is then
+ *	    compared against the median of the fixes in the window; if it is further away than
+ *	    #GPS_GATE_SIGMAS combined sigmas (plus the distance the rover could have covered) it is
+ *	    rejected. #GPS_MAX_REJECTS rejections in a row restart the window at the new fix, as
+ *	    the old fixes are then the ones that are wrong. A course change of more than
+ *	    #GPS_TURN_RESET degrees drops the fixes from before the turn. While moving, the window
+ *	    is sized to minimize the noise of the average plus the square of its lag, half the
+ *	    window times the distance travelled per fix. The estimate is the inverse variance
+ *	    weighted mean of the window.
+ * @param estimator The #GpsEstimator.
+ * @param fix The new fix, as returned by #I2CGPSRead().
+ * @param estimate Output, the new estimate. Only written if 1 is returned.
+ * @return 1 if the fix was accepted and estimate was updated, 0 if the fix was rejected.
+**/
+int UpdateEstimator(GpsEstimator * estimator, GpsMsg * fix, PositionEstimate * estimate);
+
+#endif
@@ -0,0 +1,131 @@
+/**
+ * @file Hal.h
+ * @brief Header file for the Hal library.
+ * @details Header file for the Hal (hardware abstraction layer) library. Every piece of hardware
+ *	    the nodes touch has a backend for the TX2 on the rover and one or more for a plain
+ *	    Linux host, so the whole node tree can be started, and benchmarked, on any Linux box:
+ *	    <br>
+ *	    <br>
+ *	    CAN (#CanBackend): the TX2's can0 with the tegra modules loaded, a virtual CAN
+ *	    interface (vcan0) whose frames can be watched with candump or answered by a simulated
+ *	    motor controller, none, where frames are counted and dropped, or sim, where they
+ *	    drive the rover of roverSim.c.
+ *	    <br>
+ *	    I2C (#I2CSource): /dev/i2c-N, the chip models of I2CMock.h, or the same models playing
+ *	    back #HAL_NMEA_REPLAY_FILE and #HAL_GYRO_REPLAY_FILE, or reporting the rover of roverSim.c.
+ *	    <br>
+ *	    Camera (#CameraBackend): the Jetson camera and segmentation network of tx2_cam_node.cpp,
+ *	    or tx2_host_cam_node.c with a V4L2 camera, a recording of masks, or masks rendered
+ *	    from the map of roverSim.c, see Camera.h.
+ *	    <br>
+ *	    Clock (#ClockBackend): the clock every timestamp and timed wait of the nodes is taken
+ *	    from, see Clock.h. sim is the simulated time of roverSim.c, faster than real time,
+ *	    virtual a time that moves only when every node is waiting.
+ *	    <br>
+ *	    <br>
+ *	    The sim backends need roverSim.c to be running, see Simulation.h.
+ *	    <br>
+ *	    <br>
+ *	    The backends are chosen in Parameters.txt (canBackend, i2cBackend, cameraBackend,
+ *	    clockBackend) and default to the rover's hardware. They are read once, at startup:
+ *	    tx2_master.c picks the camera node to start, and each node, master included, calls
+ *	    #HalInit() before it opens any hardware or takes a timestamp, which takes the choices
+ *	    from the #ParameterData snapshot master has published. Changing them in a running
+ *	    system has no effect until it is restarted.
+**/
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Clock.h"
+
+#define HAL_CAN_INTERFACE "can0"			/**< Interface of the #CanSocketCan backend. */
+#define HAL_VCAN_INTERFACE "vcan0"			/**< Interface of the #CanVirtual backend, created if missing. */
+#define HAL_NMEA_REPLAY_FILE "../gps_record.nmea"	/**< NMEA played by #I2CSourceReplay, recorded by tx2_gps_node.c. */
+#define HAL_GYRO_REPLAY_FILE "../gyro_profile.txt"	/**< Z rate profile played by #I2CSourceReplay, see I2CMock.h. */
+
+/**
+ * @brief Where CAN frames go, the order of the canBackend choices in Parameters.txt.
+**/
+typedef enum _CanBackend {
+	CanSocketCan,		// "socketcan", #HAL_CAN_INTERFACE on the TX2's mttcan controller
+	CanVirtual,		// "vcan", #HAL_VCAN_INTERFACE
+	CanNone,		// "none", frames are dropped
+	CanSim			// "sim", frames go to roverSim.c
+} CanBackend;
+
+/**
+ * @brief Where the I2C devices are, the order of the i2cBackend choices in Parameters.txt.
+**/
+typedef enum _I2CSource {
+	I2CSourceDevice,	// "device", /dev/i2c-N
+	I2CSourceMock,		// "mock", the I2CMock.h models
+	I2CSourceReplay,	// "replay", the models playing back recorded data
+	I2CSourceSim		// "sim", the models reporting the rover of roverSim.c
+} I2CSource;
+
+/**
+ * @brief Where segmentation masks come from, the order of the cameraBackend choices in Parameters.txt.
+**/
+typedef enum _CameraBackend {
+	CameraJetson,		// "jetson", tx2_cam_node.cpp
+	CameraV4L2,		// "v4l2", tx2_host_cam_node.c with a V4L2 camera
+	CameraReplay,		// "replay", tx2_host_cam_node.c playing a mask recording
+	CameraSim		// "sim", tx2_host_cam_node.c rendering the map of roverSim.c
+} CameraBackend;
+
+/**
+ * @brief Which clock the nodes use, the order of the clockBackend choices in Parameters.txt.
+**/
+typedef enum _ClockBackend {
+	ClockMonotonic,		// "monotonic", CLOCK_MONOTONIC
+	ClockBoottime,		// "boottime", CLOCK_BOOTTIME, keeps counting while a host is suspended
+	ClockSim,		// "sim", the simulated time of roverSim.c
+	ClockVirtual		// "virtual", the virtual clock of Clock.h, time moves when every node waits
+} ClockBackend;
+
+/**
+ * @brief The backends in use.
+**/
+typedef struct _HalConfig {
+	int can;		// #CanBackend
+	int i2c;		// #I2CSource
+	int camera;		// #CameraBackend
+	int clock;		// #ClockBackend
+} HalConfig;
+
+/**
+ * @brief Chooses the backends for this process.
+ * @details Takes the choices from the #ParameterData snapshot published by tx2_master.c. A
+ *	    process started without master, a tool for example, reads #PARAMETERS_FILE instead,
+ *	    and if that fails too the rover's hardware is used. The I2C choice is passed on to
+ *	    I2CBus.c through the environment (#I2C_BACKEND_ENV and the I2CMock.h variables), unless
+ *	    those are already set, so they can still be overridden by hand.
+ * @param config Output, may be NULL.
+ * @return 0 on success, -1 if the defaults are in use.
+ * @post #ClockNowNs() uses the chosen clock. If the sim clock is chosen but roverSim.c is not
+ *	 running, CLOCK_MONOTONIC is used.
+**/
+int HalInit(HalConfig * config);
+
+/**
+ * @brief Returns the backends chosen by #HalInit(), the rover's hardware before it is called.
+**/
+HalConfig * HalGetConfig();
+
+/**
+ * @brief Returns the parameters #HalInit() read, all zero before it is called or if it read none.
+ * @details For the site settings a node only needs when it starts, magDeclination for one.
+**/
+struct parameters * HalGetParameters();
+
+/**
+ * @brief Prints the backends in use on one line.
+**/
+void HalPrintConfig(char * node);
+
+#endif
@@ -0,0 +1,138 @@
+/**
+ * @file Heading.h
+ * @brief Header file for the Heading library.
+ * @details Header file for the Heading library. tx2_gyro_node.c samples the gyroscope
+ *	    continuously and integrates the Z rate into a heading, with the gyro bias learned
+ *	    whenever the rover is standing still. Every sample is published to shared memory
+ *	    (#HeadingData) as a #HeadingSample, and the last #HEADING_HISTORY samples are kept.
+ *	    Other nodes use the query functions below to get the current heading and rate, the
+ *	    heading at any time in the last ~17 seconds, or the angle turned since a given time,
+ *	    without sending the gyro node a request.
+ *	    <br>
+ *	    <br>
+ *	    The heading is in degrees, positive for left turns as the gyro has always reported, and
+ *	    is not wrapped so differences between two times are simply subtracted. All times are
+ *	    nanoseconds of the clock chosen in Hal.h, see #HeadingNowNs().
+ *	    <br>
+ *	    <br>
+ *	    There is a single writer. A reader copies the samples it needs and then checks the
+ *	    sample count again to make sure the writer has not overwritten them in the meantime.
+**/
+
+#ifndef HEADING_H
+#define HEADING_H
+
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "I2CGyro.h"
+
+#define HEADING_HISTORY 4096		/**< Samples kept, ~17 s at 238 Hz. */
+#define HEADING_STILL_RATE 2.0f		/**< Degrees/sec, below this (bias removed) the rover may be still. */
+#define HEADING_STILL_ACCEL 0.05f	/**< g, acceleration magnitude change allowed while still. */
+#define HEADING_STILL_TIME 0.5		/**< Seconds the above must hold before the bias is learned. */
+#define HEADING_BIAS_TAU 5.0		/**< Seconds, time constant of the bias estimate. */
+
+#define TURN_START_RATE 20.0f		/**< Degrees/sec that starts a turn measurement. */
+#define TURN_RATE 10.0f			/**< Degrees/sec above which the rover is still turning. */
+#define TURN_SETTLE_TIME 0.1		/**< Seconds below #TURN_RATE before a turn is over. */
+#define TURN_MIN_TIME 0.3		/**< Seconds a turn must last to be reported. */
+#define TURN_IDLE_TIMEOUT 2.0		/**< Seconds without a turn before #MeasureTurn() gives up. */
+#define TURN_POLL_NS 10000000L		/**< How often #MeasureTurn() checks for new samples. */
+
+/**
+ * @brief One published gyro sample.
+**/
+typedef struct _HeadingSample {
+	long long time;		// #ClockNowNs() ns
+	double heading;		// integrated heading, degrees
+	float rate;		// yaw rate with the bias removed, degrees/sec
+	float bias;		// bias estimate at this sample, degrees/sec
+} HeadingSample;
+
+/**
+ * @brief Data area of the #HeadingData shared memory.
+**/
+typedef struct _HeadingShared {
+	volatile unsigned long long count;		// samples published so far
+	HeadingSample history[HEADING_HISTORY];		// ring buffer, sample n is at n % HEADING_HISTORY
+} HeadingShared;
+
+/**
+ * @brief State kept by the writer while integrating.
+**/
+typedef struct _HeadingIntegrator {
+	double heading;
+	double bias;
+	double stillTime;		// seconds the rover has looked still
+	double accelAverage;		// slow average of the acceleration magnitude, g
+	long long biasSamples;		// samples the bias has been learned from
+	long long lastTime;
+} HeadingIntegrator;
+
+/**
+ * @brief Returns #ClockNowNs(), the time base of all heading samples.
+**/
+long long HeadingNowNs();
+
+/**
+ * @brief Resets a #HeadingIntegrator, heading and bias start at 0.
+**/
+void InitHeading(HeadingIntegrator * integrator);
+
+/**
+ * @brief Integrates one #GyroSample.
+ * @details The Z rate, less the bias, is integrated over the time since the previous sample.
+ *	    When the rate and acceleration have been steady for #HEADING_STILL_TIME the rover is
+ *	    taken to be still and the bias is moved toward the measured rate. The bias is a plain
+ *	    average of the first still samples, then a moving average with a #HEADING_BIAS_TAU
+ *	    time constant.
+ * @param integrator The #HeadingIntegrator.
+ * @param sample The new sample.
+ * @param out Output, the sample to publish.
+**/
+void IntegrateHeading(HeadingIntegrator * integrator, GyroSample * sample, HeadingSample * out);
+
+/**
+ * @brief Publishes a sample to shared memory. Only the gyro node calls this.
+**/
+void PublishHeading(HeadingShared * shared, HeadingSample * sample);
+
+/**
+ * @brief Copies the newest published sample.
+ * @return 0 on success, -1 if nothing has been published yet.
+**/
+int GetLatestHeading(HeadingShared * shared, HeadingSample * sample);
+
+/**
+ * @brief Returns the heading at a given time, interpolated between samples.
+ * @param shared The #HeadingData shared memory.
+ * @param time #ClockNowNs() ns. Times after the newest sample get the newest heading.
+ * @param heading Output, degrees.
+ * @return 0 on success, -1 if time is older than the history.
+**/
+int HeadingAt(HeadingShared * shared, long long time, double * heading);
+
+/**
+ * @brief Returns the angle turned since a given time.
+ * @param shared The #HeadingData shared memory.
+ * @param since #ClockNowNs() ns, typically taken with #HeadingNowNs() before a turn command.
+ * @param angle Output, degrees, positive for left turns.
+ * @return 0 on success, -1 if since is older than the history.
+**/
+int AngleSince(HeadingShared * shared, long long since, double * angle);
+
+/**
+ * @brief Blocks until a turn started after since has completed.
+ * @details Follows the published samples: a turn starts when the rate exceeds
+ *	    #TURN_START_RATE and ends once it has stayed under #TURN_RATE for #TURN_SETTLE_TIME.
+ *	    Turns shorter than #TURN_MIN_TIME are ignored. The angle reported is the whole heading
+ *	    change since since, not just the samples above the thresholds.
+ * @param shared The #HeadingData shared memory.
+ * @param since #ClockNowNs() ns the turn command was sent at.
+ * @param angle Output, degrees, positive for left turns. Set in both cases.
+ * @return 0 if a turn was measured, -1 if none started within #TURN_IDLE_TIMEOUT.
+**/
+int MeasureTurn(HeadingShared * shared, long long since, float * angle);
+
+#endif
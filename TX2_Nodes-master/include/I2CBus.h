@@ -0,0 +1,178 @@
+/**
+ * @file I2CBus.h
+ * @brief Header file for the I2CBus library.
+ * @details Header file for the I2CBus library. This library is the only code that talks to
+ *	    /dev/i2c-N. The device libraries (I2CGPS.c, I2CGyro.c) open an #I2CDevice for their
+ *	    chip and hand it transactions, lists of write and read messages that are sent with a
+ *	    single I2C_RDWR ioctl (a register write followed by a burst read with a repeated start,
+ *	    for example). The library applies the device's #I2CRetryPolicy to failed transactions
+ *	    and keeps #I2CDeviceStats for each device.
+ *	    <br>
+ *	    <br>
+ *	    Setting the environment variable #I2C_BACKEND_ENV to "mock" replaces the bus with the
+ *	    models in I2CMock.c, which let the GPS and gyro nodes run, and be benchmarked, without
+ *	    hardware. See I2CMock.h for how the models are scripted.
+**/
+
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#define I2C_BACKEND_ENV "I2C_BACKEND"	/**< Environment variable selecting the backend, "mock" or unset. */
+#define I2C_MAX_MESSAGES 8		/**< Most messages in one transaction. */
+#define I2C_MAX_WRITE 128		/**< Most bytes in one write message, the data is copied. */
+
+#define I2C_DEFAULT_ATTEMPTS 3		/**< Default #I2CRetryPolicy, tries per transaction. */
+#define I2C_DEFAULT_BACKOFF_US 200	/**< Default #I2CRetryPolicy, wait before the first retry. */
+#define I2C_DEFAULT_MAX_BACKOFF_US 10000 /**< Default #I2CRetryPolicy, the wait doubles up to this. */
+
+/**
+ * @brief Which backend an #I2CDevice is using.
+**/
+typedef enum _I2CBackend {
+	I2CBackendDevice,	// /dev/i2c-N
+	I2CBackendMock		// I2CMock.c models
+} I2CBackend;
+
+/**
+ * @brief How failed transactions are retried.
+ * @details A transaction that fails with a transient error (NACK, arbitration lost, timeout,
+ *	    busy) is tried again up to attempts times in total. The wait between attempts starts
+ *	    at backoffUs and doubles up to maxBackoffUs. Other errors fail straight away.
+**/
+typedef struct _I2CRetryPolicy {
+	int attempts;
+	long backoffUs;
+	long maxBackoffUs;
+} I2CRetryPolicy;
+
+/**
+ * @brief Counters kept for each #I2CDevice.
+**/
+typedef struct _I2CDeviceStats {
+	unsigned long transactions;	// transactions completed
+	unsigned long messages;		// messages in those transactions
+	unsigned long bytesRead;
+	unsigned long bytesWritten;
+	unsigned long retries;		// attempts after the first
+	unsigned long failures;		// transactions that failed after all attempts
+	long long busyNs;		// time spent in transactions, including backoff
+	long long maxNs;		// longest transaction
+} I2CDeviceStats;
+
+/**
+ * @brief A chip on an I2C bus.
+**/
+typedef struct _I2CDevice {
+	char name[16];
+	int address;
+	int fd;
+	I2CBackend backend;
+	void * mock;			// model state, mock backend only
+	I2CRetryPolicy policy;
+	I2CDeviceStats stats;
+} I2CDevice;
+
+/**
+ * @brief A list of messages sent with a single ioctl.
+ * @details Build with #I2CBegin(), #I2CAddWrite() and #I2CAddRead(), then send with
+ *	    #I2CTransfer(). Write data is copied into the transaction, read buffers are filled in
+ *	    place.
+**/
+typedef struct _I2CTransaction {
+	struct i2c_msg msgs[I2C_MAX_MESSAGES];
+	unsigned char writeData[I2C_MAX_MESSAGES][I2C_MAX_WRITE];
+	int count;
+} I2CTransaction;
+
+/**
+ * @brief Opens a device on an I2C bus.
+ * @param device The #I2CDevice being opened.
+ * @param bus Linux device path, e.g. "/dev/i2c-1". Ignored by the mock backend.
+ * @param address 7 bit slave address.
+ * @param name Name used in statistics. The mock backend picks its model by address.
+ * @return 0 on success, -1 on error.
+ * @post The device has the default #I2CRetryPolicy and zeroed #I2CDeviceStats.
+**/
+int I2COpen(I2CDevice * device, char * bus, int address, char * name);
+
+/**
+ * @brief Closes a device opened with #I2COpen().
+**/
+void I2CClose(I2CDevice * device);
+
+/**
+ * @brief Replaces the #I2CRetryPolicy of a device.
+**/
+void I2CSetRetryPolicy(I2CDevice * device, I2CRetryPolicy * policy);
+
+/**
+ * @brief Starts building a transaction.
+**/
+void I2CBegin(I2CTransaction * transaction);
+
+/**
+ * @brief Adds a write message to a transaction.
+ * @return 0 on success, -1 if the transaction is full or data is longer than #I2C_MAX_WRITE.
+**/
+int I2CAddWrite(I2CTransaction * transaction, I2CDevice * device, void * data, int length);
+
+/**
+ * @brief Adds a read message to a transaction.
+ * @param buffer Filled in by #I2CTransfer().
+ * @return 0 on success, -1 if the transaction is full.
+**/
+int I2CAddRead(I2CTransaction * transaction, I2CDevice * device, void * buffer, int length);
+
+/**
+ * @brief Sends a transaction, retrying it according to the device's #I2CRetryPolicy.
+ * @param device The device statistics and policy are taken from.
+ * @param transaction The transaction.
+ * @return 0 on success, -1 on failure with errno set by the last attempt.
+**/
+int I2CTransfer(I2CDevice * device, I2CTransaction * transaction);
+
+/**
+ * @brief Writes a single register, register address then value in one message.
+**/
+int I2CWriteRegister(I2CDevice * device, int registerAddress, unsigned char value);
+
+/**
+ * @brief Reads consecutive registers, the register address write and the burst read are one transaction.
+ * @return Number of bytes read, -1 on failure.
+**/
+int I2CReadRegisters(I2CDevice * device, int registerAddress, void * buffer, int length);
+
+/**
+ * @brief Writes raw data, for devices without registers.
+ * @return Number of bytes written, -1 on failure.
+**/
+int I2CWrite(I2CDevice * device, void * data, int length);
+
+/**
+ * @brief Reads raw data, for devices without registers.
+ * @return Number of bytes read, -1 on failure.
+**/
+int I2CRead(I2CDevice * device, void * buffer, int length);
+
+/**
+ * @brief Copies out the statistics of a device.
+**/
+void I2CGetStats(I2CDevice * device, I2CDeviceStats * stats);
+
+/**
+ * @brief Prints the statistics of a device on one line.
+**/
+void I2CPrintStats(I2CDevice * device);
+
+#endif
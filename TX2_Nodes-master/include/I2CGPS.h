@@ -11,13 +11,21 @@
 
 #include <string.h>
 #include <stdio.h>
-#include <linux/i2c-dev.h>
-#include <sys/ioctl.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <stdint.h>
 #include "Messages.h"
+#include "I2CBus.h"
+
+#define GPS_I2C_BUS "/dev/i2c-1"	/**< Bus the XA1110 is on. */
+#define GPS_ADDRESS 0x10		/**< Slave address of the XA1110. */
+
+/**
+ * @brief #I2CRetryPolicy of the XA1110, it NACKs while busy. Tries, first backoff (us), max backoff (us).
+**/
+#define GPS_RETRY_POLICY { 5, 1000, 10000 }
 
 /**
  * @brief Copies location p2 over to position p1.
@@ -38,29 +46,73 @@
 			((p1).longitude += (p2).longitude)
 
 /**
- * @brief Opens file for I2C bus that GNSS module is attached to.
- * @details Opens the file for the I2C bus the GNSS module is attached to and attaches 
- *	    slave address to the I2C file descriptor.
- * @return Returns the file descriptor for the I2C bus.
+ * @brief Number of bytes requested per I2C read when draining the XA1110 buffer.
+**/
+#define I2C_GPS_CHUNK_SIZE 64
+
+/**
+ * @brief Upper bound on reads per drain, keeps a misbehaving module from holding the bus.
+**/
+#define I2C_GPS_MAX_CHUNKS 32
+
+/**
+ * @brief Most bytes written to the XA1110 in one transaction by #I2CGPSWriteRaw().
+**/
+#define I2C_GPS_WRITE_CHUNK 255
+
+/**
+ * @brief Byte the XA1110 returns once its output buffer is empty.
+**/
+#define I2C_GPS_PADDING '\n'
+
+/**
+ * @brief #I2CGPSRead() return values.
+**/
+#define GPS_READ_FIX 1		// new valid fix parsed
+#define GPS_READ_NO_FIX 0	// NMEA data was read, but no valid fix in it
+#define GPS_READ_EMPTY -1	// module buffer was empty, only padding read
+
+/**
+ * @brief Bus and parser counters kept by the I2CGPS library.
+ * @details Counters are cumulative from #I2CGPSOpen(). The GPS node uses them to report how
+ *	    much bus traffic is spent per fix and how much of it is padding.
+**/
+typedef struct _I2CGPSStats {
+	unsigned long transactions;	// I2C read transactions issued
+	unsigned long bytesRead;	// total bytes returned by the module
+	unsigned long paddingBytes;	// bytes of padding read after the buffer emptied
+	unsigned long readErrors;	// failed reads
+	unsigned long sentences;	// complete NMEA sentences assembled
+	unsigned long checksumErrors;	// GNGLL sentences with a bad checksum
+	unsigned long bytesWritten;	// by #I2CGPSWriteRaw()
+	unsigned long writeErrors;	// of #I2CGPSWriteRaw()
+	I2CDeviceStats bus;		// bus statistics of the XA1110
+} I2CGPSStats;
+
+/**
+ * @brief Opens the GNSS module on #GPS_I2C_BUS.
+ * @details Opens the GNSS module through the I2CBus library, with the #GPS_RETRY_POLICY.
+ * @return 0 on success, -1 on error.
  * @post The I2C bus the GNSS module is attached to is ready for reading/writing.
 **/
 int I2CGPSOpen();
 
 /**
  * @brief Reads from GNSS module.
- * @details I2CGPSRead() reads from the GNSS module. It is also parses the NMEA data returned
- *	    and extracts the latitude and longitude. The #Message struct that is passed in
- *	    is assigned the extracted values. This function also checks the checksum received
- *	    NMEA data to make sure the returned message is correct.
+ * @details I2CGPSRead() drains the GNSS module's output buffer. Reads are issued in chunks of
+ *	    #I2C_GPS_CHUNK_SIZE bytes until the module starts returning padding, so a whole burst
+ *	    of NMEA sentences is collected in as few transactions as possible without reading a
+ *	    full 255 byte block of padding every time. The NMEA data is parsed as it arrives and
+ *	    GGA, GLL and VTG packets of the burst are merged into the gpsMsg member of the #Message
+ *	    struct; position, UTC fix time (milliseconds since midnight), fix quality, satellites,
+ *	    HDOP, altitude, correction age, course and speed. Checksums are verified.
  * @param message The #Message struct used to assign the latitude and longitude coordinates.
- * @return As the NMEA data is stored in a buffer in the GNSS module, we may not receive an
- *	   entire packet, we may only get half. If either this situation occurs, or there is no
- *	   fix on GNSS satellites, the return value is 0. A 0 is also returned in the scenario
- *	   that the checksum received from the GNSS module does not match what this function 
- *	   calculated. Else, if valid latitude and longitude coordinates are extracted, the return value is 1.
+ * @return #GPS_READ_FIX if a valid fix was parsed, #GPS_READ_NO_FIX if NMEA data was read but
+ *	   held no fix (no satellite lock, bad checksum or a sentence split across bursts), and
+ *	   #GPS_READ_EMPTY if the module had nothing buffered. A sentence cut off by the end of a
+ *	   drain is retained and completed by the next call.
  * @post The #Message struct that is passed in as a parameter will have the most recent GNSS
- *	 latitude and longitude coordinates. 1 will be returned if the GNSS data is valid, 0
- *	 if there is either no fix or half of a packet was received.
+ *	 latitude and longitude coordinates if #GPS_READ_FIX is returned.
 **/
 int I2CGPSRead(Message * message);
 
@@ -78,9 +130,41 @@ int I2CGPSRead(Message * message);
 int I2CGPSWrite(char * command);
 
 /**
- * @brief Closes the I2C file.
- * @details Closes the I2C file via the I2C file descriptor.
+ * @brief Writes binary data to the GNSS module as it is, RTCM corrections for example.
+ * @details The data is written in transactions of at most #I2C_GPS_WRITE_CHUNK bytes.
+ * @return The bytes written, -1 on error.
+**/
+int I2CGPSWriteRaw(uint8_t * data, int length);
+
+/**
+ * @brief Parses a buffer of NMEA data without touching the bus.
+ * @details Runs the same parser #I2CGPSRead() uses over a buffer, typically one burst taken from a
+ *	    recording made with #I2CGPSRecord(). Used by tools that replay recorded GNSS data.
+ * @param data The NMEA data.
+ * @param length Number of bytes in data.
+ * @param fix Output, holds the fix if one was found.
+ * @return #GPS_READ_FIX if a valid fix was parsed, else #GPS_READ_NO_FIX.
+**/
+int I2CGPSParse(char * data, int length, GpsMsg * fix);
+
+/**
+ * @brief Records the raw NMEA data read from the module.
+ * @details Every drain performed by #I2CGPSRead() is written to fd without the padding, preceded
+ *	    by a line holding a single '#' so the bursts can be told apart on replay. Pass -1 to
+ *	    stop recording.
+ * @param fd File descriptor the data is written to.
+**/
+void I2CGPSRecord(int fd);
+
+/**
+ * @brief Copies the library's bus and parser counters.
+ * @param stats The #I2CGPSStats struct the counters are copied into.
+**/
+void I2CGPSGetStats(I2CGPSStats * stats);
+
+/**
+ * @brief Closes the GNSS module.
 **/
-void CloseI2C();
+void I2CGPSClose();
 
 #endif
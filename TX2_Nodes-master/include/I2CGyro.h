@@ -5,6 +5,19 @@
  * @brief Header file for the I2CGyro library
  * @details Header file for the I2CGyro library. Function prototypes (non-internal functions!), macros, and typedefs
  * 	    can be found here.
+ * 	    <br>
+ * 	    <br>
+ * 	    The LSM9DS1 is run with its hardware FIFO in continuous mode. The accelerometer and
+ * 	    gyroscope both sample at 238 Hz into the FIFO, which holds 32 samples (~134 ms). The
+ * 	    caller wakes up roughly every #GYRO_FIFO_THRESHOLD samples (#GyroFifoPeriodNs()) and
+ * 	    collects everything queued with #GyroFifoRead(), which costs one status read and one
+ * 	    burst read regardless of the number of samples. Every sample is given a #ClockNowNs()
+ * 	    timestamp, spaced by the sample period the device is actually running at.
+ * 	    <br>
+ * 	    <br>
+ * 	    The magnetometer is a separate device on the same bus (#MAG_ADDRESS) without a FIFO.
+ * 	    It runs at 80 Hz and #MagRead() returns the newest X/Y/Z field in one burst read,
+ * 	    already turned into the axes of the accelerometer and gyroscope.
 **/
 
 #ifndef I2CGYRO_H
@@ -12,47 +25,167 @@
 
 #include <stdio.h>
 #include <string.h>
-#include <linux/i2c-dev.h>
-#include <sys/ioctl.h>
 #include <unistd.h>
-#include <fcntl.h>
 #include <errno.h>
 #include <math.h>
+#include <time.h>
+#include "I2CBus.h"
+
+#define GYRO_I2C_BUS "/dev/i2c-0"	/**< Bus the LSM9DS1 is on. */
+#define GYRO_ADDRESS 0x6B		/**< Slave address of the LSM9DS1 accelerometer/gyroscope. */
+#define MAG_ADDRESS 0x1E		/**< Slave address of the LSM9DS1 magnetometer. */
 
 // register addresses and register value macros
 #define CTRL_1_G 0x10
+#define CTRL_4   0x1E
 #define CTRL_6_X 0x20
+#define CTRL_8   0x22
+#define CTRL_9   0x23
+#define FIFO_CTRL 0x2E
+#define FIFO_SRC 0x2F
+#define OUT_X_G  0x18
+#define OUT_Z_G  0x1C
 #define ODR_238  0x80
-#define USEC_238HZ  4202
-#define SAMPLE_T 0.0042f
 
-typedef struct i2c {
-	char registerAddress;
-	char Buffer[6];
-        short int bytes;
-} I2C; /**< Struct containing the address being read from/written to, the number of bytes, and the buffer where the input/output is stored*/
+// magnetometer register addresses
+#define WHO_AM_I_M  0x0F
+#define CTRL_1_M    0x20
+#define CTRL_2_M    0x21
+#define CTRL_3_M    0x22
+#define CTRL_4_M    0x23
+#define CTRL_5_M    0x24
+#define STATUS_M    0x27
+#define OUT_X_M     0x28
+#define AUTO_INC_M  0x80	/**< Set in the register address to read several magnetometer registers. */
+
+// register values
+#define CTRL_4_XYZ_G    0x38	/**< Enable X, Y and Z gyro outputs. */
+#define CTRL_8_DEFAULT  0x44	/**< Block data update, register address auto increment. */
+#define CTRL_9_FIFO_EN  0x02	/**< Enable the FIFO. */
+#define FIFO_MODE_BYPASS     0x00	/**< FIFO off, also empties the FIFO. */
+#define FIFO_MODE_CONTINUOUS 0xC0	/**< Newest samples overwrite the oldest once full. */
+#define FIFO_SRC_OVRN   0x40	/**< FIFO overran, samples were lost. */
+#define FIFO_SRC_FSS    0x3F	/**< Number of unread samples. */
+#define CTRL_1_M_80HZ   0xFC	/**< Temperature compensation, X/Y ultra high performance, 80 Hz. */
+#define CTRL_2_M_4GAUSS 0x00	/**< +/- 4 gauss full scale. */
+#define CTRL_3_M_CONTINUOUS 0x00	/**< Continuous conversion. */
+#define CTRL_4_M_UHP    0x0C	/**< Z ultra high performance. */
+#define CTRL_5_M_BDU    0x40	/**< Block data update. */
+#define WHO_AM_I_M_VALUE 0x3D	/**< Expected magnetometer WHO_AM_I. */
+
+// FIFO layout
+#define GYRO_ODR_HZ 238.0		/**< Nominal output data rate. */
+#define GYRO_FIFO_DEPTH 32		/**< Samples held by the FIFO. */
+#define GYRO_FIFO_THRESHOLD 16		/**< Samples queued between reads, ~67 ms at 238 Hz. */
+#define GYRO_SAMPLE_BYTES 12		/**< Gyro X/Y/Z then accel X/Y/Z, 16 bits each. */
+#define GYRO_DPS_PER_LSB ((2.5f * 245.0f) / 65535.0f)	/**< Same scale GetAngularVelocity() has always used. */
+#define ACCEL_G_PER_LSB 0.000061f	/**< +/- 2 g full scale. */
+#define MAG_GAUSS_PER_LSB 0.00014f	/**< +/- 4 gauss full scale. */
+
+/**
+ * @brief Sample period tolerance, the measured period is clamped to the nominal +/- this fraction.
+**/
+#define GYRO_ODR_TOLERANCE 0.05
+
+/**
+ * @brief One sample taken from the FIFO.
+**/
+typedef struct _GyroSample {
+	float rate[3];		// X, Y, Z angular velocity, degrees/sec
+	float accel[3];		// X, Y, Z acceleration, g
+	long long time;		// #ClockNowNs() time the sample was taken, ns
+} GyroSample;
 
 /**
- * @brief Opens up the I2C file associated with the Gyro module.
- * @details Opens up the I2c file associated with the Gyro module. It also attaches the slave address
- *	    of the attached device (LSM9DS1) to the file descriptor.
- * @return Returns the file descriptor for the opened file.
+ * @brief One magnetometer reading.
+ * @details The magnetometer's X axis points the opposite way to the accelerometer's, #MagRead()
+ *	    flips it so field is in the same axes as #GyroSample.
 **/
-int OpenI2C();
+typedef struct _MagSample {
+	float field[3];		// X, Y, Z magnetic field, gauss, uncalibrated
+	long long time;		// #ClockNowNs() time of the read, ns
+} MagSample;
 
 /**
- * @brief Closes the I2C file descriptor used to communicate with Gyro.
+ * @brief Counters kept by the FIFO reader, bus level counters are kept by I2CBus.c.
 **/
-void CloseI2C();
+typedef struct _GyroStats {
+	unsigned long reads;		// burst reads performed
+	unsigned long samples;		// samples read
+	unsigned long overruns;		// reads that found the FIFO had overrun
+	unsigned long errors;		// failed bus transactions
+	unsigned long magReads;		// magnetometer reads
+	I2CDeviceStats bus;		// bus statistics of the LSM9DS1 accelerometer/gyroscope
+	I2CDeviceStats magBus;		// bus statistics of the LSM9DS1 magnetometer
+} GyroStats;
+
+/**
+ * @brief Opens the LSM9DS1 on #GYRO_I2C_BUS.
+ * @details Opens the LSM9DS1 through the I2CBus library, sets up the gyroscope and accelerometer
+ *	    and starts the FIFO in continuous mode. The magnetometer is opened as well, if it does
+ *	    not respond the gyroscope is still used and #MagRead() fails.
+ * @return 0 on success, -1 on error.
+**/
+int I2CGyroOpen();
+
+/**
+ * @brief Stops the FIFO and closes the LSM9DS1.
+**/
+void I2CGyroClose();
 
 /**
  * @brief GetAngularVelocity() returns the angular velocity as measured by the gyroscope.
  * @details This function returns the angular velocity (in degrees/sec) as measured by the
  * 	    gyroscope. At the moment, this function simply returns the angular velocity of the
- * 	    Z (vertical) axis. This is used when the rover is in the process of turning to 
+ * 	    Z (vertical) axis. This is used when the rover is in the process of turning to
  * 	    figure out how the rover is responding to turn commands and making any corrections
- * 	    if needed.
+ * 	    if needed. This reads the output registers directly and bypasses the FIFO.
 **/
 float GetAngularVelocity();
 
+/**
+ * @brief Empties the FIFO and restarts it.
+ * @details Used before a new measurement so it only sees samples taken from now on. Timestamps
+ *	    of the following #GyroFifoRead() are counted from this call.
+**/
+int GyroFifoFlush();
+
+/**
+ * @brief Reads every sample queued in the FIFO.
+ * @details Reads the FIFO status, then reads all queued samples in a single I2C transaction.
+ *	    The newest sample is stamped with the time of the status read and the older ones are
+ *	    spaced back from it by #GyroSamplePeriod(). If the FIFO overran, samples were lost;
+ *	    the gap is counted in #GyroStats and the timestamps still reflect it.
+ * @param samples Output array, oldest sample first.
+ * @param maxSamples Size of samples, should be at least #GYRO_FIFO_DEPTH.
+ * @return The number of samples read, 0 if none were queued, -1 on a bus error.
+**/
+int GyroFifoRead(GyroSample * samples, int maxSamples);
+
+/**
+ * @brief Returns the sample period the device is running at, in seconds.
+ * @details The LSM9DS1's internal oscillator is only accurate to a few percent. The period is
+ *	    measured from the number of samples read against #ClockNowNs() since the last
+ *	    flush, and starts at 1 / #GYRO_ODR_HZ.
+**/
+double GyroSamplePeriod();
+
+/**
+ * @brief Returns the time the FIFO takes to reach #GYRO_FIFO_THRESHOLD samples, in ns.
+ * @details This is the interval callers should wake up at to read the FIFO.
+**/
+long long GyroFifoPeriodNs();
+
+/**
+ * @brief Reads the newest magnetometer output, X, Y and Z in one burst.
+ * @param sample Output.
+ * @return 0 on success, -1 if the magnetometer is not available or the read failed.
+**/
+int MagRead(MagSample * sample);
+
+/**
+ * @brief Copies out the FIFO reader counters.
+**/
+void GyroGetStats(GyroStats * stats);
+
 #endif
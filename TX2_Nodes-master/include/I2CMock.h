@@ -0,0 +1,92 @@
+/**
+ * @file I2CMock.h
+ * @brief Header file for the I2CMock library.
+ * @details Header file for the I2CMock library, the in-memory backend of I2CBus.c. It is used
+ *	    when the environment variable #I2C_BACKEND_ENV is "mock". Each device address gets a
+ *	    model of the chip the rover has there:
+ *	    <br>
+ *	    <br>
+ *	    XA1110 (0x10): releases a burst of NMEA sentences every #MOCK_GPS_PERIOD_MS into an
+ *	    output buffer, reads return the buffer followed by '\n' padding, writes (PMTK commands)
+ *	    are accepted and counted. The bursts are taken from the recording named by
+ *	    #MOCK_NMEA_ENV (the format recorded by tx2_gps_node.c, see #I2CGPSRecord()), looping at
+ *	    the end, or are a fixed GGA/VTG fix if no recording is given. Until #MOCK_GPS_TTFF_ENV
+ *	    seconds after it is opened the bursts have no fix, a time to first fix that is cut to
+ *	    #MOCK_GPS_TTFF_AIDED of it by a PMTK741 position and to #MOCK_GPS_TTFF_EPO by that and
+ *	    PMTK721 EPO data, roughly as the XA1110's datasheet has it. A PMTK721 without
+ *	    #MOCK_GPS_EPO_WORDS words is ignored as the module does. Binary writes are taken as
+ *	    RTCM corrections, for #MOCK_GPS_RTCM_AGE seconds after one the fixes are differential,
+ *	    quality 2 with the age of the corrections, and a simulated rover's noise is scaled by
+ *	    #MOCK_GPS_RTCM_NOISE.
+ *	    <br>
+ *	    <br>
+ *	    LSM9DS1 (0x6B): a register file with the FIFO modelled. Samples are generated at
+ *	    #GYRO_ODR_HZ while the FIFO is in continuous mode, with overrun once 32 are queued.
+ *	    The Z rate follows the profile named by #MOCK_GYRO_ENV, lines of "seconds rate", the
+ *	    rate holding from that many seconds after the device is opened until the next line.
+ *	    A constant bias and noise are added, the accelerometer reads 1 g on Z.
+ *	    <br>
+ *	    <br>
+ *	    LSM9DS1 magnetometer (0x1E): the field of a level rover that faced #MOCK_MAG_HEADING
+ *	    when opened and has since turned as the same profile says, with a hard iron offset.
+ *	    <br>
+ *	    <br>
+ *	    With the "sim" I2C backend the three models report the rover of roverSim.c instead:
+ *	    its position and course as GGA/VTG fixes, its yaw rate, and its heading, see
+ *	    Simulation.h.
+ *	    <br>
+ *	    <br>
+ *	    #MOCK_FAIL_ENV makes that percentage of transactions fail with EAGAIN, to exercise
+ *	    retry policies. Transactions take as long as they would on a bus at #MOCK_BUS_HZ_ENV Hz
+ *	    (default #MOCK_BUS_HZ, 0 for no delay).
+**/
+
+#ifndef I2C_MOCK_H
+#define I2C_MOCK_H
+
+#include <linux/i2c.h>
+
+#define MOCK_NMEA_ENV "I2C_MOCK_NMEA"		/**< NMEA recording played by the XA1110 model. */
+#define MOCK_GYRO_ENV "I2C_MOCK_GYRO"		/**< Z rate profile played by the LSM9DS1 model. */
+#define MOCK_FAIL_ENV "I2C_MOCK_FAIL_PERCENT"	/**< Percentage of transactions that fail. */
+#define MOCK_BUS_HZ_ENV "I2C_MOCK_BUS_HZ"	/**< Bus clock the transaction time is based on. */
+#define MOCK_GPS_TTFF_ENV "I2C_MOCK_TTFF"	/**< Seconds the XA1110 model takes to its first fix, unassisted. */
+
+#define MOCK_BUS_HZ 400000		/**< Default bus clock, fast mode. */
+#define MOCK_GPS_PERIOD_MS 1000		/**< XA1110 output period. */
+#define MOCK_GPS_BUFFER 4096		/**< XA1110 output buffer, oldest data is lost past this. */
+#define MOCK_GPS_TTFF_AIDED 0.8		/**< Of the time to first fix left with time and position given. */
+#define MOCK_GPS_TTFF_EPO 0.4		/**< Of the time to first fix left with EPO data given as well. */
+#define MOCK_GPS_EPO_WORDS 18		/**< Words of a PMTK721 after its satellite, a 72 byte record. */
+#define MOCK_GPS_RTCM_AGE 10		/**< Seconds corrections are used for. */
+#define MOCK_GPS_RTCM_NOISE 0.3		/**< Of the simulated rover's GPS noise left with corrections. */
+#define MOCK_GYRO_BIAS 0.35		/**< Degrees/sec added to the Z rate. */
+#define MOCK_GYRO_NOISE 0.2		/**< Degrees/sec, peak uniform noise on the Z rate. */
+#define MOCK_PROFILE_STEPS 1024		/**< Most lines in a rate profile. */
+#define MOCK_MAG_HEADING 30.0		/**< Magnetic heading at the start, degrees clockwise from north. */
+#define MOCK_MAG_HORIZONTAL 0.24	/**< Gauss, horizontal earth field. */
+#define MOCK_MAG_VERTICAL -0.40		/**< Gauss, vertical earth field, pointing down. */
+#define MOCK_MAG_OFFSET_X 0.08		/**< Gauss, hard iron offset in the magnetometer's X. */
+#define MOCK_MAG_OFFSET_Y -0.05		/**< Gauss, hard iron offset in the magnetometer's Y. */
+#define MOCK_MAG_OFFSET_Z 0.03		/**< Gauss, hard iron offset in the magnetometer's Z. */
+
+/**
+ * @brief Creates the model for the device at address.
+ * @param name Device name, only used in messages.
+ * @param address 7 bit slave address.
+ * @return The model state, NULL if there is no model for address.
+**/
+void * I2CMockOpen(char * name, int address);
+
+/**
+ * @brief Frees a model created by #I2CMockOpen().
+**/
+void I2CMockClose(void * mock);
+
+/**
+ * @brief Performs a transaction against a model, same semantics as the I2C_RDWR ioctl.
+ * @return The number of messages transferred, -1 with errno set on failure.
+**/
+int I2CMockTransfer(void * mock, struct i2c_msg * msgs, int count);
+
+#endif
@@ -75,6 +75,24 @@ float DegreeTurnAndDirection(Position currentPosition,
 			      Position previousPosition,
 			      Position destinationPosition);
 
+/**
+ * @brief Returns the bearing from one position to another.
+ * @param from Starting #Position.
+ * @param to Destination #Position.
+ * @return Initial great circle bearing, degrees clockwise from true north, 0 to 360.
+**/
+float Bearing(Position from, Position to);
+
+/**
+ * @brief Returns the turn from a heading onto a bearing.
+ * @details Same convention as #DegreeTurnAndDirection, for when the heading is known from the
+ *	    compass (Orientation.h) rather than from the positions the rover has driven through.
+ * @param heading Current heading, degrees clockwise from true north.
+ * @param bearing Wanted heading, degrees clockwise from true north.
+ * @return Degrees to turn, -180 to 180, negative for left turns and positive for right turns.
+**/
+float HeadingTurn(float heading, float bearing);
+
 // function used to print position, used primarily for testing
 void PrintPosition(Position * position);
 
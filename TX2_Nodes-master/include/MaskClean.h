@@ -0,0 +1,108 @@
+/**
+ * @file MaskClean.h
+ * @brief Header file for the MaskClean library.
+ * @details Header file for the MaskClean library, the morphological cleanup tx2_nav_node.c runs
+ *	    on each segmentation mask before the filters of FilterGen.h are applied to it. Single
+ *	    misclassified pixels and thin speckles otherwise go straight into the dot products and
+ *	    tip the rover left or right.
+ *	    <br>
+ *	    <br>
+ *	    The mask holds class values, and the higher the value the less the nav node wants to
+ *	    drive there, so the cleanup works on the values themselves (grayscale morphology): an
+ *	    erosion takes the smallest value in a square around each pixel, a dilation the largest,
+ *	    and every pixel keeps one of the classes around it. An opening (erosion, then dilation)
+ *	    removes obstacles smaller than its kernel from open ground, a closing (dilation, then
+ *	    erosion) removes patches of open ground smaller than its kernel from obstacles. The
+ *	    opening runs first. On a mask of two classes this is the usual binary open/close.
+ *	    <br>
+ *	    <br>
+ *	    A square kernel is separable, so each erosion or dilation is a pass along the rows and
+ *	    one along the columns, both taking the minimum or maximum of 16 pixels at a time with
+ *	    SSE2 or NEON (plain C elsewhere). Pixels past the edges repeat the edge pixel. Only the
+ *	    rows the nav node uses are cleaned, with enough rows above them that the result does
+ *	    not depend on where the cleaning started.
+**/
+
+#ifndef MASK_CLEAN_H
+#define MASK_CLEAN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MASK_MAX_KERNEL 15		/**< Largest kernel size, pixels. */
+
+/**
+ * @brief Cleanup statistics.
+**/
+typedef struct _MaskCleanStats {
+	unsigned long masks;		// masks cleaned
+	long long cleanNs;		// total time spent cleaning them
+	long long maxNs;		// longest of those
+} MaskCleanStats;
+
+/**
+ * @brief Cleanup of masks of one size.
+**/
+typedef struct _MaskClean {
+	int width;
+	int height;
+	int openRadius;			// kernel size / 2, 0 for no opening
+	int closeRadius;		// kernel size / 2, 0 for no closing
+	uint8_t * buffers[2];		// width * height each, the result is in buffers[1]
+	uint8_t * row;			// a row with its repeated edges, width + #MASK_MAX_KERNEL
+	MaskCleanStats stats;
+} MaskClean;
+
+/**
+ * @brief Sets up the cleanup of width x height masks, with no opening or closing.
+ * @return 0 on success, -1 if out of memory.
+**/
+int MaskCleanInit(MaskClean * clean, int width, int height);
+
+/**
+ * @brief Sets the kernel sizes.
+ * @details A kernel of size n covers n x n pixels. Sizes should be odd, an even size acts as
+ *	    the odd size below it, and 0 or 1 turns the step off.
+ * @param clean The #MaskClean.
+ * @param openSize Kernel of the opening, up to #MASK_MAX_KERNEL.
+ * @param closeSize Kernel of the closing, up to #MASK_MAX_KERNEL.
+**/
+void MaskCleanSetSizes(MaskClean * clean, int openSize, int closeSize);
+
+/**
+ * @brief Cleans a mask.
+ * @param clean The #MaskClean.
+ * @param mask The mask, width * height bytes, left untouched.
+ * @param firstRow The first row that is needed, rows above it in the result are undefined.
+ * @return The cleaned mask, width * height bytes owned by clean and valid until the next call,
+ *	   or mask itself when there is neither an opening nor a closing.
+**/
+uint8_t * MaskCleanApply(MaskClean * clean, uint8_t * mask, int firstRow);
+
+/**
+ * @brief Erodes (dilate 0) or dilates (dilate 1) rows of a mask with a square kernel.
+ * @details The building block of #MaskCleanApply(), for tools that want a single step.
+ * @param in The rows to process, width bytes each.
+ * @param out Output, the same size as in, may be in.
+ * @param temp Scratch space, the same size as in.
+ * @param row Scratch space, width + 2 * radius bytes.
+ * @param width Row length.
+ * @param rows Number of rows.
+ * @param radius Kernel size / 2.
+ * @param dilate 1 for the maximum, 0 for the minimum.
+**/
+void MaskMorph(uint8_t * in, uint8_t * out, uint8_t * temp, uint8_t * row, int width, int rows, int radius, int dilate);
+
+/**
+ * @brief Copies out the cleanup statistics.
+**/
+void MaskCleanGetStats(MaskClean * clean, MaskCleanStats * stats);
+
+/**
+ * @brief Frees what #MaskCleanInit() allocated.
+**/
+void MaskCleanClose(MaskClean * clean);
+
+#endif
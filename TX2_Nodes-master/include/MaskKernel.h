@@ -0,0 +1,129 @@
+/**
+ * @file MaskKernel.h
+ * @brief Header file for the MaskKernel library.
+ * @details Header file for the MaskKernel library, the dot products tx2_nav_node.c takes of the
+ *	    lower half of each mask with the left, center and right filters of FilterGen.h. There
+ *	    is more than one way to take them, and which is fastest depends on the resolution and
+ *	    on the board:
+ *	    <br>
+ *	    <br>
+ *	    scalar, a pass over the half mask for each filter, zeros included, as nav always did<br>
+ *	    fused, one pass taking all three, the mask is read once<br>
+ *	    spans, the filters are runs of one weight (a row of FilterGen.h), so each run's pixels
+ *	    are summed as integers and multiplied by its weight once<br>
+ *	    spans-simd, the same with the pixels summed 16 at a time with SSE2 or NEON, where
+ *	    there is neither it is not a candidate
+ *	    <br>
+ *	    <br>
+ *	    All of them give the dot products of scalar, the spans to float rounding. Like FFTW's
+ *	    wisdom, the first start on a board times every candidate on a synthetic mask of the
+ *	    resolution and keeps the fastest in #MASK_KERNEL_CACHE_FILE, a line per resolution and
+ *	    CPU model. Later starts read the choice back instead, in microseconds. Setting
+ *	    #MASK_KERNEL_RETUNE_ENV times them again, after a kernel changed or the board was
+ *	    reflashed, and so does a cache line of another #MASK_KERNEL_VERSION.
+**/
+
+#ifndef MASK_KERNEL_H
+#define MASK_KERNEL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "FilterGen.h"
+
+#define MASK_KERNEL_CACHE_FILE "../kernel_cache.txt"	/**< Kernels chosen, relative to build/. */
+#define MASK_KERNEL_RETUNE_ENV "TX2_RETUNE"		/**< Environment variable, set to time the kernels again. */
+#define MASK_KERNEL_VERSION 1				/**< Bumped when a kernel changes, older choices are timed again. */
+#define MASK_KERNEL_FILTERS 3				/**< Left, center and right. */
+#define MASK_KERNEL_TUNE_NS 20000000LL			/**< Ns each candidate is timed for. */
+#define MASK_KERNEL_CPU 128				/**< Longest CPU model kept, with the '\0'. */
+
+/**
+ * @brief The kernels.
+**/
+typedef enum _MaskKernelId {
+	MaskKernelScalar,
+	MaskKernelFused,
+	MaskKernelSpans,
+	MaskKernelSpansSimd,
+	MaskKernelCount
+} MaskKernelId;
+
+/**
+ * @brief A run of one weight in a filter.
+**/
+typedef struct _MaskSpan {
+	int start;			// index into the half mask
+	int length;
+	FILTER_TYPE weight;
+} MaskSpan;
+
+/**
+ * @brief How the kernel was chosen.
+**/
+typedef struct _MaskKernelStats {
+	int cached;				// read from the cache, not timed
+	long long tuneNs;			// choosing it, timing or reading
+	long long kernelNs[MaskKernelCount];	// a mask with each, 0 if not timed or not a candidate
+} MaskKernelStats;
+
+/**
+ * @brief The dot products of masks of one size.
+**/
+typedef struct _MaskKernels {
+	int width;
+	int height;
+	int offset;					// of the lower half in the mask
+	int length;					// pixels in the lower half
+	FILTER_TYPE * filters[MASK_KERNEL_FILTERS];	// length each
+	MaskSpan * spans[MASK_KERNEL_FILTERS];
+	int spanCount[MASK_KERNEL_FILTERS];
+	int kernel;					// #MaskKernelId in use
+	char cpu[MASK_KERNEL_CPU];			// model the choice is kept for
+	MaskKernelStats stats;
+} MaskKernels;
+
+/**
+ * @brief Sets up the dot products of width x height masks with the scalar kernel.
+ * @param filters The filters of FilterGen.h, width x height / 2 each, kept.
+ * @return 0 on success, -1 if out of memory.
+**/
+int MaskKernelInit(MaskKernels * kernels, int width, int height, FILTER_TYPE ** filters);
+
+/**
+ * @brief Chooses the kernel, from the cache or by timing the candidates.
+ * @param cacheFile Where the choices are kept, NULL to time them without keeping the choice.
+ * @param force Time them even if there is a choice, as #MASK_KERNEL_RETUNE_ENV.
+ * @return The #MaskKernelId chosen.
+**/
+int MaskKernelTune(MaskKernels * kernels, char * cacheFile, int force);
+
+/**
+ * @brief Takes the dot products of the lower half of a mask with the filters.
+ * @param mask width x height classes.
+ * @param dots Output, one per filter.
+**/
+void MaskKernelApply(MaskKernels * kernels, uint8_t * mask, FILTER_TYPE * dots);
+
+/**
+ * @brief Takes them with a given kernel, for timing and comparing.
+**/
+void MaskKernelApplyWith(MaskKernels * kernels, int kernel, uint8_t * mask, FILTER_TYPE * dots);
+
+/**
+ * @brief Returns the name of a #MaskKernelId, as in the cache.
+**/
+char * MaskKernelName(int kernel);
+
+/**
+ * @brief Copies out the statistics.
+**/
+void MaskKernelGetStats(MaskKernels * kernels, MaskKernelStats * stats);
+
+/**
+ * @brief Frees the spans, not the filters.
+**/
+void MaskKernelClose(MaskKernels * kernels);
+
+#endif
@@ -68,7 +68,9 @@ typedef enum messageTypes {
 	KillMessage,			// kill message sent from controller
 	CalibrationCompleteMessage,
 	CommandMessage,			// tells master to interpret Message as CmdMsg
-	GyroMessage			// request for Gyro node to start collecting samples
+	GyroMessage,			// unused, the gyro node samples continuously (see Heading.h)
+	BenchMessage,			// ipcBench.c traffic, check BenchMsg struct in Message struct
+	TimeMessage			// clock offset ping, answered by the comm node, check TimeMsg struct
 } MessageTypes; 
 
 
@@ -162,11 +164,32 @@ typedef struct positionMsg {
 **/
 typedef struct gpsMsg {
 	Position position;
-	float heading;
-	float velocity;
-	unsigned int time;
+	float heading;			// course over ground, degrees
+	float velocity;			// speed over ground, m/s
+	unsigned int time;		// UTC time of fix, ms since midnight
+	float hdop;			// horizontal dilution of precision, 0 if not reported
+	int satellites;			// satellites used in the fix
+	int fixQuality;			// GGA fix quality, 0 none, 1 GPS, 2 differential
+	float altitude;			// meters above mean sea level, 0 if not reported
+	float correctionAge;		// seconds since the differential correction, -1 if not differential
 } GpsMsg; 
 
+/**
+ * @brief Position estimate published by tx2_gps_node.c in shared memory.
+ * @details #Position is the first member so readers that only want a #Position, such as
+ *	    #GET_SHARED_POSITION, can keep treating the shared memory as one.
+**/
+typedef struct _PositionEstimate {
+	Position position;
+	float accuracy;			// estimated 1 sigma horizontal error, meters
+	float hdop;			// HDOP of the newest fix used
+	int satellites;			// satellites of the newest fix used
+	int fixesUsed;			// fixes that contributed to the estimate
+	unsigned int time;		// UTC time of the newest fix used, ms since midnight
+	int fixQuality;			// of the newest fix used, GGA
+	float correctionAge;		// of the newest fix used, seconds, -1 if not differential
+} PositionEstimate;
+
 /////////////////////////////////////////////////
 //	Command List Typedefs TODO	       //
 /////////////////////////////////////////////////
@@ -183,7 +206,8 @@ typedef enum _CommandOperation {
 	Create,
         Delete,
         Update,
-	Flush
+	Flush,
+	Survey		// plan the area of Coverage.h and queue all of it
 } CommandOperation; 
 
 /**
@@ -222,6 +246,30 @@ typedef struct okMsg {
 	char message[32];
 } OkMsg; 
 
+/**
+ * @brief Struct used by the synthetic nodes of ipcBench.c.
+ * @details The send time of each message is kept in shared memory by sequence number, so the
+ *	    message itself stays small, like every other member of the union.
+**/
+typedef struct benchMsg {
+	unsigned long sequence;		// message number within a run
+	unsigned long count;		// messages the consumer has taken so far, in replies
+} BenchMsg;
+
+/**
+ * @brief Struct used by the clock offset pings of TimeSync.h.
+ * @details The controller side sends originate and its estimate, tx2_comm_node.c fills in
+ *	    receive and transmit and writes it straight back.
+**/
+typedef struct timeMsg {
+	long long originate;		// controller clock the ping was sent at, t1
+	long long receive;		// rover clock it was read at, t2
+	long long transmit;		// rover clock the answer was written at, t3
+	long long offset;		// rover minus controller clock, the controller's estimate, ns
+	unsigned int error;		// bound on the estimate, ns, 0 if there is none yet
+	float drift;			// of the rover clock against the controller's, ppm
+} TimeMsg;
+
 /**
  * @brief The struct used by all nodes to communicate with one another.
  * @details The Message struct is the main struct used by nodes communicating with one another. 
@@ -256,6 +304,8 @@ typedef struct message {
 		OpModeMsg opModeMsg;
 		GpsMsg gpsMsg;
 		CmdMsg cmdMsg;
+		BenchMsg benchMsg;
+		TimeMsg timeMsg;
 	};
 } Message; 
 
@@ -293,6 +343,7 @@ int ModifySetAndWait(int oldFd, int newFd);
  * @brief Wrapper function which calls pselect().
  * @details SetAndWait() performs some basic setup before calling pselect(). This function
  *	    returns under 2 conditions; a file descriptor is available to be read, or a timeout.
+ *	    The timeout is measured on the clock of Clock.h, see #ClockWait().
  * @param rdfs The address of the fd_set read file descriptors variable.
  * @param seconds pselect() timeout in seconds.
  * @param nanoSeconds pselect() timeout in nano seconds.
@@ -303,4 +354,34 @@ int ModifySetAndWait(int oldFd, int newFd);
 **/
 int SetAndWait(fd_set * rdfs, long seconds, long nanoSeconds);
 
+/**
+ * @brief #SetAndWait() with an absolute timeout.
+ * @details For loops that wake at set times, a periodic read for example, rather than after
+ *	    a set time without messages.
+ * @param rdfs The address of the fd_set read file descriptors variable.
+ * @param when #ClockNowNs() time to give up at, #CLOCK_NEVER to wait for a message only.
+ * @return As #SetAndWait().
+ * @pre Assumes #SetupSetAndWait() was called prior to calling SetAndWaitUntil().
+**/
+int SetAndWaitUntil(fd_set * rdfs, long long when);
+
+/**
+ * @brief Writes a #Message to a pipe.
+ * @details Every #Message between the nodes must go through SendMessage() and
+ *	    #ReceiveMessage(): on the virtual clock (see Clock.h) time stands still while a
+ *	    message is in flight, so that its reader gets to it at the time it was sent.
+ * @param fd The pipe.
+ * @param message The #Message.
+ * @return As write().
+**/
+int SendMessage(int fd, Message * message);
+
+/**
+ * @brief Reads a #Message from a pipe, see #SendMessage().
+ * @param fd The pipe.
+ * @param message Output.
+ * @return As read().
+**/
+int ReceiveMessage(int fd, Message * message);
+
 #endif
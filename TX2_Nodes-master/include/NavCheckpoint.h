@@ -0,0 +1,107 @@
+/**
+ * @file NavCheckpoint.h
+ * @brief Header file for the NavCheckpoint library.
+ * @details Header file for the NavCheckpoint library. Everything tx2_nav_node.c has learned
+ *	    since it started lives in its globals: the turning calibration, where it is going,
+ *	    where it has been, its state and the moving averages of the filters. If nav dies all
+ *	    of that goes with it, and a new nav has to calibrate its turns again before the rover
+ *	    moves, and needs the destination sent again. Nav keeps a copy of it (#NavState) in
+ *	    shared memory (#CheckpointData), which outlives the process, and tx2_master.c restarts
+ *	    nav when it dies. The new nav takes the copy over in one read and drives on.
+ *	    <br>
+ *	    <br>
+ *	    Nav saves after every message it handles. Most saves change nothing, or a few values,
+ *	    so the state is compared to the copy #NAV_CHECKPOINT_BLOCK bytes at a time and only the
+ *	    blocks that differ are written. The writer makes the sequence number odd while it
+ *	    writes, as #PublishObstacles(). A nav killed halfway through a save leaves it odd, and
+ *	    a header that does not match (#NAV_CHECKPOINT_MAGIC, #NAV_CHECKPOINT_VERSION, the size
+ *	    of #NavState) means a different build wrote it, either way the copy is not used and
+ *	    nav starts cold. tx2_master.c removes the copy when it starts, so only a nav restarted
+ *	    by the same master takes it over.
+**/
+
+#ifndef NAV_CHECKPOINT_H
+#define NAV_CHECKPOINT_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "Messages.h"
+#include "FilterGen.h"
+
+#define NAV_CHECKPOINT_MAGIC 0x4e564350u	/**< "NVCP", the copy has been written. */
+#define NAV_CHECKPOINT_VERSION 1		/**< Changes whenever #NavState does. */
+#define NAV_CHECKPOINT_BLOCK 64			/**< Bytes compared and written at a time. */
+#define NAV_CHECKPOINT_TURNS 11			/**< Entries of the turning lookup table. */
+
+/**
+ * @brief What nav keeps, zeroed before it is filled so the padding compares equal.
+**/
+typedef struct _NavState {
+	int imageWidth;					// of the masks, a different camera starts cold
+	int imageHeight;
+	double trueTurningAngle;			// smallest turn, degrees
+	double turningTable[NAV_CHECKPOINT_TURNS];	// degrees turned by index turn commands
+	int turningTableCount;				// 0 if the turns were never calibrated
+	int opMode;					// #OpMode
+	int state;					// the navigation state of tx2_nav_node.c
+	int atDestination;
+	int compassTurnNeeded;
+	int maskRequested;				// a mask was asked for and has not come in
+	Position current;
+	Position previous;
+	Position destination;
+	PreviousValues left;				// moving averages of the filters
+	PreviousValues center;
+	PreviousValues right;
+} NavState;
+
+/**
+ * @brief Save statistics.
+**/
+typedef struct _NavCheckpointStats {
+	unsigned long saves;		// calls to #NavCheckpointSave()
+	unsigned long writes;		// saves that changed something
+	unsigned long blocks;		// blocks written by them
+	unsigned long restores;		// times the copy was taken over
+} NavCheckpointStats;
+
+/**
+ * @brief Data area of the #CheckpointData shared memory, written by tx2_nav_node.c.
+**/
+typedef struct _NavCheckpoint {
+	unsigned int magic;		// #NAV_CHECKPOINT_MAGIC once written
+	unsigned int version;		// #NAV_CHECKPOINT_VERSION
+	unsigned int size;		// sizeof(#NavState)
+	volatile unsigned int sequence;	// odd while the state is being written
+	long long time;			// #ClockNowNs() of the last save that changed something
+	NavCheckpointStats stats;	// kept across restarts
+	NavState state;
+} NavCheckpoint;
+
+/**
+ * @brief Writes the whole state, for a nav that started cold.
+ * @param now #ClockNowNs().
+**/
+void NavCheckpointReset(NavCheckpoint * checkpoint, NavState * state, long long now);
+
+/**
+ * @brief Takes the copy over.
+ * @param state Output, only written if the copy can be used.
+ * @return 0 if it was, -1 if nav has to start cold.
+**/
+int NavCheckpointRestore(NavCheckpoint * checkpoint, NavState * state);
+
+/**
+ * @brief Writes the blocks of the state that differ from the copy.
+ * @param now #ClockNowNs().
+ * @return The number of blocks written, 0 if nothing changed.
+**/
+int NavCheckpointSave(NavCheckpoint * checkpoint, NavState * state, long long now);
+
+/**
+ * @brief Copies out the statistics.
+**/
+void NavCheckpointGetStats(NavCheckpoint * checkpoint, NavCheckpointStats * stats);
+
+#endif
@@ -0,0 +1,183 @@
+/**
+ * @file Obstacles.h
+ * @brief Header file for the Obstacles library.
+ * @details Header file for the Obstacles library. The filters of FilterGen.h only tell
+ *	    tx2_nav_node.c how much of each part of the mask should be avoided. This library
+ *	    finds the obstacles themselves: the pixels of the classes the rover can not drive over
+ *	    (#OBSTACLE_CLASSES) are grouped into connected components, 8-connected, and each one
+ *	    becomes an #Obstacle with its bounding box, area, the point where it meets the ground
+ *	    (the middle of its bottom row) and how far away and in which direction that point is.
+ *	    tx2_nav_node.c runs it on every cleaned mask and publishes the list to shared memory
+ *	    (#ObstacleData) next to the mask, for the planners and stop logic of other nodes.
+ *	    <br>
+ *	    <br>
+ *	    The labelling is a single pass over the rows. Each row is cut into runs of obstacle
+ *	    pixels, each run is joined (union-find) with the runs of the row above it touches, and
+ *	    the areas and boxes are added up by run once every run knows its component. The work
+ *	    goes with the number of runs rather than pixels, and nothing is allocated per mask.
+ *	    <br>
+ *	    <br>
+ *	    Distances come from a table of meters along the ground, straight ahead of the camera, to
+ *	    where each row meets the ground. It is read from #GROUND_CALIBRATION_FILE, "fov degrees"
+ *	    for the horizontal field of view and "row n meters" lines measured on the rover, with
+ *	    the rows between interpolated (in 1 / meters, which is linear in the row for a flat
+ *	    ground). Without the file the table is worked out for a camera #OBSTACLE_CAMERA_MOUNT
+ *	    above flat ground, tilted #OBSTACLE_CAMERA_TILT down, the camera of Simulation.h. Rows
+ *	    at or above the horizon have no distance.
+**/
+
+#ifndef OBSTACLES_H
+#define OBSTACLES_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#define GROUND_CALIBRATION_FILE "../ground_calibration.txt"	/**< Row to distance table, see Obstacles.h. */
+#define OBSTACLE_MAX 64			/**< Most obstacles published per mask, the nearest are kept. */
+#define OBSTACLE_MAX_AREA 1000000	/**< Largest obstacleMinArea, pixels. */
+#define OBSTACLE_CAMERA_MOUNT 0.6	/**< Meters, camera height without a calibration, as #SIM_CAMERA_MOUNT. */
+#define OBSTACLE_CAMERA_TILT 10.0	/**< Degrees below the horizon without a calibration, as #SIM_CAMERA_TILT. */
+#define OBSTACLE_CAMERA_FOV 60.0	/**< Degrees, horizontal field of view without a calibration, as #SIM_CAMERA_FOV. */
+
+/**
+ * @brief segNet classes the rover can not drive over, a bit per class.
+ * @details 'building' to 'vegetation' (6 to 14) and 'person' to 'cycle' (17 to 20), see
+ *	    MoveRover() in tx2_nav_node.c. 'terrain' can be driven over and 'sky' is never on the
+ *	    ground. #CAMERA_OBSTACLE_LABEL and #SIM_OBSTACLE_LABEL are 'cycle'.
+**/
+#define OBSTACLE_CLASSES (0x7fc0u | 0x1e0000u)
+
+/**
+ * @brief An obstacle found in a mask.
+**/
+typedef struct _Obstacle {
+	int left;			// bounding box, pixels, inclusive
+	int top;
+	int right;
+	int bottom;			// lowest row, where it meets the ground
+	int area;			// pixels
+	int contactLeft;		// first and last column of the bottom row
+	int contactRight;
+	int contact;			// column in the middle of the bottom row
+	int label;			// class at the bottom row
+	float distance;			// meters along the ground to the contact point, negative if unknown
+	float bearing;			// degrees to the contact point, positive to the right
+} Obstacle;
+
+/**
+ * @brief The obstacles of one mask, nearest first.
+**/
+typedef struct _ObstacleList {
+	unsigned long frame;		// masks looked at before this one
+	long long time;			// #ClockNowNs() ns the mask was looked at
+	int width;			// mask size
+	int height;
+	int count;			// obstacles in obstacles
+	int found;			// obstacles found, may be more than #OBSTACLE_MAX
+	Obstacle obstacles[OBSTACLE_MAX];
+} ObstacleList;
+
+/**
+ * @brief Data area of the #ObstacleData shared memory, written by tx2_nav_node.c.
+**/
+typedef struct _ObstacleShared {
+	volatile unsigned int sequence;	// odd while the list is being written
+	ObstacleList list;
+} ObstacleShared;
+
+/**
+ * @brief Timing statistics.
+**/
+typedef struct _ObstacleStats {
+	unsigned long masks;		// masks looked at
+	unsigned long runs;		// obstacle runs in them
+	long long findNs;		// total time spent finding obstacles
+	long long maxNs;		// longest of those
+} ObstacleStats;
+
+/**
+ * @brief A run of obstacle pixels in a row.
+**/
+typedef struct _ObstacleRun {
+	int start;			// first column
+	int end;			// last column
+	int row;
+	int parent;			// union-find, index of a run of the same component
+} ObstacleRun;
+
+/**
+ * @brief Finds the obstacles of masks of one size.
+**/
+typedef struct _ObstacleFinder {
+	int width;
+	int height;
+	int minArea;			// smaller components are left out, pixels
+	uint8_t classes[256];		// 1 for the classes in #OBSTACLE_CLASSES
+	float * rowDistance;		// meters ahead to where each row meets the ground, negative if it does not
+	float focal;			// pixels, from the horizontal field of view
+	ObstacleRun * runs;		// room for the most runs a mask can have
+	Obstacle * components;		// totals of each component, at the index of its root run
+	int maxRuns;
+	unsigned long frame;
+	ObstacleStats stats;
+} ObstacleFinder;
+
+/**
+ * @brief Sets up finding obstacles in width x height masks.
+ * @param finder The #ObstacleFinder.
+ * @param width Mask width.
+ * @param height Mask height.
+ * @param calibrationFile The row to distance table, see Obstacles.h, the camera defaults if missing.
+ * @return 0 on success, -1 if out of memory or the calibration file is unusable.
+**/
+int ObstacleFinderInit(ObstacleFinder * finder, int width, int height, char * calibrationFile);
+
+/**
+ * @brief Sets the smallest area, in pixels, of an obstacle.
+**/
+void ObstacleSetMinArea(ObstacleFinder * finder, int minArea);
+
+/**
+ * @brief Finds the obstacles in a mask.
+ * @param finder The #ObstacleFinder.
+ * @param mask The mask, width * height bytes.
+ * @param firstRow Rows above it are not looked at.
+ * @param time #ClockNowNs() ns, stored in the list.
+ * @param list Output, the obstacles nearest first, those with no distance last.
+ * @return The number of obstacles found, may be more than #OBSTACLE_MAX.
+**/
+int ObstacleFind(ObstacleFinder * finder, uint8_t * mask, int firstRow, long long time, ObstacleList * list);
+
+/**
+ * @brief Meters ahead to where a row meets the ground, negative if it does not.
+**/
+float ObstacleRowDistance(ObstacleFinder * finder, int row);
+
+/**
+ * @brief Copies out the timing statistics.
+**/
+void ObstacleGetStats(ObstacleFinder * finder, ObstacleStats * stats);
+
+/**
+ * @brief Frees what #ObstacleFinderInit() allocated.
+**/
+void ObstacleFinderClose(ObstacleFinder * finder);
+
+/**
+ * @brief Publishes an #ObstacleList to #ObstacleData shared memory.
+ * @details Only the obstacles in the list are copied. Readers never wait, see #GetObstacles().
+**/
+void PublishObstacles(ObstacleShared * shared, ObstacleList * list);
+
+/**
+ * @brief Reads the newest #ObstacleList from #ObstacleData shared memory.
+ * @details The writer makes the sequence number odd while it writes, the list is copied until
+ *	    it was copied with an even, unchanged sequence.
+ * @return 0 on success, -1 if nothing has been published yet.
+**/
+int GetObstacles(ObstacleShared * shared, ObstacleList * list);
+
+#endif
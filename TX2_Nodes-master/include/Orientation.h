@@ -0,0 +1,181 @@
+/**
+ * @file Orientation.h
+ * @brief Header file for the Orientation library.
+ * @details Header file for the Orientation library. tx2_gyro_node.c runs every accelerometer and
+ *	    gyroscope sample from the FIFO through a Mahony filter, together with the newest
+ *	    magnetometer reading, and publishes the resulting orientation to shared memory
+ *	    (#OrientationData). The filter keeps roll and pitch from drifting with the
+ *	    accelerometer and the heading with the magnetometer, which gives an absolute heading,
+ *	    tilt compensated, as soon as the node has started, and while GPS has no fix.
+ *	    <br>
+ *	    <br>
+ *	    The magnetometer is only trusted once a #MagCalibration has been loaded from
+ *	    #MAG_CALIBRATION_FILE or learned. Without one the filter runs on the accelerometer and
+ *	    gyroscope alone and #OrientationSample magValid is 0. A calibration is learned with a
+ *	    #MagCalibrator while the rover turns through a full circle, and then saved.
+ *	    <br>
+ *	    <br>
+ *	    Relative headings and turn measurements still come from Heading.h, which keeps the
+ *	    sample history. #OrientationData only holds the newest orientation, published once per
+ *	    FIFO read, and is read without locking: the writer makes the sequence number odd while
+ *	    it writes, readers retry until they copy the sample with an even, unchanged sequence.
+**/
+
+#ifndef ORIENTATION_H
+#define ORIENTATION_H
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "I2CGyro.h"
+
+#define MAG_CALIBRATION_FILE "../mag_calibration.txt"	/**< Where the magnetometer calibration is kept. */
+#define MAG_CAL_MIN_SPAN 0.1f		/**< Gauss, X and Y must have covered at least this to calibrate. */
+#define MAG_CAL_TURN 360.0		/**< Degrees the rover must turn through to calibrate. */
+#define MAG_REJECT 0.3f			/**< Readings this far, relative, from the usual field strength are skipped. */
+
+#define ORIENTATION_KP 1.0f		/**< Mahony proportional gain, 1/s. */
+#define ORIENTATION_KI 0.02f		/**< Mahony integral gain, learns the gyro bias, 1/s^2. */
+#define ORIENTATION_SETTLE_KP 10.0f	/**< Proportional gain while settling, converges in about a second. */
+#define ORIENTATION_SETTLE_TIME 2.0	/**< Seconds of #ORIENTATION_SETTLE_KP after a reset. */
+
+/**
+ * @brief Magnetometer calibration, hard iron offset and soft iron scale per axis.
+ * @details A calibrated field is (field - offset) * scale, in the axes of #MagSample.
+**/
+typedef struct _MagCalibration {
+	float offset[3];
+	float scale[3];
+} MagCalibration;
+
+/**
+ * @brief Learns a #MagCalibration from the extremes of the field while the rover turns.
+**/
+typedef struct _MagCalibrator {
+	float min[3];
+	float max[3];
+	double minHeading;		// extremes of the gyro heading, the turn covered
+	double maxHeading;
+	unsigned long samples;
+} MagCalibrator;
+
+/**
+ * @brief State of the Mahony filter.
+**/
+typedef struct _OrientationFilter {
+	float q[4];			// body to earth quaternion, earth is X north, Y west, Z up
+	float integral[3];		// integral feedback, the negated gyro bias, rad/s
+	float magStrength;		// slow average of the calibrated field strength, gauss
+	double settleTime;		// seconds left at #ORIENTATION_SETTLE_KP
+	long long lastTime;
+	int magUsed;			// the last update used the magnetometer
+	float declination;		// degrees east, true heading = magnetic heading + this
+} OrientationFilter;
+
+/**
+ * @brief A published orientation.
+**/
+typedef struct _OrientationSample {
+	long long time;			// #ClockNowNs() ns of the newest sample used
+	float q[4];			// body to earth quaternion
+	float roll;			// degrees, positive with the left side up
+	float pitch;			// degrees, positive nose down
+	float heading;			// degrees clockwise from true north, 0 to 360
+	float bias[3];			// gyro bias learned by the filter, degrees/sec
+	int magValid;			// heading is absolute, the magnetometer is calibrated and in use
+} OrientationSample;
+
+/**
+ * @brief Data area of the #OrientationData shared memory.
+**/
+typedef struct _OrientationShared {
+	volatile unsigned int sequence;	// odd while the sample is being written
+	OrientationSample sample;
+} OrientationShared;
+
+/**
+ * @brief Loads a #MagCalibration.
+ * @param fileName The calibration file, see #SaveMagCalibration().
+ * @param calibration Output.
+ * @return 0 on success, -1 if the file is missing or incomplete.
+**/
+int LoadMagCalibration(char * fileName, MagCalibration * calibration);
+
+/**
+ * @brief Saves a #MagCalibration as "offset x y z" and "scale x y z" lines.
+ * @return 0 on success, -1 on error.
+**/
+int SaveMagCalibration(char * fileName, MagCalibration * calibration);
+
+/**
+ * @brief Applies a #MagCalibration to a field.
+ * @param calibration The calibration.
+ * @param field Raw field from #MagSample.
+ * @param out Output, calibrated field. May be field.
+**/
+void ApplyMagCalibration(MagCalibration * calibration, float * field, float * out);
+
+/**
+ * @brief Resets a #MagCalibrator.
+**/
+void InitMagCalibrator(MagCalibrator * calibrator);
+
+/**
+ * @brief Adds a raw field reading to a #MagCalibrator.
+ * @param calibrator The #MagCalibrator.
+ * @param field Raw field from #MagSample.
+ * @param heading Gyro heading (Heading.h) at the reading, degrees.
+**/
+void AddMagCalibration(MagCalibrator * calibrator, float * field, double heading);
+
+/**
+ * @brief Returns the calibration once the rover has turned far enough.
+ * @details Ready once the heading has covered #MAG_CAL_TURN and the X and Y field have each
+ *	    covered #MAG_CAL_MIN_SPAN. The offsets are the middle of each axis' range and X and Y
+ *	    are scaled to their average range. Z is only calibrated if the rover tilted enough for
+ *	    it to cover #MAG_CAL_MIN_SPAN as well, a level rover leaves its offset at 0, which
+ *	    does not affect the heading.
+ * @return 0 with calibration filled in, -1 if not ready.
+**/
+int MagCalibrationReady(MagCalibrator * calibrator, MagCalibration * calibration);
+
+/**
+ * @brief Resets a #OrientationFilter to level, facing north, and settles it again.
+ * @param declination Degrees east of true north the compass points, magDeclination in
+ *	  Parameters.txt.
+**/
+void InitOrientation(OrientationFilter * filter, float declination);
+
+/**
+ * @brief Updates the filter with one sample.
+ * @details Integrates the gyroscope over the time since the previous sample, corrected towards
+ *	    the gravity direction of the accelerometer and, when mag is given, the direction of
+ *	    the horizontal field. Readings whose strength is more than #MAG_REJECT off the usual
+ *	    strength are skipped as disturbed. Only float arithmetic and one square root per
+ *	    vector, no trigonometry, so it costs well under a microsecond.
+ * @param filter The #OrientationFilter.
+ * @param sample Accelerometer and gyroscope sample.
+ * @param mag Calibrated field, NULL to update without the magnetometer.
+**/
+void UpdateOrientation(OrientationFilter * filter, GyroSample * sample, float * mag);
+
+/**
+ * @brief Fills in an #OrientationSample from the filter state.
+ * @param filter The #OrientationFilter.
+ * @param magValid Whether the heading is absolute, see #OrientationSample.
+ * @param out Output.
+**/
+void GetFilterOrientation(OrientationFilter * filter, int magValid, OrientationSample * out);
+
+/**
+ * @brief Publishes an orientation to shared memory. Only the gyro node calls this.
+**/
+void PublishOrientation(OrientationShared * shared, OrientationSample * sample);
+
+/**
+ * @brief Copies the newest published orientation.
+ * @return 0 on success, -1 if nothing has been published yet.
+**/
+int GetOrientation(OrientationShared * shared, OrientationSample * sample);
+
+#endif
@@ -3,23 +3,41 @@
  * @author Patrick Henz
  * @date 12-11-2019
  * @brief Header file for Parameters library.
- * @details Header file for Parameters library. At the moment, this library is used only by the
- * 	    tx2_nav_node.c. This allows navigation related information to be set in the text file
- * 	    Parameters.txt in a human readable format without the need to recompile the source code.
- * 	    The controller application, controller.c, can even send a parameter message to the rover
- * 	    prompting the navigation node to read in the Parameters.txt file again to load in values,
- * 	    meaning these values can be modified during run time, without rebuilding the rovers 
- * 	    sowftware or restarting the rover at all.
+ * @details Header file for Parameters library. This allows navigation related information to be
+ * 	    set in the text file Parameters.txt in a human readable format without the need to
+ * 	    recompile the source code. The file holds "name : value" lines in any order, '#'
+ * 	    starts a comment. Every value is checked against its type and range, and a file with
+ * 	    any error is rejected as a whole, so a half edited file is never used. The hardware
+ * 	    backends (Hal.h) are given by name, "canBackend : vcan" for example.
+ * 	    <br>
+ * 	    <br>
+ * 	    tx2_master.c loads the file before it starts the other nodes and publishes it to shared
+ * 	    memory (#ParameterData) as a #ParameterSnapshot with a version number. Any node can read
+ * 	    the newest snapshot with #GetParameterSnapshot() without locking, and notice a new one
+ * 	    by its version. Master reloads the file whenever it is saved (inotify, see
+ * 	    #WatchParameters()) or when the controller application, controller.c, sends a parameter
+ * 	    message, and then sends tx2_nav_node.c a #ParametersMessage so it applies the new values.
+ * 	    None of this needs a node to be restarted.
 **/
 
 #ifndef PARAMETERS_H
 #define PARAMETERS_H
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "Hal.h"
 
 #define PARAMETERS_FILE "../Parameters.txt"
+#define PARAMETER_SNAPSHOTS 4		/**< Snapshots kept in shared memory, a snapshot is immutable until this many newer ones exist. */
+#define PARAMETER_NAME_LENGTH 48	/**< Longest parameter name. */
 
 /**
  * @brief This struct contains all parameters used by the tx2_nav_node.c during the navigation
@@ -63,24 +81,122 @@ typedef struct parameters {
 	int   usingGps;
 	// flag that puts the rover in manual mode at startup. 1 for manual, 0 for automatic
 	int   manual;
+	// kernel sizes, in pixels, of the opening and closing of the segmentation mask before
+	// the dot products, see MaskClean.h. 0 or 1 turns a step off.
+	int   maskOpenSize;
+	int   maskCloseSize;
+	// smallest obstacle published, in pixels, see Obstacles.h
+	int   obstacleMinArea;
+	// meters ahead nav aims at the middle of the walkway, see Walkway.h. 0 turns it off.
+	float walkwayLookahead;
+	// how old, in ms, the newest mask, pose and gyro sample may be before nav slows down,
+	// see Watchdog.h. 0 leaves one unwatched.
+	int   watchdogMaskMs;
+	int   watchdogPoseMs;
+	int   watchdogGyroMs;
+	// 1 if the motor controller firmware knows the STOP command of protocol.h. Without it the
+	// watchdog stops the rover by sending nothing more and the queued moves run out.
+	int   motorStop;
+	// ms one forward command drives the rover for, measured on it, see Governor.h. 0 until it
+	// has been, nav then sends one forward command per mask.
+	int   motorMoveMs;
+	// masks/sec nav asks for while stopped and at most, see Governor.h
+	float governorMinHz;
+	float governorMaxHz;
+	// meters driven per mask, 0 always asks for governorMaxHz
+	float governorMetersPerMask;
+	// meters/sec the rover drives forward at, 0 estimates it from the GPS positions
+	float governorSpeed;
+	// degrees C of the hottest thermal zone the mask rate is held down from, and is down to
+	// governorMinHz at
+	int   governorThrottleC;
+	int   governorCriticalC;
+	// degrees east magnetic north is of true north where the rover drives, see Orientation.h.
+	// Read by the gyro node when it starts.
+	float magDeclination;
+	// hardware backends, see Hal.h. These may be left out of Parameters.txt, the rover's
+	// hardware is used then. Only read when the nodes start.
+	HalConfig hal;
 } Parameters;
 
+/**
+ * @brief One published version of the #Parameters.
+**/
+typedef struct _ParameterSnapshot {
+	unsigned int version;		// 1 for the first file loaded, counts up with each change
+	time_t loaded;			// wall clock time the file was loaded
+	Parameters values;
+} ParameterSnapshot;
+
+/**
+ * @brief Data area of the #ParameterData shared memory.
+ * @details Snapshot n is kept at n % #PARAMETER_SNAPSHOTS. The writer fills in the slot of the
+ *	    next version before it updates version, so the slot of the current version is never
+ *	    being written.
+**/
+typedef struct _ParametersShared {
+	volatile unsigned int version;	// newest published version, 0 if none
+	ParameterSnapshot snapshots[PARAMETER_SNAPSHOTS];
+} ParametersShared;
+
 /**
  * @brief Function call reads in new parameter values.
  * @details Calling this function reads in the file defined by fileName and parses it for
- * 	    #Parameters values. These values are then loaded into the parameters sturct which
- * 	    is pointed to by the incoming #Parameters address.
+ * 	    #Parameters values. The file is mapped and parsed in a single pass. Names are matched
+ * 	    against the table in Parameters.c (older names are accepted too), every value is
+ * 	    checked for its type and range, and every parameter must be given exactly once. Each
+ * 	    problem is printed with its line number. Only the hardware backends may be left out.
  * @param fileName Path to Parameters.txt file.
  * @param parameters Pointer to #Parameters struct whose values will be read in from the 
  * 	  Parameters.txt file.
- * @pre Expects the Parameters.txt file to be in a very specific order. Check Parameters.txt to see
- * 	the format. This function sees ':' as a delimeter, with anyting immediately following the
- * 	colon ccharacter as the value to be read in. This allows for Parameters.txt to be in a 
- * 	human readable format.
- * @post The #Parameters pointer will contain the values parsed from Parameters.txt.
+ * @return 0 on success, -1 if the file could not be read or has any error.
+ * @post On success the #Parameters pointer will contain the values parsed from Parameters.txt,
+ *	 on failure it is left untouched.
 **/
 int GetParameters(char * fileName, Parameters * parameters);
 
+/**
+ * @brief Publishes parameters as a new snapshot. Only tx2_master.c calls this.
+ * @param shared The #ParameterData shared memory.
+ * @param parameters The new values.
+ * @return The version of the new snapshot.
+**/
+unsigned int PublishParameters(ParametersShared * shared, Parameters * parameters);
+
+/**
+ * @brief Loads the file and publishes it if it is valid and differs from the current snapshot.
+ * @param shared The #ParameterData shared memory.
+ * @param fileName Path to Parameters.txt file.
+ * @return 1 if a new snapshot was published, 0 if the file is unchanged, -1 if it was rejected
+ *	   and the current snapshot stays in use.
+**/
+int ReloadParameters(ParametersShared * shared, char * fileName);
+
+/**
+ * @brief Copies the newest snapshot.
+ * @param shared The #ParameterData shared memory.
+ * @param snapshot Output.
+ * @return 0 on success, -1 if nothing has been published yet.
+**/
+int GetParameterSnapshot(ParametersShared * shared, ParameterSnapshot * snapshot);
+
+/**
+ * @brief Starts watching a parameters file for changes.
+ * @details Watches the directory of the file, so editors that save by renaming a new file over
+ *	    the old one are noticed as well.
+ * @param fileName Path to Parameters.txt file.
+ * @return An inotify file descriptor to wait on, -1 on error.
+**/
+int WatchParameters(char * fileName);
+
+/**
+ * @brief Reads the pending events of a #WatchParameters() descriptor.
+ * @param fd The descriptor returned by #WatchParameters().
+ * @param fileName The same path given to #WatchParameters().
+ * @return 1 if the file was written or replaced, 0 otherwise.
+**/
+int ParametersChanged(int fd, char * fileName);
+
 /**
  * @breif Prints out data members of #Parameters pointer.
  * @details Prints out data members of #Parameters pointer. Used primarily for testing purposes.
@@ -0,0 +1,103 @@
+/**
+ * @file Profile.h
+ * @brief Header file for the Profile library.
+ * @details Header file for the Profile library. The timing statistics of the nodes say how long
+ *	    something took, not why: whether the filters of tx2_nav_node.c wait on memory, or
+ *	    what the gyro node spends its time on. This library counts what the CPU did in a
+ *	    region of code with the kernel's performance counters (perf_event_open(2)): time on
+ *	    the CPU, cycles, instructions, last level cache misses, branch misses and context
+ *	    switches (#ProfileCounter). Each thread opens its counters as one group the first time
+ *	    it enters a region, and a region reads the group when it is entered and when it is
+ *	    left, one read(2) each, adding up the difference. What was read on the way in is kept
+ *	    by the thread, so regions may be nested and entered by several threads at once.
+ *	    <br>
+ *	    <br>
+ *	    Profiling is off unless #PROFILE_ENV names the node ("all" for every node), and off it
+ *	    costs one test of #profileOn per region. Counters the kernel does not have (no PMU in a
+ *	    virtual machine, perf_event_paranoid) are left out and printed as "-". The regions are
+ *	    printed when the node exits and whenever it gets #PROFILE_DUMP_SIGNAL:
+ *	    <br>
+ *	    <br>
+ *	    TX2_PROFILE=tx2_nav_node ./tx2_master<br>
+ *	    kill -USR1 $(pidof tx2_nav_node)
+**/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define PROFILE_ENV "TX2_PROFILE"		/**< Environment variable, "all" or node names separated by commas. */
+#define PROFILE_DUMP_SIGNAL SIGUSR1		/**< Prints the regions of a profiled node. */
+#define PROFILE_MAX_REGIONS 32			/**< Most regions printed. */
+#define PROFILE_MAX_DEPTH 8			/**< Most regions a thread is in at once, deeper ones are not counted. */
+
+/**
+ * @brief The counters of a thread, the order they are read in.
+**/
+typedef enum _ProfileCounter {
+	ProfileTaskClock,		// ns on a CPU, a software counter, leads the group
+	ProfileCycles,
+	ProfileInstructions,
+	ProfileCacheMisses,		// last level cache
+	ProfileBranchMisses,
+	ProfileContextSwitches,		// a software counter
+	ProfileCounters
+} ProfileCounter;
+
+/**
+ * @brief A region of code, a global of the code it is in.
+**/
+typedef struct _ProfileRegion {
+	const char * name;
+	volatile int registered;			// in the list #ProfileDump() prints
+	unsigned long calls;
+	unsigned long long total[ProfileCounters];	// added up, scaled up if the counters were shared
+} ProfileRegion;
+
+/**
+ * @brief Set by #ProfileInit() if this node is profiled.
+**/
+extern int profileOn;
+
+/**
+ * @brief Enters a region, nothing if the node is not profiled.
+**/
+#define PROFILE_BEGIN(region) do { if (profileOn) { ProfileBegin(region); } } while (0)
+
+/**
+ * @brief Leaves a region, nothing if the node is not profiled.
+**/
+#define PROFILE_END(region) do { if (profileOn) { ProfileEnd(region); } } while (0)
+
+/**
+ * @brief Turns profiling on if #PROFILE_ENV names the node, opening the counters of the calling thread.
+ * @details The regions are printed at exit and on #PROFILE_DUMP_SIGNAL.
+ * @param node Name of the node, as in #PROFILE_ENV.
+ * @return 1 if the node is profiled, 0 if not, -1 if it should be but the kernel has no counters.
+**/
+int ProfileInit(char * node);
+
+/**
+ * @brief Enters a region, use #PROFILE_BEGIN().
+**/
+void ProfileBegin(ProfileRegion * region);
+
+/**
+ * @brief Leaves a region, use #PROFILE_END(). Prints the regions if #PROFILE_DUMP_SIGNAL came in.
+**/
+void ProfileEnd(ProfileRegion * region);
+
+/**
+ * @brief Prints every region entered so far: calls, CPU time, instructions per cycle, and cache
+ *	  and branch misses per thousand instructions.
+**/
+void ProfileDump();
+
+#endif
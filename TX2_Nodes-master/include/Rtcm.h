@@ -0,0 +1,171 @@
+/**
+ * @file Rtcm.h
+ * @brief Header file for the Rtcm library.
+ * @details Header file for the Rtcm library, differential corrections for the XA1110. With
+ *	    SBAS alone its fixes wander by meters. Given the RTCM corrections of a base station
+ *	    nearby it fixes in differential mode (PMTK301,1), fix quality 2 with the age of the
+ *	    corrections in the GGA sentence.
+ *	    <br>
+ *	    <br>
+ *	    tx2_gps_node.c reads the corrections from the source named by #RTCM_SOURCE_ENV:
+ *	    <br>
+ *	    <br>
+ *	    tcp:address:port, a caster or relay on the local network, reconnected every
+ *	    #RTCM_RECONNECT_NS while it is down (rtcmReplay.c serves a recording this way)<br>
+ *	    serial:device:baud, a radio receiving the base station<br>
+ *	    file:path, a recording, an epoch every #RTCM_FILE_PERIOD_NS on the clock, looping.
+ *	    An epoch runs until a message type comes again
+ *	    <br>
+ *	    <br>
+ *	    The bytes are framed as RTCM 3 (0xD3, 10 bit length, the message, CRC-24Q), bytes
+ *	    between frames and frames with a bad CRC are dropped. Whole frames wait in a queue of
+ *	    #RTCM_QUEUE_FRAMES, the oldest dropped when it is full (the oldest not yet begun if
+ *	    part of one is with the receiver) or when they are older than #RTCM_STALE_NS, an old
+ *	    correction is worse than none. The node writes them to the XA1110 in slots right after
+ *	    it has read a burst, at most #RTCM_SLOT_BYTES a slot and never past the time the next
+ *	    burst is read, so the fixes are read as often as before.
+**/
+
+#ifndef RTCM_H
+#define RTCM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define RTCM_SOURCE_ENV "TX2_RTCM"		/**< Environment variable naming the source, none if unset. */
+#define RTCM_PREAMBLE 0xD3			/**< First byte of a frame. */
+#define RTCM_MAX_MESSAGE 1023			/**< Longest message, the length has 10 bits. */
+#define RTCM_MAX_FRAME (RTCM_MAX_MESSAGE + 6)	/**< With the header and CRC. */
+#define RTCM_QUEUE_FRAMES 32			/**< Frames waiting to be written. */
+#define RTCM_EPOCH_TYPES 16			/**< Most message types in an epoch of a file. */
+#define RTCM_STALE_NS 5000000000LL		/**< Frames waiting longer are dropped. */
+#define RTCM_RECONNECT_NS 5000000000LL		/**< Between attempts to reach a source that is down. */
+#define RTCM_FILE_PERIOD_NS 1000000000LL	/**< Between epochs of a file. */
+#define RTCM_SLOT_BYTES 1024			/**< Most written to the XA1110 in a slot. */
+#define RTCM_SLOT_NS 50000000LL			/**< Between slots while frames are waiting. */
+
+/**
+ * @brief Kinds of source, see #RTCM_SOURCE_ENV.
+**/
+typedef enum _RtcmSourceType {
+	RtcmSourceTcp,
+	RtcmSourceSerial,
+	RtcmSourceFile
+} RtcmSourceType;
+
+/**
+ * @brief A frame waiting to be written.
+**/
+typedef struct _RtcmFrame {
+	uint8_t data[RTCM_MAX_FRAME];
+	int length;
+	long long time;			// #ClockNowNs() it was read at
+} RtcmFrame;
+
+/**
+ * @brief What the stream has read and written.
+**/
+typedef struct _RtcmStats {
+	unsigned long bytes;		// read from the source
+	unsigned long frames;		// with a good CRC
+	unsigned long crcErrors;
+	unsigned long skipped;		// bytes outside of frames
+	unsigned long dropped;		// frames dropped, the queue was full or they were stale
+	unsigned long written;		// frames written to the receiver
+	unsigned long writtenBytes;
+	unsigned long writeErrors;
+	unsigned long connects;		// of a tcp or serial source
+	long long lastFrame;		// #ClockNowNs() of the newest frame, 0 if none
+	long long lastWritten;		// #ClockNowNs() the newest frame was written
+	int lastType;			// message type of the newest frame
+} RtcmStats;
+
+/**
+ * @brief A source of corrections.
+**/
+typedef struct _RtcmStream {
+	int type;				// #RtcmSourceType
+	char name[96];				// tcp address, serial device or file
+	int port;				// tcp port or serial baud
+	int fd;					// -1 while not connected
+	long long nextConnect;
+	uint8_t * file;				// a file source's data
+	long fileLength;
+	long filePosition;
+	long long nextEpoch;
+	uint8_t pending[2 * RTCM_MAX_FRAME];	// bytes read, not framed yet
+	int pendingLength;
+	RtcmFrame queue[RTCM_QUEUE_FRAMES];	// a ring
+	int queueHead;
+	int queueCount;
+	int written;				// bytes of the head frame written
+	RtcmStats stats;
+} RtcmStream;
+
+/**
+ * @brief Opens a source and tries to connect it.
+ * @param source "tcp:address:port", "serial:device:baud" or "file:path".
+ * @param now #ClockNowNs().
+ * @return 0 on success, -1 if the source cannot be understood, a tcp address is not IPv4 or the file read.
+**/
+int RtcmOpen(RtcmStream * stream, char * source, long long now);
+
+/**
+ * @brief Returns the descriptor to wait on for the source, -1 if there is none right now.
+**/
+int RtcmFd(RtcmStream * stream);
+
+/**
+ * @brief Returns the #ClockNowNs() time the stream is next due without its descriptor, a reconnect or an epoch of a file.
+**/
+long long RtcmNextDue(RtcmStream * stream);
+
+/**
+ * @brief Reads what the source has and queues the frames in it, and reconnects if due.
+ * @return The frames queued, -1 if the source went down.
+**/
+int RtcmService(RtcmStream * stream, long long now);
+
+/**
+ * @brief Returns the part of the oldest frame left to write, after dropping stale ones.
+ * @param data Output, the bytes.
+ * @param most Most bytes wanted.
+ * @return The bytes, 0 if the queue is empty.
+**/
+int RtcmNextChunk(RtcmStream * stream, long long now, uint8_t ** data, int most);
+
+/**
+ * @brief Takes bytes returned by #RtcmNextChunk() as written.
+ * @param bytes The bytes written, -1 if the write failed, the frame is dropped.
+**/
+void RtcmWritten(RtcmStream * stream, int bytes, long long now);
+
+/**
+ * @brief Returns the message type of a frame.
+**/
+int RtcmMessageType(uint8_t * frame);
+
+/**
+ * @brief Returns the CRC-24Q of data, as it ends a frame.
+**/
+unsigned int RtcmCrc24q(uint8_t * data, int length);
+
+/**
+ * @brief Returns the length of the frame data starts with.
+ * @return The length, 0 if more bytes are needed, -1 if data does not start with a frame.
+**/
+int RtcmFrameLength(uint8_t * data, int length);
+
+/**
+ * @brief Copies out the statistics.
+**/
+void RtcmGetStats(RtcmStream * stream, RtcmStats * stats);
+
+/**
+ * @brief Closes the source.
+**/
+void RtcmClose(RtcmStream * stream);
+
+#endif
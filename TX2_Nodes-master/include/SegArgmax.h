@@ -0,0 +1,141 @@
+/**
+ * @file SegArgmax.h
+ * @brief Header file for the SegArgmax library.
+ * @details Header file for the SegArgmax library, the segmentation mask made from the scores of
+ *	    the segmentation network on the CPU. segNet scores every class at every cell of a grid
+ *	    coarser than the camera and its mask is the class of the best score, scaled up to the
+ *	    camera, how sure it was of each cell thrown away. Here one pass over the scores gives
+ *	    both, the mask and a confidence byte per pixel:
+ *	    <br>
+ *	    <br>
+ *	    #SegConfidenceMax, the best score<br>
+ *	    #SegConfidenceMargin, the best score less the second best, small where two classes
+ *	    are close, at the edge of a walkway for one
+ *	    <br>
+ *	    <br>
+ *	    times a scale, 0 to 255. The scores are taken as segNet's output layer keeps them, a
+ *	    plane of grid width x grid height per class. The simd kernel takes 4 cells at a time
+ *	    with SSE2 or NEON, the classes of a chunk of cells one plane after the other so the
+ *	    planes are read in order, and gives the mask and confidence of the scalar kernel. Where
+ *	    there is neither it is the scalar kernel.
+ *	    <br>
+ *	    <br>
+ *	    The #SegmentationData shared memory holds the mask followed by its confidence, width x
+ *	    height bytes each (#SEG_ARGMAX_PLANES). tx2_cam_node.cpp fills both from segNet's
+ *	    scores, tx2_host_cam_node.c leaves its masks at #SEG_ARGMAX_CERTAIN, and
+ *	    tx2_nav_node.c records the confidence of the lower half of each mask.
+**/
+
+#ifndef SEG_ARGMAX_H
+#define SEG_ARGMAX_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SEG_ARGMAX_PLANES 2		/**< Mask and confidence in the #SegmentationData shared memory. */
+#define SEG_ARGMAX_MAX_CLASSES 256	/**< A class fits a byte of the mask. */
+#define SEG_ARGMAX_SCALE 32.0f		/**< Confidence per unit of score, a margin of 8 is certain. */
+#define SEG_ARGMAX_CERTAIN 255		/**< Confidence of masks made without scores. */
+#define SEG_ARGMAX_LOW 64		/**< Confidence below this is low. */
+#define SEG_ARGMAX_CHUNK 256		/**< Cells the simd kernel takes the classes of at once. */
+
+/**
+ * @brief What the confidence is.
+**/
+typedef enum _SegConfidence {
+	SegConfidenceMax,
+	SegConfidenceMargin
+} SegConfidence;
+
+/**
+ * @brief The kernels.
+**/
+typedef enum _SegArgmaxKernel {
+	SegArgmaxScalar,
+	SegArgmaxSimd,
+	SegArgmaxKernelCount
+} SegArgmaxKernel;
+
+/**
+ * @brief Masks made.
+**/
+typedef struct _SegArgmaxStats {
+	unsigned long masks;
+	long long argmaxNs;		// total in the kernel
+	long long scaleNs;		// total scaling the grid up
+	long long maxNs;		// longest mask
+} SegArgmaxStats;
+
+/**
+ * @brief The masks of scores of one size.
+**/
+typedef struct _SegArgmax {
+	int classes;
+	int ignore;			// class never chosen, -1 for none
+	int gridWidth;			// of the scores
+	int gridHeight;
+	int width;			// of the mask
+	int height;
+	int confidence;			// #SegConfidence
+	float scale;			// confidence per unit of score
+	int kernel;			// #SegArgmaxKernel in use
+	uint8_t * gridMask;		// the grid before it is scaled up, NULL if it is the size of the mask
+	uint8_t * gridConfidence;	// the grid's confidence, also when it is not wanted
+	int * columns;			// grid column of each mask column
+	SegArgmaxStats stats;
+} SegArgmax;
+
+/**
+ * @brief Sets up masks of width x height from scores of a grid.
+ * @param classes Planes of scores, at most #SEG_ARGMAX_MAX_CLASSES.
+ * @param ignore A class never chosen, as segNet's 'void', -1 for none.
+ * @param confidence #SegConfidenceMax or #SegConfidenceMargin, times #SEG_ARGMAX_SCALE.
+ * @return 0 on success, -1 if the sizes are wrong or out of memory.
+ * @post The simd kernel is used where there is one.
+**/
+int SegArgmaxInit(SegArgmax * argmax, int classes, int ignore, int gridWidth, int gridHeight,
+		  int width, int height, int confidence);
+
+/**
+ * @brief Sets the confidence per unit of score.
+**/
+void SegArgmaxSetScale(SegArgmax * argmax, float scale);
+
+/**
+ * @brief Makes the mask and confidence of scores.
+ * @param scores classes planes of gridWidth x gridHeight.
+ * @param mask Output, width x height classes.
+ * @param confidence Output, width x height, NULL if not wanted.
+**/
+void SegArgmaxApply(SegArgmax * argmax, float * scores, uint8_t * mask, uint8_t * confidence);
+
+/**
+ * @brief Makes them at the grid with a given kernel, for timing and comparing.
+ * @param mask Output, gridWidth x gridHeight.
+ * @param confidence Output, gridWidth x gridHeight.
+**/
+void SegArgmaxApplyWith(SegArgmax * argmax, int kernel, float * scores, uint8_t * mask, uint8_t * confidence);
+
+/**
+ * @brief Returns the average confidence of pixels and the fraction of them below #SEG_ARGMAX_LOW.
+**/
+float SegConfidenceSummary(uint8_t * confidence, int length, float * low);
+
+/**
+ * @brief Returns the name of a #SegArgmaxKernel.
+**/
+char * SegArgmaxName(int kernel);
+
+/**
+ * @brief Copies out the statistics.
+**/
+void SegArgmaxGetStats(SegArgmax * argmax, SegArgmaxStats * stats);
+
+/**
+ * @brief Frees the buffers.
+**/
+void SegArgmaxClose(SegArgmax * argmax);
+
+#endif
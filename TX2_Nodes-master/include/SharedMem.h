@@ -24,31 +24,17 @@
 
 // file names for shared memory
 #define SHARED_SEG_NAME "shared_nav_memory"
-#define SHARED_ANG_NAME "shared_angle_memory"
+#define SHARED_HEAD_NAME "shared_heading_memory"
 #define SHARED_POS_NAME "shared_pos_memory"
-
-/**
- * @brief Macro used to set an angle in shared memory.
- * @details This macro sets an angle in shared memory, and sets
- *	    a bit signifying to the receiving node that new data 
- *	    is available.
-**/
-#define SET_SHARED_ANGLE(mem, val) *((float *)((mem) + 1)) = (val);\
-				   mem->dataAvailableFlag = 1
-
-/**\
- * @brief Macro used by receiving node to read in new angle.
- * @details Macro used by receiving node to read in new angle in 
- *	    in shared memory. dataAvailableFlag is reset after read.
- *	    A while loop is used to block the reading process until the
- *	    data is avialable. This isn't the best way to implement and
- *	    could easily lead to the reading process entering deadlock.
- *	    Though, as this is only every used during a turn, so long as the
- *	    gyro doesn't malfunction the reading process should not get stuck.
-**/
-#define GET_SHARED_ANGLE(mem, val) while (0 == mem->dataAvailableFlag);\
-				   (val) = *((float *)((mem) + 1));\
-				   mem->dataAvailableFlag = 0
+#define SHARED_ORIENT_NAME "shared_orientation_memory"
+#define SHARED_PARAM_NAME "shared_parameter_memory"
+#define SHARED_SIM_NAME "shared_simulation_memory"
+#define SHARED_CLOCK_NAME "shared_clock_memory"
+#define SHARED_BENCH_NAME "shared_bench_memory"
+#define SHARED_OBSTACLE_NAME "shared_obstacle_memory"
+#define SHARED_WALKWAY_NAME "shared_walkway_memory"
+#define SHARED_CHECKPOINT_NAME "shared_nav_checkpoint"
+#define SHARED_GOVERNOR_NAME "shared_governor_memory"
 
 /**
  * @brief Macro used to set a shared #Position in memory.
@@ -73,13 +59,45 @@
 				        mem->currentlyBeingAccessed = 0;\
 				      } while (0)
 
+/**
+ * @brief Macro used to set a shared #PositionEstimate in memory.
+ * @details Macro used to set a shared #PositionEstimate in memory. As #Position is the first
+ *	    member of #PositionEstimate, #GET_SHARED_POSITION still reads the position from it.
+**/
+#define SET_SHARED_ESTIMATE(mem, val) while (mem->currentlyBeingAccessed);\
+				      memcpy((PositionEstimate *)((mem) + 1), &(val), sizeof(PositionEstimate));\
+				      mem->dataAvailableFlag = 1
+
+/**
+ * @brief Macro used to read a #PositionEstimate from shared memory.
+ * @details Macro used to read a #PositionEstimate from shared memory. val is only updated if a
+ *	    new estimate was published since the last read.
+**/
+#define GET_SHARED_ESTIMATE(mem, val) do {\
+					mem->currentlyBeingAccessed = 1;\
+					if (mem->dataAvailableFlag == 1) {\
+						memcpy(&(val), (PositionEstimate *)((mem) + 1), sizeof(PositionEstimate));\
+						mem->dataAvailableFlag = 0;\
+					}\
+					mem->currentlyBeingAccessed = 0;\
+				      } while (0)
+
 /**
  * @brief Enum used to differentiate between different types of shared memory.
 **/
 typedef enum _SMType {
 	SegmentationData,
-	AngleData,
-	PositionData
+	HeadingData,		// #HeadingShared, written by tx2_gyro_node.c, see Heading.h
+	PositionData,
+	OrientationData,	// #OrientationShared, written by tx2_gyro_node.c, see Orientation.h
+	ParameterData,		// #ParametersShared, written by tx2_master.c, see Parameters.h
+	SimulationData,		// #SimShared, written by roverSim.c, see Simulation.h
+	BenchData,		// #BenchState, written by ipcBench.c and its synthetic nodes
+	ObstacleData,		// #ObstacleShared, written by tx2_nav_node.c, see Obstacles.h
+	WalkwayData,		// #WalkwayShared, written by tx2_nav_node.c, see Walkway.h
+	CheckpointData,		// #NavCheckpoint, written by tx2_nav_node.c, see NavCheckpoint.h
+	GovernorData,		// #GovernorShared, written by tx2_nav_node.c, see Governor.h
+	SMTypeCount		// number of shared memory types, not a type
 } SMType;
 
 /**
@@ -120,7 +138,7 @@ SharedMem * CreateSharedMemory(int size, SMType type);
  * @brief Function opens shared memory of a specified size and type.
  * @details This function opens the shared memory created from the #CreateSharedMemory call, specified via
  *	    the parameter type. The size of the shared memory location also needs to be known by the process
- *	    which is opening this location. For #AngleData and #PositionData, this size of the shared memory 
+ *	    which is opening this location. For #HeadingData and #PositionData, this size of the shared memory 
  *	    is hard coded. For semantic segmentation however, the size is entirley dependent on the resolution
  *	    of the camera. In this case, a special #Message struct #ShMem is passed in a message from the 
  *	    tx2_cam_node.cpp to tx2_nav_node.c, which contains the dimensions of the image, allowing the size
@@ -0,0 +1,194 @@
+/**
+ * @file Simulation.h
+ * @brief Header file for the Simulation library.
+ * @details Header file for the Simulation library, the world shared by roverSim.c and the "sim"
+ *	    backends of Hal.h. roverSim.c creates the #SimulationData shared memory, a #SimShared,
+ *	    before it starts tx2_master.c, and from then on the node tree drives a simulated rover
+ *	    instead of the real one:
+ *	    <br>
+ *	    <br>
+ *	    CAN (#CanSim): tx2_can_node.c pushes the motor frames it would have written to can0
+ *	    into a ring, roverSim.c plays them on a model of the motor controller and integrates a
+ *	    skid-steer kinematic model of the rover on a flat 2D map.
+ *	    <br>
+ *	    I2C (#I2CSourceSim): the I2CMock.h models report the simulated rover. The XA1110 gives
+ *	    GGA/VTG fixes of its position, the LSM9DS1 its yaw rate and the magnetometer its
+ *	    heading.
+ *	    <br>
+ *	    Camera (#CameraSim): tx2_host_cam_node.c renders the mask the segmentation network
+ *	    would produce from where the camera is, see #SimulationRender().
+ *	    <br>
+ *	    Clock (#ClockSim): simulated time, which runs timeScale times faster than real time,
+ *	    see #ClockUseScaled(), or with a timeScale of 0 the virtual clock of Clock.h, which
+ *	    runs as fast as the nodes can keep up.
+ *	    <br>
+ *	    <br>
+ *	    The map is a list of #SimShape capsules, line segments with a radius: walkways, and
+ *	    obstacles standing on them. Positions are meters east (x) and north (y) of an origin
+ *	    whose latitude and longitude are given, headings are degrees clockwise from north.
+ *	    The world and clock are fixed before the nodes start, the pose is published by
+ *	    roverSim.c with a sequence number, like #OrientationShared, and the frame ring has one
+ *	    writer and one reader, like #HeadingShared.
+**/
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define SIM_FRAME_RING 256		/**< Motor frames buffered between tx2_can_node.c and roverSim.c, a power of 2. */
+#define SIM_MAX_SHAPES 64		/**< Most walkways and obstacles on a map. */
+
+#define SIM_CAMERA_WIDTH 640		/**< Rendered mask width. */
+#define SIM_CAMERA_HEIGHT 360		/**< Rendered mask height. */
+#define SIM_CAMERA_MOUNT 0.6		/**< Meters, height of the camera above the ground. */
+#define SIM_CAMERA_TILT 10.0		/**< Degrees the camera points below the horizon. */
+#define SIM_CAMERA_FOV 60.0		/**< Degrees, horizontal field of view. */
+#define SIM_CAMERA_FPS 10		/**< Masks per simulated second, the rate of the segmentation network. */
+
+#define SIM_WALKWAY_LABEL 4		/**< Mask value of walkways, segNet 'sidewalk'. */
+#define SIM_TERRAIN_LABEL 15		/**< Mask value of the ground off the walkways, segNet 'terrain'. */
+#define SIM_SKY_LABEL 16		/**< Mask value above the horizon, segNet 'sky'. */
+#define SIM_OBSTACLE_LABEL 20		/**< Mask value of obstacles, segNet 'cycle', as #CAMERA_OBSTACLE_LABEL. */
+
+/**
+ * @brief What a #SimShape is.
+**/
+typedef enum _SimShapeType {
+	SimWalkway,
+	SimObstacle
+} SimShapeType;
+
+/**
+ * @brief A walkway or obstacle, everything within radius of the segment from (x1, y1) to (x2, y2).
+**/
+typedef struct _SimShape {
+	int type;			// #SimShapeType
+	double x1;
+	double y1;
+	double x2;
+	double y2;
+	double radius;			// half the width of a walkway
+} SimShape;
+
+/**
+ * @brief Where the simulated rover is and how it moves.
+**/
+typedef struct _SimPose {
+	double x;			// meters east of the origin
+	double y;			// meters north of the origin
+	double heading;			// true heading, degrees clockwise from north, 0-360
+	double speed;			// meters/sec, forward
+	double rate;			// degrees/sec, positive for left turns, the gyro convention
+	long long time;			// #ClockNowNs() of the pose
+} SimPose;
+
+/**
+ * @brief A CAN frame written by tx2_can_node.c.
+**/
+typedef struct _SimFrame {
+	unsigned int id;
+	unsigned char length;
+	unsigned char data[8];
+} SimFrame;
+
+/**
+ * @brief Data area of the #SimulationData shared memory.
+**/
+typedef struct _SimShared {
+	// clock, fixed before the nodes start
+	long long realEpoch;		// CLOCK_MONOTONIC when simulated time started
+	double timeScale;		// simulated seconds per real second, 0 for the virtual clock
+
+	// world, fixed before the nodes start
+	double latitude;		// origin of the map
+	double longitude;
+	double gpsNoise;		// meters, peak uniform error of the simulated fixes
+	int shapeCount;
+	SimShape shapes[SIM_MAX_SHAPES];
+
+	// rover, written by roverSim.c
+	volatile unsigned int sequence;	// odd while the pose is being written
+	SimPose pose;
+
+	// masks rendered by tx2_host_cam_node.c, the first is asked for once nav is ready
+	volatile unsigned long masks;
+
+	// the camera hangs from stallStart until stallEnd, #ClockNowNs() times set by roverSim.c
+	volatile long long stallStart;
+	volatile long long stallEnd;
+
+	// motor frames, written by tx2_can_node.c, read by roverSim.c
+	volatile unsigned int frameHead;
+	volatile unsigned int frameTail;
+	unsigned long framesLost;	// frames pushed while the ring was full
+	SimFrame frames[SIM_FRAME_RING];
+} SimShared;
+
+/**
+ * @brief Maps the #SimulationData shared memory created by roverSim.c.
+ * @details The memory is mapped once per process, later calls return the same mapping. It is
+ *	    opened directly rather than with SharedMem.c so that the backends of one node can
+ *	    share it without taking its #SMType slot.
+ * @return The world, NULL if roverSim.c is not running.
+**/
+SimShared * SimulationOpen();
+
+/**
+ * @brief Publishes the pose of the rover.
+**/
+void SimulationSetPose(SimShared * sim, SimPose * pose);
+
+/**
+ * @brief Copies out the pose of the rover.
+**/
+void SimulationGetPose(SimShared * sim, SimPose * pose);
+
+/**
+ * @brief Queues a CAN frame for roverSim.c.
+ * @return 0 on success, -1 if the ring was full and the frame was lost.
+**/
+int SimulationPushFrame(SimShared * sim, unsigned int id, unsigned char * data, int length);
+
+/**
+ * @brief Takes the oldest queued CAN frame.
+ * @return 1 if a frame was taken, 0 if there was none.
+**/
+int SimulationPopFrame(SimShared * sim, SimFrame * frame);
+
+/**
+ * @brief Converts a point of the map into latitude and longitude, degrees, west and south negative.
+**/
+void SimulationLatLon(SimShared * sim, double x, double y, double * latitude, double * longitude);
+
+/**
+ * @brief Returns the mask value of the ground at a point of the map.
+ * @return #SIM_OBSTACLE_LABEL, #SIM_WALKWAY_LABEL or #SIM_TERRAIN_LABEL.
+**/
+int SimulationLabel(SimShared * sim, double x, double y);
+
+/**
+ * @brief Returns 1 if a circle at a point of the map touches an obstacle, else 0.
+**/
+int SimulationBlocked(SimShared * sim, double x, double y, double radius);
+
+/**
+ * @brief Renders the segmentation mask seen from a pose.
+ * @details The camera looks along the heading of the rover from #SIM_CAMERA_MOUNT above the
+ *	    ground, #SIM_CAMERA_TILT below the horizon. Each pixel below the horizon is traced to
+ *	    the flat ground and given the #SimulationLabel() there, obstacles are drawn as their
+ *	    footprint. Pixels above the horizon are #SIM_SKY_LABEL.
+ * @param sim The world.
+ * @param pose The rover.
+ * @param mask Output, width * height bytes.
+ * @param width Mask width.
+ * @param height Mask height.
+**/
+void SimulationRender(SimShared * sim, SimPose * pose, uint8_t * mask, int width, int height);
+
+#endif
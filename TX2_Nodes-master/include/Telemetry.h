@@ -0,0 +1,272 @@
+/**
+ * @file Telemetry.h
+ * @brief Header file for the Telemetry library.
+ * @details Header file for the Telemetry library. What the nodes print is all anybody has after
+ *	    a day in the field, interleaved and impossible to go through once it runs for hours.
+ *	    The nodes record telemetry instead: tx2_nav_node.c the pose, the scores of each mask
+ *	    and what it decided, tx2_master.c every message it routes, CAN frames included, and
+ *	    how many each node sent per second, tx2_comm_node.c the clock offset of the
+ *	    controller (see TimeSync.h). Each node writes its own archive,
+ *	    "node-date-time.tlm" in #TELEMETRY_DIR if that directory exists, or in the one
+ *	    #TELEMETRY_ENV names. A node opens it after #HalInit(), so the times of every archive
+ *	    are on the one clock the nodes share and those of one run line up.
+ *	    <br>
+ *	    <br>
+ *	    An archive holds streams (#TelemetryStream), each a table of a time and up to
+ *	    #TELEMETRY_MAX_COLUMNS integer or float columns. Rows are kept in memory and written
+ *	    in chunks of up to #TELEMETRY_CHUNK_ROWS, at least every #TELEMETRY_FLUSH_NS, one
+ *	    column after the other, so a column can be read without the others:
+ *	    <br>
+ *	    <br>
+ *	    times, the differences of their differences (regular samples come to 0), zigzag
+ *	    varints<br>
+ *	    integers, their differences, zigzag varints<br>
+ *	    floats, each XORed with the one before it and only the bits that changed written
+ *	    (as Facebook's Gorilla)
+ *	    <br>
+ *	    <br>
+ *	    The file is a header and blocks (#TelemetryBlock): the streams, the chunks, and when
+ *	    the node exits an index of the chunks with their first and last times followed by
+ *	    #TelemetryTrailer. A file without it, the node was killed, has its index built by
+ *	    stepping from block to block, a chunk cut short is left out. telemetryQuery.c maps a
+ *	    file and only decodes the columns asked for of the chunks in the time range.
+**/
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TELEMETRY_DIR "../telemetry"		/**< Archives are written here if it exists, relative to build/. */
+#define TELEMETRY_ENV "TX2_TELEMETRY"		/**< Environment variable, another directory than #TELEMETRY_DIR. */
+#define TELEMETRY_MAGIC "TX2TLM01"		/**< First bytes of an archive. */
+#define TELEMETRY_INDEX_MAGIC "TLMINDEX"	/**< Last bytes of an archive with an index. */
+#define TELEMETRY_NAME 32			/**< Longest stream or column name, with the '\0'. */
+#define TELEMETRY_MAX_STREAMS 16		/**< Streams in one archive. */
+#define TELEMETRY_MAX_COLUMNS 16		/**< Columns of a stream, besides the time. */
+#define TELEMETRY_CHUNK_ROWS 4096		/**< Rows in a chunk at most. */
+#define TELEMETRY_FLUSH_NS 30000000000LL	/**< Rows are written at least this often, ns. */
+
+/**
+ * @brief Type of a column.
+**/
+typedef enum _TelemetryType {
+	TelemetryInt,
+	TelemetryFloat
+} TelemetryType;
+
+/**
+ * @brief Type of a block.
+**/
+typedef enum _TelemetryBlockType {
+	TelemetryStreamBlock = 1,	// a #TelemetryStreamInfo
+	TelemetryChunkBlock,		// a #TelemetryChunk and its columns
+	TelemetryIndexBlock		// #TelemetryIndexEntry values
+} TelemetryBlockType;
+
+/**
+ * @brief Start of an archive.
+**/
+typedef struct _TelemetryHeader {
+	char magic[8];			// #TELEMETRY_MAGIC
+	char node[TELEMETRY_NAME];	// that wrote it
+	long long startNs;		// #ClockNowNs() when it was opened, the times are on this clock
+	long long startUnixNs;		// wall clock time then, ns since 1970
+} TelemetryHeader;
+
+/**
+ * @brief Start of every block after the header.
+**/
+typedef struct _TelemetryBlock {
+	int type;			// #TelemetryBlockType
+	unsigned int size;		// bytes after this
+} TelemetryBlock;
+
+/**
+ * @brief A column of a stream.
+**/
+typedef struct _TelemetryColumn {
+	char name[TELEMETRY_NAME];
+	int type;			// #TelemetryType
+} TelemetryColumn;
+
+/**
+ * @brief A stream, as written in its block.
+**/
+typedef struct _TelemetryStreamInfo {
+	int id;				// index of the stream in the archive
+	int columnCount;		// besides the time
+	char name[TELEMETRY_NAME];
+	TelemetryColumn columns[TELEMETRY_MAX_COLUMNS];
+} TelemetryStreamInfo;
+
+/**
+ * @brief Start of a chunk block, the columns follow, the time first.
+**/
+typedef struct _TelemetryChunk {
+	int stream;
+	int rows;
+	long long first;			// time of the first row
+	long long last;				// and of the last
+	unsigned int sizes[TELEMETRY_MAX_COLUMNS + 1];	// bytes of each column, the time first
+} TelemetryChunk;
+
+/**
+ * @brief Where a chunk is.
+**/
+typedef struct _TelemetryIndexEntry {
+	long long offset;		// of its #TelemetryBlock
+	int stream;
+	int rows;
+	long long first;
+	long long last;
+} TelemetryIndexEntry;
+
+/**
+ * @brief End of an archive that was closed.
+**/
+typedef struct _TelemetryTrailer {
+	long long indexOffset;		// of the index #TelemetryBlock
+	long long chunks;		// entries in it
+	char magic[8];			// #TELEMETRY_INDEX_MAGIC
+} TelemetryTrailer;
+
+/**
+ * @brief A value of a row, as kept until it is written.
+**/
+typedef union _TelemetryValue {
+	long long i;
+	double f;
+} TelemetryValue;
+
+/**
+ * @brief A stream being written.
+**/
+typedef struct _TelemetryStream {
+	TelemetryStreamInfo info;
+	int rows;			// kept, not written yet
+	long long * times;		// #TELEMETRY_CHUNK_ROWS
+	TelemetryValue * values;	// #TELEMETRY_CHUNK_ROWS for each column, one column after the other
+} TelemetryStream;
+
+/**
+ * @brief What has been written.
+**/
+typedef struct _TelemetryStats {
+	unsigned long rows;
+	unsigned long chunks;
+	unsigned long long rawBytes;	// the rows as 8 bytes a value
+	unsigned long long bytes;	// the columns written
+	long long encodeNs;		// encoding and writing the chunks
+} TelemetryStats;
+
+/**
+ * @brief An archive being written.
+**/
+typedef struct _TelemetryWriter {
+	int fd;				// -1 if not recording
+	char fileName[512];
+	long long offset;		// end of the file
+	long long lastFlush;		// #ClockNowNs() rows were last written
+	int streamCount;
+	TelemetryStream streams[TELEMETRY_MAX_STREAMS];
+	TelemetryIndexEntry * index;	// of the chunks written
+	long long indexCount;
+	long long indexSize;
+	unsigned char * buffer;		// a chunk being encoded
+	TelemetryStats stats;
+} TelemetryWriter;
+
+/**
+ * @brief An archive mapped for reading.
+**/
+typedef struct _TelemetryReader {
+	unsigned char * data;
+	long long size;
+	TelemetryHeader header;
+	int streamCount;
+	TelemetryStreamInfo streams[TELEMETRY_MAX_STREAMS];
+	TelemetryIndexEntry * index;	// the chunks in the order written, each stream's in time order
+	long long indexCount;
+	int indexed;			// the index was read from the file, not built
+} TelemetryReader;
+
+/**
+ * @brief Opens an archive for a node if telemetry is recorded.
+ * @param node Name of the node, the start of the file name.
+ * @param now #ClockNowNs().
+ * @return 1 if it is recorded, 0 if not, -1 on an error. Recording nothing is safe after either.
+**/
+int TelemetryOpen(TelemetryWriter * writer, char * node, long long now);
+
+/**
+ * @brief Adds a stream.
+ * @param columns Its columns, not counting the time.
+ * @return The stream, for #TelemetryRecord(), -1 if not recording or there are too many.
+**/
+int TelemetryAddStream(TelemetryWriter * writer, char * name, TelemetryColumn * columns, int count);
+
+/**
+ * @brief Records a row.
+ * @details The row is written with its chunk once that is full or #TELEMETRY_FLUSH_NS after the last
+ *	    chunks were written. Nothing if not recording.
+ * @param time #ClockNowNs() of the row, rows of a stream in time order.
+ * @param values One for each column, integer columns are rounded.
+**/
+void TelemetryRecord(TelemetryWriter * writer, int stream, long long time, double * values);
+
+/**
+ * @brief Writes the rows kept, the index and the trailer, and closes the archive.
+**/
+void TelemetryClose(TelemetryWriter * writer);
+
+/**
+ * @brief Copies out the statistics.
+**/
+void TelemetryGetStats(TelemetryWriter * writer, TelemetryStats * stats);
+
+/**
+ * @brief Maps an archive, reading the streams and the index or building it.
+ * @return 0 on success, -1 if it can't be read.
+**/
+int TelemetryMap(TelemetryReader * reader, char * fileName);
+
+/**
+ * @brief Returns the id of a stream, -1 if there is none by that name.
+**/
+int TelemetryFindStream(TelemetryReader * reader, char * name);
+
+/**
+ * @brief Returns the index of a column of a stream, 0 for "time", -1 if there is none by that name.
+ * @details The columns are numbered from 1, as they are in #TelemetryChunk sizes.
+**/
+int TelemetryFindColumn(TelemetryReader * reader, int stream, char * name);
+
+/**
+ * @brief Decodes one column of a chunk without the others.
+ * @param chunk Entry of #TelemetryReader index.
+ * @param column 0 for the time, or from #TelemetryFindColumn().
+ * @param values Output, rows of the chunk, times and integers in i, floats in f.
+ * @return The rows, -1 if the chunk is damaged.
+**/
+int TelemetryDecode(TelemetryReader * reader, long long chunk, int column, TelemetryValue * values);
+
+/**
+ * @brief Returns the bytes a column takes in a chunk.
+**/
+unsigned int TelemetryColumnBytes(TelemetryReader * reader, long long chunk, int column);
+
+/**
+ * @brief Unmaps an archive.
+**/
+void TelemetryUnmap(TelemetryReader * reader);
+
+#endif
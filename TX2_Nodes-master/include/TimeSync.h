@@ -0,0 +1,131 @@
+/**
+ * @file TimeSync.h
+ * @brief Header file for the TimeSync library.
+ * @details Header file for the TimeSync library. The clocks of controller.c and the rover have
+ *	    nothing to do with each other, so how long a command takes to get to the rover, or
+ *	    when something the rover recorded happened on the controller, could not be told.
+ *	    The controller side (logWriter.c, roverSim.c) estimates the offset between them the
+ *	    way NTP does, over the connection it already has to tx2_comm_node.c: every
+ *	    #TIMESYNC_PERIOD_NS it sends a #TimeMessage with its time (t1), the comm node writes
+ *	    in when it read it (t2) and when it answered (t3), and the answer is read at t4.
+ *	    <br>
+ *	    <br>
+ *	    offset = ((t2 - t1) + (t3 - t4)) / 2, the rover clock minus the controller clock<br>
+ *	    delay = (t4 - t1) - (t3 - t2), the round trip on the wire
+ *	    <br>
+ *	    <br>
+ *	    Whatever the two ways take, the true offset is within delay / 2 of the sample's, so of
+ *	    the newest #TIMESYNC_FILTER samples the one with the least delay is used, a sample
+ *	    queued behind an image is left out. The drift of the clocks is fitted to the samples
+ *	    used over the last #TIMESYNC_POINTS of them. The offset at a time is that of the newest
+ *	    sample used plus the drift since, with an error bound of its delay / 2 and
+ *	    #TIMESYNC_WANDER of the time since.
+ *	    <br>
+ *	    <br>
+ *	    With the offset each sample also gives the one way latencies, controller to rover
+ *	    (t2 - t1 - offset) and back (t4 - t3 + offset), within the error bound. The controller
+ *	    side sends its estimate along with every ping and the comm node records it, so what the
+ *	    rover records can be put on the controller's clock afterwards (telemetryQuery.c -sync).
+**/
+
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Messages.h"
+
+#define TIMESYNC_PERIOD_NS 1000000000LL		/**< Pings are sent this often, ns. */
+#define TIMESYNC_FILTER 8			/**< Newest samples the least delay is picked from. */
+#define TIMESYNC_POINTS 32			/**< Samples used the drift is fitted over. */
+#define TIMESYNC_MIN_SPAN_NS 10000000000LL	/**< Ns the samples used must span before the drift is fitted. */
+#define TIMESYNC_MAX_DRIFT 0.0005		/**< Largest drift believed, 500 ppm as NTP. */
+#define TIMESYNC_WANDER 0.000015		/**< Error bound the drift adds, per second since the sample used. */
+
+/**
+ * @brief A sample, on the controller clock.
+**/
+typedef struct _TimeSyncSample {
+	long long local;		// halfway between t1 and t4
+	long long offset;		// rover minus controller, ns
+	long long delay;		// round trip, ns
+} TimeSyncSample;
+
+/**
+ * @brief The samples taken and the one way latencies they gave.
+**/
+typedef struct _TimeSyncStats {
+	unsigned long samples;
+	unsigned long rejected;		// answers of a negative delay, or to no ping of ours
+	unsigned long used;		// picked by the filter
+	long long minDelay;
+	long long maxDelay;
+	long long upMin;		// controller to rover, ns
+	long long upMax;
+	long long upSum;
+	long long downMin;		// rover to controller, ns
+	long long downMax;
+	long long downSum;
+} TimeSyncStats;
+
+/**
+ * @brief The estimate of one controller side.
+**/
+typedef struct _TimeSync {
+	TimeSyncSample filter[TIMESYNC_FILTER];	// newest samples, a ring
+	int filterCount;
+	int filterNext;
+	TimeSyncSample points[TIMESYNC_POINTS];	// samples used, a ring
+	int pointCount;
+	int pointNext;
+	TimeSyncSample best;			// newest sample used
+	double drift;				// rover seconds per controller second, minus 1
+	int valid;				// a sample has been used
+	long long lastPing;			// t1 of the newest ping
+	TimeSyncStats stats;
+} TimeSync;
+
+/**
+ * @brief Starts an estimate without samples.
+**/
+void TimeSyncInit(TimeSync * sync);
+
+/**
+ * @brief Fills in a ping to send the rover.
+ * @param now Controller clock, t1.
+**/
+void TimeSyncPing(TimeSync * sync, Message * message, long long now);
+
+/**
+ * @brief Whether a ping is due.
+**/
+int TimeSyncDue(TimeSync * sync, long long now);
+
+/**
+ * @brief Stamps the answer to a ping, on the rover.
+ * @param receive #ClockNowNs() the ping was read at, t2.
+ * @param transmit #ClockNowNs() just before it is written back, t3.
+**/
+void TimeSyncAnswer(Message * message, long long receive, long long transmit);
+
+/**
+ * @brief Takes the answer to a ping.
+ * @param now Controller clock it was read at, t4.
+ * @return 0 if it was a sample, -1 if it was rejected.
+**/
+int TimeSyncAdd(TimeSync * sync, Message * message, long long now);
+
+/**
+ * @brief Returns the rover clock minus the controller clock at a controller time.
+ * @param error Output, the bound on how wrong it is, ns, may be NULL.
+ * @return The offset, 0 with an error of -1 if there is no estimate yet.
+**/
+long long TimeSyncOffset(TimeSync * sync, long long local, long long * error);
+
+/**
+ * @brief Copies out the statistics.
+**/
+void TimeSyncGetStats(TimeSync * sync, TimeSyncStats * stats);
+
+#endif
@@ -0,0 +1,156 @@
+/**
+ * @file Walkway.h
+ * @brief Header file for the Walkway library.
+ * @details Header file for the Walkway library. The left, center and right filters of
+ *	    FilterGen.h tell tx2_nav_node.c where there is the least to avoid, not where the path
+ *	    is, so on a walkway the rover weaves from one edge to the other. This library finds the
+ *	    edges of the walkway in each cleaned mask and tells nav how far the middle of the
+ *	    walkway is to the side of the rover and which way it runs. Nav turns that into a turn
+ *	    toward the centreline, see #WalkwayTurn(), and when going straight pulls the side
+ *	    of a turn larger than it can make down, as it does for a GPS turn. The estimate is published to shared
+ *	    memory (#WalkwayData) too.
+ *	    <br>
+ *	    <br>
+ *	    Every #WALKWAY_ROW_STEP rows, from the bottom up, the run of path pixels
+ *	    (#WALKWAY_CLASSES, gaps up to #WALKWAY_GAP allowed) nearest the middle of the run below
+ *	    gives a left and a right edge point. Edges that run into the side of the picture are
+ *	    not seen and give no point. A line, column = a + b * row, is fitted to each edge by
+ *	    least squares, the points more than #WALKWAY_OUTLIER pixels off are dropped and the
+ *	    line fitted again. Between masks the previous lines keep points more than
+ *	    #WALKWAY_GATE pixels off them out (unless that leaves too few, when the walkway is
+ *	    taken as new), and the new lines are blended into them (#WALKWAY_SMOOTHING).
+ *	    <br>
+ *	    <br>
+ *	    Each line is put on the ground with the row to distance table of Obstacles.h, at the
+ *	    bottom row and at the highest row looked at, which gives its direction and how far to
+ *	    the side it is. The centreline is halfway between the two edges. Off the middle of a
+ *	    walkway only one edge may be in the picture, the centreline is then half the width of
+ *	    the walkway, remembered from the masks with both edges, from that edge.
+**/
+
+#ifndef WALKWAY_H
+#define WALKWAY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#define WALKWAY_ROW_STEP 4		/**< Rows between edge points. */
+#define WALKWAY_GAP 4			/**< Other pixels a run of path may cross, pixels. */
+#define WALKWAY_MIN_POINTS 6		/**< Fewest points an edge line is fitted to. */
+#define WALKWAY_OUTLIER 6.0		/**< Pixels off the first fit that drop a point. */
+#define WALKWAY_GATE 40.0		/**< Pixels off the previous line that drop a point. */
+#define WALKWAY_SMOOTHING 0.5		/**< Weight of the new lines against the previous. */
+
+/**
+ * @brief segNet classes of a path, a bit per class: 'ground', 'road', 'sidewalk' and 'parking'.
+ * @details #SIM_WALKWAY_LABEL is 'sidewalk'.
+**/
+#define WALKWAY_CLASSES 0x3cu
+
+/**
+ * @brief Where the walkway is, from one mask.
+**/
+typedef struct _WalkwayEstimate {
+	unsigned long frame;		// masks looked at before this one
+	long long time;			// #ClockNowNs() ns the mask was looked at
+	int valid;			// the centreline was found
+	int leftPoints;			// edge points the lines were fitted to, 0 if the edge was not
+	int rightPoints;
+	float offset;			// meters from the rover to the centreline, positive to the right
+	float heading;			// degrees from straight ahead to the centreline, positive to the right
+	float width;			// meters across the walkway, remembered if only one edge was seen
+	float left[2];			// left edge, column = left[0] + left[1] * row, 0 if not leftPoints
+	float right[2];			// right edge, the same, 0 if not rightPoints
+} WalkwayEstimate;
+
+/**
+ * @brief Data area of the #WalkwayData shared memory, written by tx2_nav_node.c.
+**/
+typedef struct _WalkwayShared {
+	volatile unsigned int sequence;	// odd while the estimate is being written
+	WalkwayEstimate estimate;
+} WalkwayShared;
+
+/**
+ * @brief Timing statistics.
+**/
+typedef struct _WalkwayStats {
+	unsigned long masks;		// masks looked at
+	unsigned long valid;		// of those with a valid estimate
+	long long fitNs;		// total time spent on them
+	long long maxNs;		// longest of those
+} WalkwayStats;
+
+/**
+ * @brief Edge fitting of masks of one size.
+**/
+typedef struct _Walkway {
+	int width;
+	int height;
+	uint8_t classes[256];		// 1 for the classes in #WALKWAY_CLASSES
+	float * rowDistance;		// meters ahead by row, from Obstacles.h, not owned
+	float focal;			// pixels
+	float * points;			// row, left and right column of each sampled row, -1 if not seen
+	int haveLine[2];		// lines holds the left or right line of the masks before
+	double lines[2][2];		// left and right, smoothed
+	double pathWidth;		// meters, 0 until both edges have been seen
+	unsigned long frame;
+	WalkwayStats stats;
+} Walkway;
+
+/**
+ * @brief Sets up edge fitting of width x height masks.
+ * @param walkway The #Walkway.
+ * @param width Mask width.
+ * @param height Mask height.
+ * @param rowDistance Meters ahead to where each row meets the ground, see #ObstacleRowDistance().
+ *	  Kept, not copied.
+ * @param focal Pixels, as #ObstacleFinder focal.
+ * @return 0 on success, -1 if out of memory.
+**/
+int WalkwayInit(Walkway * walkway, int width, int height, float * rowDistance, float focal);
+
+/**
+ * @brief Finds the walkway in a mask.
+ * @param walkway The #Walkway.
+ * @param mask The mask, width * height bytes.
+ * @param firstRow Rows above it are not looked at.
+ * @param time #ClockNowNs() ns, stored in the estimate.
+ * @param estimate Output.
+ * @return 0 if the estimate is valid, -1 if not.
+**/
+int WalkwayFit(Walkway * walkway, uint8_t * mask, int firstRow, long long time, WalkwayEstimate * estimate);
+
+/**
+ * @brief Degrees to turn toward the centreline of an estimate, positive to the right.
+ * @details The heading of the centreline plus the angle to the point of it lookahead meters
+ *	    ahead, as pure pursuit. 0 for an invalid estimate or a lookahead of 0.
+**/
+double WalkwayTurn(WalkwayEstimate * estimate, double lookahead);
+
+/**
+ * @brief Copies out the timing statistics.
+**/
+void WalkwayGetStats(Walkway * walkway, WalkwayStats * stats);
+
+/**
+ * @brief Frees what #WalkwayInit() allocated.
+**/
+void WalkwayClose(Walkway * walkway);
+
+/**
+ * @brief Publishes a #WalkwayEstimate to #WalkwayData shared memory.
+**/
+void PublishWalkway(WalkwayShared * shared, WalkwayEstimate * estimate);
+
+/**
+ * @brief Reads the newest #WalkwayEstimate from #WalkwayData shared memory.
+ * @details Copied until it was copied with an even, unchanged sequence, as #GetObstacles().
+ * @return 0 on success, -1 if nothing has been published yet.
+**/
+int GetWalkway(WalkwayShared * shared, WalkwayEstimate * estimate);
+
+#endif
@@ -0,0 +1,141 @@
+/**
+ * @file Watchdog.h
+ * @brief Header file for the Watchdog library.
+ * @details Header file for the Watchdog library. tx2_nav_node.c only acts when a mask comes
+ *	    in, so if the camera node stalls (a capture timing out, the GPU hanging) nav simply
+ *	    waits, the motor controller runs whatever it has queued and nobody notices. The
+ *	    watchdog keeps the time of the newest mask, pose and gyro sample (#WatchdogSource)
+ *	    and checks their ages against a deadline for each, which depends on what nav is doing
+ *	    (#WatchdogMode). A deadline of 0 leaves the source unwatched in that mode, masks are
+ *	    only watched while driving as nav does not ask for them otherwise.
+ *	    <br>
+ *	    <br>
+ *	    The age of the masks is counted from the newest mask or from when nav asked for the
+ *	    next one, whichever is later, so the time nav itself spends turning is not held
+ *	    against the camera. Every time a source goes past its deadline it is counted and
+ *	    logged once. While driving the rover is degraded by how far past its deadline the
+ *	    oldest source is (#WatchdogLevel): slowed down past the deadline, stopped past
+ *	    #WATCHDOG_STOP_FACTOR times it and handed over to manual control past
+ *	    #WATCHDOG_MANUAL_FACTOR times it. Once every source is back on time the rover drives
+ *	    on as before, except after a hand over, which the operator undoes. Stopping empties
+ *	    the motor controller's queue if its firmware knows how (motorStop in Parameters.txt),
+ *	    otherwise the moves already queued run out.
+ *	    <br>
+ *	    <br>
+ *	    Nav waits for its messages no longer than #WatchdogNextCheck(), so a stalled camera is
+ *	    noticed on time even though nothing arrives.
+**/
+
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#define WATCHDOG_STOP_FACTOR 2		/**< Deadlines past which the rover is stopped. */
+#define WATCHDOG_MANUAL_FACTOR 10	/**< Deadlines past which the rover is handed over to manual. */
+#define WATCHDOG_MAX_DEADLINE 60000	/**< Largest deadline parameter, ms. */
+
+/**
+ * @brief What the watchdog keeps the age of.
+**/
+typedef enum _WatchdogSource {
+	WatchdogMask,			// segmentation masks from the camera node
+	WatchdogPose,			// position estimates from the GPS node
+	WatchdogGyro,			// heading samples from the gyro node
+	WatchdogSources
+} WatchdogSource;
+
+/**
+ * @brief What nav is doing, each has its own deadlines.
+**/
+typedef enum _WatchdogMode {
+	WatchdogDriving,		// automatic, on the way to a destination
+	WatchdogWaiting,		// automatic, at the destination or without one
+	WatchdogManual,			// driven by the operator
+	WatchdogModes
+} WatchdogMode;
+
+/**
+ * @brief How far the rover is degraded, only while driving.
+**/
+typedef enum _WatchdogLevel {
+	WatchdogOk,
+	WatchdogSlow,			// a source is past its deadline
+	WatchdogStop,			// past #WATCHDOG_STOP_FACTOR deadlines
+	WatchdogHandOver		// past #WATCHDOG_MANUAL_FACTOR deadlines
+} WatchdogLevel;
+
+/**
+ * @brief Missed deadlines.
+**/
+typedef struct _WatchdogStats {
+	unsigned long checks;				// calls to #WatchdogCheck()
+	unsigned long missed[WatchdogSources];		// times each source went past its deadline
+	long long worstNs[WatchdogSources];		// oldest each source has been seen when late
+	unsigned long degraded[WatchdogHandOver + 1];	// times each level was entered
+} WatchdogStats;
+
+/**
+ * @brief The ages and deadlines.
+**/
+typedef struct _Watchdog {
+	long long deadline[WatchdogModes][WatchdogSources];	// ns, 0 for not watched
+	long long since[WatchdogSources];	// #ClockNowNs() of the newest sample, or of asking for one
+	int late[WatchdogSources];		// past its deadline at the last check
+	WatchdogMode mode;
+	WatchdogLevel level;
+	WatchdogStats stats;
+} Watchdog;
+
+/**
+ * @brief Starts the watchdog with nothing watched, as if every source had just been seen.
+ * @param watchdog The #Watchdog.
+ * @param now #ClockNowNs().
+**/
+void WatchdogInit(Watchdog * watchdog, long long now);
+
+/**
+ * @brief Sets the deadlines from those of driving.
+ * @details Driving watches all three, waiting and manual only the pose and the gyro, which
+ *	    are only logged there.
+ * @param maskMs Milliseconds, 0 for not watched. So are poseMs and gyroMs.
+**/
+void WatchdogSetDeadlines(Watchdog * watchdog, int maskMs, int poseMs, int gyroMs);
+
+/**
+ * @brief Sets what nav is doing.
+**/
+void WatchdogSetMode(Watchdog * watchdog, WatchdogMode mode);
+
+/**
+ * @brief Tells the watchdog a source has a new sample.
+ * @param time #ClockNowNs() ns the sample was taken or received, older than the newest is ignored.
+**/
+void WatchdogFeed(Watchdog * watchdog, WatchdogSource source, long long time);
+
+/**
+ * @brief Checks the ages, logging the sources that have gone past their deadlines.
+ * @param now #ClockNowNs().
+ * @return The #WatchdogLevel, #WatchdogOk unless driving.
+**/
+WatchdogLevel WatchdogCheck(Watchdog * watchdog, long long now);
+
+/**
+ * @brief Returns the next #ClockNowNs() time a deadline, or a multiple of it, can pass.
+ * @return LLONG_MAX if nothing is watched.
+**/
+long long WatchdogNextCheck(Watchdog * watchdog, long long now);
+
+/**
+ * @brief Returns the name of a source, for logging.
+**/
+char * WatchdogSourceName(WatchdogSource source);
+
+/**
+ * @brief Copies out the statistics.
+**/
+void WatchdogGetStats(Watchdog * watchdog, WatchdogStats * stats);
+
+#endif
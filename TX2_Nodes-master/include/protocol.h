@@ -15,6 +15,8 @@
 /********* Commands *********/
 #define PUSH						0x0		/**< Push data to the end of the list/queue */
 #define INSERT						0x1		/**< Insert data at the beginning of the list */
+#define STOP						0x2		/**< With the flush bit, empty the list and stop without queueing the direction. Only sent if motorStop is set in Parameters.txt, the motor unit firmware does not know it yet */
+#define STOP_NO_DIRECTION			0x0		/**< Directional bits of #STOP, which are not read */
 
 #define MOVE_RIGHT              0       /**< Directional: Turn right */
 #define MOVE_LEFT               1       /**< Directional: Turn left */
@@ -0,0 +1,906 @@
+/**
+ * @file ipcBench.c
+ * @brief ipcBench tool.
+ * @details The ipcBench tool measures the message bus of the node tree end to end. It starts
+ * 	    tx2_master.c, unchanged, from a scratch directory where every child node is a link
+ * 	    back to ipcBench, so master forks and execs synthetic producer and consumer nodes
+ * 	    that tell their role from their name, and routes their traffic exactly as it routes
+ * 	    that of the real nodes. The nodes are coordinated through the #BenchData shared
+ * 	    memory, which also holds the send time of every message by sequence number. Each
+ * 	    routing pattern is run twice, one message at a time for the latency, then with a
+ * 	    window of messages in flight for the throughput:
+ * 	    <br>
+ * 	    <br>
+ * 	    direct: tx2_gps_node.c to tx2_gyro_node.c, master only forwards.<br>
+ * 	    navRewrite: tx2_comm_node.c to tx2_can_node.c, which master sends to tx2_nav_node.c
+ * 	    instead, the path of the manual drive commands.<br>
+ * 	    commandQueue: a #Create command from tx2_comm_node.c, queued by master (Command.h)
+ * 	    and sent to tx2_nav_node.c as a #PositionMessage, which pops the queue when it has
+ * 	    it. Queued commands wait for the ones ahead of them, as destinations do.<br>
+ * 	    sharedMemory: tx2_gps_node.c publishes a timestamp with a sequence number, like
+ * 	    #OrientationShared, every #BENCH_PUBLISH_US, tx2_gyro_node.c polls for it.
+ * 	    <br>
+ * 	    <br>
+ * 	    The consumer replies to the producer through master, every message when measuring
+ * 	    latency, once per half window when measuring throughput. One-way latency is from
+ * 	    the producer writing a message to the consumer reading it, round trip until the
+ * 	    producer reads the reply, the first #BENCH_WARMUP messages are left out. The CPU
+ * 	    cost per message is the CPU time of the producer, consumer and master during the
+ * 	    run over the messages sent, the sharedMemory consumer spins so its cost is a core.
+ * 	    <br>
+ * 	    <br>
+ * 	    The result is one CSV line per pattern and mode on stdout, under a header line,
+ * 	    latencies in microseconds. The transport column names what carried the messages,
+ * 	    so that runs over other transports can be put in the same table. The output of the
+ * 	    nodes goes to #BENCH_LOG_FILE.
+ * 	    <br>
+ * 	    <br>
+ * 	    Usage: ./ipcBench [messages] [window]
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "include/Messages.h"
+#include "include/SharedMem.h"
+#include "include/Clock.h"
+
+#define BENCH_MASTER "build/tx2_master"		/**< The master that is measured. */
+#define BENCH_PARAMETERS "Parameters_host.txt"	/**< Copied for master, with the backends below. */
+#define BENCH_LOG_FILE "ipcBench.log"		/**< Output of the nodes. */
+#define BENCH_SCRATCH "/tmp/ipcBench.XXXXXX"	/**< Where master is started, with the node links. */
+#define BENCH_TRANSPORT "pipe"			/**< What carries the messages between the nodes. */
+
+#define BENCH_NODES 6			/**< Child nodes of master, as CHILD_COUNT in tx2_master.c. */
+#define BENCH_MESSAGES 10000		/**< Default messages per run, after the warm up. */
+#define BENCH_WINDOW 32			/**< Default messages in flight when measuring throughput. */
+#define BENCH_WARMUP 500		/**< Messages sent before the measured ones. */
+#define BENCH_MAX_MESSAGES 200000	/**< Most messages in a run, warm up included. */
+#define BENCH_PUBLISH_US 200		/**< Microseconds between shared memory publishes. */
+#define BENCH_POLL_NS (10 * CLOCK_MILLISECOND)	/**< How often an idle node looks for a new run. */
+#define BENCH_TIMEOUT 30		/**< Seconds a run may go without progress. */
+
+#define SEC_TO_NS(s) ((long long)((s) * 1000000000.0))
+
+/**
+ * @brief How the messages of a run travel.
+**/
+typedef enum _BenchPattern {
+	PatternDirect,
+	PatternRewrite,
+	PatternCommand,
+	PatternSharedMemory
+} BenchPattern;
+
+/**
+ * @brief What a run measures.
+**/
+typedef enum _BenchMode {
+	ModeLatency,			// one message in flight
+	ModeThroughput			// a window of messages in flight
+} BenchMode;
+
+/**
+ * @brief A run of the suite.
+**/
+typedef struct _BenchRun {
+	char * name;
+	int pattern;			// #BenchPattern
+	int mode;			// #BenchMode
+	int producer;			// #NodeName
+	int consumer;
+} BenchRun;
+
+/**
+ * @brief The suite, in the order it runs.
+**/
+BenchRun benchRuns[] = {
+	{ "direct",       PatternDirect,       ModeLatency,    TX2Gps,  TX2Gyro },
+	{ "direct",       PatternDirect,       ModeThroughput, TX2Gps,  TX2Gyro },
+	{ "navRewrite",   PatternRewrite,      ModeLatency,    TX2Comm, TX2Nav },
+	{ "navRewrite",   PatternRewrite,      ModeThroughput, TX2Comm, TX2Nav },
+	{ "commandQueue", PatternCommand,      ModeLatency,    TX2Comm, TX2Nav },
+	{ "commandQueue", PatternCommand,      ModeThroughput, TX2Comm, TX2Nav },
+	{ "sharedMemory", PatternSharedMemory, ModeLatency,    TX2Gps,  TX2Gyro }
+};
+
+#define BENCH_RUNS (sizeof(benchRuns) / sizeof(benchRuns[0]))	/**< Runs in the suite. */
+
+/**
+ * @brief Node names as master starts them, indexed by #NodeName.
+**/
+char * benchNodeNames[BENCH_NODES] = {
+	[TX2Comm] = "tx2_comm_node",
+	[TX2Can] = "tx2_can_node",
+	[TX2Cam] = "tx2_cam_node",
+	[TX2Nav] = "tx2_nav_node",
+	[TX2Gps] = "tx2_gps_node",
+	[TX2Gyro] = "tx2_gyro_node"
+};
+
+/**
+ * @brief Files master executes, linked to ipcBench in the scratch directory.
+**/
+char * benchLinks[BENCH_NODES] = {
+	"tx2_comm_node",
+	"tx2_can_node",
+	"tx2_host_cam_node",
+	"tx2_nav_node",
+	"tx2_gps_node",
+	"tx2_gyro_node"
+};
+
+/**
+ * @brief Data area of the #BenchData shared memory.
+**/
+typedef struct _BenchState {
+	// suite, set by ipcBench before master starts
+	int messages;			// per run, warm up included
+	int window;
+
+	// run, set by ipcBench
+	volatile int runIndex;		// into #benchRuns
+	volatile unsigned int run;	// incremented to start a run
+	volatile int quit;		// set to stop the nodes
+
+	// set by the nodes
+	volatile int ready;		// nodes started
+	volatile int started;		// nodes that have seen the run start
+	volatile int reported;		// nodes that have reported their CPU time for the run
+	volatile unsigned int done;	// run, once the producer has finished it
+	volatile int failed;		// the run made no progress for #BENCH_TIMEOUT
+	volatile unsigned long received;// messages the consumer has taken
+	volatile long long last;	// ns, when it took the last one
+	double cpu[BENCH_NODES];	// seconds the run cost each node, by #NodeName
+
+	// sharedMemory pattern, written by the producer
+	volatile unsigned int sequence;	// odd while being written
+	volatile unsigned long published;
+	volatile long long publishedAt;
+
+	// by sequence number, in ns
+	long long sent[BENCH_MAX_MESSAGES];
+	long long oneWay[BENCH_MAX_MESSAGES];	// 0 if it never arrived
+	long long roundTrip[BENCH_MAX_MESSAGES];
+} BenchState;
+
+/**
+ * @brief The latencies of a run, in microseconds.
+**/
+typedef struct _Distribution {
+	unsigned long count;
+	double min;
+	double p50;
+	double p90;
+	double p99;
+	double p999;
+	double max;
+	double mean;
+} Distribution;
+
+/**
+ * @brief tx2_master.c, -1 before it is started.
+**/
+pid_t runningMaster = -1;
+
+/**
+ * @brief Scratch directory, the #BENCH_SCRATCH template until it is made.
+**/
+char scratch[] = BENCH_SCRATCH;
+
+/**
+ * @brief Returns CLOCK_MONOTONIC in nanoseconds.
+**/
+long long NowNs()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((long long)now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
+
+/**
+ * @brief Returns the CPU time of the calling process in seconds.
+**/
+double ProcessCpu()
+{
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + (usage.ru_utime.tv_usec / 1000000.0) +
+	       usage.ru_stime.tv_sec + (usage.ru_stime.tv_usec / 1000000.0);
+}
+
+/**
+ * @brief Returns the CPU time of another process in seconds, from /proc, 0 if it is gone.
+**/
+double OtherCpu(pid_t pid)
+{
+	char path[64];
+	char stat[512];
+	char * end;
+	unsigned long user, system;
+	int length;
+	int fd;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return 0.0;
+	}
+	length = read(fd, stat, sizeof(stat) - 1);
+	close(fd);
+	if (length <= 0) {
+		return 0.0;
+	}
+	stat[length] = '\0';
+
+	// "pid (name) state ... utime stime", the name may hold spaces
+	end = strrchr(stat, ')');
+	if (NULL == end || 2 != sscanf(end + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &user, &system)) {
+		return 0.0;
+	}
+
+	return (double)(user + system) / sysconf(_SC_CLK_TCK);
+}
+
+/**
+ * @brief Sends a #BenchMessage.
+**/
+void SendBench(int fd, int source, int destination, unsigned long sequence, unsigned long count)
+{
+	Message message;
+
+	memset(&message, 0, sizeof(message));
+	message.messageType = BenchMessage;
+	message.source = source;
+	message.destination = destination;
+	message.benchMsg.sequence = sequence;
+	message.benchMsg.count = count;
+	SendMessage(fd, &message);
+}
+
+/**
+ * @brief Sends message sequence of a run, stamping its send time.
+**/
+void SendOne(BenchState * state, BenchRun * run, int fd, unsigned long sequence)
+{
+	Message message;
+
+	memset(&message, 0, sizeof(message));
+	message.source = run->producer;
+
+	if (PatternCommand == run->pattern) {
+		// appended to the queue, after whatever is in it
+		message.messageType = CommandMessage;
+		message.destination = TX2Master;
+		message.cmdMsg.commandType = PositionCommand;
+		message.cmdMsg.commandOperation = Create;
+		message.cmdMsg.previousCommandId = ULONG_MAX;
+		message.cmdMsg.position.latitude = sequence;
+	} else {
+		message.messageType = BenchMessage;
+		message.destination = (PatternRewrite == run->pattern)?(TX2Can):(run->consumer);
+		message.benchMsg.sequence = sequence;
+	}
+
+	state->sent[sequence] = NowNs();
+	SendMessage(fd, &message);
+}
+
+/**
+ * @brief Waits for every node to see the run start, so none misses the first message.
+ * @return 0 once they have, -1 on a timeout.
+**/
+int WaitForStart(BenchState * state)
+{
+	long long giveUp = NowNs() + SEC_TO_NS(BENCH_TIMEOUT);
+
+	while (state->started < BENCH_NODES) {
+		if (NowNs() > giveUp) {
+			return -1;
+		}
+		usleep(100);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Internal function that sends the messages of a run and takes the replies.
+ * @return 1 if a #KillMessage came instead, else 0.
+**/
+int Produce(BenchState * state, BenchRun * run, int readFd, int writeFd)
+{
+	fd_set rdfs;
+	Message message;
+	unsigned long total = state->messages;
+	unsigned long window = (ModeLatency == run->mode)?(1):(state->window);
+	unsigned long sent = 0;
+	unsigned long acked = 0;
+	long long progress;
+	int killed = 0;
+
+	if (WaitForStart(state) < 0) {
+		state->failed = 1;
+		state->done = state->run;
+		return 0;
+	}
+
+	progress = NowNs();
+
+	while (acked < total) {
+		while (sent < total && sent - acked < window) {
+			SendOne(state, run, writeFd, sent);
+			sent++;
+		}
+
+		if (SetAndWait(&rdfs, 1, 0) <= 0) {
+			if (NowNs() - progress > SEC_TO_NS(BENCH_TIMEOUT)) {
+				state->failed = 1;
+				break;
+			}
+			continue;
+		}
+
+		ReceiveMessage(readFd, &message);
+		if (KillMessage == message.messageType) {
+			killed = 1;
+			break;
+		}
+		if (BenchMessage != message.messageType) {
+			continue;
+		}
+
+		if (ModeLatency == run->mode) {
+			state->roundTrip[message.benchMsg.sequence] = NowNs() - state->sent[message.benchMsg.sequence];
+		}
+		acked = message.benchMsg.count;
+		progress = NowNs();
+	}
+
+	__sync_synchronize();
+	state->done = state->run;
+
+	return killed;
+}
+
+/**
+ * @brief Internal function that takes a message of a run and replies to the producer.
+**/
+void Consume(BenchState * state, BenchRun * run, Message * message, int writeFd)
+{
+	Message pop;
+	unsigned long sequence;
+	unsigned long received;
+	unsigned long credit = (state->window > 1)?(state->window / 2):(1);
+	long long now = NowNs();
+
+	if (PatternCommand == run->pattern && PositionMessage == message->messageType) {
+		sequence = (unsigned long)message->positionMsg.position.latitude;
+
+		// done with the command, as nav would be, master sends the next one
+		memset(&pop, 0, sizeof(pop));
+		pop.messageType = CommandMessage;
+		pop.source = TX2Nav;
+		pop.destination = TX2Master;
+		SendMessage(writeFd, &pop);
+	} else if (PatternCommand != run->pattern && BenchMessage == message->messageType) {
+		sequence = message->benchMsg.sequence;
+	} else {
+		return;
+	}
+
+	if (sequence >= (unsigned long)state->messages) {
+		return;
+	}
+
+	state->oneWay[sequence] = now - state->sent[sequence];
+	state->last = now;
+	received = ++state->received;
+
+	if (ModeLatency == run->mode || 0 == received % credit || received == (unsigned long)state->messages) {
+		SendBench(writeFd, run->consumer, run->producer, sequence, received);
+	}
+}
+
+/**
+ * @brief Internal function that publishes the samples of the sharedMemory pattern.
+**/
+void Publish(BenchState * state)
+{
+	unsigned long i;
+
+	if (WaitForStart(state) < 0) {
+		state->failed = 1;
+		state->done = state->run;
+		return;
+	}
+
+	for (i = 0; i < (unsigned long)state->messages; i++) {
+		state->sequence++;
+		__sync_synchronize();
+		state->published = i;
+		state->sent[i] = state->publishedAt = NowNs();
+		__sync_synchronize();
+		state->sequence++;
+
+		usleep(BENCH_PUBLISH_US);
+	}
+
+	// the last sample has been out a whole period, the consumer has had its chance
+	__sync_synchronize();
+	state->done = state->run;
+}
+
+/**
+ * @brief Internal function that polls for the samples of the sharedMemory pattern, until the run is done.
+**/
+void Observe(BenchState * state, unsigned int run)
+{
+	unsigned long previous = ULONG_MAX;
+	unsigned long sample;
+	unsigned int sequence;
+	long long at;
+
+	while (state->done != run) {
+		sequence = state->sequence;
+		if (sequence & 1) {
+			continue;
+		}
+		__sync_synchronize();
+		sample = state->published;
+		at = state->publishedAt;
+		__sync_synchronize();
+
+		if (sequence != state->sequence || sample == previous || sample >= (unsigned long)state->messages) {
+			sched_yield();
+			continue;
+		}
+
+		state->oneWay[sample] = NowNs() - at;
+		state->last = NowNs();
+		state->received++;
+		previous = sample;
+	}
+}
+
+/**
+ * @brief Internal function that runs a synthetic node, started by master as role.
+ * @return 0 once killed, -1 on error.
+**/
+int BenchNode(int role, int argc, char ** argv)
+{
+	fd_set rdfs;
+	Message message;
+	SharedMem * sharedMem;
+	BenchState * state;
+	BenchRun * run = NULL;
+	unsigned int seenRun = 0;
+	double cpuStart = 0.0;
+	int reported = 1;
+	int quitSent = 0;
+	int killed = 0;
+	int readFd, writeFd;
+
+	if (argc < 3) {
+		printf("%s: no pipes\n", benchNodeNames[role]);
+		return -1;
+	}
+	readFd = atoi(argv[1]);
+	writeFd = atoi(argv[2]);
+	SetupSetAndWait(&readFd, 1);
+
+	sharedMem = OpenSharedMemory(sizeof(BenchState), BenchData);
+	if (NULL == sharedMem) {
+		return -1;
+	}
+	state = (BenchState *)(sharedMem + 1);
+	__sync_fetch_and_add(&state->ready, 1);
+
+	while (!killed) {
+		if (state->run != seenRun) {
+			seenRun = state->run;
+			run = &benchRuns[state->runIndex];
+			cpuStart = ProcessCpu();
+			reported = 0;
+			__sync_fetch_and_add(&state->started, 1);
+
+			if (PatternSharedMemory == run->pattern && role == run->producer) {
+				Publish(state);
+			} else if (PatternSharedMemory == run->pattern && role == run->consumer) {
+				Observe(state, seenRun);
+			} else if (role == run->producer) {
+				killed = Produce(state, run, readFd, writeFd);
+			}
+		}
+
+		if (!reported && state->done == seenRun) {
+			state->cpu[role] = ProcessCpu() - cpuStart;
+			__sync_fetch_and_add(&state->reported, 1);
+			reported = 1;
+		}
+
+		// master stops the tree when a node asks it to
+		if (state->quit && TX2Comm == role && !quitSent) {
+			memset(&message, 0, sizeof(message));
+			message.messageType = KillMessage;
+			message.source = TX2Comm;
+			message.destination = TX2Master;
+			SendMessage(writeFd, &message);
+			quitSent = 1;
+		}
+
+		if (killed || SetAndWait(&rdfs, 0, BENCH_POLL_NS) <= 0) {
+			continue;
+		}
+
+		ReceiveMessage(readFd, &message);
+		if (KillMessage == message.messageType) {
+			killed = 1;
+		} else if (NULL != run && role == run->consumer) {
+			Consume(state, run, &message, writeFd);
+		}
+	}
+
+	munmap(sharedMem, sizeof(SharedMem) + sizeof(BenchState));
+	CloseSharedMemory();
+
+	return 0;
+}
+
+/**
+ * @brief Returns the #NodeName a synthetic node was started as, -1 for ipcBench itself.
+**/
+int NodeRole(char * name)
+{
+	char * base = strrchr(name, '/');
+	int i;
+
+	base = (NULL == base)?(name):(base + 1);
+	for (i = 0; i < BENCH_NODES; i++) {
+		if (0 == strcmp(base, benchNodeNames[i])) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * @brief Removes the scratch directory.
+**/
+void RemoveScratch()
+{
+	char path[PATH_MAX];
+	int i;
+
+	if ('X' == scratch[strlen(scratch) - 1]) {
+		return;
+	}
+
+	for (i = 0; i < BENCH_NODES; i++) {
+		snprintf(path, sizeof(path), "%s/%s", scratch, benchLinks[i]);
+		unlink(path);
+	}
+	snprintf(path, sizeof(path), "%s/Parameters.txt", scratch);
+	unlink(path);
+	rmdir(scratch);
+}
+
+/**
+ * @brief Kills the nodes if ipcBench is interrupted.
+**/
+void StopNodes(int signal)
+{
+	if (runningMaster > 0) {
+		kill(-runningMaster, SIGKILL);
+	}
+	RemoveScratch();
+	shm_unlink(SHARED_BENCH_NAME);
+	_exit(1);
+}
+
+/**
+ * @brief Makes the scratch directory master is started from.
+ * @details The child nodes are links to ipcBench, and the parameters are #BENCH_PARAMETERS with
+ *	    the real clock and the camera node master starts on a host, whatever it says.
+ * @return 0 on success, -1 on error.
+**/
+int MakeScratch()
+{
+	char self[PATH_MAX];
+	char path[PATH_MAX];
+	char line[256];
+	FILE * in;
+	FILE * out;
+	int length;
+	int i;
+
+	length = readlink("/proc/self/exe", self, sizeof(self) - 1);
+	if (length <= 0 || NULL == mkdtemp(scratch)) {
+		printf("error making %s\n", BENCH_SCRATCH);
+		return -1;
+	}
+	self[length] = '\0';
+
+	for (i = 0; i < BENCH_NODES; i++) {
+		snprintf(path, sizeof(path), "%s/%s", scratch, benchLinks[i]);
+		if (symlink(self, path) < 0) {
+			printf("error linking %s\n", path);
+			return -1;
+		}
+	}
+
+	in = fopen(BENCH_PARAMETERS, "r");
+	snprintf(path, sizeof(path), "%s/Parameters.txt", scratch);
+	out = fopen(path, "w");
+	if (NULL == in || NULL == out) {
+		printf("error copying %s\n", BENCH_PARAMETERS);
+		return -1;
+	}
+
+	while (NULL != fgets(line, sizeof(line), in)) {
+		if (0 != strncmp(line, "clockBackend", 12) && 0 != strncmp(line, "cameraBackend", 13)) {
+			fputs(line, out);
+		}
+	}
+	fprintf(out, "cameraBackend :replay\nclockBackend :monotonic\n");
+
+	fclose(in);
+	fclose(out);
+
+	return 0;
+}
+
+/**
+ * @brief Orders latencies for qsort().
+**/
+int CompareLatency(const void * a, const void * b)
+{
+	long long x = *(const long long *)a;
+	long long y = *(const long long *)b;
+
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief Internal function that sums up the latencies of a run, skipping the warm up.
+ * @details A latency of 0 is a message that never arrived.
+**/
+void Summarize(long long * samples, unsigned long total, Distribution * distribution)
+{
+	long long * sorted;
+	unsigned long i;
+	unsigned long n = 0;
+	double sum = 0.0;
+
+	memset(distribution, 0, sizeof(Distribution));
+
+	sorted = malloc(sizeof(long long) * total);
+	if (NULL == sorted) {
+		return;
+	}
+
+	for (i = BENCH_WARMUP; i < total; i++) {
+		if (samples[i] > 0) {
+			sorted[n++] = samples[i];
+			sum += samples[i];
+		}
+	}
+
+	if (n > 0) {
+		qsort(sorted, n, sizeof(long long), CompareLatency);
+		distribution->count = n;
+		distribution->min = sorted[0] / 1000.0;
+		distribution->p50 = sorted[(n - 1) / 2] / 1000.0;
+		distribution->p90 = sorted[(unsigned long)((n - 1) * 0.9)] / 1000.0;
+		distribution->p99 = sorted[(unsigned long)((n - 1) * 0.99)] / 1000.0;
+		distribution->p999 = sorted[(unsigned long)((n - 1) * 0.999)] / 1000.0;
+		distribution->max = sorted[n - 1] / 1000.0;
+		distribution->mean = (sum / n) / 1000.0;
+	}
+
+	free(sorted);
+}
+
+/**
+ * @brief Prints the columns of a #Distribution, empty ones if it has no samples.
+**/
+void PrintDistribution(Distribution * distribution)
+{
+	if (0 == distribution->count) {
+		printf(",,,,,,,");
+		return;
+	}
+
+	printf(",%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f", distribution->min, distribution->p50, distribution->p90,
+		distribution->p99, distribution->p999, distribution->max, distribution->mean);
+}
+
+/**
+ * @brief Runs one entry of #benchRuns and prints its line.
+ * @return 0 on success, -1 if master has gone.
+**/
+int RunOne(BenchState * state, int index, pid_t master)
+{
+	BenchRun * run = &benchRuns[index];
+	Distribution oneWay, roundTrip;
+	unsigned long measured = state->messages - BENCH_WARMUP;
+	double masterCpu;
+	double cpu;
+	double seconds;
+
+	state->runIndex = index;
+	state->started = 0;
+	state->reported = 0;
+	state->failed = 0;
+	state->received = 0;
+	state->last = 0;
+	state->published = ULONG_MAX;
+	memset(state->cpu, 0, sizeof(state->cpu));
+	memset(state->oneWay, 0, sizeof(long long) * state->messages);
+	memset(state->roundTrip, 0, sizeof(long long) * state->messages);
+
+	masterCpu = OtherCpu(master);
+	__sync_synchronize();
+	state->run++;
+
+	while (state->done != state->run || state->reported < BENCH_NODES) {
+		if (0 != waitpid(master, NULL, WNOHANG)) {
+			printf("master has exited, see %s\n", BENCH_LOG_FILE);
+			runningMaster = -1;
+			return -1;
+		}
+		usleep(1000);
+	}
+	masterCpu = OtherCpu(master) - masterCpu;
+
+	Summarize(state->oneWay, state->messages, &oneWay);
+	Summarize(state->roundTrip, state->messages, &roundTrip);
+
+	seconds = (state->last - state->sent[BENCH_WARMUP]) / 1000000000.0;
+	cpu = state->cpu[run->producer] + state->cpu[run->consumer];
+	if (PatternSharedMemory != run->pattern) {
+		cpu += masterCpu;
+	}
+
+	printf("%s,%s,%s,%lu,%lu,%d,%.3f,%.0f", BENCH_TRANSPORT, run->name,
+		(ModeLatency == run->mode)?("latency"):("throughput"),
+		measured, measured - oneWay.count, state->failed, seconds,
+		(seconds > 0.0)?(oneWay.count / seconds):(0.0));
+	PrintDistribution(&oneWay);
+	PrintDistribution(&roundTrip);
+	printf(",%.2f,%.2f\n", (cpu * 1000000.0) / state->messages, (masterCpu * 1000000.0) / state->messages);
+	fflush(stdout);
+
+	return 0;
+}
+
+int main(int argc, char ** argv)
+{
+	SharedMem * sharedMem;
+	BenchState * state;
+	char parameters[PATH_MAX];
+	char masterPath[PATH_MAX];
+	long long giveUp;
+	int messages = BENCH_MESSAGES;
+	int window = BENCH_WINDOW;
+	int status = 0;
+	int log;
+	int role;
+	unsigned int i;
+	pid_t master;
+
+	// started by master as one of its child nodes
+	role = NodeRole(argv[0]);
+	if (role >= 0) {
+		return BenchNode(role, argc, argv);
+	}
+
+	if (argc > 1) {
+		messages = atoi(argv[1]);
+	}
+	if (argc > 2) {
+		window = atoi(argv[2]);
+	}
+	if (messages < 1 || messages + BENCH_WARMUP > BENCH_MAX_MESSAGES || window < 1) {
+		printf("usage: ./ipcBench [messages, at most %d] [window]\n", BENCH_MAX_MESSAGES - BENCH_WARMUP);
+		return -1;
+	}
+
+	if (NULL == realpath(BENCH_MASTER, masterPath)) {
+		printf("run ipcBench from the directory with %s\n", BENCH_MASTER);
+		return -1;
+	}
+
+	signal(SIGINT, StopNodes);
+	signal(SIGTERM, StopNodes);
+
+	if (MakeScratch() < 0) {
+		RemoveScratch();
+		return -1;
+	}
+	snprintf(parameters, sizeof(parameters), "%s/Parameters.txt", scratch);
+
+	shm_unlink(SHARED_BENCH_NAME);
+	sharedMem = CreateSharedMemory(sizeof(BenchState), BenchData);
+	if (NULL == sharedMem) {
+		RemoveScratch();
+		return -1;
+	}
+	state = (BenchState *)(sharedMem + 1);
+	memset(state, 0, sizeof(BenchState));
+	state->messages = messages + BENCH_WARMUP;
+	state->window = window;
+
+	// measured on the real clock, whatever the environment says
+	unsetenv(CLOCK_ENV);
+
+	// start the nodes, in their own process group so stragglers can be killed
+	log = open(BENCH_LOG_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	master = fork();
+	if (0 == master) {
+		setpgid(0, 0);
+		if (chdir(scratch) < 0) {
+			exit(-1);
+		}
+		dup2(log, STDOUT_FILENO);
+		dup2(log, STDERR_FILENO);
+		execl(masterPath, "tx2_master", parameters, (char *)NULL);
+		printf("error starting %s\n", masterPath);
+		exit(-1);
+	}
+	close(log);
+	runningMaster = master;
+
+	if (master < 0) {
+		printf("error starting %s\n", BENCH_MASTER);
+		StopNodes(0);
+	}
+
+	giveUp = NowNs() + SEC_TO_NS(BENCH_TIMEOUT);
+	while (state->ready < BENCH_NODES) {
+		if (NowNs() > giveUp || 0 != waitpid(master, NULL, WNOHANG)) {
+			printf("the nodes did not start, see %s\n", BENCH_LOG_FILE);
+			StopNodes(0);
+		}
+		usleep(1000);
+	}
+
+	printf("transport,pattern,mode,messages,lost,failed,seconds,msgs_per_s,"
+	       "oneway_min_us,oneway_p50_us,oneway_p90_us,oneway_p99_us,oneway_p999_us,oneway_max_us,oneway_mean_us,"
+	       "rtt_min_us,rtt_p50_us,rtt_p90_us,rtt_p99_us,rtt_p999_us,rtt_max_us,rtt_mean_us,"
+	       "cpu_us_per_msg,master_cpu_us_per_msg\n");
+
+	for (i = 0; i < BENCH_RUNS && 0 == status; i++) {
+		status = RunOne(state, i, master);
+	}
+
+	// comm asks master to stop the tree
+	if (runningMaster > 0) {
+		state->quit = 1;
+		giveUp = NowNs() + SEC_TO_NS(BENCH_TIMEOUT);
+		while (0 == waitpid(master, NULL, WNOHANG) && NowNs() < giveUp) {
+			usleep(10000);
+		}
+		kill(-master, SIGKILL);
+		waitpid(master, NULL, 0);
+	}
+	runningMaster = -1;
+
+	munmap(sharedMem, sizeof(SharedMem) + sizeof(BenchState));
+	CloseSharedMemory();
+	shm_unlink(SHARED_BENCH_NAME);
+	RemoveScratch();
+
+	return status;
+}
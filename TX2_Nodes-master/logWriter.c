@@ -6,6 +6,11 @@
  * @details The logWriter process is created by controller.c to essentially
  * 	    print incoming data from the TX2 to the screen. It also handles
  * 	    incoming image data and saves to disk.
+ * 	    <br>
+ * 	    <br>
+ * 	    It also pings tx2_comm_node.c every second for the clock offset between
+ * 	    the rover and this machine's wall clock (see TimeSync.h), and prints the
+ * 	    estimate and the one way latencies every #SYNC_REPORT pings.
 **/
 
 #include <stdio.h> 
@@ -19,14 +24,47 @@
 #include <fcntl.h>
 #include <signal.h>
 #include <errno.h>
+#include <time.h>
 #include "include/Messages.h"
+#include "include/TimeSync.h"
 
 int sock;
 
+#define SYNC_REPORT 30 /**< Pings between printing the clock offset. */
+
+TimeSync timeSync; /**< Offset of the rover clock from ours. */
+
 #define BUFFER_SIZE 64
 
 char imageBuffer[BUFFER_SIZE];
 
+/**
+ * @brief Returns the wall clock in nanoseconds, the timeline the rover is put on.
+**/
+long long WallNowNs()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return ((long long)now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
+
+/**
+ * @brief Prints the clock offset and the one way latencies.
+**/
+void PrintTimeSync()
+{
+	TimeSyncStats stats;
+	long long offset, error;
+
+	TimeSyncGetStats(&timeSync, &stats);
+	offset = TimeSyncOffset(&timeSync, WallNowNs(), &error);
+
+	printf("\rclock offset %.3f ms +- %.3f ms, drift %.1f ppm, up %.3f/%.3f/%.3f ms, down %.3f/%.3f/%.3f ms (min/avg/max)\n\r",
+		offset / 1e6, error / 1e6, timeSync.drift * 1e6,
+		stats.upMin / 1e6, stats.upSum / 1e6 / stats.samples, stats.upMax / 1e6,
+		stats.downMin / 1e6, stats.downSum / 1e6 / stats.samples, stats.downMax / 1e6);
+}
+
 /**
  * @brief Function used to read data from TCP socket.
  * @details This function reads incoming data from the TX2.
@@ -37,8 +75,10 @@ void ReadFromSocket()
 {
 	int i;
 	Message messageIn;
+	long long now;
 	// read the message
 	read(sock, &messageIn, sizeof(messageIn));
+	now = WallNowNs();
 
 	// if CAN message, print to screen
 	if (messageIn.messageType == CANMessage)
@@ -89,17 +129,27 @@ void ReadFromSocket()
 		// result of socket check, tell comm node we are A-OK.
 		write(sock, &messageIn, sizeof(messageIn));
 	}
+	else if (messageIn.messageType == TimeMessage)
+	{
+		// answer to our ping
+		if (0 == TimeSyncAdd(&timeSync, &messageIn, now) && 0 == timeSync.stats.samples % SYNC_REPORT)
+		{
+			PrintTimeSync();
+		}
+	}
 }
 
 int main(int argc, char ** argv)
 {
 	fd_set rdfs;
 	int readFds[1];
+	Message ping;
 	sock = atoi(argv[1]);
 	readFds[0] = sock;
 
 	// initialize SetAndWait
 	SetupSetAndWait(readFds, 1);
+	TimeSyncInit(&timeSync);
 
 	while(1)
 	{
@@ -112,5 +162,11 @@ int main(int argc, char ** argv)
 		if (FD_ISSET(sock, &rdfs)) {
 			ReadFromSocket();
 		}
+
+		// time for the next clock offset ping
+		if (TimeSyncDue(&timeSync, WallNowNs())) {
+			TimeSyncPing(&timeSync, &ping, WallNowNs());
+			write(sock, &ping, sizeof(ping));
+		}
 	}
 }
@@ -0,0 +1,364 @@
+/**
+ * @file maskBench.c
+ * @brief maskBench tool.
+ * @details The maskBench tool plays a mask recording (see #CameraRecordOpen()) through the
+ * 	    decision tx2_nav_node.c makes from each mask, once as recorded and once cleaned with
+ * 	    MaskClean.h, and compares the two. The left, center and right filters of FilterGen.h
+ * 	    are made and applied the way the nav node does it, and each mask is turned into
+ * 	    forward, left or right the way its moving forward state does, with the value counts at
+ * 	    1 so every mask decides on its own. Every change of decision from one mask to the
+ * 	    next is counted, the fewer the steadier the rover. The time taken by the cleanup, and
+ * 	    by finding the obstacles of Obstacles.h in the cleaned masks, is compared with that of
+ * 	    the three dot products, taken with the kernel of MaskKernel.h that is fastest here. Every
+ * 	    kernel is timed first and the times printed, the cache of the nav node is left alone.
+ * 	    So are the kernels of SegArgmax.h, on scores made from the first mask, its class the
+ * 	    highest of each pixel and the others random below, some of them close.
+ * 	    <br>
+ * 	    <br>
+ * 	    A speckle rate replaces that fraction of the pixels with random classes first, for
+ * 	    recordings cleaner than the segmentation network, rendered by roverSim.c for example.
+ * 	    The decisions are then also compared with those made from the masks without speckles.
+ * 	    <br>
+ * 	    <br>
+ * 	    The dot product threshold, turning weight, kernel sizes and smallest obstacle come from
+ * 	    the parameters file (#MASK_BENCH_PARAMETERS), the kernel sizes can be given on the
+ * 	    command line. Obstacle distances use #MASK_BENCH_GROUND if there is one.
+ * 	    <br>
+ * 	    <br>
+ * 	    Usage: ./maskBench recording [openSize closeSize] [speckle]
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "include/FilterGen.h"
+#include "include/MaskClean.h"
+#include "include/MaskKernel.h"
+#include "include/SegArgmax.h"
+#include "include/Obstacles.h"
+#include "include/Parameters.h"
+#include "include/Clock.h"
+
+#define MASK_BENCH_PARAMETERS "Parameters.txt"	/**< Where the thresholds and kernel sizes are read. */
+#define MASK_BENCH_GROUND "ground_calibration.txt"	/**< #GROUND_CALIBRATION_FILE as seen from here. */
+#define MASK_BENCH_CLASSES 21			/**< segNet classes, speckles take one at random. */
+#define MASK_BENCH_SEED 1			/**< Speckles are the same every run. */
+#define MASK_BENCH_ARGMAX_RUNS 5		/**< Times each argmax kernel is timed, the best kept. */
+
+/**
+ * @brief Decisions, as the moving forward state of the nav node.
+**/
+typedef enum _Decision {
+	DecideForward,
+	DecideLeft,
+	DecideRight
+} Decision;
+
+/**
+ * @brief How a recording went, cleaned or not.
+**/
+typedef struct _Run {
+	unsigned long changes;		// decisions that differ from the one before
+	unsigned long wrong;		// decisions that differ from the one without speckles
+	unsigned long decisions[3];	// by #Decision
+	long long filterNs;		// time in the dot products
+	long long cleanNs;		// time in the cleanup
+	Decision last;
+} Run;
+
+/**
+ * @brief Decides where a mask sends the rover and counts it.
+ * @param truth The decision without speckles.
+ * @return The decision.
+**/
+Decision Decide(Run * run, unsigned long frame, uint8_t * mask, Parameters * parameters, MaskKernels * kernels,
+		unsigned int * areas, Decision truth)
+{
+	FILTER_TYPE dots[MASK_KERNEL_FILTERS];
+	FILTER_TYPE left, center, right;
+	Decision decision;
+	long long start;
+
+	start = ClockMonotonicNs();
+	MaskKernelApply(kernels, mask, dots);
+	left = dots[0] / areas[0];
+	center = dots[1] / areas[1];
+	right = dots[2] / areas[2];
+	run->filterNs += ClockMonotonicNs() - start;
+
+	// no GPS turn, the nav node favours going straight
+	center *= parameters->turningWeight;
+	left *= (1 + (1 - parameters->turningWeight));
+	right *= (1 + (1 - parameters->turningWeight));
+
+	if (center < parameters->dotProductThreshold && center < left && center < right) {
+		decision = DecideForward;
+	} else if (left < right) {
+		decision = DecideLeft;
+	} else {
+		decision = DecideRight;
+	}
+
+	if (frame > 0 && decision != run->last) {
+		run->changes++;
+	}
+	if (decision != truth) {
+		run->wrong++;
+	}
+	run->decisions[decision]++;
+	run->last = decision;
+
+	return decision;
+}
+
+/**
+ * @brief Times the argmax kernels of SegArgmax.h on scores made from a mask and compares them.
+**/
+void ArgmaxBench(uint8_t * mask, int width, int height)
+{
+	SegArgmax argmax;
+	uint8_t * classes[SegArgmaxKernelCount];
+	uint8_t * confidence[SegArgmaxKernelCount];
+	long long kernelNs[SegArgmaxKernelCount];
+	long long start;
+	long size = (long)width * height;
+	unsigned long recorded = 0;
+	unsigned long differ = 0;
+	float * scores;
+	float average, low;
+	int kernel, c, n;
+	long i;
+
+	scores = malloc(size * MASK_BENCH_CLASSES * sizeof(float));
+	if (NULL == scores || SegArgmaxInit(&argmax, MASK_BENCH_CLASSES, -1, width, height, width, height,
+					    SegConfidenceMargin) < 0) {
+		free(scores);
+		return;
+	}
+
+	for (c = 0; c < MASK_BENCH_CLASSES; c++) {
+		for (i = 0; i < size; i++) {
+			scores[(c * size) + i] = ((6.0f * rand()) / RAND_MAX) - ((c == mask[i] % MASK_BENCH_CLASSES)?(0.0f):(5.0f));
+		}
+	}
+
+	for (kernel = 0; kernel < SegArgmaxKernelCount; kernel++) {
+		classes[kernel] = malloc(size);
+		confidence[kernel] = malloc(size);
+		if (NULL == classes[kernel] || NULL == confidence[kernel]) {
+			return;
+		}
+
+		kernelNs[kernel] = 0;
+		for (n = 0; n < MASK_BENCH_ARGMAX_RUNS; n++) {
+			start = ClockMonotonicNs();
+			SegArgmaxApplyWith(&argmax, kernel, scores, classes[kernel], confidence[kernel]);
+			start = ClockMonotonicNs() - start;
+			kernelNs[kernel] = (0 == n || start < kernelNs[kernel])?(start):(kernelNs[kernel]);
+		}
+	}
+
+	for (i = 0; i < size; i++) {
+		recorded += (classes[SegArgmaxSimd][i] == mask[i] % MASK_BENCH_CLASSES);
+		differ += (classes[SegArgmaxSimd][i] != classes[SegArgmaxScalar][i] ||
+			   confidence[SegArgmaxSimd][i] != confidence[SegArgmaxScalar][i]);
+	}
+	average = SegConfidenceSummary(confidence[SegArgmaxSimd], size, &low);
+
+	printf("argmax of %d classes: %s %.3f ms %s %.3f ms, %lu pixels differ, %.1f%% as recorded, confidence %.0f, %.1f%% low\n",
+		MASK_BENCH_CLASSES, SegArgmaxName(SegArgmaxScalar), kernelNs[SegArgmaxScalar] / 1000000.0,
+		SegArgmaxName(SegArgmaxSimd), kernelNs[SegArgmaxSimd] / 1000000.0, differ, (100.0 * recorded) / size,
+		average, 100.0 * low);
+
+	for (kernel = 0; kernel < SegArgmaxKernelCount; kernel++) {
+		free(classes[kernel]);
+		free(confidence[kernel]);
+	}
+	SegArgmaxClose(&argmax);
+	free(scores);
+}
+
+/**
+ * @brief Prints how a recording went.
+**/
+void PrintRun(char * name, Run * run, unsigned long frames, int speckled)
+{
+	printf("%-8s %6lu changes (%5.1f per 100 masks), forward %lu left %lu right %lu",
+		name, run->changes, (100.0 * run->changes) / frames, run->decisions[DecideForward],
+		run->decisions[DecideLeft], run->decisions[DecideRight]);
+	if (speckled) {
+		printf(", %lu not as without speckles", run->wrong);
+	}
+	printf(", dot products %.3f ms", (run->filterNs / 1000000.0) / frames);
+	if (run->cleanNs) {
+		printf(", cleanup %.3f ms (%.1f%%)", (run->cleanNs / 1000000.0) / frames,
+			(100.0 * run->cleanNs) / run->filterNs);
+	}
+	printf("\n");
+}
+
+int main(int argc, char ** argv)
+{
+	Parameters parameters;
+	MaskClean clean;
+	MaskKernels kernels;
+	ObstacleFinder finder;
+	ObstacleList list;
+	ObstacleStats obstacleStats;
+	unsigned long obstacles = 0;
+	unsigned long near = 0;
+	double nearest = 0.0;
+	Run truth, raw, cleaned;
+	Decision decision;
+	FILTER_TYPE * filters[3];
+	unsigned int areas[3];
+	struct stat info;
+	char header[64];
+	char * newline;
+	uint8_t * data;
+	uint8_t * masks;
+	uint8_t * mask;
+	uint8_t * result;
+	double speckle = 0.0;
+	long long start;
+	int kernel;
+	unsigned long frames;
+	unsigned long frame;
+	long size;
+	long length;
+	long i;
+	int width, height;
+	int fd;
+
+	if (argc < 2) {
+		printf("usage: ./maskBench recording [openSize closeSize] [speckle]\n");
+		return -1;
+	}
+
+	if (GetParameters(MASK_BENCH_PARAMETERS, &parameters) < 0) {
+		printf("error reading %s\n", MASK_BENCH_PARAMETERS);
+		return -1;
+	}
+	if (argc > 3) {
+		parameters.maskOpenSize = atoi(argv[2]);
+		parameters.maskCloseSize = atoi(argv[3]);
+	}
+	if (argc > 4) {
+		speckle = atof(argv[4]);
+	}
+
+	fd = open(argv[1], O_RDONLY);
+	if (fd < 0 || fstat(fd, &info) < 0) {
+		printf("error opening %s\n", argv[1]);
+		return -1;
+	}
+	data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (MAP_FAILED == data) {
+		printf("error mapping %s\n", argv[1]);
+		return -1;
+	}
+
+	// "MASK width height\n"
+	length = (info.st_size < (long)sizeof(header))?(info.st_size):((long)sizeof(header) - 1);
+	memcpy(header, data, length);
+	header[length] = '\0';
+	newline = strchr(header, '\n');
+	if (NULL == newline || 2 != sscanf(header, "MASK %d %d", &width, &height) || width <= 0 || height <= 0) {
+		printf("%s is not a mask recording\n", argv[1]);
+		return -1;
+	}
+	masks = data + (newline - header) + 1;
+	size = (long)width * height;
+	frames = (info.st_size - (masks - data)) / size;
+	if (0 == frames) {
+		printf("%s has no masks\n", argv[1]);
+		return -1;
+	}
+
+	// the filters of the nav node
+	areas[0] = CreateLeftFilter(&filters[0], (width / 2), (height / 2), width, (height / 2));
+	areas[1] = CreateCenterFilter(&filters[1], (int)((double)width * (0.75f)) / 2, (int)((double)width * (0.75f)), (height / 2), width, (height / 2));
+	areas[2] = CreateRightFilter(&filters[2], (width / 2), (height / 2), width, (height / 2));
+
+	// every kernel timed, the fastest used
+	if (MaskKernelInit(&kernels, width, height, filters) < 0) {
+		return -1;
+	}
+	MaskKernelTune(&kernels, NULL, 1);
+	printf("kernels on %s:", kernels.cpu);
+	for (kernel = 0; kernel < MaskKernelCount; kernel++) {
+		if (kernels.stats.kernelNs[kernel] > 0) {
+			printf(" %s %.3f ms", MaskKernelName(kernel), kernels.stats.kernelNs[kernel] / 1000000.0);
+		}
+	}
+	printf(", using %s\n", MaskKernelName(kernels.kernel));
+
+	ArgmaxBench(masks, width, height);
+
+	mask = malloc(size);
+	if (NULL == mask || MaskCleanInit(&clean, width, height) < 0) {
+		return -1;
+	}
+	MaskCleanSetSizes(&clean, parameters.maskOpenSize, parameters.maskCloseSize);
+	if (ObstacleFinderInit(&finder, width, height, MASK_BENCH_GROUND) < 0) {
+		return -1;
+	}
+	ObstacleSetMinArea(&finder, parameters.obstacleMinArea);
+
+	memset(&truth, 0, sizeof(truth));
+	memset(&raw, 0, sizeof(raw));
+	memset(&cleaned, 0, sizeof(cleaned));
+	srand(MASK_BENCH_SEED);
+
+	for (frame = 0; frame < frames; frame++) {
+		decision = Decide(&truth, frame, masks + (frame * size), &parameters, &kernels, areas, DecideForward);
+
+		memcpy(mask, masks + (frame * size), size);
+		if (speckle > 0.0) {
+			for (i = 0; i < size; i++) {
+				if (rand() < speckle * RAND_MAX) {
+					mask[i] = rand() % MASK_BENCH_CLASSES;
+				}
+			}
+		}
+
+		Decide(&raw, frame, mask, &parameters, &kernels, areas, decision);
+
+		start = ClockMonotonicNs();
+		result = MaskCleanApply(&clean, mask, height / 2);
+		cleaned.cleanNs += ClockMonotonicNs() - start;
+
+		Decide(&cleaned, frame, result, &parameters, &kernels, areas, decision);
+
+		obstacles += ObstacleFind(&finder, result, height / 2, 0, &list);
+		if (list.count && list.obstacles[0].distance > 0.0f) {
+			nearest += list.obstacles[0].distance;
+			near++;
+		}
+	}
+
+	printf("%lu %dx%d masks from %s, speckle %.3f, opening %d, closing %d\n", frames, width, height, argv[1],
+		speckle, parameters.maskOpenSize, parameters.maskCloseSize);
+	PrintRun("recorded", &raw, frames, speckle > 0.0);
+	PrintRun("cleaned", &cleaned, frames, speckle > 0.0);
+
+	ObstacleGetStats(&finder, &obstacleStats);
+	printf("obstacles %5.1f per mask, nearest %.2f m on average, %.1f runs, %.3f ms (%.1f%%) max %.3f ms\n",
+		(double)obstacles / frames, (near)?(nearest / near):(0.0), (double)obstacleStats.runs / frames,
+		(obstacleStats.findNs / 1000000.0) / frames, (100.0 * obstacleStats.findNs) / cleaned.filterNs,
+		obstacleStats.maxNs / 1000000.0);
+
+	MaskCleanClose(&clean);
+	MaskKernelClose(&kernels);
+	ObstacleFinderClose(&finder);
+	free(mask);
+	munmap(data, info.st_size);
+
+	return 0;
+}
@@ -0,0 +1,1010 @@
+/**
+ * @file roverSim.c
+ * @brief roverSim tool.
+ * @details The roverSim tool drives the whole node tree, unchanged, around a simulated world,
+ * 	    closed loop and faster than real time. For each scenario it creates the world (see
+ * 	    Simulation.h), starts tx2_master.c with a parameters file that selects the "sim"
+ * 	    backends, connects to tx2_comm_node.c like controller.c does and sends the
+ * 	    destination. It then plays the motor frames written by tx2_can_node.c on a model of
+ * 	    the motor controller and integrates a skid-steer model of the rover, until the rover
+ * 	    has stopped at the destination or the scenario times out.
+ * 	    <br>
+ * 	    <br>
+ * 	    The motor controller queues the one byte commands of protocol.h and runs them one
+ * 	    after the other, #SIM_MOVE_MS for a move, #SIM_TURN_MS for a turn in place, and
+ * 	    flushes the queue (and stops) on a flush command, which with the STOP command of
+ * 	    protocol.h queues nothing. The tracks follow their commanded speeds with a
+ * 	    #SIM_MOTOR_TAU lag, and the rover turns #SIM_SKID times slower than
+ * 	    ideal differential drive would, the tracks slipping sideways. The rover stops short
+ * 	    of obstacles, counting a collision.
+ * 	    <br>
+ * 	    <br>
+ * 	    A scenario is a text file of "name :value" lines, like Parameters.txt, '#' starts a
+ * 	    comment, any other line is an error. A destination or a survey is needed. Distances are meters, x east and y north of the origin, headings degrees
+ * 	    clockwise from north:
+ * 	    <br>
+ * 	    <br>
+ * 	    parameters :file, read by tx2_master.c from build/ (#SIM_PARAMETERS_FILE)<br>
+ * 	    timeScale :simulated seconds per real second (#SIM_TIME_SCALE), 0 for the virtual clock<br>
+ * 	    timeout :simulated seconds before the mission fails (#SIM_TIMEOUT)<br>
+ * 	    arrival :distance from the destination that counts as there (#SIM_ARRIVAL)<br>
+ * 	    gpsNoise :peak error of the simulated fixes (0)<br>
+ * 	    cameraStall :seconds after the destination is sent, seconds the camera then hangs for<br>
+ * 	    navCrash :seconds after the destination is sent that tx2_nav_node.c is killed<br>
+ * 	    survey :file, a #Survey of it is sent instead of the destination (see Coverage.h), which
+ * 	    should be where the survey ends<br>
+ * 	    origin :latitude longitude<br>
+ * 	    start :x y heading<br>
+ * 	    destination :x y<br>
+ * 	    walkway :x1 y1 x2 y2 width, any number<br>
+ * 	    obstacle :x y radius, or x1 y1 x2 y2 radius for a wall, any number<br>
+ * 	    <br>
+ * 	    Once every scenario has run the suite is summed up: whether the rover arrived, the
+ * 	    mission time (from the destination being sent, once the nodes have started and nav
+ * 	    has calibrated its turns, until the rover stopped) in simulated
+ * 	    and real seconds, distance driven, collisions, time spent off the walkways, and the
+ * 	    CPU time of every node, taken from /proc just before the nodes are killed. The output
+ * 	    of the nodes goes to #SIM_LOG_FILE. roverSim pings the comm node for the clock offset
+ * 	    as logWriter.c does (see TimeSync.h) and reports the estimate and the one way latencies;
+ * 	    on one clock the offset should come out within its error bound of 0.
+ * 	    <br>
+ * 	    <br>
+ * 	    With a timeScale of 0 the scenario runs on the virtual clock of Clock.h: roverSim
+ * 	    and every node are participants, and simulated time moves whenever they all wait,
+ * 	    so a scenario runs as fast as the host can compute it, and the same way every time.
+ * 	    <br>
+ * 	    <br>
+ * 	    Usage: ./roverSim scenario [scenario ...]
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <time.h>
+#include <math.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "include/Messages.h"
+#include "include/SharedMem.h"
+#include "include/Simulation.h"
+#include "include/Clock.h"
+#include "include/protocol.h"
+#include "include/Coverage.h"
+#include "include/TimeSync.h"
+
+#define PORT 5000				/**< tx2_comm_node.c port, as controller.c. */
+#define SIM_BUILD_DIRECTORY "build"		/**< Where tx2_master.c is started from. */
+#define SIM_MASTER "./tx2_master"		/**< Started for each scenario. */
+#define SIM_LOG_FILE "../roverSim.log"		/**< Output of the nodes, relative to build/. */
+#define SIM_PARAMETERS_FILE "../Parameters_sim.txt"	/**< Default parameters file, relative to build/. */
+
+#define SIM_TIME_SCALE 10.0		/**< Default simulated seconds per real second. */
+#define SIM_TIMEOUT 600.0		/**< Default simulated seconds a mission may take. */
+#define SIM_ARRIVAL 6.0			/**< Default meters from the destination that count as arrived. */
+#define SIM_SETTLE 3.0			/**< Simulated seconds stopped at the destination that end a mission. */
+#define SIM_STARTUP_TIMEOUT 300.0	/**< Simulated seconds the nodes may take to start and calibrate. */
+#define SIM_STEP_MS 10			/**< Simulated milliseconds per integration step. */
+#define SIM_EXIT_TIMEOUT 10		/**< Real seconds to wait for the nodes to exit. */
+#define SIM_MAX_SCENARIOS 32		/**< Most scenarios in one suite. */
+#define SIM_MAX_NODES 16		/**< Most processes whose CPU time is reported. */
+
+#define SIM_MOTOR_ID 0x123		/**< CAN id of the motor controller. */
+#define SIM_MOTOR_QUEUE 16		/**< Commands the motor controller holds, more are dropped. */
+#define SIM_MOVE_MS 100			/**< Milliseconds a forward or backward command runs. */
+#define SIM_TURN_MS 400			/**< Milliseconds a turn command runs. */
+#define SIM_TRACK_SPEED 0.5		/**< Meters/sec of a driven track. */
+#define SIM_TRACK_WIDTH 0.5		/**< Meters between the tracks. */
+#define SIM_SKID 2.0			/**< Ideal turn rate over the real one. */
+#define SIM_MOTOR_TAU 0.05		/**< Seconds, time constant of the track speeds. */
+#define SIM_ROVER_RADIUS 0.35		/**< Meters, the rover as a circle, for collisions. */
+
+#define SEC_TO_NS(s) ((long long)((s) * 1000000000.0))
+#define NS_TO_SEC(ns) ((ns) / 1000000000.0)
+
+/**
+ * @brief A scenario, as read from its file.
+**/
+typedef struct _Scenario {
+	char name[64];
+	char parameters[256];
+	double timeScale;
+	double timeout;
+	double arrival;
+	double gpsNoise;
+	double stallStart;
+	double stallLength;
+	double navCrash;
+	char survey[256];		// full path, empty for none
+	double latitude;
+	double longitude;
+	double startX;
+	double startY;
+	double startHeading;
+	double destinationX;
+	double destinationY;
+	int shapeCount;
+	SimShape shapes[SIM_MAX_SHAPES];
+} Scenario;
+
+/**
+ * @brief The motor controller and the tracks.
+**/
+typedef struct _Motor {
+	unsigned char queue[SIM_MOTOR_QUEUE];
+	int head;
+	int count;
+	int direction;			// command running, -1 for none
+	long long remaining;		// nanoseconds it has left
+	double left;			// track speeds, meters/sec
+	double right;
+	unsigned long commands;
+	unsigned long flushes;
+	unsigned long dropped;
+} Motor;
+
+/**
+ * @brief CPU time of one process.
+**/
+typedef struct _NodeCpu {
+	char name[32];
+	double seconds;
+} NodeCpu;
+
+/**
+ * @brief How a scenario went.
+**/
+typedef struct _Result {
+	char * outcome;			// "arrived", "timeout" or "failed"
+	double simSeconds;		// mission time
+	double realSeconds;
+	double distance;		// meters driven
+	double offWalkway;		// simulated seconds off the walkways
+	double remaining;		// meters from the destination at the end
+	double stallDistance;		// meters driven while the camera hung
+	int navKilled;			// tx2_nav_node.c was killed
+	double startup;			// simulated seconds until the nodes were ready
+	unsigned long collisions;
+	unsigned long commands;
+	unsigned long framesLost;
+	NodeCpu cpu[SIM_MAX_NODES];
+	int nodeCount;
+	long long offset;		// clock offset estimated at the end, ns
+	long long offsetError;		// bound on it, -1 without an estimate
+	double drift;			// ppm
+	TimeSyncStats sync;
+} Result;
+
+/**
+ * @brief tx2_master.c of the running scenario, -1 if there is none.
+**/
+pid_t runningMaster = -1;
+
+/**
+ * @brief Kills the nodes of the running scenario if roverSim is interrupted.
+**/
+void StopNodes(int signal)
+{
+	if (runningMaster > 0) {
+		kill(-runningMaster, SIGKILL);
+	}
+	shm_unlink(SHARED_SIM_NAME);
+	shm_unlink(SHARED_CLOCK_NAME);
+	_exit(1);
+}
+
+/**
+ * @brief Returns CLOCK_MONOTONIC in nanoseconds.
+**/
+long long NowNs()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((long long)now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
+
+/**
+ * @brief Reads a scenario file.
+ * @return 0 on success, -1 on error.
+**/
+int LoadScenario(char * fileName, Scenario * scenario)
+{
+	FILE * file;
+	char line[256];
+	char name[64];
+	char path[256];
+	char * value;
+	char * base;
+	SimShape * shape;
+	int lineNumber = 0;
+	int destination = 0;
+	int count;
+
+	file = fopen(fileName, "r");
+	if (NULL == file) {
+		printf("error opening scenario %s\n", fileName);
+		return -1;
+	}
+
+	memset(scenario, 0, sizeof(Scenario));
+	strcpy(scenario->parameters, SIM_PARAMETERS_FILE);
+	scenario->timeScale = SIM_TIME_SCALE;
+	scenario->timeout = SIM_TIMEOUT;
+	scenario->arrival = SIM_ARRIVAL;
+
+	// the name is the file name without directory or extension
+	base = strrchr(fileName, '/');
+	snprintf(scenario->name, sizeof(scenario->name), "%s", (NULL != base)?(base + 1):(fileName));
+	value = strrchr(scenario->name, '.');
+	if (NULL != value) {
+		*value = '\0';
+	}
+
+	while (NULL != fgets(line, sizeof(line), file)) {
+		lineNumber++;
+
+		value = strchr(line, '#');
+		if (NULL != value) {
+			*value = '\0';
+		}
+
+		// blank lines and comments
+		if (1 != sscanf(line, "%63s", name)) {
+			continue;
+		}
+
+		value = strchr(line, ':');
+		if (NULL == value) {
+			printf("%s:%d: bad line \"%s\", no ':'\n", fileName, lineNumber, name);
+			fclose(file);
+			return -1;
+		}
+		value++;
+
+		// "name:value" as well as "name :value"
+		base = strchr(name, ':');
+		if (NULL != base) {
+			*base = '\0';
+		}
+
+		shape = &scenario->shapes[scenario->shapeCount];
+
+		if (0 == strcmp(name, "parameters")) {
+			count = sscanf(value, "%255s", scenario->parameters);
+		} else if (0 == strcmp(name, "timeScale")) {
+			count = sscanf(value, "%lf", &scenario->timeScale);
+		} else if (0 == strcmp(name, "timeout")) {
+			count = sscanf(value, "%lf", &scenario->timeout);
+		} else if (0 == strcmp(name, "arrival")) {
+			count = sscanf(value, "%lf", &scenario->arrival);
+		} else if (0 == strcmp(name, "gpsNoise")) {
+			count = sscanf(value, "%lf", &scenario->gpsNoise);
+		} else if (0 == strcmp(name, "cameraStall")) {
+			count = (2 == sscanf(value, "%lf %lf", &scenario->stallStart, &scenario->stallLength));
+		} else if (0 == strcmp(name, "navCrash")) {
+			count = sscanf(value, "%lf", &scenario->navCrash);
+		} else if (0 == strcmp(name, "survey")) {
+			// as the scenarios are given, master reads it from build/
+			count = (1 == sscanf(value, "%255s", path) && NULL != realpath(path, scenario->survey));
+		} else if (0 == strcmp(name, "origin")) {
+			count = (2 == sscanf(value, "%lf %lf", &scenario->latitude, &scenario->longitude));
+		} else if (0 == strcmp(name, "start")) {
+			count = (3 == sscanf(value, "%lf %lf %lf", &scenario->startX, &scenario->startY, &scenario->startHeading));
+		} else if (0 == strcmp(name, "destination")) {
+			count = (2 == sscanf(value, "%lf %lf", &scenario->destinationX, &scenario->destinationY));
+			destination = count;
+		} else if (scenario->shapeCount < SIM_MAX_SHAPES && 0 == strcmp(name, "walkway")) {
+			shape->type = SimWalkway;
+			count = (5 == sscanf(value, "%lf %lf %lf %lf %lf", &shape->x1, &shape->y1, &shape->x2, &shape->y2, &shape->radius));
+			shape->radius /= 2.0;
+			scenario->shapeCount += count;
+		} else if (scenario->shapeCount < SIM_MAX_SHAPES && 0 == strcmp(name, "obstacle")) {
+			shape->type = SimObstacle;
+			count = sscanf(value, "%lf %lf %lf %lf %lf", &shape->x1, &shape->y1, &shape->x2, &shape->y2, &shape->radius);
+			if (3 == count) {
+				// a post, x2 holds the radius
+				shape->radius = shape->x2;
+				shape->x2 = shape->x1;
+				shape->y2 = shape->y1;
+			}
+			count = (3 == count || 5 == count);
+			scenario->shapeCount += count;
+		} else {
+			count = 0;
+		}
+
+		if (count < 1) {
+			printf("%s:%d: bad line \"%s\"\n", fileName, lineNumber, name);
+			fclose(file);
+			return -1;
+		}
+	}
+
+	fclose(file);
+
+	// anything else would arrive before it has started
+	if (!destination && '\0' == scenario->survey[0]) {
+		printf("%s: no destination or survey\n", fileName);
+		return -1;
+	}
+
+	if (scenario->timeScale < 0.0) {
+		printf("%s: timeScale must be positive, or 0 for the virtual clock\n", fileName);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Connects to tx2_comm_node.c, retrying while the nodes start.
+ * @return The socket, -1 if the node is not listening yet.
+**/
+int ConnectToRover()
+{
+	struct sockaddr_in address;
+	int opt = 1;
+	int sock;
+
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(PORT);
+	inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+
+	sock = socket(AF_INET, SOCK_STREAM, 0);
+	if (sock < 0) {
+		return -1;
+	}
+
+	// on the virtual clock the connection is an event for the comm node to pick up, counted
+	// first as the node may have accepted it before connect() returns
+	ClockExternalSent();
+
+	if (0 != connect(sock, (struct sockaddr *)&address, sizeof(address))) {
+		ClockExternalReceived();
+		close(sock);
+		return -1;
+	}
+
+	setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+	fcntl(sock, F_SETFL, O_NONBLOCK);
+
+	return sock;
+}
+
+/**
+ * @brief Takes a motor frame, the way the motor controller does.
+**/
+void MotorFrame(Motor * motor, SimFrame * frame)
+{
+	unsigned char command;
+	int slot;
+
+	if (SIM_MOTOR_ID != frame->id || frame->length < 1) {
+		return;
+	}
+
+	command = frame->data[0];
+	motor->commands++;
+
+	// flushing stops the rover too
+	if (IS_FLUSH(command)) {
+		motor->count = 0;
+		motor->direction = -1;
+		motor->flushes++;
+	}
+
+	// and only stops
+	if (STOP == GET_CMDS(command)) {
+		return;
+	}
+
+	if (motor->count == SIM_MOTOR_QUEUE) {
+		motor->dropped++;
+		return;
+	}
+
+	if (INSERT == GET_CMDS(command)) {
+		motor->head = (motor->head + SIM_MOTOR_QUEUE - 1) % SIM_MOTOR_QUEUE;
+		slot = motor->head;
+	} else {
+		slot = (motor->head + motor->count) % SIM_MOTOR_QUEUE;
+	}
+
+	motor->queue[slot] = GET_DIR(command);
+	motor->count++;
+}
+
+/**
+ * @brief Advances the motor controller and the tracks by dt seconds.
+**/
+void MotorStep(Motor * motor, double dt)
+{
+	double targetLeft = 0.0;
+	double targetRight = 0.0;
+	double gain;
+
+	// next command
+	if (-1 == motor->direction && motor->count > 0) {
+		motor->direction = motor->queue[motor->head];
+		motor->head = (motor->head + 1) % SIM_MOTOR_QUEUE;
+		motor->count--;
+		motor->remaining = ((MOVE_LEFT == motor->direction || MOVE_RIGHT == motor->direction)?
+				    (SIM_TURN_MS):(SIM_MOVE_MS)) * 1000000LL;
+	}
+
+	switch (motor->direction) {
+		case MOVE_FORWARD:
+			targetLeft = targetRight = SIM_TRACK_SPEED;
+			break;
+		case MOVE_BACKWARD:
+			targetLeft = targetRight = -SIM_TRACK_SPEED;
+			break;
+		case MOVE_LEFT:
+			targetLeft = -SIM_TRACK_SPEED;
+			targetRight = SIM_TRACK_SPEED;
+			break;
+		case MOVE_RIGHT:
+			targetLeft = SIM_TRACK_SPEED;
+			targetRight = -SIM_TRACK_SPEED;
+			break;
+	}
+
+	gain = 1.0 - exp(-dt / SIM_MOTOR_TAU);
+	motor->left += (targetLeft - motor->left) * gain;
+	motor->right += (targetRight - motor->right) * gain;
+
+	if (-1 != motor->direction) {
+		motor->remaining -= SEC_TO_NS(dt);
+		if (motor->remaining <= 0) {
+			motor->direction = -1;
+		}
+	}
+}
+
+/**
+ * @brief Moves the rover by dt seconds at the track speeds.
+ * @return 1 if it ran into an obstacle, else 0.
+**/
+int RoverStep(SimShared * sim, Motor * motor, SimPose * pose, double dt)
+{
+	double speed = (motor->left + motor->right) / 2.0;
+	double rate = (motor->right - motor->left) / (SIM_TRACK_WIDTH * SIM_SKID);
+	double heading, x, y;
+
+	// left turns are positive rates, compass headings go clockwise
+	pose->rate = rate * (180.0 / M_PI);
+	pose->heading = fmod(pose->heading - (pose->rate * dt) + 360.0, 360.0);
+
+	heading = pose->heading * (M_PI / 180.0);
+	x = pose->x + (speed * sin(heading) * dt);
+	y = pose->y + (speed * cos(heading) * dt);
+
+	if (SimulationBlocked(sim, x, y, SIM_ROVER_RADIUS)) {
+		pose->speed = 0.0;
+		return 1;
+	}
+
+	pose->x = x;
+	pose->y = y;
+	pose->speed = speed;
+
+	return 0;
+}
+
+/**
+ * @brief Reads the CPU time of master and every node it started from /proc.
+**/
+void ReadNodeCpu(pid_t master, Result * result)
+{
+	DIR * proc;
+	struct dirent * entry;
+	char path[300];
+	char stat[512];
+	char * name;
+	char * end;
+	unsigned long user, system;
+	int parent;
+	int length;
+	int fd;
+	char state;
+
+	result->nodeCount = 0;
+
+	proc = opendir("/proc");
+	if (NULL == proc) {
+		return;
+	}
+
+	while (NULL != (entry = readdir(proc)) && result->nodeCount < SIM_MAX_NODES - 1) {
+		if (entry->d_name[0] < '0' || entry->d_name[0] > '9') {
+			continue;
+		}
+
+		snprintf(path, sizeof(path), "/proc/%s/stat", entry->d_name);
+		fd = open(path, O_RDONLY);
+		if (fd < 0) {
+			continue;
+		}
+		length = read(fd, stat, sizeof(stat) - 1);
+		close(fd);
+		if (length <= 0) {
+			continue;
+		}
+		stat[length] = '\0';
+
+		// "pid (name) state ppid ... utime stime", the name may hold spaces
+		name = strchr(stat, '(');
+		end = strrchr(stat, ')');
+		if (NULL == name || NULL == end ||
+		    4 != sscanf(end + 2, "%c %d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &state, &parent, &user, &system)) {
+			continue;
+		}
+
+		if (atoi(entry->d_name) != master && parent != master) {
+			continue;
+		}
+
+		*end = '\0';
+		snprintf(result->cpu[result->nodeCount].name, sizeof(result->cpu[0].name), "%s", name + 1);
+		result->cpu[result->nodeCount].seconds = (user + system) / (double)sysconf(_SC_CLK_TCK);
+		result->nodeCount++;
+	}
+
+	closedir(proc);
+}
+
+/**
+ * @brief Finds a node started by master, by name, in /proc.
+ * @return Its pid, -1 if it is not running.
+**/
+pid_t FindNode(pid_t master, char * node)
+{
+	DIR * proc;
+	struct dirent * entry;
+	char path[300];
+	char stat[512];
+	char * name;
+	char * end;
+	pid_t found = -1;
+	int parent;
+	int length;
+	int fd;
+
+	proc = opendir("/proc");
+	if (NULL == proc) {
+		return -1;
+	}
+
+	while (found < 0 && NULL != (entry = readdir(proc))) {
+		if (entry->d_name[0] < '0' || entry->d_name[0] > '9') {
+			continue;
+		}
+
+		snprintf(path, sizeof(path), "/proc/%s/stat", entry->d_name);
+		fd = open(path, O_RDONLY);
+		if (fd < 0) {
+			continue;
+		}
+		length = read(fd, stat, sizeof(stat) - 1);
+		close(fd);
+		if (length <= 0) {
+			continue;
+		}
+		stat[length] = '\0';
+
+		// "pid (name) state ppid", as #ReadNodeCpu()
+		name = strchr(stat, '(');
+		end = strrchr(stat, ')');
+		if (NULL == name || NULL == end || 1 != sscanf(end + 2, "%*c %d", &parent)) {
+			continue;
+		}
+		*end = '\0';
+
+		if (parent == master && 0 == strcmp(name + 1, node)) {
+			found = atoi(entry->d_name);
+		}
+	}
+
+	closedir(proc);
+
+	return found;
+}
+
+/**
+ * @brief Sends a #Message to tx2_comm_node.c.
+**/
+void SendToRover(int sock, Message * message)
+{
+	int flags = fcntl(sock, F_GETFL);
+
+	// a whole message at once, on the virtual clock time waits until the comm node has it
+	ClockExternalSent();
+	fcntl(sock, F_SETFL, flags & ~O_NONBLOCK);
+	write(sock, message, sizeof(Message));
+	fcntl(sock, F_SETFL, flags);
+}
+
+/**
+ * @brief Sends the destination of a scenario, as controller.c would.
+**/
+void SendDestination(int sock, SimShared * sim, Scenario * scenario)
+{
+	Message message;
+	double latitude, longitude;
+
+	SimulationLatLon(sim, scenario->destinationX, scenario->destinationY, &latitude, &longitude);
+
+	memset(&message, 0, sizeof(message));
+	message.messageType = CommandMessage;
+	message.destination = TX2Master;
+	message.cmdMsg.commandType = PositionCommand;
+	message.cmdMsg.commandOperation = ('\0' != scenario->survey[0])?(Survey):(Create);
+	message.cmdMsg.position.latitude = latitude;
+	message.cmdMsg.position.longitude = longitude;
+	SendToRover(sock, &message);
+}
+
+/**
+ * @brief Runs a scenario.
+ * @return 0 if it ran, whatever the outcome, -1 if the nodes could not be started.
+**/
+int RunScenario(Scenario * scenario, Result * result)
+{
+	SharedMem * sharedMem;
+	SimShared * sim;
+	SimPose pose;
+	SimFrame frame;
+	Motor motor;
+	Message message;
+	TimeSync timeSync;
+	struct rusage usage;
+	double simCpu;
+	double dt = SIM_STEP_MS / 1000.0;
+	long long next, start, realStart, stopped, realStopped;
+	long long crash = -1;
+	pid_t nav;
+	int touching = 0;
+	int sent = 0;
+	int status;
+	int sock = -1;
+	int log;
+	pid_t master;
+
+	memset(result, 0, sizeof(Result));
+	memset(&motor, 0, sizeof(Motor));
+	TimeSyncInit(&timeSync);
+	motor.direction = -1;
+	result->outcome = "failed";
+
+	// the world, before any node looks for it
+	shm_unlink(SHARED_SIM_NAME);
+	sharedMem = CreateSharedMemory(sizeof(SimShared), SimulationData);
+	if (NULL == sharedMem) {
+		return -1;
+	}
+	sim = (SimShared *)(sharedMem + 1);
+	memset(sim, 0, sizeof(SimShared));
+
+	sim->timeScale = scenario->timeScale;
+	sim->latitude = scenario->latitude;
+	sim->longitude = scenario->longitude;
+	sim->gpsNoise = scenario->gpsNoise;
+	sim->shapeCount = scenario->shapeCount;
+	memcpy(sim->shapes, scenario->shapes, sizeof(SimShape) * scenario->shapeCount);
+	sim->realEpoch = NowNs();
+
+	// simulated time, the nodes take the same clock
+	if (scenario->timeScale > 0.0) {
+		ClockUseScaled(sim->realEpoch, sim->timeScale);
+	} else if (ClockUseVirtual(1) < 0) {
+		return -1;
+	}
+
+	memset(&pose, 0, sizeof(pose));
+	pose.x = scenario->startX;
+	pose.y = scenario->startY;
+	pose.heading = scenario->startHeading;
+	pose.time = ClockNowNs();
+	SimulationSetPose(sim, &pose);
+
+	getrusage(RUSAGE_SELF, &usage);
+	simCpu = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + ((usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0);
+
+	// start the nodes, in their own process group so stragglers can be killed
+	log = open(SIM_LOG_FILE, O_WRONLY | O_CREAT | O_APPEND, 0644);
+	dprintf(log, "\n=== %s ===\n", scenario->name);
+
+	master = fork();
+	if (0 == master) {
+		setpgid(0, 0);
+		dup2(log, STDOUT_FILENO);
+		dup2(log, STDERR_FILENO);
+		if ('\0' != scenario->survey[0]) {
+			setenv(SURVEY_ENV, scenario->survey, 1);
+		}
+		execl(SIM_MASTER, "tx2_master", scenario->parameters, (char *)NULL);
+		printf("error starting %s\n", SIM_MASTER);
+		exit(-1);
+	}
+	close(log);
+	runningMaster = master;
+
+	if (master < 0) {
+		printf("error starting %s\n", SIM_MASTER);
+		ClockClose();
+		return -1;
+	}
+
+	// on the virtual clock time waits for master to start
+	ClockExpect(master);
+
+	start = stopped = next = ClockNowNs();
+	realStart = realStopped = NowNs();
+
+	while (1) {
+		next += SIM_STEP_MS * 1000000LL;
+		ClockSleepUntil(next);
+
+		while (SimulationPopFrame(sim, &frame)) {
+			MotorFrame(&motor, &frame);
+		}
+
+		MotorStep(&motor, dt);
+
+		if (RoverStep(sim, &motor, &pose, dt)) {
+			result->collisions += (touching)?(0):(1);
+			touching = 1;
+		} else {
+			touching = 0;
+		}
+
+		pose.time = next;
+		SimulationSetPose(sim, &pose);
+
+		result->distance += fabs(pose.speed) * dt;
+		if (next >= sim->stallStart && next < sim->stallEnd) {
+			result->stallDistance += fabs(pose.speed) * dt;
+		}
+		if (SIM_TERRAIN_LABEL == SimulationLabel(sim, pose.x, pose.y)) {
+			result->offWalkway += dt;
+		}
+
+		// the rover keeps moving while the nodes start, nav calibrates its turns on it
+		if (sock < 0) {
+			sock = ConnectToRover();
+		} else {
+			// answer socket checks like logWriter.c, or the comm node gives up on us after
+			// a quiet mission and stops reading the connection
+			while (sizeof(message) == read(sock, &message, sizeof(message))) {
+				if (OKMessage == message.messageType) {
+					SendToRover(sock, &message);
+				} else if (TimeMessage == message.messageType) {
+					TimeSyncAdd(&timeSync, &message, next);
+				}
+			}
+
+			if (TimeSyncDue(&timeSync, next)) {
+				TimeSyncPing(&timeSync, &message, next);
+				SendToRover(sock, &message);
+			}
+		}
+
+		// nav drops messages until it has started and calibrated, it is ready once it asks for a mask
+		if (!sent && sock >= 0 && sim->masks > 0) {
+			SendDestination(sock, sim, scenario);
+			result->startup = NS_TO_SEC(next - start);
+			start = stopped = next;
+			if (scenario->stallLength > 0.0) {
+				// the start first, the camera checks both
+				sim->stallStart = next + SEC_TO_NS(scenario->stallStart);
+				sim->stallEnd = sim->stallStart + SEC_TO_NS(scenario->stallLength);
+			}
+			if (scenario->navCrash > 0.0) {
+				crash = next + SEC_TO_NS(scenario->navCrash);
+			}
+			realStart = realStopped = NowNs();
+			sent = 1;
+		}
+
+		// master has to notice and start nav again, which takes over where it was
+		if (crash >= 0 && next >= crash) {
+			nav = FindNode(master, "tx2_nav_node");
+			if (nav > 0) {
+				kill(nav, SIGKILL);
+				result->navKilled = 1;
+			}
+			crash = -1;
+		}
+
+		result->remaining = hypot(scenario->destinationX - pose.x, scenario->destinationY - pose.y);
+
+		if (!sent || -1 != motor.direction || motor.count > 0 || fabs(pose.speed) > 0.01 || fabs(pose.rate) > 1.0) {
+			stopped = next;
+			realStopped = NowNs();
+		} else if (result->remaining < scenario->arrival && NS_TO_SEC(next - stopped) >= SIM_SETTLE) {
+			result->outcome = "arrived";
+			break;
+		}
+
+		if (NS_TO_SEC(next - start) >= ((sent)?(scenario->timeout):(SIM_STARTUP_TIMEOUT))) {
+			result->outcome = "timeout";
+			stopped = next;
+			realStopped = NowNs();
+			break;
+		}
+
+		if (0 != waitpid(master, NULL, WNOHANG)) {
+			printf("%s: tx2_master exited\n", scenario->name);
+			kill(-master, SIGKILL);
+			waitpid(master, NULL, 0);
+			master = -1;
+			break;
+		}
+	}
+
+	result->simSeconds = NS_TO_SEC(stopped - start);
+	result->realSeconds = NS_TO_SEC(realStopped - realStart);
+	result->commands = motor.commands;
+	result->framesLost = sim->framesLost + motor.dropped;
+	result->offset = TimeSyncOffset(&timeSync, next, &result->offsetError);
+	result->drift = timeSync.drift * 1000000.0;
+	TimeSyncGetStats(&timeSync, &result->sync);
+
+	if (master > 0) {
+		// CPU times while the nodes are still there to read
+		ReadNodeCpu(master, result);
+
+		if (sock >= 0) {
+			memset(&message, 0, sizeof(message));
+			message.messageType = KillMessage;
+			SendToRover(sock, &message);
+		}
+
+		// the nodes stop reading their pipes, the virtual clock can't wait for them anymore
+		ClockRelease();
+
+		next = NowNs() + SEC_TO_NS(SIM_EXIT_TIMEOUT);
+		while (0 == (status = waitpid(master, NULL, WNOHANG)) && NowNs() < next) {
+			usleep(50000);
+		}
+		if (0 == status) {
+			printf("%s: nodes did not exit, killing them\n", scenario->name);
+		}
+		kill(-master, SIGKILL);
+		waitpid(master, NULL, 0);
+	}
+	runningMaster = -1;
+
+	// roverSim itself, last
+	strcpy(result->cpu[result->nodeCount].name, "roverSim");
+	getrusage(RUSAGE_SELF, &usage);
+	result->cpu[result->nodeCount].seconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+						 ((usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0) - simCpu;
+	result->nodeCount++;
+
+	if (sock >= 0) {
+		close(sock);
+	}
+	munmap(sharedMem, sizeof(SharedMem) + sizeof(SimShared));
+	CloseSharedMemory();
+	shm_unlink(SHARED_SIM_NAME);
+	ClockClose();
+
+	return 0;
+}
+
+/**
+ * @brief Prints how a scenario went.
+**/
+void PrintResult(Scenario * scenario, Result * result)
+{
+	int i;
+
+	printf("%s: %s, %.1f s simulated in %.1f s (%.1fx), %.1f m driven, %.1f m from the destination\n",
+		scenario->name, result->outcome, result->simSeconds, result->realSeconds,
+		(result->realSeconds > 0.0)?(result->simSeconds / result->realSeconds):(0.0),
+		result->distance, result->remaining);
+	printf("    %.1f s to start, %lu collisions, %.1f s off the walkways, %lu motor commands, %lu lost\n",
+		result->startup, result->collisions, result->offWalkway, result->commands, result->framesLost);
+	if (scenario->stallLength > 0.0) {
+		printf("    %.1f m driven while the camera hung for %.1f s\n", result->stallDistance, scenario->stallLength);
+	}
+	if (scenario->navCrash > 0.0) {
+		printf("    tx2_nav_node %s %.1f s in\n", (result->navKilled)?("killed"):("not found to kill"), scenario->navCrash);
+	}
+	if (result->sync.samples > 0) {
+		printf("    clock offset %.3f ms +- %.3f ms, drift %.1f ppm, %lu pings, up %.3f/%.3f/%.3f ms, down %.3f/%.3f/%.3f ms\n",
+			result->offset / 1e6, result->offsetError / 1e6, result->drift, result->sync.samples,
+			result->sync.upMin / 1e6, result->sync.upSum / 1e6 / result->sync.samples, result->sync.upMax / 1e6,
+			result->sync.downMin / 1e6, result->sync.downSum / 1e6 / result->sync.samples,
+			result->sync.downMax / 1e6);
+	}
+	printf("    cpu ms (%% of a core):");
+	for (i = 0; i < result->nodeCount; i++) {
+		printf(" %s %.0f (%.1f%%)", result->cpu[i].name, result->cpu[i].seconds * 1000.0,
+			(result->realSeconds > 0.0)?(100.0 * result->cpu[i].seconds / result->realSeconds):(0.0));
+	}
+	printf("\n");
+}
+
+int main(int argc, char * argv[])
+{
+	Scenario * scenarios;
+	Result * results;
+	double cpu;
+	int count = argc - 1;
+	int arrived = 0;
+	int i, j;
+
+	if (count < 1 || count > SIM_MAX_SCENARIOS) {
+		printf("usage: ./roverSim scenario [scenario ...]\n");
+		return -1;
+	}
+
+	scenarios = calloc(count, sizeof(Scenario));
+	results = calloc(count, sizeof(Result));
+	if (NULL == scenarios || NULL == results) {
+		return -1;
+	}
+
+	// read them all first, a typo should not waste a suite
+	for (i = 0; i < count; i++) {
+		if (LoadScenario(argv[i + 1], &scenarios[i]) < 0) {
+			return -1;
+		}
+	}
+
+	if (chdir(SIM_BUILD_DIRECTORY) < 0) {
+		printf("run roverSim from the directory with %s/\n", SIM_BUILD_DIRECTORY);
+		return -1;
+	}
+
+	// the nodes may close the connection first
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, StopNodes);
+	signal(SIGTERM, StopNodes);
+
+	close(open(SIM_LOG_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644));
+
+	for (i = 0; i < count; i++) {
+		if (scenarios[i].timeScale > 0.0) {
+			printf("running %s, %.0fx real time\n", scenarios[i].name, scenarios[i].timeScale);
+		} else {
+			printf("running %s, virtual clock\n", scenarios[i].name);
+		}
+		if (RunScenario(&scenarios[i], &results[i]) < 0) {
+			printf("%s: could not be run\n", scenarios[i].name);
+			continue;
+		}
+		PrintResult(&scenarios[i], &results[i]);
+		arrived += (0 == strcmp(results[i].outcome, "arrived"))?(1):(0);
+	}
+
+	// suite summary
+	printf("\n%-20s %-8s %10s %10s %10s %10s %12s\n", "scenario", "result", "mission s", "real s", "distance m",
+		"collisions", "total cpu ms");
+	for (i = 0; i < count; i++) {
+		cpu = 0.0;
+		for (j = 0; j < results[i].nodeCount; j++) {
+			cpu += results[i].cpu[j].seconds;
+		}
+		printf("%-20s %-8s %10.1f %10.1f %10.1f %10lu %12.0f\n", scenarios[i].name,
+			(NULL != results[i].outcome)?(results[i].outcome):("failed"), results[i].simSeconds,
+			results[i].realSeconds, results[i].distance, results[i].collisions, cpu * 1000.0);
+	}
+	printf("%d of %d scenarios arrived\n", arrived, count);
+
+	free(scenarios);
+	free(results);
+
+	return (arrived == count)?(0):(1);
+}
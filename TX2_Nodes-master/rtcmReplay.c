@@ -0,0 +1,183 @@
+/**
+ * @file rtcmReplay.c
+ * @brief rtcmReplay tool.
+ * @details The rtcmReplay tool serves a recording of RTCM 3 corrections over TCP, an epoch a
+ * 	    second like a caster, for tx2_gps_node.c to take with TX2_RTCM=tcp:address:port (see
+ * 	    Rtcm.h). The recording is read with the Rtcm library's file source, so epochs are cut
+ * 	    where a message type comes again and damaged frames are left out. Each client is
+ * 	    served from the start of the recording, looping at the end, one client at a time.
+ * 	    <br>
+ * 	    <br>
+ * 	    Without a recording at hand, -generate writes one: an epoch a second of a 1005
+ * 	    station message and GPS and GLONASS MSM4 messages of random content, valid frames
+ * 	    the XA1110 models of I2CMock.h take as corrections.
+ * 	    <br>
+ * 	    <br>
+ * 	    Usage: ./rtcmReplay recording.rtcm [port]<br>
+ * 	    Usage: ./rtcmReplay -generate recording.rtcm seconds
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "include/Rtcm.h"
+#include "include/Clock.h"
+
+#define RTCM_REPLAY_PORT 2101		/**< Default port, the NTRIP port. */
+#define RTCM_REPLAY_REPORT 30		/**< Epochs between reports. */
+
+/**
+ * @brief Message types and lengths of a generated epoch.
+**/
+int generatedTypes[] = { 1005, 1074, 1084 };
+int generatedLengths[] = { 19, 160, 130 };
+
+/**
+ * @brief Writes a frame of a type and length, the content after the type random.
+**/
+void WriteFrame(FILE * file, int type, int length)
+{
+	uint8_t frame[RTCM_MAX_FRAME];
+	unsigned int crc;
+	int i;
+
+	frame[0] = RTCM_PREAMBLE;
+	frame[1] = (length >> 8) & 0x03;
+	frame[2] = length & 0xFF;
+	for (i = 0; i < length; i++) {
+		frame[3 + i] = rand() & 0xFF;
+	}
+	frame[3] = (type >> 4) & 0xFF;
+	frame[4] = ((type & 0x0F) << 4) | (frame[4] & 0x0F);
+
+	crc = RtcmCrc24q(frame, length + 3);
+	frame[length + 3] = (crc >> 16) & 0xFF;
+	frame[length + 4] = (crc >> 8) & 0xFF;
+	frame[length + 5] = crc & 0xFF;
+
+	fwrite(frame, 1, length + 6, file);
+}
+
+/**
+ * @brief Writes a recording of seconds epochs.
+**/
+int Generate(char * fileName, int seconds)
+{
+	FILE * file;
+	int i, j;
+
+	file = fopen(fileName, "wb");
+	if (NULL == file) {
+		printf("error writing %s\n", fileName);
+		return -1;
+	}
+
+	srand(1);
+	for (i = 0; i < seconds; i++) {
+		for (j = 0; j < (int)(sizeof(generatedTypes) / sizeof(int)); j++) {
+			WriteFrame(file, generatedTypes[j], generatedLengths[j]);
+		}
+	}
+
+	fclose(file);
+	printf("%d epochs written to %s\n", seconds, fileName);
+	return 0;
+}
+
+/**
+ * @brief Serves the recording to one client until it goes away.
+**/
+void Serve(int client, char * source)
+{
+	RtcmStream stream;
+	RtcmStats stats;
+	uint8_t * data;
+	long long now;
+	unsigned long epochs = 0;
+	unsigned long sent = 0;
+	int bytes;
+
+	if (RtcmOpen(&stream, source, ClockNowNs()) < 0) {
+		return;
+	}
+
+	while (1) {
+		ClockSleepUntil(RtcmNextDue(&stream));
+		now = ClockNowNs();
+		RtcmService(&stream, now);
+		epochs++;
+
+		while ((bytes = RtcmNextChunk(&stream, now, &data, RTCM_MAX_FRAME)) > 0) {
+			if (send(client, data, bytes, MSG_NOSIGNAL) != bytes) {
+				printf("client gone after %lu epochs, %lu bytes\n", epochs, sent);
+				RtcmClose(&stream);
+				return;
+			}
+			RtcmWritten(&stream, bytes, now);
+			sent += bytes;
+		}
+
+		if (0 == epochs % RTCM_REPLAY_REPORT) {
+			RtcmGetStats(&stream, &stats);
+			printf("%lu epochs, %lu frames, %lu bytes sent, %lu CRC errors\n",
+				epochs, stats.frames, sent, stats.crcErrors);
+		}
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	struct sockaddr_in address;
+	char source[128];
+	int server, client;
+	int port = RTCM_REPLAY_PORT;
+	int opt = 1;
+
+	if (4 == argc && 0 == strcmp(argv[1], "-generate")) {
+		return Generate(argv[2], atoi(argv[3]));
+	}
+
+	if (argc < 2 || argc > 3) {
+		printf("Usage: %s <recording> [port]\n", argv[0]);
+		printf("       %s -generate <recording> <seconds>\n", argv[0]);
+		return -1;
+	}
+
+	port = (3 == argc)?(atoi(argv[2])):(port);
+	snprintf(source, sizeof(source), "file:%s", argv[1]);
+
+	server = socket(AF_INET, SOCK_STREAM, 0);
+	if (server < 0) {
+		printf("error creating socket\n");
+		return -1;
+	}
+	setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = INADDR_ANY;
+	address.sin_port = htons(port);
+
+	if (bind(server, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(server, 1) < 0) {
+		printf("error listening on port %d\n", port);
+		return -1;
+	}
+
+	printf("serving %s on port %d\n", argv[1], port);
+
+	while (1) {
+		client = accept(server, NULL, NULL);
+		if (client < 0) {
+			continue;
+		}
+		printf("client connected\n");
+		Serve(client, source);
+		close(client);
+	}
+
+	return 0;
+}
@@ -0,0 +1,445 @@
+/**
+ * @file Camera.c
+ * @brief Function definitions for the Camera library.
+ * @details Function definitions for the Camera library.
+**/
+
+#include "../include/Camera.h"
+#include "../include/Simulation.h"
+
+/**
+ * @brief Internal function that retries an ioctl interrupted by a signal.
+**/
+int CameraIoctl(int fd, unsigned long request, void * argument)
+{
+	int status;
+
+	do {
+		status = ioctl(fd, request, argument);
+	} while (status < 0 && EINTR == errno);
+
+	return status;
+}
+
+/**
+ * @brief Internal function that opens #CAMERA_V4L2_DEVICE and starts streaming.
+ * @return 0 on success, -1 on error.
+**/
+int CameraOpenV4L2(Camera * camera)
+{
+	struct v4l2_format format;
+	struct v4l2_requestbuffers request;
+	struct v4l2_buffer buffer;
+	enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	int i;
+
+	camera->fd = open(CAMERA_V4L2_DEVICE, O_RDWR);
+	if (camera->fd < 0) {
+		printf("error opening %s\n", CAMERA_V4L2_DEVICE);
+		return -1;
+	}
+
+	// the driver picks the nearest size it has
+	memset(&format, 0, sizeof(format));
+	format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	format.fmt.pix.width = CAMERA_WIDTH;
+	format.fmt.pix.height = CAMERA_HEIGHT;
+	format.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
+	format.fmt.pix.field = V4L2_FIELD_NONE;
+
+	if (CameraIoctl(camera->fd, VIDIOC_S_FMT, &format) < 0 || V4L2_PIX_FMT_YUYV != format.fmt.pix.pixelformat) {
+		printf("%s has no YUYV format\n", CAMERA_V4L2_DEVICE);
+		return -1;
+	}
+
+	camera->width = format.fmt.pix.width;
+	camera->height = format.fmt.pix.height;
+	camera->stride = format.fmt.pix.bytesperline;
+
+	memset(&request, 0, sizeof(request));
+	request.count = CAMERA_BUFFERS;
+	request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	request.memory = V4L2_MEMORY_MMAP;
+
+	if (CameraIoctl(camera->fd, VIDIOC_REQBUFS, &request) < 0 || 0 == request.count) {
+		printf("%s has no capture buffers\n", CAMERA_V4L2_DEVICE);
+		return -1;
+	}
+
+	camera->bufferCount = (request.count > CAMERA_BUFFERS)?(CAMERA_BUFFERS):(request.count);
+
+	// map the buffers and queue them all
+	for (i = 0; i < camera->bufferCount; i++) {
+		memset(&buffer, 0, sizeof(buffer));
+		buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		buffer.memory = V4L2_MEMORY_MMAP;
+		buffer.index = i;
+
+		if (CameraIoctl(camera->fd, VIDIOC_QUERYBUF, &buffer) < 0) {
+			return -1;
+		}
+
+		camera->lengths[i] = buffer.length;
+		camera->buffers[i] = mmap(NULL, buffer.length, PROT_READ | PROT_WRITE, MAP_SHARED, camera->fd, buffer.m.offset);
+
+		if (MAP_FAILED == camera->buffers[i]) {
+			camera->buffers[i] = NULL;
+			return -1;
+		}
+
+		if (CameraIoctl(camera->fd, VIDIOC_QBUF, &buffer) < 0) {
+			return -1;
+		}
+	}
+
+	if (CameraIoctl(camera->fd, VIDIOC_STREAMON, &type) < 0) {
+		printf("error starting %s\n", CAMERA_V4L2_DEVICE);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Internal function that maps #CAMERA_REPLAY_FILE.
+ * @return 0 on success, also without a recording, -1 if the recording is unusable.
+**/
+int CameraOpenReplay(Camera * camera)
+{
+	struct stat info;
+	char header[64];
+	char * newline;
+	long headerLength;
+	int fd;
+
+	camera->width = CAMERA_WIDTH;
+	camera->height = CAMERA_HEIGHT;
+
+	fd = open(CAMERA_REPLAY_FILE, O_RDONLY);
+	if (fd < 0) {
+		printf("no %s, replaying an open walkway\n", CAMERA_REPLAY_FILE);
+		return 0;
+	}
+
+	if (fstat(fd, &info) < 0 || info.st_size < (off_t)sizeof(header)) {
+		close(fd);
+		printf("%s is too short\n", CAMERA_REPLAY_FILE);
+		return -1;
+	}
+
+	camera->buffers[0] = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (MAP_FAILED == camera->buffers[0]) {
+		camera->buffers[0] = NULL;
+		return -1;
+	}
+
+	camera->lengths[0] = info.st_size;
+
+	// "MASK width height\n"
+	memcpy(header, camera->buffers[0], sizeof(header) - 1);
+	header[sizeof(header) - 1] = '\0';
+	newline = strchr(header, '\n');
+
+	if (NULL == newline || 2 != sscanf(header, "MASK %d %d", &camera->width, &camera->height) ||
+	    camera->width <= 0 || camera->height <= 0) {
+		printf("%s is not a mask recording\n", CAMERA_REPLAY_FILE);
+		return -1;
+	}
+
+	headerLength = (newline - header) + 1;
+	camera->masks = (uint8_t *)camera->buffers[0] + headerLength;
+	camera->maskCount = (info.st_size - headerLength) / ((long)camera->width * camera->height);
+
+	if (0 == camera->maskCount) {
+		printf("%s has no masks\n", CAMERA_REPLAY_FILE);
+		return -1;
+	}
+
+	printf("replaying %ld %dx%d masks from %s\n", camera->maskCount, camera->width, camera->height, CAMERA_REPLAY_FILE);
+
+	return 0;
+}
+
+/**
+ * @brief Internal function that maps the world of roverSim.c.
+ * @return 0 on success, -1 if roverSim.c is not running.
+**/
+int CameraOpenSim(Camera * camera)
+{
+	camera->width = SIM_CAMERA_WIDTH;
+	camera->height = SIM_CAMERA_HEIGHT;
+
+	camera->sim = SimulationOpen();
+	if (NULL == camera->sim) {
+		printf("roverSim is not running, nothing to render\n");
+		return -1;
+	}
+
+	camera->nextFrame = ClockNowNs();
+
+	printf("rendering %dx%d masks at %d fps from the simulator\n", camera->width, camera->height, SIM_CAMERA_FPS);
+
+	return 0;
+}
+
+int CameraOpen(Camera * camera, int backend)
+{
+	int status;
+
+	memset(camera, 0, sizeof(Camera));
+	camera->backend = backend;
+	camera->fd = -1;
+
+	if (CameraV4L2 == backend) {
+		status = CameraOpenV4L2(camera);
+	} else if (CameraSim == backend) {
+		status = CameraOpenSim(camera);
+	} else {
+		status = CameraOpenReplay(camera);
+	}
+
+	if (status < 0) {
+		CameraClose(camera);
+	}
+
+	return status;
+}
+
+/**
+ * @brief Internal function that takes a frame from the V4L2 queue.
+ * @param buffer Output, give it back with VIDIOC_QBUF once done with the frame.
+ * @return The frame, NULL on error.
+**/
+uint8_t * CameraDequeue(Camera * camera, struct v4l2_buffer * buffer)
+{
+	memset(buffer, 0, sizeof(struct v4l2_buffer));
+	buffer->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	buffer->memory = V4L2_MEMORY_MMAP;
+
+	if (CameraIoctl(camera->fd, VIDIOC_DQBUF, buffer) < 0 || buffer->index >= (unsigned int)camera->bufferCount) {
+		return NULL;
+	}
+
+	return (uint8_t *)camera->buffers[buffer->index];
+}
+
+/**
+ * @brief Internal function that labels a YUYV frame by its brightness against the ground.
+**/
+void CameraLabel(Camera * camera, uint8_t * frame, uint8_t * mask)
+{
+	uint8_t * row;
+	unsigned long sum = 0;
+	int ground;
+	int difference;
+	int x, y;
+
+	// the ground right in front of the rover, Y is every other byte
+	for (y = camera->height - CAMERA_V4L2_GROUND_ROWS; y < camera->height; y++) {
+		row = frame + ((long)y * camera->stride);
+		for (x = 0; x < camera->width; x++) {
+			sum += row[x * 2];
+		}
+	}
+	ground = sum / ((unsigned long)CAMERA_V4L2_GROUND_ROWS * camera->width);
+
+	for (y = 0; y < camera->height; y++) {
+		row = frame + ((long)y * camera->stride);
+		for (x = 0; x < camera->width; x++) {
+			difference = row[x * 2] - ground;
+			mask[x] = (difference > CAMERA_V4L2_CONTRAST || difference < -CAMERA_V4L2_CONTRAST)?
+				  (CAMERA_OBSTACLE_LABEL):(CAMERA_CLEAR_LABEL);
+		}
+		mask += camera->width;
+	}
+}
+
+int CameraMask(Camera * camera, uint8_t * mask)
+{
+	struct v4l2_buffer buffer;
+	uint8_t * frame;
+	long long start;
+	long long elapsed;
+	SimPose pose;
+
+	// the simulated camera gives frames at the rate of the network. So does a recording on the
+	// virtual clock, where masks without a cost would keep time from ever moving on
+	if (CameraSim == camera->backend || (CameraReplay == camera->backend && ClockIsVirtual())) {
+		start = ClockNowNs();
+		if (start < camera->nextFrame) {
+			ClockSleepUntil(camera->nextFrame);
+		} else {
+			camera->nextFrame = start;
+		}
+		camera->nextFrame += 1000000000LL / SIM_CAMERA_FPS;
+	}
+
+	start = ClockNowNs();
+
+	if (CameraV4L2 == camera->backend) {
+		frame = CameraDequeue(camera, &buffer);
+		if (NULL == frame) {
+			camera->stats.failures++;
+			return -1;
+		}
+
+		CameraLabel(camera, frame, mask);
+		CameraIoctl(camera->fd, VIDIOC_QBUF, &buffer);
+	} else if (CameraSim == camera->backend) {
+		// a capture that hangs, the way a stuck GPU does
+		if (start >= camera->sim->stallStart && start < camera->sim->stallEnd) {
+			ClockSleepUntil(camera->sim->stallEnd);
+		}
+		SimulationGetPose(camera->sim, &pose);
+		SimulationRender(camera->sim, &pose, mask, camera->width, camera->height);
+		camera->sim->masks++;
+	} else if (NULL != camera->masks) {
+		memcpy(mask, camera->masks + (camera->next * camera->width * camera->height), (long)camera->width * camera->height);
+		camera->next = (camera->next + 1) % camera->maskCount;
+	} else {
+		memset(mask, CAMERA_CLEAR_LABEL, (long)camera->width * camera->height);
+	}
+
+	elapsed = ClockNowNs() - start;
+	camera->stats.frames++;
+	camera->stats.captureNs += elapsed;
+	camera->stats.maxNs = (elapsed > camera->stats.maxNs)?(elapsed):(camera->stats.maxNs);
+
+	return 0;
+}
+
+/**
+ * @brief Internal function that converts one YUYV pixel to RGB.
+**/
+void CameraYuvToRgb(int y, int u, int v, unsigned char * rgb)
+{
+	int r = y + ((1436 * (v - 128)) >> 10);
+	int g = y - ((352 * (u - 128) + 731 * (v - 128)) >> 10);
+	int b = y + ((1815 * (u - 128)) >> 10);
+
+	rgb[0] = (r < 0)?(0):((r > 255)?(255):(r));
+	rgb[1] = (g < 0)?(0):((g > 255)?(255):(g));
+	rgb[2] = (b < 0)?(0):((b > 255)?(255):(b));
+}
+
+int CameraSaveImage(Camera * camera, char * fileName)
+{
+	struct v4l2_buffer buffer;
+	unsigned char * line;
+	uint8_t * frame;
+	uint8_t * pixel;
+	FILE * file;
+	int x, y;
+	int status = 0;
+
+	file = fopen(fileName, "w");
+	if (NULL == file) {
+		printf("error creating %s\n", fileName);
+		return -1;
+	}
+
+	if (CameraV4L2 == camera->backend) {
+		frame = CameraDequeue(camera, &buffer);
+		line = malloc(camera->width * 3);
+
+		if (NULL == frame || NULL == line) {
+			status = -1;
+		} else {
+			fprintf(file, "P6\n%d %d\n255\n", camera->width, camera->height);
+
+			// two pixels share their U and V
+			for (y = 0; y < camera->height; y++) {
+				pixel = frame + ((long)y * camera->stride);
+				for (x = 0; x + 1 < camera->width; x += 2, pixel += 4) {
+					CameraYuvToRgb(pixel[0], pixel[1], pixel[3], &line[x * 3]);
+					CameraYuvToRgb(pixel[2], pixel[1], pixel[3], &line[(x + 1) * 3]);
+				}
+				fwrite(line, 3, camera->width, file);
+			}
+		}
+
+		if (NULL != frame) {
+			CameraIoctl(camera->fd, VIDIOC_QBUF, &buffer);
+		}
+		free(line);
+	} else {
+		line = malloc((long)camera->width * camera->height);
+
+		if (NULL == line) {
+			status = -1;
+		} else {
+			// labels are small, stretch them so the picture shows something
+			CameraMask(camera, line);
+			for (x = 0; x < camera->width * camera->height; x++) {
+				line[x] = (line[x] > 25)?(255):(line[x] * 10);
+			}
+			fprintf(file, "P5\n%d %d\n255\n", camera->width, camera->height);
+			fwrite(line, 1, (long)camera->width * camera->height, file);
+		}
+
+		free(line);
+	}
+
+	if (0 != fclose(file)) {
+		status = -1;
+	}
+
+	return status;
+}
+
+void CameraGetStats(Camera * camera, CameraStats * stats)
+{
+	memcpy(stats, &camera->stats, sizeof(CameraStats));
+}
+
+void CameraClose(Camera * camera)
+{
+	enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	int i;
+
+	if (camera->fd >= 0) {
+		CameraIoctl(camera->fd, VIDIOC_STREAMOFF, &type);
+	}
+
+	for (i = 0; i < CAMERA_BUFFERS; i++) {
+		if (NULL != camera->buffers[i]) {
+			munmap(camera->buffers[i], camera->lengths[i]);
+			camera->buffers[i] = NULL;
+		}
+	}
+
+	if (camera->fd >= 0) {
+		close(camera->fd);
+		camera->fd = -1;
+	}
+
+	camera->masks = NULL;
+}
+
+int CameraRecordOpen(char * fileName, int width, int height)
+{
+	char header[64];
+	int length;
+	int fd;
+
+	fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return -1;
+	}
+
+	length = snprintf(header, sizeof(header), "MASK %d %d\n", width, height);
+
+	if (length != write(fd, header, length)) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int CameraRecordMask(int fd, uint8_t * mask, int size)
+{
+	return (size == write(fd, mask, size))?(0):(-1);
+}
@@ -13,6 +13,12 @@
 
 int CanSocket; /**< File descriptor for open CAN socket */
 
+int canBackend; /**< The #CanBackend in use */
+
+unsigned long canDropped; /**< Frames written while #canBackend is #CanNone */
+
+SimShared * canSim; /**< The rover of roverSim.c while #canBackend is #CanSim */
+
 /**
  * Socket Address private member
  */
@@ -140,13 +146,64 @@ int LoadModules()
 	return error;
 }
 
+/**
+ * @brief Internal function that creates the virtual CAN interface of a Linux host.
+ * @details Does nothing if #HAL_VCAN_INTERFACE already exists, so a host set up once with
+ *	    "ip link add dev vcan0 type vcan" does not need the CAN node to run as root.
+ * @return Returns 0 if the interface is up, -1 if it could not be created.
+**/
+int LoadVirtualCan()
+{
+	if (0 != if_nametoindex(HAL_VCAN_INTERFACE)) {
+		return 0;
+	}
+
+	// same as for the real controller, there is no library call for these
+	if (0 != system("modprobe vcan") ||
+	    0 != system("ip link add dev " HAL_VCAN_INTERFACE " type vcan") ||
+	    0 != system("ip link set up " HAL_VCAN_INTERFACE)) {
+		printf("error creating %s\n", HAL_VCAN_INTERFACE);
+		return -1;
+	}
+
+	return 0;
+}
+
 // Initialize socket can, return the file descriptor if succesful, esle return -1.
-int InitializeCan()
+int InitializeCan(int backend)
 {
+	char * interface = (CanVirtual == backend)?(HAL_VCAN_INTERFACE):(HAL_CAN_INTERFACE);
+
 	printf("Initializing CAN controller\n");
 
+	canBackend = backend;
+	canDropped = 0;
+
+	// nothing to open, writes are dropped
+	if (CanNone == backend) {
+		CanSocket = -1;
+		return 0;
+	}
+
+	// no socket either, writes go to the simulator
+	if (CanSim == backend) {
+		CanSocket = -1;
+		canSim = SimulationOpen();
+		if (NULL == canSim) {
+			printf("roverSim is not running\n");
+			return -1;
+		}
+		return 0;
+	}
+
 	// dynamically load the kernel modules
-	LoadModules();
+	if (CanVirtual == backend) {
+		if (LoadVirtualCan() < 0) {
+			return -1;
+		}
+	} else {
+		LoadModules();
+	}
 
 	//  opens socket
 	if ((CanSocket = socket(PF_CAN, SOCK_RAW, CAN_RAW)) < 0)
@@ -159,8 +216,7 @@ int InitializeCan()
 	memset(&addr, 0, sizeof(addr));
 	memset(&ifr.ifr_name, 0, sizeof(ifr.ifr_name));
 
-	strncpy(ifr.ifr_name, "can0", 4);
-	ifr.ifr_name[4] = '\0';
+	strncpy(ifr.ifr_name, interface, sizeof(ifr.ifr_name) - 1);
 	ifr.ifr_ifindex = if_nametoindex(ifr.ifr_name);
 
 	addr.can_family = AF_CAN;
@@ -236,6 +292,22 @@ int CanWrite(Message * message)
 	int status;
 	struct can_frame frame; //  /usr/include/linux/can.h
 
+	// no bus, count the frame as sent
+	if (CanNone == canBackend) {
+		canDropped++;
+		return CAN_MTU;
+	}
+
+	// simulated motor controller
+	if (CanSim == canBackend) {
+		if (SimulationPushFrame(canSim, message->canMsg.SId, message->canMsg.Message,
+					message->canMsg.Bytes) < 0) {
+			canDropped++;
+			return -1;
+		}
+		return CAN_MTU;
+	}
+
 	memset(&frame, 0, sizeof(frame));
 
 	// setup the struct with the CAN data contained in the #Message struct
@@ -255,7 +327,14 @@ int CanWrite(Message * message)
 	return status;
 }
 
+unsigned long CanDropped()
+{
+	return canDropped;
+}
+
 void CloseCan()
 {
-	close(CanSocket);
+	if (CanSocket >= 0) {
+		close(CanSocket);
+	}
 }
@@ -0,0 +1,698 @@
+/**
+ * @file Clock.c
+ * @brief Function definitions for the Clock library.
+ * @details Function definitions for the Clock library.
+**/
+
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "../include/Clock.h"
+#include "../include/SharedMem.h"
+
+#define CLOCK_WAKE_SIGNAL (SIGRTMIN + 1)	/**< Sent to a participant whose wait is over. */
+
+/**
+ * @brief Kernel clock of the real and scaled clocks.
+**/
+clockid_t clockId = CLOCK_MONOTONIC;
+
+/**
+ * @brief CLOCK_MONOTONIC ns the scaled clock started at.
+**/
+long long clockEpoch;
+
+/**
+ * @brief Speed of the scaled clock, 0 for the real clock.
+**/
+double clockScale;
+
+/**
+ * @brief The virtual clock, NULL if the process is not on it.
+**/
+ClockShared * clockShared;
+
+/**
+ * @brief 1 once #CLOCK_ENV has been looked at.
+**/
+int clockChecked;
+
+/**
+ * @brief 1 once the exit handler is registered.
+**/
+int clockExitRegistered;
+
+/**
+ * @brief The process that started the virtual time and removes it, 0 if another one did.
+**/
+pid_t clockOwner;
+
+/**
+ * @brief Virtual clock slot of the calling thread, -1 if it has none.
+**/
+__thread int clockSlot = -1;
+
+long long ClockMonotonicNs()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((long long)now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
+
+/**
+ * @brief Internal function that converts nanoseconds into a timespec.
+**/
+void ClockTimespec(long long ns, struct timespec * time)
+{
+	time->tv_sec = ns / 1000000000LL;
+	time->tv_nsec = ns % 1000000000LL;
+}
+
+/**
+ * @brief Internal function that joins the virtual clock if #CLOCK_ENV asks for it, once.
+**/
+void ClockCheckEnv()
+{
+	char * env;
+
+	if (clockChecked) {
+		return;
+	}
+	clockChecked = 1;
+
+	env = getenv(CLOCK_ENV);
+	if (NULL != env && 0 == strcmp(env, "virtual") && ClockUseVirtual(0) < 0) {
+		printf("virtual clock not available, the clock is CLOCK_MONOTONIC\n");
+	}
+}
+
+/**
+ * @brief Internal function, the handler of #CLOCK_WAKE_SIGNAL. The signal only has to interrupt pselect().
+**/
+void ClockWakeHandler(int signal)
+{
+}
+
+/**
+ * @brief Internal function that takes the spin lock of the virtual clock.
+**/
+void ClockLock(ClockShared * clock)
+{
+	while (__sync_lock_test_and_set(&clock->lock, 1)) {
+		sched_yield();
+	}
+}
+
+/**
+ * @brief Internal function that releases the spin lock of the virtual clock.
+**/
+void ClockUnlock(ClockShared * clock)
+{
+	__sync_lock_release(&clock->lock);
+}
+
+/**
+ * @brief Internal function that ends the wait of a participant, with the lock held.
+**/
+void ClockWake(ClockShared * clock, ClockParticipant * participant)
+{
+	// it runs from now on, even before it has noticed
+	participant->waiting = 0;
+	clock->running++;
+	syscall(SYS_tgkill, participant->process, participant->thread, CLOCK_WAKE_SIGNAL);
+}
+
+/**
+ * @brief Internal function, the coordinator. Moves the clock on if nobody has anything left to do, with the lock held.
+**/
+void ClockAdvance(ClockShared * clock)
+{
+	ClockParticipant * next = NULL;
+	long long wake = CLOCK_NEVER;
+	int i;
+
+	if (clock->running > 0 || clock->inFlight > 0 || clock->external > 0) {
+		return;
+	}
+
+	// the earliest wake time, the lowest slot on a tie
+	for (i = 0; i < CLOCK_MAX_PARTICIPANTS; i++) {
+		if (clock->participants[i].process && clock->participants[i].waiting &&
+		    clock->participants[i].wake < wake) {
+			next = &clock->participants[i];
+			wake = next->wake;
+		}
+	}
+
+	// everyone waits for a message, or for something outside the clock
+	if (NULL == next) {
+		return;
+	}
+
+	if (wake > clock->now) {
+		clock->now = wake;
+		clock->advances++;
+	}
+
+	ClockWake(clock, next);
+}
+
+/**
+ * @brief Internal function that gives the calling thread its virtual clock slot.
+ * @return 0 on success, -1 if every slot is taken.
+**/
+int ClockJoinThread()
+{
+	ClockParticipant * participant;
+	pid_t process = getpid();
+	pid_t thread = syscall(SYS_gettid);
+	int reserved = -1;
+	int free = -1;
+	int i;
+
+	ClockLock(clockShared);
+
+	for (i = 0; i < CLOCK_MAX_PARTICIPANTS; i++) {
+		participant = &clockShared->participants[i];
+
+		// reserved by the parent with #ClockExpect()
+		if (participant->process == process && participant->thread == thread) {
+			clockSlot = i;
+			break;
+		}
+
+		if (reserved < 0 && participant->process == process && 0 == participant->thread) {
+			reserved = i;
+		} else if (free < 0 && 0 == participant->process) {
+			free = i;
+		}
+	}
+
+	if (clockSlot < 0 && reserved >= 0) {
+		// already counted as running
+		clockShared->participants[reserved].thread = thread;
+		clockSlot = reserved;
+	} else if (clockSlot < 0 && free >= 0) {
+		participant = &clockShared->participants[free];
+		participant->process = process;
+		participant->thread = thread;
+		participant->waiting = 0;
+		clockShared->running++;
+		clockSlot = free;
+	}
+
+	ClockUnlock(clockShared);
+
+	if (clockSlot < 0) {
+		printf("more than %d threads on the virtual clock\n", CLOCK_MAX_PARTICIPANTS);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Internal function that returns the virtual clock slot of the calling thread, NULL if the process is not on the virtual clock.
+**/
+ClockParticipant * ClockSelf()
+{
+	ClockCheckEnv();
+
+	if (NULL == clockShared || (clockSlot < 0 && ClockJoinThread() < 0)) {
+		return NULL;
+	}
+
+	return &clockShared->participants[clockSlot];
+}
+
+/**
+ * @brief Internal function that frees every slot of a process, with the lock held.
+**/
+void ClockFreeSlots(pid_t process)
+{
+	ClockParticipant * participant;
+	int i;
+
+	for (i = 0; i < CLOCK_MAX_PARTICIPANTS; i++) {
+		participant = &clockShared->participants[i];
+		if (participant->process != process) {
+			continue;
+		}
+
+		if (!participant->waiting) {
+			clockShared->running--;
+		}
+		memset(participant, 0, sizeof(ClockParticipant));
+	}
+}
+
+/**
+ * @brief Internal function that takes every thread of the process off the virtual clock, at exit.
+**/
+void ClockExit()
+{
+	pid_t process = getpid();
+
+	if (NULL == clockShared) {
+		return;
+	}
+
+	ClockLock(clockShared);
+	ClockFreeSlots(process);
+	ClockAdvance(clockShared);
+	ClockUnlock(clockShared);
+
+	clockSlot = -1;
+
+	// a forked child that never got to exec is not the owner
+	if (clockOwner == process) {
+		shm_unlink(SHARED_CLOCK_NAME);
+	}
+}
+
+/**
+ * @brief Internal function, #ClockWait() on the virtual clock.
+**/
+int ClockWaitVirtual(ClockParticipant * self, int maxFd, fd_set * rdfs, long long when)
+{
+	struct timespec zero = { 0, 0 };
+	fd_set wanted;
+	sigset_t mask;
+	int status;
+	int error;
+
+	if (NULL != rdfs) {
+		memcpy(&wanted, rdfs, sizeof(fd_set));
+	}
+
+	// the wake signal gets through only while waiting
+	sigprocmask(SIG_BLOCK, NULL, &mask);
+	sigdelset(&mask, CLOCK_WAKE_SIGNAL);
+
+	while (1) {
+		if (NULL != rdfs) {
+			memcpy(rdfs, &wanted, sizeof(fd_set));
+		}
+
+		ClockLock(clockShared);
+
+		// shutting down, time jumps to whoever asks
+		if (clockShared->released && CLOCK_NEVER != when && when > clockShared->now) {
+			clockShared->now = when;
+		}
+
+		if (when <= clockShared->now) {
+			ClockUnlock(clockShared);
+			// the time is up, but say what is readable
+			return (maxFd < 0)?(0):(pselect(maxFd + 1, rdfs, NULL, NULL, &zero, NULL));
+		}
+
+		if (!clockShared->released) {
+			self->wake = when;
+			self->waiting = 1;
+			clockShared->running--;
+			ClockAdvance(clockShared);
+		}
+
+		ClockUnlock(clockShared);
+
+		status = pselect(maxFd + 1, rdfs, NULL, NULL, NULL, &mask);
+		error = errno;
+
+		ClockLock(clockShared);
+		if (self->waiting) {
+			self->waiting = 0;
+			clockShared->running++;
+		}
+		ClockUnlock(clockShared);
+
+		if (status > 0 || (status < 0 && EINTR != error)) {
+			errno = error;
+			return status;
+		}
+
+		// woken, or a wake left over from a wait that ended on a message
+	}
+}
+
+void ClockUseReal(clockid_t clock)
+{
+	ClockCheckEnv();
+
+	if (NULL != clockShared) {
+		return;
+	}
+
+	clockId = clock;
+	clockScale = 0.0;
+}
+
+void ClockUseScaled(long long epoch, double scale)
+{
+	ClockCheckEnv();
+
+	if (NULL != clockShared) {
+		return;
+	}
+
+	clockId = CLOCK_MONOTONIC;
+	clockEpoch = epoch;
+	clockScale = scale;
+}
+
+int ClockUseVirtual(int create)
+{
+	struct sigaction wake;
+	sigset_t mask;
+	int created = 0;
+	int fd = -1;
+
+	clockChecked = 1;
+
+	if (NULL == clockShared) {
+		if (create) {
+			shm_unlink(SHARED_CLOCK_NAME);
+		} else {
+			fd = shm_open(SHARED_CLOCK_NAME, O_RDWR, 0);
+		}
+
+		if (fd < 0) {
+			fd = shm_open(SHARED_CLOCK_NAME, O_RDWR | O_CREAT | O_EXCL, 0666);
+			created = 1;
+		}
+
+		if (fd < 0 || (created && ftruncate(fd, sizeof(ClockShared)) < 0)) {
+			printf("error opening %s\n", SHARED_CLOCK_NAME);
+			if (fd >= 0) {
+				close(fd);
+			}
+			return -1;
+		}
+
+		clockShared = mmap(NULL, sizeof(ClockShared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+
+		if (MAP_FAILED == clockShared) {
+			clockShared = NULL;
+			printf("error mapping %s\n", SHARED_CLOCK_NAME);
+			return -1;
+		}
+
+		if (created) {
+			// looks like CLOCK_MONOTONIC to anything that compares
+			clockShared->now = ClockMonotonicNs();
+			clockOwner = getpid();
+		}
+
+		memset(&wake, 0, sizeof(wake));
+		wake.sa_handler = ClockWakeHandler;
+		sigaction(CLOCK_WAKE_SIGNAL, &wake, NULL);
+
+		if (!clockExitRegistered) {
+			atexit(ClockExit);
+			clockExitRegistered = 1;
+		}
+
+		// children started from here on follow
+		setenv(CLOCK_ENV, "virtual", 1);
+	}
+
+	// blocked everywhere but in a wait, threads created later inherit this
+	sigemptyset(&mask);
+	sigaddset(&mask, CLOCK_WAKE_SIGNAL);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+
+	return (clockSlot < 0)?(ClockJoinThread()):(0);
+}
+
+void ClockClose()
+{
+	if (NULL == clockShared) {
+		return;
+	}
+
+	ClockExit();
+
+	if (clockOwner == getpid()) {
+		unsetenv(CLOCK_ENV);
+	}
+
+	munmap(clockShared, sizeof(ClockShared));
+	clockShared = NULL;
+	clockOwner = 0;
+	clockScale = 0.0;
+	clockId = CLOCK_MONOTONIC;
+}
+
+int ClockIsVirtual()
+{
+	ClockCheckEnv();
+	return (NULL != clockShared)?(1):(0);
+}
+
+long long ClockNowNs()
+{
+	struct timespec now;
+	long long real;
+
+	ClockCheckEnv();
+
+	if (NULL != clockShared) {
+		return clockShared->now;
+	}
+
+	clock_gettime(clockId, &now);
+	real = ((long long)now.tv_sec * 1000000000LL) + now.tv_nsec;
+
+	if (clockScale > 0.0) {
+		return clockEpoch + (long long)((real - clockEpoch) * clockScale);
+	}
+
+	return real;
+}
+
+void ClockSleepUntil(long long when)
+{
+	ClockParticipant * self = ClockSelf();
+	struct timespec wake;
+
+	if (NULL != self) {
+		ClockWaitVirtual(self, -1, NULL, when);
+		return;
+	}
+
+	if (clockScale > 0.0) {
+		when = clockEpoch + (long long)((when - clockEpoch) / clockScale);
+	}
+
+	ClockTimespec(when, &wake);
+
+	// restart after signals, the wake time is absolute
+	while (EINTR == clock_nanosleep(clockId, TIMER_ABSTIME, &wake, NULL));
+}
+
+void ClockSleep(long long ns)
+{
+	ClockSleepUntil(ClockNowNs() + ns);
+}
+
+int ClockWait(int maxFd, fd_set * rdfs, long long when)
+{
+	ClockParticipant * self = ClockSelf();
+	struct timespec timeout;
+	long long remaining;
+
+	if (NULL != self) {
+		return ClockWaitVirtual(self, maxFd, rdfs, when);
+	}
+
+	if (CLOCK_NEVER == when) {
+		return pselect(maxFd + 1, rdfs, NULL, NULL, NULL, NULL);
+	}
+
+	remaining = when - ClockNowNs();
+	remaining = (remaining < 0)?(0):(remaining);
+	if (clockScale > 0.0) {
+		remaining = (long long)(remaining / clockScale);
+	}
+
+	ClockTimespec(remaining, &timeout);
+
+	return pselect(maxFd + 1, rdfs, NULL, NULL, &timeout, NULL);
+}
+
+void ClockExpect(pid_t process)
+{
+	ClockParticipant * participant;
+	int i;
+
+	if (NULL == ClockSelf()) {
+		return;
+	}
+
+	ClockLock(clockShared);
+
+	// a child may have joined before its parent got here
+	for (i = 0; process && i < CLOCK_MAX_PARTICIPANTS; i++) {
+		if (clockShared->participants[i].process == process) {
+			ClockUnlock(clockShared);
+			return;
+		}
+	}
+
+	for (i = 0; i < CLOCK_MAX_PARTICIPANTS; i++) {
+		participant = &clockShared->participants[i];
+		if (0 == participant->process) {
+			participant->process = (process)?(process):(getpid());
+			participant->thread = process;
+			participant->waiting = 0;
+			clockShared->running++;
+			break;
+		}
+	}
+
+	ClockUnlock(clockShared);
+
+	if (CLOCK_MAX_PARTICIPANTS == i) {
+		printf("more than %d threads on the virtual clock\n", CLOCK_MAX_PARTICIPANTS);
+	}
+}
+
+void ClockReap(pid_t process, int unread)
+{
+	ClockCheckEnv();
+
+	if (NULL == clockShared) {
+		return;
+	}
+
+	ClockLock(clockShared);
+	ClockFreeSlots(process);
+	clockShared->inFlight -= unread;
+	ClockAdvance(clockShared);
+	ClockUnlock(clockShared);
+}
+
+void ClockLeave()
+{
+	ClockParticipant * self = ClockSelf();
+
+	if (NULL == self) {
+		return;
+	}
+
+	ClockLock(clockShared);
+	if (!self->waiting) {
+		clockShared->running--;
+	}
+	memset(self, 0, sizeof(ClockParticipant));
+	ClockAdvance(clockShared);
+	ClockUnlock(clockShared);
+
+	clockSlot = -1;
+}
+
+void ClockIdle()
+{
+	ClockParticipant * self = ClockSelf();
+
+	if (NULL == self) {
+		return;
+	}
+
+	ClockLock(clockShared);
+	if (!self->waiting) {
+		self->wake = CLOCK_NEVER;
+		self->waiting = 1;
+		clockShared->running--;
+		ClockAdvance(clockShared);
+	}
+	ClockUnlock(clockShared);
+}
+
+void ClockBusy()
+{
+	ClockParticipant * self = ClockSelf();
+
+	if (NULL == self) {
+		return;
+	}
+
+	ClockLock(clockShared);
+	if (self->waiting) {
+		self->waiting = 0;
+		clockShared->running++;
+	}
+	ClockUnlock(clockShared);
+}
+
+void ClockMessageSent()
+{
+	ClockCheckEnv();
+
+	// the sender is running, the clock can't move before this lands
+	if (NULL != clockShared) {
+		__sync_fetch_and_add(&clockShared->inFlight, 1);
+	}
+}
+
+void ClockMessageReceived()
+{
+	ClockCheckEnv();
+
+	if (NULL != clockShared) {
+		__sync_fetch_and_sub(&clockShared->inFlight, 1);
+	}
+}
+
+void ClockExternalSent()
+{
+	ClockCheckEnv();
+
+	if (NULL != clockShared) {
+		__sync_fetch_and_add(&clockShared->external, 1);
+	}
+}
+
+void ClockExternalReceived()
+{
+	ClockCheckEnv();
+
+	if (NULL == clockShared) {
+		return;
+	}
+
+	// a controller off the clock never counted its messages
+	ClockLock(clockShared);
+	if (clockShared->external > 0) {
+		clockShared->external--;
+	}
+	ClockUnlock(clockShared);
+}
+
+void ClockRelease()
+{
+	int i;
+
+	ClockCheckEnv();
+
+	if (NULL == clockShared) {
+		return;
+	}
+
+	ClockLock(clockShared);
+	clockShared->released = 1;
+
+	// let everyone see it
+	for (i = 0; i < CLOCK_MAX_PARTICIPANTS; i++) {
+		if (clockShared->participants[i].process && clockShared->participants[i].waiting) {
+			ClockWake(clockShared, &clockShared->participants[i]);
+		}
+	}
+
+	ClockUnlock(clockShared);
+}
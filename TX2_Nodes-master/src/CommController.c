@@ -1,4 +1,5 @@
 #include "../include/CommController.h"
+#include "../include/Clock.h"
 
 #define BUFFER_SIZE 4096 
 
@@ -50,9 +51,12 @@ int EstablishSocket()
 		close(TCPSocket);
 	}
 
-	// wait here until a new request comes in.
+	// wait here until a new request comes in. The clock goes on without us
+	ClockIdle();
 	while ((TCPSocket = accept(SetupSocket, (struct sockaddr *) &address, 
 					  (socklen_t *) &addressLength)) < 0);
+	ClockBusy();
+	ClockExternalReceived();
 	printf("client connected.\n");
 	brokenConnection = 0;
 
@@ -121,7 +125,14 @@ int InitializeComm(int port)
 
 int CommRead(Message * message)
 {
-	return read(TCPSocket, message, sizeof(*message));
+	int status = read(TCPSocket, message, sizeof(*message));
+
+	// a client on the virtual clock counted it, see Clock.h
+	if (sizeof(*message) == status) {
+		ClockExternalReceived();
+	}
+
+	return status;
 }
 
 int CommWrite(Message * message)
@@ -49,6 +49,18 @@ CommandNode * CreateNewCommandNode(CmdMsg * cmdMsg,
 	return temp;
 }
 
+/**
+ * @brief Internal function that marshals the command at the head of the queue into a #Message for nav.
+**/
+void HeadMessage(Message * message)
+{
+	message->messageType = PositionMessage;
+	message->source = TX2Master;
+	message->destination = TX2Nav;
+	message->positionMsg.position.latitude = commandHead->position.latitude;
+	message->positionMsg.position.longitude = commandHead->position.longitude;
+}
+
 int InsertCommand(CmdMsg * cmdMsg, Message * message)
 {
 	CommandNode * temp;
@@ -73,11 +85,29 @@ int InsertCommand(CmdMsg * cmdMsg, Message * message)
 	// if this was a head insertion, we need to marshal the necessary parameters into the #Message
 	// struct pointer that was passed in.
 	if (HEAD_INSERT == insertionType) {
-		message->messageType = PositionMessage;
-		message->source = TX2Master;
-		message->destination = TX2Nav;
-		message->positionMsg.position.latitude = commandHead->position.latitude;
-		message->positionMsg.position.longitude = commandHead->position.longitude;
+		HeadMessage(message);
+	}
+
+	return insertionType;
+}
+
+int InsertCommands(CmdMsg * cmdMsgs, int count, Message * message)
+{
+	CommandNode ** tail = &commandHead;
+	int insertionType = (NULL == commandHead)?(HEAD_INSERT):(NON_HEAD_INSERT);
+	int i;
+
+	// one walk to the end, then each command goes after the one before it
+	while (NULL != *tail) {
+		tail = &(*tail)->nextCommand;
+	}
+	for (i = 0; i < count; i++) {
+		*tail = CreateNewCommandNode(&cmdMsgs[i], NULL);
+		tail = &(*tail)->nextCommand;
+	}
+
+	if (HEAD_INSERT == insertionType && count > 0) {
+		HeadMessage(message);
 	}
 
 	return insertionType;
@@ -186,3 +216,15 @@ void PrintCommands()
 		temp = temp->nextCommand;
 	}
 }
+
+int CountCommands()
+{
+	CommandNode * temp;
+	int count = 0;
+
+	for (temp = commandHead; NULL != temp; temp = temp->nextCommand) {
+		count++;
+	}
+
+	return count;
+}
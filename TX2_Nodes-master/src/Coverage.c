@@ -0,0 +1,735 @@
+/**
+ * @file Coverage.c
+ * @brief Function definitions for the Coverage library.
+ * @details Function definitions for the Coverage library.
+**/
+
+#include "../include/Coverage.h"
+
+#define COVERAGE_EARTH_RADIUS 6371000.0	/**< Meters, as Simulation.h. */
+#define COVERAGE_EPSILON 1e-6		/**< Meters, pieces of lane and moves shorter than this are left out. */
+
+/**
+ * @brief An edge of the turned area, from its lowest v to its highest.
+**/
+typedef struct _CoverageEdge {
+	double v0;
+	double v1;
+	double u0;			// u at v0
+	double slope;			// du/dv
+} CoverageEdge;
+
+/**
+ * @brief A piece of lane inside the area.
+**/
+typedef struct _CoverageSegment {
+	double u0;
+	double u1;
+	double v;
+	int cell;
+	int next;			// the piece of the same cell on the next lane, -1 for none
+	int previous;
+	int below;			// pieces it overlaps on the lane before
+	int above;			// and on the lane after
+	int match;			// the last one it overlaps on the lane before
+} CoverageSegment;
+
+/**
+ * @brief The moves around whatever is in the way between two lanes, over the corners of the area.
+**/
+typedef struct _CoverageRoute {
+	int corners;			// points of the area, holes included
+	signed char * visible;		// corners x corners, the straight move between them stays in, -1 if not tested yet
+	double * distance;		// of each corner, and the two ends, from the start of a move
+	int * previous;			// corner before each on the way, -1 for the start
+	char * done;
+} CoverageRoute;
+
+int CoverageReadArea(char * fileName, CoverageArea * area)
+{
+	FILE * file;
+	char line[128];
+	char word[16];
+	char * comment;
+	double x, y;
+	int lineNumber = 0;
+	int pointCount = 0;
+	int count;
+	int i;
+
+	file = fopen(fileName, "r");
+	if (NULL == file) {
+		printf("error opening %s\n", fileName);
+		return -1;
+	}
+
+	memset(area, 0, sizeof(CoverageArea));
+
+	while (NULL != fgets(line, sizeof(line), file)) {
+		lineNumber++;
+
+		comment = strchr(line, '#');
+		if (NULL != comment) {
+			*comment = '\0';
+		}
+		if (1 != sscanf(line, "%15s", word)) {
+			continue;
+		}
+
+		if (0 == strcmp(word, "origin")) {
+			count = (2 == sscanf(line, "%*s %lf %lf", &area->latitude, &area->longitude));
+		} else if (0 == strcmp(word, "spacing")) {
+			count = sscanf(line, "%*s %lf", &area->spacing);
+		} else if (0 == strcmp(word, "heading")) {
+			count = sscanf(line, "%*s %lf", &area->heading);
+		} else if (0 == strcmp(word, "photoSpacing")) {
+			count = sscanf(line, "%*s %lf", &area->photoSpacing);
+		} else if (0 == strcmp(word, "outer") || 0 == strcmp(word, "hole")) {
+			// the outside comes first, there is one
+			count = (area->ringCount < COVERAGE_MAX_RINGS && (0 == area->ringCount) == (0 == strcmp(word, "outer")));
+			if (count) {
+				area->ringStart[area->ringCount++] = pointCount;
+			}
+		} else {
+			// a corner of the last ring
+			count = (2 == sscanf(line, "%lf %lf", &x, &y) && area->ringCount > 0 && pointCount < COVERAGE_MAX_POINTS);
+			if (count) {
+				area->points[pointCount].x = x;
+				area->points[pointCount].y = y;
+				pointCount++;
+			}
+		}
+
+		if (count < 1) {
+			printf("%s:%d: bad line \"%s\"\n", fileName, lineNumber, word);
+			fclose(file);
+			return -1;
+		}
+	}
+
+	fclose(file);
+
+	area->ringStart[area->ringCount] = pointCount;
+
+	if (0 == area->ringCount || area->spacing <= 0.0 || area->photoSpacing < 0.0) {
+		printf("%s needs an outer ring and a spacing\n", fileName);
+		return -1;
+	}
+
+	for (i = 0; i < area->ringCount; i++) {
+		if (area->ringStart[i + 1] - area->ringStart[i] < 3) {
+			printf("%s: ring %d has less than 3 points\n", fileName, i);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Internal function that orders edges by where they start, for qsort().
+**/
+int CompareEdges(const void * a, const void * b)
+{
+	double v0 = ((CoverageEdge *)a)->v0;
+	double v1 = ((CoverageEdge *)b)->v0;
+
+	return (v0 < v1)?(-1):((v0 > v1)?(1):(0));
+}
+
+/**
+ * @brief Internal function that turns a point of the lanes back into the area.
+**/
+void Unturn(CoverageArea * area, double u, double v, CoveragePoint * point)
+{
+	double s = sin(area->heading * (M_PI / 180.0));
+	double c = cos(area->heading * (M_PI / 180.0));
+
+	point->x = (u * s) + (v * c);
+	point->y = (u * c) - (v * s);
+}
+
+/**
+ * @brief Internal function that returns how far c is to the left of the line from a to b, meters.
+**/
+double SideOfLine(CoveragePoint * a, CoveragePoint * b, CoveragePoint * c)
+{
+	double length = hypot(b->x - a->x, b->y - a->y);
+
+	if (length < COVERAGE_EPSILON) {
+		return 0.0;
+	}
+
+	return (((b->x - a->x) * (c->y - a->y)) - ((b->y - a->y) * (c->x - a->x))) / length;
+}
+
+/**
+ * @brief Internal function that tells whether a point is in the area, its edges included.
+**/
+int InsideArea(CoverageArea * area, CoveragePoint * point)
+{
+	CoveragePoint * a;
+	CoveragePoint * b;
+	double t, length;
+	int inside = 0;
+	int ring, i;
+
+	for (ring = 0; ring < area->ringCount; ring++) {
+		for (i = area->ringStart[ring]; i < area->ringStart[ring + 1]; i++) {
+			a = &area->points[i];
+			b = &area->points[(i + 1 < area->ringStart[ring + 1])?(i + 1):(area->ringStart[ring])];
+
+			// on the edge
+			length = ((b->x - a->x) * (b->x - a->x)) + ((b->y - a->y) * (b->y - a->y));
+			t = (length > 0.0)?((((point->x - a->x) * (b->x - a->x)) + ((point->y - a->y) * (b->y - a->y))) / length):(0.0);
+			t = (t < 0.0)?(0.0):((t > 1.0)?(1.0):(t));
+			if (hypot(a->x + (t * (b->x - a->x)) - point->x, a->y + (t * (b->y - a->y)) - point->y) < COVERAGE_EPSILON) {
+				return 1;
+			}
+
+			// even-odd, as the lanes
+			if ((a->y > point->y) != (b->y > point->y) &&
+			    point->x < a->x + ((point->y - a->y) * (b->x - a->x) / (b->y - a->y))) {
+				inside = !inside;
+			}
+		}
+	}
+
+	return inside;
+}
+
+/**
+ * @brief Internal function that tells whether the straight move from p to q stays in the area.
+ * @details It may run along an edge or touch a corner, but not cross an edge. Then between
+ *	    the corners it touches it is either all in or all out, and the middle of each piece
+ *	    tells which.
+**/
+int MoveClear(CoverageArea * area, CoveragePoint * p, CoveragePoint * q)
+{
+	double touches[COVERAGE_MAX_POINTS + 2];
+	double length = hypot(q->x - p->x, q->y - p->y);
+	double sa, sb, t;
+	CoveragePoint * a;
+	CoveragePoint * b;
+	CoveragePoint middle;
+	int touchCount = 0;
+	int ring, i, j;
+
+	if (length < COVERAGE_EPSILON) {
+		return 1;
+	}
+
+	touches[touchCount++] = 0.0;
+	for (ring = 0; ring < area->ringCount; ring++) {
+		for (i = area->ringStart[ring]; i < area->ringStart[ring + 1]; i++) {
+			a = &area->points[i];
+			b = &area->points[(i + 1 < area->ringStart[ring + 1])?(i + 1):(area->ringStart[ring])];
+
+			// a and b on either side of the move, and p and q on either side of the edge
+			sa = SideOfLine(p, q, a);
+			sb = SideOfLine(p, q, b);
+			if (((sa > COVERAGE_EPSILON && sb < -COVERAGE_EPSILON) || (sa < -COVERAGE_EPSILON && sb > COVERAGE_EPSILON))) {
+				sa = SideOfLine(a, b, p);
+				sb = SideOfLine(a, b, q);
+				if ((sa > COVERAGE_EPSILON && sb < -COVERAGE_EPSILON) || (sa < -COVERAGE_EPSILON && sb > COVERAGE_EPSILON)) {
+					return 0;
+				}
+			}
+
+			// a corner on the way, in order
+			t = (((a->x - p->x) * (q->x - p->x)) + ((a->y - p->y) * (q->y - p->y))) / (length * length);
+			if (t > 0.0 && t < 1.0 && fabs(SideOfLine(p, q, a)) < COVERAGE_EPSILON) {
+				for (j = touchCount; j > 0 && touches[j - 1] > t; j--) {
+					touches[j] = touches[j - 1];
+				}
+				touches[j] = t;
+				touchCount++;
+			}
+		}
+	}
+	touches[touchCount++] = 1.0;
+
+	for (i = 0; i + 1 < touchCount; i++) {
+		t = (touches[i] + touches[i + 1]) / 2.0;
+		middle.x = p->x + (t * (q->x - p->x));
+		middle.y = p->y + (t * (q->y - p->y));
+		if (!InsideArea(area, &middle)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Internal function that tells whether the move between two corners stays in the area, tested once.
+**/
+int CornersClear(CoverageArea * area, CoverageRoute * route, int i, int j)
+{
+	if (route->visible[(i * route->corners) + j] < 0) {
+		route->visible[(i * route->corners) + j] = MoveClear(area, &area->points[i], &area->points[j]);
+		route->visible[(j * route->corners) + i] = route->visible[(i * route->corners) + j];
+	}
+
+	return route->visible[(i * route->corners) + j];
+}
+
+/**
+ * @brief Internal function that adds a waypoint in meters of the origin.
+ * @return 0 on success, -1 if there is no room.
+**/
+int AddPoint(double x, double y, int photo, CoverageWaypoint * waypoints, int max, int * count, CoverageStats * stats)
+{
+	CoverageWaypoint * last = (*count > 0)?(&waypoints[*count - 1]):(NULL);
+	double length = (NULL != last)?(hypot(x - last->x, y - last->y)):(0.0);
+
+	// the end of one lane can be the start of the next
+	if (NULL != last && length < COVERAGE_EPSILON) {
+		last->photo |= photo;
+		return 0;
+	}
+
+	if (*count == max) {
+		printf("survey needs more than %d waypoints\n", max);
+		return -1;
+	}
+
+	waypoints[*count].x = x;
+	waypoints[*count].y = y;
+	waypoints[*count].photo = photo;
+	(*count)++;
+
+	stats->length += length;
+
+	return 0;
+}
+
+/**
+ * @brief Internal function that adds a waypoint, given in turned coordinates.
+ * @return 0 on success, -1 if there is no room.
+**/
+int AddWaypoint(CoverageArea * area, double u, double v, int photo, CoverageWaypoint * waypoints, int max, int * count,
+		CoverageStats * stats)
+{
+	CoveragePoint point;
+
+	Unturn(area, u, v, &point);
+
+	return AddPoint(point.x, point.y, photo, waypoints, max, count, stats);
+}
+
+/**
+ * @brief Internal function that adds the corners to go around on the way from the last waypoint to a point.
+ * @details Nothing if the straight move stays in the area. Otherwise the shortest way over
+ *	    the corners of the area (Dijkstra over the moves between them that stay in), which
+ *	    runs along the edges in the way. The point itself is not added.
+ * @return 0 on success, -1 if there is no room.
+**/
+int AddTransit(CoverageArea * area, CoverageRoute * route, CoveragePoint * to, CoverageWaypoint * waypoints, int max,
+	       int * count, CoverageStats * stats)
+{
+	CoveragePoint from;
+	CoveragePoint * point;
+	CoveragePoint * next;
+	double distance;
+	int corners = route->corners;
+	int start = corners;
+	int end = corners + 1;
+	int nearest, i, j;
+	int path[COVERAGE_MAX_POINTS];
+	int pathLength = 0;
+
+	if (0 == *count) {
+		return 0;
+	}
+	from.x = waypoints[*count - 1].x;
+	from.y = waypoints[*count - 1].y;
+	if (MoveClear(area, &from, to)) {
+		return 0;
+	}
+
+	for (i = 0; i < corners + 2; i++) {
+		route->distance[i] = HUGE_VAL;
+		route->previous[i] = -1;
+		route->done[i] = 0;
+	}
+	route->distance[start] = 0.0;
+
+	for (;;) {
+		nearest = -1;
+		for (i = 0; i < corners + 2; i++) {
+			if (!route->done[i] && route->distance[i] < HUGE_VAL &&
+			    (nearest < 0 || route->distance[i] < route->distance[nearest])) {
+				nearest = i;
+			}
+		}
+		if (nearest < 0 || end == nearest) {
+			break;
+		}
+		route->done[nearest] = 1;
+		point = (start == nearest)?(&from):(&area->points[nearest]);
+
+		for (j = 0; j < corners + 2; j++) {
+			if (start == j || route->done[j]) {
+				continue;
+			}
+
+			// the moves between corners are the same for every transit
+			next = (end == j)?(to):(&area->points[j]);
+			if ((start == nearest || end == j)?(!MoveClear(area, point, next)):(!CornersClear(area, route, nearest, j))) {
+				continue;
+			}
+
+			distance = route->distance[nearest] + hypot(next->x - point->x, next->y - point->y);
+			if (distance < route->distance[j]) {
+				route->distance[j] = distance;
+				route->previous[j] = nearest;
+			}
+		}
+	}
+
+	// no way around, the ends are a hair outside, straight then
+	if (route->distance[end] == HUGE_VAL) {
+		return 0;
+	}
+
+	for (i = route->previous[end]; i >= 0 && start != i; i = route->previous[i]) {
+		path[pathLength++] = i;
+	}
+	for (i = pathLength - 1; i >= 0; i--) {
+		if (AddPoint(area->points[path[i]].x, area->points[path[i]].y, 0, waypoints, max, count, stats) < 0) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Internal function that drives to a piece of lane and along it.
+ * @param forward From u0 to u1, or back.
+ * @return 0 on success, -1 if there is no room.
+**/
+int SweepSegment(CoverageArea * area, CoverageRoute * route, CoverageSegment * segment, int forward,
+		 CoverageWaypoint * waypoints, int max, int * count, CoverageStats * stats)
+{
+	double start = (forward)?(segment->u0):(segment->u1);
+	double direction = (forward)?(1.0):(-1.0);
+	double length = segment->u1 - segment->u0;
+	CoveragePoint first;
+	int photos = 0;
+	int i;
+
+	// around what is in the way, from the lane before or the cell before
+	Unturn(area, start, segment->v, &first);
+	if (AddTransit(area, route, &first, waypoints, max, count, stats) < 0) {
+		return -1;
+	}
+
+	// a picture every photoSpacing from the start, the end if it is not on one
+	if (area->photoSpacing > 0.0) {
+		photos = (int)floor((length / area->photoSpacing) + COVERAGE_EPSILON);
+		for (i = 0; i <= photos; i++) {
+			if (AddWaypoint(area, start + (direction * i * area->photoSpacing), segment->v, 1, waypoints, max,
+					count, stats) < 0) {
+				return -1;
+			}
+		}
+		photos++;
+	} else if (AddWaypoint(area, start, segment->v, 0, waypoints, max, count, stats) < 0) {
+		return -1;
+	}
+
+	if (AddWaypoint(area, start + (direction * length), segment->v, 0, waypoints, max, count, stats) < 0) {
+		return -1;
+	}
+
+	stats->photos += photos;
+
+	return 0;
+}
+
+/**
+ * @brief Internal function that cuts the lanes into the pieces inside the area.
+ * @param segments Output, allocated, in lane order and along each lane.
+ * @param laneFirst Output, allocated, first piece of each lane and one past the last.
+ * @return The number of pieces, -1 on failure.
+**/
+int FindSegments(CoverageArea * area, CoverageSegment ** segments, int ** laneFirst, CoverageStats * stats)
+{
+	double s = sin(area->heading * (M_PI / 180.0));
+	double c = cos(area->heading * (M_PI / 180.0));
+	CoverageEdge edges[COVERAGE_MAX_POINTS];
+	double crossings[COVERAGE_MAX_POINTS];
+	int active[COVERAGE_MAX_POINTS];
+	CoverageSegment * grown;
+	CoveragePoint * a;
+	CoveragePoint * b;
+	double ua, va, ub, vb, v, crossing;
+	double vMin = HUGE_VAL;
+	double vMax = -HUGE_VAL;
+	int edgeCount = 0;
+	int activeCount = 0;
+	int segmentCount = 0;
+	int segmentSize = 0;
+	int nextEdge = 0;
+	int lanes, lane, ring;
+	int i, j;
+
+	// turned so the lanes run along u, v is across them
+	for (ring = 0; ring < area->ringCount; ring++) {
+		for (i = area->ringStart[ring]; i < area->ringStart[ring + 1]; i++) {
+			a = &area->points[i];
+			b = &area->points[(i + 1 < area->ringStart[ring + 1])?(i + 1):(area->ringStart[ring])];
+			ua = (a->x * s) + (a->y * c);
+			va = (a->x * c) - (a->y * s);
+			ub = (b->x * s) + (b->y * c);
+			vb = (b->x * c) - (b->y * s);
+
+			vMin = (va < vMin)?(va):(vMin);
+			vMax = (va > vMax)?(va):(vMax);
+
+			// along a lane, it never crosses one
+			if (va == vb) {
+				continue;
+			}
+			edges[edgeCount].v0 = (va < vb)?(va):(vb);
+			edges[edgeCount].v1 = (va < vb)?(vb):(va);
+			edges[edgeCount].u0 = (va < vb)?(ua):(ub);
+			edges[edgeCount].slope = (ub - ua) / (vb - va);
+			edgeCount++;
+		}
+	}
+
+	// centered on the area, at least one
+	lanes = (int)ceil(((vMax - vMin) / area->spacing) - COVERAGE_EPSILON);
+	lanes = (lanes < 1)?(1):(lanes);
+	if (lanes > COVERAGE_MAX_LANES) {
+		printf("survey needs %d lanes, more than %d\n", lanes, COVERAGE_MAX_LANES);
+		return -1;
+	}
+	stats->lanes = lanes;
+
+	*segments = NULL;
+	*laneFirst = malloc(sizeof(int) * (lanes + 1));
+	if (NULL == *laneFirst) {
+		return -1;
+	}
+
+	qsort(edges, edgeCount, sizeof(CoverageEdge), CompareEdges);
+
+	for (lane = 0; lane < lanes; lane++) {
+		v = ((vMin + vMax) / 2.0) + ((lane - ((lanes - 1) / 2.0)) * area->spacing);
+		(*laneFirst)[lane] = segmentCount;
+
+		// the edges the lane meets, a vertex on it counts for the edge above it only
+		while (nextEdge < edgeCount && edges[nextEdge].v0 <= v) {
+			active[activeCount++] = nextEdge++;
+		}
+		for (i = 0, j = 0; i < activeCount; i++) {
+			if (edges[active[i]].v1 > v) {
+				active[j++] = active[i];
+			}
+		}
+		activeCount = j;
+
+		for (i = 0; i < activeCount; i++) {
+			crossing = edges[active[i]].u0 + ((v - edges[active[i]].v0) * edges[active[i]].slope);
+			for (j = i; j > 0 && crossings[j - 1] > crossing; j--) {
+				crossings[j] = crossings[j - 1];
+			}
+			crossings[j] = crossing;
+		}
+
+		// inside between every other pair
+		for (i = 0; i + 1 < activeCount; i += 2) {
+			if (crossings[i + 1] - crossings[i] < COVERAGE_EPSILON) {
+				continue;
+			}
+			if (segmentCount == segmentSize) {
+				segmentSize = (segmentSize > 0)?(segmentSize * 2):(1024);
+				grown = realloc(*segments, sizeof(CoverageSegment) * segmentSize);
+				if (NULL == grown) {
+					return -1;
+				}
+				*segments = grown;
+			}
+			memset(&(*segments)[segmentCount], 0, sizeof(CoverageSegment));
+			(*segments)[segmentCount].u0 = crossings[i];
+			(*segments)[segmentCount].u1 = crossings[i + 1];
+			(*segments)[segmentCount].v = v;
+			(*segments)[segmentCount].next = -1;
+			(*segments)[segmentCount].previous = -1;
+			segmentCount++;
+		}
+	}
+	(*laneFirst)[lanes] = segmentCount;
+	stats->segments = segmentCount;
+
+	return segmentCount;
+}
+
+/**
+ * @brief Internal function that joins the pieces into cells.
+ * @param cellFirst Output, the first piece of each cell.
+ * @param cellLast Output, the last piece of each cell.
+ * @return The number of cells.
+**/
+int FindCells(CoverageSegment * segments, int * laneFirst, int lanes, int * cellFirst, int * cellLast)
+{
+	int cells = 0;
+	int lane, previousFirst;
+	int i, j;
+
+	for (lane = 0; lane < lanes; lane++) {
+		// both lanes are in order, one pass finds what overlaps what
+		previousFirst = (lane > 0)?(laneFirst[lane - 1]):(laneFirst[lane]);
+		for (i = previousFirst, j = laneFirst[lane]; i < laneFirst[lane] && j < laneFirst[lane + 1]; ) {
+			if (segments[i].u0 < segments[j].u1 && segments[j].u0 < segments[i].u1) {
+				segments[i].above++;
+				segments[j].below++;
+				segments[j].match = i;
+			}
+			if (segments[i].u1 < segments[j].u1) {
+				i++;
+			} else {
+				j++;
+			}
+		}
+
+		// a cell goes on while neither lane splits or joins
+		for (j = laneFirst[lane]; j < laneFirst[lane + 1]; j++) {
+			i = segments[j].match;
+			if (1 == segments[j].below && 1 == segments[i].above) {
+				segments[j].cell = segments[i].cell;
+				segments[j].previous = i;
+				segments[i].next = j;
+				cellLast[segments[j].cell] = j;
+			} else {
+				segments[j].cell = cells;
+				cellFirst[cells] = j;
+				cellLast[cells] = j;
+				cells++;
+			}
+		}
+	}
+
+	return cells;
+}
+
+/**
+ * @brief Internal function that sweeps the cells, each from the end nearest to where the last one ended.
+ * @return The number of waypoints, -1 if there is no room.
+**/
+int SweepCells(CoverageArea * area, CoverageRoute * route, CoverageSegment * segments, int * cellFirst, int * cellLast,
+	       int cells, CoverageWaypoint * waypoints, int max, CoverageStats * stats)
+{
+	char swept[cells];
+	double u, distance, best;
+	double fromU = 0.0;
+	double fromV = 0.0;
+	int count = 0;
+	int cell, entry, bestCell, bestEntry, forward;
+	int i, k;
+
+	memset(swept, 0, cells);
+
+	// from the origin at first
+	for (k = 0; k < cells; k++) {
+		best = HUGE_VAL;
+		bestCell = -1;
+		bestEntry = 0;
+		for (cell = 0; cell < cells; cell++) {
+			if (swept[cell]) {
+				continue;
+			}
+			for (entry = 0; entry < 4; entry++) {
+				// first or last lane, u0 or u1 end
+				i = (entry < 2)?(cellFirst[cell]):(cellLast[cell]);
+				u = (entry & 1)?(segments[i].u1):(segments[i].u0);
+				distance = hypot(u - fromU, segments[i].v - fromV);
+				if (distance < best) {
+					best = distance;
+					bestCell = cell;
+					bestEntry = entry;
+				}
+			}
+		}
+
+		swept[bestCell] = 1;
+		forward = !(bestEntry & 1);
+		for (i = (bestEntry < 2)?(cellFirst[bestCell]):(cellLast[bestCell]); i >= 0;
+		     i = (bestEntry < 2)?(segments[i].next):(segments[i].previous)) {
+			if (SweepSegment(area, route, &segments[i], forward, waypoints, max, &count, stats) < 0) {
+				return -1;
+			}
+			forward = !forward;
+			fromU = (forward)?(segments[i].u0):(segments[i].u1);
+			fromV = segments[i].v;
+		}
+	}
+
+	return count;
+}
+
+int CoveragePlan(CoverageArea * area, CoverageWaypoint * waypoints, int max, CoverageStats * stats)
+{
+	CoverageStats ignored;
+	CoverageRoute route;
+	CoverageSegment * segments = NULL;
+	int * laneFirst = NULL;
+	int * cellFirst = NULL;
+	int * cellLast = NULL;
+	int segmentCount;
+	int count = -1;
+
+	if (NULL == stats) {
+		stats = &ignored;
+	}
+	memset(stats, 0, sizeof(CoverageStats));
+
+	// the corners and the two ends of a transit
+	route.corners = area->ringStart[area->ringCount];
+	route.visible = malloc(route.corners * route.corners);
+	route.distance = malloc(sizeof(double) * (route.corners + 2));
+	route.previous = malloc(sizeof(int) * (route.corners + 2));
+	route.done = malloc(route.corners + 2);
+
+	segmentCount = FindSegments(area, &segments, &laneFirst, stats);
+	if (segmentCount >= 0) {
+		cellFirst = malloc(sizeof(int) * (segmentCount + 1));
+		cellLast = malloc(sizeof(int) * (segmentCount + 1));
+	}
+
+	if (NULL != cellFirst && NULL != cellLast && NULL != route.visible && NULL != route.distance &&
+	    NULL != route.previous && NULL != route.done) {
+		memset(route.visible, -1, route.corners * route.corners);
+		stats->cells = FindCells(segments, laneFirst, stats->lanes, cellFirst, cellLast);
+
+		// no lane crosses the area, nothing to sweep
+		if (0 == stats->cells) {
+			count = 0;
+		} else {
+			count = SweepCells(area, &route, segments, cellFirst, cellLast, stats->cells, waypoints, max, stats);
+		}
+		stats->waypoints = (count > 0)?(count):(0);
+	}
+
+	free(segments);
+	free(laneFirst);
+	free(cellFirst);
+	free(cellLast);
+	free(route.visible);
+	free(route.distance);
+	free(route.previous);
+	free(route.done);
+
+	return count;
+}
+
+void CoverageLatLon(CoverageArea * area, double x, double y, double * latitude, double * longitude)
+{
+	// a flat map over the area, as SimulationLatLon()
+	*latitude = area->latitude + ((y / COVERAGE_EARTH_RADIUS) * (180.0 / M_PI));
+	*longitude = area->longitude + ((x / (COVERAGE_EARTH_RADIUS * cos(area->latitude * (M_PI / 180.0)))) * (180.0 / M_PI));
+}
@@ -0,0 +1,230 @@
+/**
+ * @file GnssAssist.c
+ * @brief Function definitions for the GnssAssist library.
+ * @details Function definitions for the GnssAssist library.
+**/
+
+#include "../include/GnssAssist.h"
+#include "../include/I2CGPS.h"
+#include "../include/Clock.h"
+
+long long GnssAssistUtcNs()
+{
+	struct timespec real, monotonic;
+
+	clock_gettime(CLOCK_REALTIME, &real);
+	clock_gettime(CLOCK_MONOTONIC, &monotonic);
+
+	return ((long long)real.tv_sec * 1000000000LL) + real.tv_nsec + ClockNowNs() -
+	       (((long long)monotonic.tv_sec * 1000000000LL) + monotonic.tv_nsec);
+}
+
+int GnssAssistLoad(GnssAssistState * state, char * fileName)
+{
+	FILE * file;
+	int version;
+	int fields;
+
+	memset(state, 0, sizeof(GnssAssistState));
+
+	file = fopen(fileName, "r");
+	if (NULL == file) {
+		return -1;
+	}
+
+	fields = fscanf(file, "%d %lld %d %lf %lf %f", &version, &state->utc, &state->clockAgreed,
+			&state->latitude, &state->longitude, &state->altitude);
+	fclose(file);
+
+	if (6 != fields || GNSS_ASSIST_VERSION != version) {
+		printf("%s is not a version %d GNSS state\n", fileName, GNSS_ASSIST_VERSION);
+		memset(state, 0, sizeof(GnssAssistState));
+		return -1;
+	}
+
+	state->valid = 1;
+	return 0;
+}
+
+int GnssAssistSave(GnssAssistState * state, char * fileName)
+{
+	char newName[256];
+	FILE * file;
+
+	if (!state->valid) {
+		return -1;
+	}
+
+	// a node killed halfway through leaves the old state
+	snprintf(newName, sizeof(newName), "%s.new", fileName);
+	file = fopen(newName, "w");
+	if (NULL == file) {
+		printf("error writing %s\n", newName);
+		return -1;
+	}
+
+	fprintf(file, "%d %lld %d %.7f %.7f %.1f\n", GNSS_ASSIST_VERSION, state->utc, state->clockAgreed,
+		state->latitude, state->longitude, state->altitude);
+
+	if (0 != fclose(file) || 0 != rename(newName, fileName)) {
+		printf("error writing %s\n", fileName);
+		return -1;
+	}
+
+	return 0;
+}
+
+void GnssAssistUpdate(GnssAssistState * state, GpsMsg * fix, Position * position, long long utcNs)
+{
+	long long difference;
+
+	// the fix has the time of day only, the date is the system clock's
+	difference = ((utcNs / 1000000LL) % 86400000LL) - fix->time;
+	difference = (difference > 43200000LL)?(difference - 86400000LL):(difference);
+	difference = (difference < -43200000LL)?(difference + 86400000LL):(difference);
+
+	state->valid = 1;
+	state->utc = utcNs / 1000000000LL;
+	state->clockAgreed = (0 != fix->time && difference <= GNSS_ASSIST_CLOCK_MS && difference >= -GNSS_ASSIST_CLOCK_MS);
+	state->latitude = position->latitude;
+	state->longitude = position->longitude;
+	state->altitude = fix->altitude;
+}
+
+/**
+ * @brief Internal function that sends one satellite of an EPO set.
+ * @details The record is sent as its satellite and 18 words, little endian, in hex.
+**/
+void GnssAssistSendEpoRecord(int satellite, uint8_t * record)
+{
+	char command[256];
+	int length;
+	int i;
+
+	length = snprintf(command, sizeof(command), "$PMTK721,%X", satellite);
+	for (i = 0; i < GNSS_ASSIST_EPO_RECORD; i += 4) {
+		length += snprintf(command + length, sizeof(command) - length, ",%08X",
+				   (unsigned int)record[i] | ((unsigned int)record[i + 1] << 8) |
+				   ((unsigned int)record[i + 2] << 16) | ((unsigned int)record[i + 3] << 24));
+	}
+	snprintf(command + length, sizeof(command) - length, "*");
+
+	I2CGPSWrite(command);
+}
+
+/**
+ * @brief Internal function that sends the EPO set covering a time.
+ * @details The sets of the file are #GNSS_ASSIST_EPO_SATELLITES records of
+ *	    #GNSS_ASSIST_EPO_RECORD bytes, the first three bytes of each the GPS hour the set
+ *	    starts at, little endian. A set is used for #GNSS_ASSIST_EPO_HOURS from then.
+ * @return The satellites sent, 0 if no set covers the time.
+**/
+int GnssAssistSendEpo(char * fileName, long long utc)
+{
+	uint8_t set[GNSS_ASSIST_EPO_SATELLITES * GNSS_ASSIST_EPO_RECORD];
+	uint8_t * record;
+	long long hour = (utc - GNSS_ASSIST_GPS_EPOCH + GNSS_ASSIST_LEAP_SECONDS) / 3600;
+	long long start;
+	FILE * file;
+	int sent = 0;
+	int i, j;
+
+	file = fopen(fileName, "rb");
+	if (NULL == file) {
+		return 0;
+	}
+
+	while (sizeof(set) == fread(set, 1, sizeof(set), file)) {
+		start = set[0] | (set[1] << 8) | (set[2] << 16);
+		if (hour < start || hour >= start + GNSS_ASSIST_EPO_HOURS) {
+			continue;
+		}
+
+		// a satellite without a prediction is all zero past the hour
+		for (i = 0; i < GNSS_ASSIST_EPO_SATELLITES; i++) {
+			record = &set[i * GNSS_ASSIST_EPO_RECORD];
+			for (j = 3; j < GNSS_ASSIST_EPO_RECORD && 0 == record[j]; j++);
+			if (j < GNSS_ASSIST_EPO_RECORD) {
+				GnssAssistSendEpoRecord(i + 1, record);
+				sent++;
+			}
+		}
+		break;
+	}
+
+	fclose(file);
+	return sent;
+}
+
+int GnssAssistInject(GnssAssistState * state, char * epoFile, long long utcNs, GnssAssistReport * report)
+{
+	char command[128];
+	long long utc = utcNs / 1000000000LL;
+	time_t now = (time_t)utc;
+	struct tm date;
+
+	memset(report, 0, sizeof(GnssAssistReport));
+	report->age = (state->valid)?(utc - state->utc):(-1);
+
+	// everything else is placed by the time
+	if (!state->valid) {
+		snprintf(report->reason, sizeof(report->reason), "no state");
+		return 0;
+	} else if (!state->clockAgreed) {
+		snprintf(report->reason, sizeof(report->reason), "clock disagreed with the last fix");
+		return 0;
+	} else if (report->age < 0) {
+		snprintf(report->reason, sizeof(report->reason), "clock behind the last fix");
+		return 0;
+	}
+
+	// the orbits before the time and position they are used with
+	if (NULL != epoFile) {
+		report->epoSatellites = GnssAssistSendEpo(epoFile, utc);
+		report->flags |= (report->epoSatellites > 0)?(GNSS_ASSIST_EPO):(0);
+	}
+
+	gmtime_r(&now, &date);
+
+	if (report->age <= GNSS_ASSIST_MAX_AGE_S) {
+		snprintf(command, sizeof(command), "$PMTK741,%.6f,%.6f,%d,%04d,%02d,%02d,%02d,%02d,%02d*",
+			 state->latitude, state->longitude, (int)state->altitude,
+			 date.tm_year + 1900, date.tm_mon + 1, date.tm_mday, date.tm_hour, date.tm_min, date.tm_sec);
+		report->flags |= GNSS_ASSIST_TIME | GNSS_ASSIST_POSITION;
+	} else {
+		snprintf(command, sizeof(command), "$PMTK740,%04d,%02d,%02d,%02d,%02d,%02d*",
+			 date.tm_year + 1900, date.tm_mon + 1, date.tm_mday, date.tm_hour, date.tm_min, date.tm_sec);
+		report->flags |= GNSS_ASSIST_TIME;
+	}
+	I2CGPSWrite(command);
+
+	return report->flags;
+}
+
+int GnssAssistRecordTtff(char * fileName, long long utcNs, long long ttffNs, int flags)
+{
+	FILE * file;
+
+	file = fopen(fileName, "a");
+	if (NULL == file) {
+		printf("error writing %s\n", fileName);
+		return -1;
+	}
+
+	fprintf(file, "%lld %lld %d\n", utcNs / 1000000000LL, ttffNs / 1000000LL, flags);
+	fclose(file);
+
+	return 0;
+}
+
+void GnssAssistFlagNames(int flags, char * names, int size)
+{
+	snprintf(names, size, "%s%s%s%s", (flags & GNSS_ASSIST_TIME)?("time "):(""),
+		 (flags & GNSS_ASSIST_POSITION)?("position "):(""), (flags & GNSS_ASSIST_EPO)?("epo "):(""),
+		 (0 == flags)?("none"):(""));
+
+	// no trailing space
+	if (flags && strlen(names) > 0) {
+		names[strlen(names) - 1] = '\0';
+	}
+}
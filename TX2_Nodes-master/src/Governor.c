@@ -0,0 +1,285 @@
+/**
+ * @file Governor.c
+ * @brief Function definitions for the Governor library.
+ * @details Function definitions for the Governor library.
+**/
+
+#include "../include/Governor.h"
+#include "../include/LatLonTrig.h"
+
+#define GOVERNOR_SPEED_WINDOW 5000000000LL	/**< Ns without a move past the accuracy counted as stopped. */
+#define GOVERNOR_SPEED_WEIGHT 0.5		/**< Weight of a new speed in the estimate. */
+
+/**
+ * @brief Names of the #GovernorReason values, for logging.
+**/
+char * governorReasonNames[GovernorReasons] = { "idle", "speed", "obstacle", "turn", "off" };
+
+/**
+ * @brief Internal function that opens the temp file of every thermal zone but those that are not real temperatures.
+**/
+void GovernorOpenZones(Governor * governor)
+{
+	char * directory = getenv(GOVERNOR_THERMAL_ENV);
+	char path[512];
+	char type[64];
+	struct dirent * entry;
+	DIR * zones;
+	int length;
+	int fd;
+
+	directory = (NULL == directory)?(GOVERNOR_THERMAL_DIR):(directory);
+	zones = opendir(directory);
+	if (NULL == zones) {
+		return;
+	}
+
+	while (NULL != (entry = readdir(zones)) && governor->zoneCount < GOVERNOR_MAX_ZONES) {
+		if (0 != strncmp(entry->d_name, "thermal_zone", 12)) {
+			continue;
+		}
+
+		// the TX2's PMIC-Die zone always reads 100 C
+		snprintf(path, sizeof(path), "%s/%s/type", directory, entry->d_name);
+		fd = open(path, O_RDONLY);
+		length = (fd < 0)?(0):(read(fd, type, sizeof(type) - 1));
+		type[(length > 0)?(length):(0)] = '\0';
+		if (fd >= 0) {
+			close(fd);
+		}
+		if (NULL != strstr(type, "PMIC")) {
+			continue;
+		}
+
+		snprintf(path, sizeof(path), "%s/%s/temp", directory, entry->d_name);
+		fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd >= 0) {
+			governor->zones[governor->zoneCount++] = fd;
+		}
+	}
+
+	closedir(zones);
+}
+
+/**
+ * @brief Internal function that reads the hottest thermal zone.
+ * @return Degrees C, 0 if none could be read.
+**/
+float GovernorReadTemperature(Governor * governor)
+{
+	char value[32];
+	float hottest = 0.0;
+	float temperature;
+	int length;
+	int i;
+
+	for (i = 0; i < governor->zoneCount; i++) {
+		length = pread(governor->zones[i], value, sizeof(value) - 1, 0);
+		if (length <= 0) {
+			continue;
+		}
+		value[length] = '\0';
+
+		// millidegrees
+		temperature = atoi(value) / 1000.0;
+		hottest = (temperature > hottest)?(temperature):(hottest);
+	}
+
+	return hottest;
+}
+
+/**
+ * @brief Internal function that holds the rate below the thermal cap.
+ * @return The rate asked for.
+**/
+float GovernorThermalCap(Governor * governor, float wanted, long long now)
+{
+	GovernorState * state = &governor->state;
+	float cap;
+
+	if (now >= governor->nextThermal) {
+		governor->nextThermal = now + GOVERNOR_THERMAL_NS;
+		state->temperature = GovernorReadTemperature(governor);
+		if (state->temperature > governor->stats.maxTemperature) {
+			governor->stats.maxTemperature = state->temperature;
+		}
+	}
+
+	if (state->temperature >= governor->throttleC && !state->throttled) {
+		state->throttled = 1;
+		state->throttleEvents++;
+		governor->stats.throttleEvents++;
+		printf("GOVERNOR: %.1f C, THROTTLING, EVENT %lu\n", state->temperature, state->throttleEvents);
+	} else if (state->temperature < governor->throttleC - GOVERNOR_HYSTERESIS && state->throttled) {
+		state->throttled = 0;
+		printf("GOVERNOR: %.1f C, THROTTLING OVER\n", state->temperature);
+	}
+
+	if (!state->throttled) {
+		return wanted;
+	}
+
+	// from maxHz at throttleC down to minHz at criticalC
+	if (governor->criticalC <= governor->throttleC || state->temperature >= governor->criticalC) {
+		cap = governor->minHz;
+	} else {
+		cap = governor->maxHz - (governor->maxHz - governor->minHz) *
+		      (state->temperature - governor->throttleC) / (governor->criticalC - governor->throttleC);
+		cap = (cap > governor->maxHz)?(governor->maxHz):(cap);
+	}
+
+	return (wanted < cap)?(wanted):(cap);
+}
+
+int GovernorInit(Governor * governor, long long now)
+{
+	memset(governor, 0, sizeof(Governor));
+	governor->nextThermal = now;
+	governor->state.nearest = -1.0;
+
+	GovernorOpenZones(governor);
+
+	return governor->zoneCount;
+}
+
+void GovernorSetLimits(Governor * governor, float minHz, float maxHz, float metersPerMask, float speed,
+		       int throttleC, int criticalC, int moveMs)
+{
+	governor->minHz = minHz;
+	governor->maxHz = (maxHz < minHz)?(minHz):(maxHz);
+	governor->metersPerMask = metersPerMask;
+	governor->speed = speed;
+	governor->throttleC = throttleC;
+	governor->criticalC = criticalC;
+	governor->moveMs = moveMs;
+}
+
+void GovernorFeedPosition(Governor * governor, Position position, float accuracy, long long now)
+{
+	float distance;
+	float speed;
+
+	if (0 == governor->lastPositionTime) {
+		memcpy(&governor->lastPosition, &position, sizeof(Position));
+		governor->lastPositionTime = now;
+		return;
+	}
+
+	// the noise of a fix is no move, a speed is only taken once past it or after a while
+	distance = Distance(governor->lastPosition, position);
+	if (distance <= accuracy && now - governor->lastPositionTime < GOVERNOR_SPEED_WINDOW) {
+		return;
+	}
+
+	speed = (distance <= accuracy)?(0.0):(distance * 1000000000.0 / (now - governor->lastPositionTime));
+	governor->estimate += GOVERNOR_SPEED_WEIGHT * (speed - governor->estimate);
+	memcpy(&governor->lastPosition, &position, sizeof(Position));
+	governor->lastPositionTime = now;
+}
+
+long long GovernorUpdate(Governor * governor, GovernorMotion motion, float nearest, long long now)
+{
+	GovernorState * state = &governor->state;
+	float speed = (governor->speed > 0.0)?(governor->speed):(governor->estimate);
+	float obstacleHz;
+
+	state->time = now;
+	state->nearest = nearest;
+	state->speed = (GovernorForward == motion)?(speed):(0.0);
+
+	if (0.0 == governor->metersPerMask) {
+		state->wanted = governor->maxHz;
+		state->reason = GovernorOff;
+	} else if (GovernorTurning == motion) {
+		state->wanted = governor->maxHz;
+		state->reason = GovernorTurn;
+	} else if (GovernorStill == motion || state->speed < GOVERNOR_STOPPED) {
+		state->wanted = governor->minHz;
+		state->reason = GovernorIdle;
+	} else {
+		state->wanted = state->speed / governor->metersPerMask;
+		state->reason = GovernorSpeed;
+		obstacleHz = (nearest > 0.0)?(GOVERNOR_OBSTACLE_MASKS * state->speed / nearest):(0.0);
+		if (obstacleHz > state->wanted) {
+			state->wanted = obstacleHz;
+			state->reason = GovernorObstacle;
+		}
+		state->wanted = (state->wanted < governor->minHz)?(governor->minHz):(state->wanted);
+		state->wanted = (state->wanted > governor->maxHz)?(governor->maxHz):(state->wanted);
+	}
+
+	state->rate = GovernorThermalCap(governor, state->wanted, now);
+
+	governor->stats.updates++;
+	governor->stats.reasons[state->reason]++;
+	governor->stats.throttled += (state->rate < state->wanted);
+	governor->stats.rateSum += state->rate;
+
+	// off and not held down, as fast as the camera goes
+	if (GovernorOff == state->reason && state->rate >= state->wanted) {
+		return 0;
+	}
+
+	return (long long)(1000000000.0 / state->rate);
+}
+
+int GovernorForwardCount(Governor * governor)
+{
+	int count;
+
+	if (GovernorOff == governor->state.reason || governor->state.wanted <= 0.0 || governor->moveMs <= 0) {
+		return 1;
+	}
+
+	// enough to drive until the mask after the next one is asked for
+	count = (int)(1000.0 / (governor->state.wanted * governor->moveMs) + 0.5);
+
+	return (count < 1)?(1):(count);
+}
+
+char * GovernorReasonName(int reason)
+{
+	return (reason >= 0 && reason < GovernorReasons)?(governorReasonNames[reason]):("unknown");
+}
+
+void GovernorGetStats(Governor * governor, GovernorStats * stats)
+{
+	memcpy(stats, &governor->stats, sizeof(GovernorStats));
+}
+
+void GovernorClose(Governor * governor)
+{
+	int i;
+
+	for (i = 0; i < governor->zoneCount; i++) {
+		close(governor->zones[i]);
+	}
+	governor->zoneCount = 0;
+}
+
+void PublishGovernor(GovernorShared * shared, GovernorState * state)
+{
+	// odd while writing
+	shared->sequence++;
+	__sync_synchronize();
+	memcpy(&shared->state, state, sizeof(GovernorState));
+	__sync_synchronize();
+	shared->sequence++;
+}
+
+int GetGovernor(GovernorShared * shared, GovernorState * state)
+{
+	unsigned int sequence;
+
+	do {
+		sequence = shared->sequence;
+		if (0 == sequence) {
+			return -1;
+		}
+		__sync_synchronize();
+		memcpy(state, &shared->state, sizeof(GovernorState));
+		__sync_synchronize();
+	} while ((sequence & 1) || sequence != shared->sequence);
+
+	return 0;
+}
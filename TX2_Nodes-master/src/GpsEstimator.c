@@ -0,0 +1,272 @@
+/**
+ * @file GpsEstimator.c
+ * @brief Function definitions for the GpsEstimator library.
+ * @details Function definitions for the GpsEstimator library.
+**/
+
+#include "../include/GpsEstimator.h"
+
+/**
+ * @brief Meters per degree of latitude, same earth radius as LatLonTrig.h.
+**/
+#define METERS_PER_DEGREE 111194.93
+
+/**
+ * @brief Used to index the estimator window newest first, i = 0 is the newest fix.
+**/
+#define WINDOW_INDEX(e, i) (((e)->head - 1 - (i) + GPS_ESTIMATOR_WINDOW) % GPS_ESTIMATOR_WINDOW)
+
+void AddPosition(Positions * positions, Position * p1)
+{
+	// add position at current location of head
+	positions->position[positions->head].latitude = p1->latitude;
+	positions->position[positions->head].longitude = p1->longitude;
+
+	// increment head, ring buffer fashion
+	positions->head = (positions->head + 1) % GPS_AVERAGE_COUNT;
+
+	// only increment count until we have all locations filled
+	if (positions->positionCount < GPS_AVERAGE_COUNT) {
+		positions->positionCount++;
+	}
+}
+
+void GetPositionAverage(Positions * positions, Position * average)
+{
+	int i;
+
+	// zero out average
+	memset(average, 0, sizeof(Position));
+
+	// accumulate
+	for (i = 0; i < GPS_AVERAGE_COUNT; i++) {
+		average->latitude += positions->position[i].latitude;
+		average->longitude += positions->position[i].longitude;
+	}
+
+	// calculate average
+	average->latitude /= GPS_AVERAGE_COUNT;
+	average->longitude /= GPS_AVERAGE_COUNT;
+}
+
+void InitEstimator(GpsEstimator * estimator)
+{
+	memset(estimator, 0, sizeof(GpsEstimator));
+}
+
+/**
+ * @brief Internal function that returns the 1 sigma error of a fix in meters.
+**/
+double FixSigma(GpsMsg * fix)
+{
+	double sigma;
+
+	sigma = GPS_UERE * ((fix->hdop > 0.0f)?(fix->hdop):(GPS_DEFAULT_HDOP));
+
+	// differential corrections are applied
+	if (2 == fix->fixQuality) {
+		sigma *= GPS_DGPS_FACTOR;
+	}
+
+	// geometry is poor with few satellites, whatever the HDOP says
+	if (fix->satellites > 0 && fix->satellites < GPS_FEW_SATELLITES) {
+		sigma *= 2.0;
+	}
+
+	return sigma;
+}
+
+/**
+ * @brief Internal function that returns the median of up to #GPS_ESTIMATOR_WINDOW values.
+**/
+double Median(double * values, int count)
+{
+	int i, j;
+	double temp;
+
+	// insertion sort, count is small
+	for (i = 1; i < count; i++) {
+		temp = values[i];
+		for (j = i - 1; j >= 0 && values[j] > temp; j--) {
+			values[j + 1] = values[j];
+		}
+		values[j + 1] = temp;
+	}
+
+	if (count % 2) {
+		return values[count / 2];
+	}
+	return (values[(count / 2) - 1] + values[count / 2]) / 2.0;
+}
+
+/**
+ * @brief Internal function that returns the seconds between two UTC ms-since-midnight times.
+**/
+double SecondsBetween(unsigned int earlier, unsigned int later)
+{
+	long delta = (long)later - (long)earlier;
+
+	// across midnight
+	if (delta < -43200000L) {
+		delta += 86400000L;
+	}
+
+	return delta / 1000.0;
+}
+
+/**
+ * @brief Internal function used to restart the window with a single fix.
+**/
+void RestartWindow(GpsEstimator * estimator, EstimatorFix * fix)
+{
+	estimator->fixes[0] = *fix;
+	estimator->head = 1;
+	estimator->count = 1;
+	estimator->rejects = 0;
+}
+
+int UpdateEstimator(GpsEstimator * estimator, GpsMsg * fix, PositionEstimate * estimate)
+{
+	EstimatorFix newFix;
+	double east[GPS_ESTIMATOR_WINDOW];
+	double north[GPS_ESTIMATOR_WINDOW];
+	double medianEast, medianNorth, medianSigma;
+	double interval, speed, distance, gate, courseChange;
+	double weight, weightSum, eastSum, northSum, scatter;
+	double step, error, best;
+	int window;
+	int restarted = 0;
+	int i, index;
+
+	// the first fix defines the local east/north plane
+	if (!estimator->referenceSet) {
+		estimator->referenceLatitude = fix->position.latitude;
+		estimator->referenceLongitude = fix->position.longitude;
+		estimator->metersPerDegreeLon = METERS_PER_DEGREE * cos(fix->position.latitude * (M_PI / 180.0));
+		estimator->referenceSet = 1;
+	}
+
+	newFix.east = (fix->position.longitude - estimator->referenceLongitude) * estimator->metersPerDegreeLon;
+	newFix.north = (fix->position.latitude - estimator->referenceLatitude) * METERS_PER_DEGREE;
+	newFix.sigma = FixSigma(fix);
+	newFix.time = fix->time;
+
+	// time between fixes, assume 1 Hz if we can't tell
+	interval = (estimator->count)?(SecondsBetween(estimator->lastTime, fix->time)):(1.0);
+	if (interval <= 0.0 || interval > 10.0) {
+		interval = 1.0;
+	}
+
+	speed = (fix->velocity > GPS_MIN_COURSE_SPEED)?(fix->velocity):(0.0);
+
+	// fixes from before a turn describe a different line, drop them
+	if (speed > 0.0) {
+		if (estimator->courseValid) {
+			courseChange = fabs(fix->heading - estimator->lastCourse);
+			if (courseChange > 180.0) {
+				courseChange = 360.0 - courseChange;
+			}
+			if (courseChange > GPS_TURN_RESET) {
+				estimator->count = 0;
+			}
+		}
+		estimator->lastCourse = fix->heading;
+		estimator->courseValid = 1;
+	}
+
+	// gate against the median of the window
+	if (estimator->count >= 3) {
+		medianSigma = 0.0;
+		for (i = 0; i < estimator->count; i++) {
+			index = WINDOW_INDEX(estimator, i);
+			east[i] = estimator->fixes[index].east;
+			north[i] = estimator->fixes[index].north;
+			medianSigma += estimator->fixes[index].sigma;
+		}
+		medianEast = Median(east, estimator->count);
+		medianNorth = Median(north, estimator->count);
+		medianSigma = (medianSigma / estimator->count) / sqrt(estimator->count);
+
+		distance = sqrt(((newFix.east - medianEast) * (newFix.east - medianEast)) +
+				((newFix.north - medianNorth) * (newFix.north - medianNorth)));
+
+		// the median lags the rover by about half the window
+		gate = (GPS_GATE_SIGMAS * sqrt((newFix.sigma * newFix.sigma) + (medianSigma * medianSigma))) +
+		       (speed * interval * (estimator->count + 1) / 2.0);
+
+		if (distance > gate) {
+			estimator->rejected++;
+			if (++estimator->rejects < GPS_MAX_REJECTS) {
+				return 0;
+			}
+			// the window is what's wrong, start over from here
+			RestartWindow(estimator, &newFix);
+			restarted = 1;
+		}
+	}
+
+	// add the fix, unless the window was just restarted with it
+	if (!restarted) {
+		estimator->fixes[estimator->head] = newFix;
+		estimator->head = (estimator->head + 1) % GPS_ESTIMATOR_WINDOW;
+		if (estimator->count < GPS_ESTIMATOR_WINDOW) {
+			estimator->count++;
+		}
+	}
+	estimator->rejects = 0;
+	estimator->lastTime = fix->time;
+	estimator->accepted++;
+
+	// pick the window that balances the noise of the average (sigma^2 / n) against the
+	// square of its lag behind the rover (half the window times the distance per fix)
+	window = GPS_ESTIMATOR_WINDOW;
+	if (speed > 0.0) {
+		step = speed * interval;
+		best = newFix.sigma * newFix.sigma;
+		window = 1;
+		for (i = 2; i <= GPS_ESTIMATOR_WINDOW; i++) {
+			error = ((newFix.sigma * newFix.sigma) / i) + (((i - 1) * step / 2.0) * ((i - 1) * step / 2.0));
+			if (error < best) {
+				best = error;
+				window = i;
+			}
+		}
+	}
+	if (estimator->count > window) {
+		estimator->count = window;
+	}
+
+	// inverse variance weighted mean
+	weightSum = eastSum = northSum = 0.0;
+	for (i = 0; i < estimator->count; i++) {
+		index = WINDOW_INDEX(estimator, i);
+		weight = 1.0 / (estimator->fixes[index].sigma * estimator->fixes[index].sigma);
+		weightSum += weight;
+		eastSum += weight * estimator->fixes[index].east;
+		northSum += weight * estimator->fixes[index].north;
+	}
+	eastSum /= weightSum;
+	northSum /= weightSum;
+
+	// if the fixes scatter more than their sigmas claim, trust the scatter
+	scatter = 0.0;
+	for (i = 0; i < estimator->count; i++) {
+		index = WINDOW_INDEX(estimator, i);
+		weight = 1.0 / (estimator->fixes[index].sigma * estimator->fixes[index].sigma);
+		scatter += weight * (((estimator->fixes[index].east - eastSum) * (estimator->fixes[index].east - eastSum)) +
+				     ((estimator->fixes[index].north - northSum) * (estimator->fixes[index].north - northSum)));
+	}
+	scatter = (scatter / weightSum) / estimator->count;
+
+	estimate->position.latitude = estimator->referenceLatitude + (northSum / METERS_PER_DEGREE);
+	estimate->position.longitude = estimator->referenceLongitude + (eastSum / estimator->metersPerDegreeLon);
+	estimate->accuracy = sqrt(((1.0 / weightSum) > scatter)?(1.0 / weightSum):(scatter));
+	estimate->hdop = fix->hdop;
+	estimate->satellites = fix->satellites;
+	estimate->fixesUsed = estimator->count;
+	estimate->time = fix->time;
+	estimate->fixQuality = fix->fixQuality;
+	estimate->correctionAge = fix->correctionAge;
+
+	return 1;
+}
@@ -0,0 +1,150 @@
+/**
+ * @file Hal.c
+ * @brief Function definitions for the Hal library.
+ * @details Function definitions for the Hal library.
+**/
+
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "../include/Hal.h"
+#include "../include/Parameters.h"
+#include "../include/SharedMem.h"
+#include "../include/I2CBus.h"
+#include "../include/I2CMock.h"
+#include "../include/Simulation.h"
+
+// backend names, from the parameter table in Parameters.c
+extern char * canBackendNames[];
+extern char * i2cBackendNames[];
+extern char * cameraBackendNames[];
+extern char * clockBackendNames[];
+
+/**
+ * @brief The backends in use, all zero is the rover's hardware.
+**/
+HalConfig halConfig;
+
+/**
+ * @brief The parameters the backends were read from.
+**/
+Parameters halParameters;
+
+/**
+ * @brief Internal function that copies the parameters master has published.
+ * @details The shared memory is mapped read only and unmapped again, rather than opened with
+ *	    SharedMem.c, so a node that opens #ParameterData itself still has its own descriptor.
+ * @return 0 on success, -1 if master has not published any.
+**/
+int HalPublishedParameters(Parameters * parameters)
+{
+	ParameterSnapshot snapshot;
+	size_t size = sizeof(SharedMem) + sizeof(ParametersShared);
+	SharedMem * sharedMem;
+	int status;
+	int fd;
+
+	fd = shm_open(SHARED_PARAM_NAME, O_RDONLY, 0);
+	if (fd < 0) {
+		return -1;
+	}
+
+	sharedMem = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (MAP_FAILED == sharedMem) {
+		return -1;
+	}
+
+	status = GetParameterSnapshot((ParametersShared *)(sharedMem + 1), &snapshot);
+	munmap(sharedMem, size);
+
+	if (status < 0) {
+		return -1;
+	}
+
+	memcpy(parameters, &snapshot.values, sizeof(Parameters));
+
+	return 0;
+}
+
+int HalInit(HalConfig * config)
+{
+	Parameters parameters;
+	SimShared * sim;
+	int status = 0;
+
+	if (HalPublishedParameters(&parameters) < 0 && GetParameters(PARAMETERS_FILE, &parameters) < 0) {
+		memset(&parameters, 0, sizeof(parameters));
+		status = -1;
+	}
+
+	memcpy(&halParameters, &parameters, sizeof(Parameters));
+	memcpy(&halConfig, &parameters.hal, sizeof(HalConfig));
+
+	switch (halConfig.clock) {
+	case ClockBoottime:
+		ClockUseReal(CLOCK_BOOTTIME);
+		break;
+	case ClockVirtual:
+		ClockUseVirtual(0);
+		break;
+	case ClockSim:
+		sim = SimulationOpen();
+		if (NULL == sim) {
+			printf("roverSim is not running, the clock is CLOCK_MONOTONIC\n");
+		} else if (sim->timeScale > 0) {
+			ClockUseScaled(sim->realEpoch, sim->timeScale);
+		} else {
+			// roverSim.c runs the virtual clock, which the node joined through CLOCK_ENV already
+			ClockUseVirtual(0);
+		}
+		break;
+	default:
+		ClockUseReal(CLOCK_MONOTONIC);
+		break;
+	}
+
+	// I2CBus.c and I2CMock.c are configured through the environment, which wins if already set
+	if (I2CSourceDevice != halConfig.i2c) {
+		setenv(I2C_BACKEND_ENV, "mock", 0);
+	}
+
+	if (I2CSourceReplay == halConfig.i2c) {
+		if (0 == access(HAL_NMEA_REPLAY_FILE, R_OK)) {
+			setenv(MOCK_NMEA_ENV, HAL_NMEA_REPLAY_FILE, 0);
+		} else {
+			printf("no %s to replay, the GPS model gives a fixed position\n", HAL_NMEA_REPLAY_FILE);
+		}
+
+		if (0 == access(HAL_GYRO_REPLAY_FILE, R_OK)) {
+			setenv(MOCK_GYRO_ENV, HAL_GYRO_REPLAY_FILE, 0);
+		} else {
+			printf("no %s to replay, the gyro model stands still\n", HAL_GYRO_REPLAY_FILE);
+		}
+	}
+
+	if (NULL != config) {
+		memcpy(config, &halConfig, sizeof(HalConfig));
+	}
+
+	return status;
+}
+
+HalConfig * HalGetConfig()
+{
+	return &halConfig;
+}
+
+Parameters * HalGetParameters()
+{
+	return &halParameters;
+}
+
+void HalPrintConfig(char * node)
+{
+	printf("%s hardware: CAN %s, I2C %s, camera %s, clock %s\n", node,
+		canBackendNames[halConfig.can], i2cBackendNames[halConfig.i2c],
+		cameraBackendNames[halConfig.camera], clockBackendNames[halConfig.clock]);
+}
@@ -0,0 +1,252 @@
+/**
+ * @file Heading.c
+ * @brief Function definitions for the Heading library.
+ * @details Function definitions for the Heading library.
+**/
+
+#include "../include/Heading.h"
+#include "../include/Clock.h"
+
+#define NS_TO_SEC(x) ((x) / 1000000000.0) // convert ns to seconds
+#define SEC_TO_NS(x) ((long long)((x) * 1000000000.0)) // convert seconds to ns
+
+long long HeadingNowNs()
+{
+	return ClockNowNs();
+}
+
+void InitHeading(HeadingIntegrator * integrator)
+{
+	memset(integrator, 0, sizeof(HeadingIntegrator));
+}
+
+void IntegrateHeading(HeadingIntegrator * integrator, GyroSample * sample, HeadingSample * out)
+{
+	double dt;
+	double rate;
+	double accel;
+	double alpha;
+
+	// time covered by this sample, a gap left by a FIFO overrun is covered by it as well
+	dt = (integrator->lastTime)?(NS_TO_SEC(sample->time - integrator->lastTime)):(1.0 / GYRO_ODR_HZ);
+	if (dt <= 0.0) {
+		dt = 1.0 / GYRO_ODR_HZ;
+	}
+	integrator->lastTime = sample->time;
+
+	accel = sqrt((sample->accel[0] * sample->accel[0]) +
+		     (sample->accel[1] * sample->accel[1]) +
+		     (sample->accel[2] * sample->accel[2]));
+	if (0.0 == integrator->accelAverage) {
+		integrator->accelAverage = accel;
+	}
+	integrator->accelAverage += (accel - integrator->accelAverage) * (dt / HEADING_STILL_TIME);
+
+	rate = sample->rate[2] - integrator->bias;
+
+	// the rover looks still as long as the rate and acceleration are steady
+	if (fabs(rate) < HEADING_STILL_RATE && fabs(accel - integrator->accelAverage) < HEADING_STILL_ACCEL) {
+		integrator->stillTime += dt;
+	} else {
+		integrator->stillTime = 0.0;
+	}
+
+	// learn the bias, average the first samples then follow it slowly
+	if (integrator->stillTime >= HEADING_STILL_TIME) {
+		integrator->biasSamples++;
+		alpha = dt / HEADING_BIAS_TAU;
+		if (alpha < 1.0 / integrator->biasSamples) {
+			alpha = 1.0 / integrator->biasSamples;
+		}
+		integrator->bias += (sample->rate[2] - integrator->bias) * alpha;
+		rate = sample->rate[2] - integrator->bias;
+	}
+
+	integrator->heading += rate * dt;
+
+	out->time = sample->time;
+	out->heading = integrator->heading;
+	out->rate = rate;
+	out->bias = integrator->bias;
+}
+
+void PublishHeading(HeadingShared * shared, HeadingSample * sample)
+{
+	memcpy(&shared->history[shared->count % HEADING_HISTORY], sample, sizeof(HeadingSample));
+
+	// the sample must be in place before it is counted
+	__sync_synchronize();
+	shared->count++;
+}
+
+/**
+ * @brief Internal function that copies sample n out of the history.
+ * @return 0 on success, -1 if sample n has not been published or has been overwritten.
+**/
+int ReadSample(HeadingShared * shared, unsigned long long n, HeadingSample * sample)
+{
+	if (n >= shared->count) {
+		return -1;
+	}
+
+	__sync_synchronize();
+	memcpy(sample, &shared->history[n % HEADING_HISTORY], sizeof(HeadingSample));
+	__sync_synchronize();
+
+	// the writer may have wrapped around onto this slot while it was copied
+	if (shared->count - n >= HEADING_HISTORY) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Internal function that returns the index of the oldest sample safe to read.
+**/
+unsigned long long OldestSample(unsigned long long count)
+{
+	// leave a slot for the writer
+	return (count >= HEADING_HISTORY)?(count - HEADING_HISTORY + 1):(0);
+}
+
+int GetLatestHeading(HeadingShared * shared, HeadingSample * sample)
+{
+	unsigned long long count = shared->count;
+
+	if (0 == count) {
+		return -1;
+	}
+
+	return ReadSample(shared, count - 1, sample);
+}
+
+int HeadingAt(HeadingShared * shared, long long time, double * heading)
+{
+	HeadingSample before, after;
+	unsigned long long count = shared->count;
+	unsigned long long low, high, middle;
+
+	if (0 == count) {
+		return -1;
+	}
+
+	// newer than anything published
+	if (ReadSample(shared, count - 1, &after) < 0) {
+		return -1;
+	}
+	if (time >= after.time) {
+		*heading = after.heading;
+		return 0;
+	}
+
+	low = OldestSample(count);
+	if (ReadSample(shared, low, &before) < 0 || time < before.time) {
+		return -1;
+	}
+
+	// find the last sample at or before time
+	high = count - 1;
+	while (high - low > 1) {
+		middle = low + ((high - low) / 2);
+		if (ReadSample(shared, middle, &before) < 0) {
+			return -1;
+		}
+		if (before.time <= time) {
+			low = middle;
+		} else {
+			high = middle;
+		}
+	}
+
+	if (ReadSample(shared, low, &before) < 0 || ReadSample(shared, high, &after) < 0) {
+		return -1;
+	}
+
+	// interpolate between the two
+	if (after.time > before.time) {
+		*heading = before.heading + ((after.heading - before.heading) *
+			   ((double)(time - before.time) / (double)(after.time - before.time)));
+	} else {
+		*heading = before.heading;
+	}
+
+	return 0;
+}
+
+int AngleSince(HeadingShared * shared, long long since, double * angle)
+{
+	HeadingSample latest;
+	double start;
+
+	if (GetLatestHeading(shared, &latest) < 0 || HeadingAt(shared, since, &start) < 0) {
+		return -1;
+	}
+
+	*angle = latest.heading - start;
+
+	return 0;
+}
+
+int MeasureTurn(HeadingShared * shared, long long since, float * angle)
+{
+	HeadingSample sample;
+	unsigned long long next;
+	long long turnStart = 0;
+	long long lastFast = 0;
+	int turning = 0;
+	double start = 0.0;
+	double change;
+
+	*angle = 0.0f;
+
+	// start from the first sample after since
+	next = OldestSample(shared->count);
+
+	while (1) {
+		// the loop has fallen behind the history, skip ahead
+		if (next < OldestSample(shared->count)) {
+			next = OldestSample(shared->count);
+		}
+
+		while (0 == ReadSample(shared, next, &sample)) {
+			next++;
+
+			if (sample.time < since) {
+				start = sample.heading;
+				continue;
+			}
+
+			if (!turning) {
+				if (sample.rate > TURN_START_RATE || sample.rate < -TURN_START_RATE) {
+					turning = 1;
+					turnStart = lastFast = sample.time;
+				}
+			} else if (sample.rate > TURN_RATE || sample.rate < -TURN_RATE) {
+				lastFast = sample.time;
+			} else if (NS_TO_SEC(sample.time - lastFast) >= TURN_SETTLE_TIME) {
+				if (NS_TO_SEC(lastFast - turnStart) >= TURN_MIN_TIME) {
+					// the turn is over
+					if (AngleSince(shared, since, &change) < 0) {
+						change = sample.heading - start;
+					}
+					*angle = change;
+					return 0;
+				}
+				// too short to be a turn
+				turning = 0;
+			}
+		}
+
+		// no turn, or the samples stopped coming mid turn. Wall time so a stopped gyro
+		// node can't hang the caller
+		if (HeadingNowNs() - ((turning)?(lastFast):(since)) > SEC_TO_NS(TURN_IDLE_TIMEOUT)) {
+			if (0 == AngleSince(shared, since, &change)) {
+				*angle = change;
+			}
+			return -1;
+		}
+
+		ClockSleep(TURN_POLL_NS);
+	}
+}
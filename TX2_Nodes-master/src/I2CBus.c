@@ -0,0 +1,273 @@
+/**
+ * @file I2CBus.c
+ * @brief Function definitions for the I2CBus library.
+ * @details Function definitions for the I2CBus library.
+**/
+
+#include "../include/I2CBus.h"
+#include "../include/I2CMock.h"
+#include "../include/Clock.h"
+
+/**
+ * @brief Internal function that returns the time in nanoseconds, see #ClockNowNs().
+**/
+long long I2CNowNs()
+{
+	return ClockNowNs();
+}
+
+/**
+ * @brief Internal function that decides whether a failed transaction is worth another attempt.
+**/
+int I2CRetryable(int error)
+{
+	switch (error) {
+		case EAGAIN:		// arbitration lost
+		case EIO:
+		case ENXIO:		// NACK, the XA1110 does this while busy
+		case EREMOTEIO:		// NACK on some adapters
+		case ETIMEDOUT:
+		case EBUSY:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+int I2COpen(I2CDevice * device, char * bus, int address, char * name)
+{
+	char * backend = getenv(I2C_BACKEND_ENV);
+
+	memset(device, 0, sizeof(I2CDevice));
+	strncpy(device->name, name, sizeof(device->name) - 1);
+	device->address = address;
+	device->fd = -1;
+	device->policy.attempts = I2C_DEFAULT_ATTEMPTS;
+	device->policy.backoffUs = I2C_DEFAULT_BACKOFF_US;
+	device->policy.maxBackoffUs = I2C_DEFAULT_MAX_BACKOFF_US;
+
+	// no hardware, use a model of the chip
+	if (NULL != backend && 0 == strcmp(backend, "mock")) {
+		device->backend = I2CBackendMock;
+		device->mock = I2CMockOpen(name, address);
+		if (NULL == device->mock) {
+			printf("no I2C mock model for %s\n", name);
+			return -1;
+		}
+		return 0;
+	}
+
+	device->backend = I2CBackendDevice;
+	device->fd = open(bus, O_RDWR);
+
+	if (device->fd < 0) {
+		printf("error opening %s for %s\n", bus, name);
+		return -1;
+	}
+
+	// the address is given with each message, this is only for plain read/write users
+	if (ioctl(device->fd, I2C_SLAVE, address) < 0) {
+		printf("error setting i2c address for %s\n", name);
+		close(device->fd);
+		device->fd = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+void I2CClose(I2CDevice * device)
+{
+	if (I2CBackendMock == device->backend) {
+		I2CMockClose(device->mock);
+		device->mock = NULL;
+	} else if (device->fd >= 0) {
+		close(device->fd);
+		device->fd = -1;
+	}
+}
+
+void I2CSetRetryPolicy(I2CDevice * device, I2CRetryPolicy * policy)
+{
+	memcpy(&device->policy, policy, sizeof(I2CRetryPolicy));
+}
+
+void I2CBegin(I2CTransaction * transaction)
+{
+	transaction->count = 0;
+}
+
+int I2CAddWrite(I2CTransaction * transaction, I2CDevice * device, void * data, int length)
+{
+	struct i2c_msg * msg;
+
+	if (transaction->count >= I2C_MAX_MESSAGES || length > I2C_MAX_WRITE) {
+		return -1;
+	}
+
+	memcpy(transaction->writeData[transaction->count], data, length);
+
+	msg = &transaction->msgs[transaction->count];
+	msg->addr = device->address;
+	msg->flags = 0;
+	msg->len = length;
+	msg->buf = transaction->writeData[transaction->count];
+
+	transaction->count++;
+	return 0;
+}
+
+int I2CAddRead(I2CTransaction * transaction, I2CDevice * device, void * buffer, int length)
+{
+	struct i2c_msg * msg;
+
+	if (transaction->count >= I2C_MAX_MESSAGES) {
+		return -1;
+	}
+
+	msg = &transaction->msgs[transaction->count];
+	msg->addr = device->address;
+	msg->flags = I2C_M_RD;
+	msg->len = length;
+	msg->buf = buffer;
+
+	transaction->count++;
+	return 0;
+}
+
+int I2CTransfer(I2CDevice * device, I2CTransaction * transaction)
+{
+	struct i2c_rdwr_ioctl_data data = { .msgs = transaction->msgs, .nmsgs = transaction->count };
+	long backoff = device->policy.backoffUs;
+	long long start, elapsed;
+	int attempt;
+	int status = -1;
+	int i;
+
+	start = I2CNowNs();
+
+	for (attempt = 0; attempt < device->policy.attempts || 0 == attempt; attempt++) {
+		if (attempt > 0) {
+			// transient error, back off and try again
+			device->stats.retries++;
+			ClockSleep(backoff * 1000LL);
+			backoff = (backoff * 2 > device->policy.maxBackoffUs)?(device->policy.maxBackoffUs):(backoff * 2);
+		}
+
+		if (I2CBackendMock == device->backend) {
+			status = I2CMockTransfer(device->mock, transaction->msgs, transaction->count);
+		} else {
+			status = ioctl(device->fd, I2C_RDWR, &data);
+		}
+
+		if (status >= 0 || !I2CRetryable(errno)) {
+			break;
+		}
+	}
+
+	elapsed = I2CNowNs() - start;
+	device->stats.busyNs += elapsed;
+	if (elapsed > device->stats.maxNs) {
+		device->stats.maxNs = elapsed;
+	}
+
+	if (status < 0) {
+		device->stats.failures++;
+		return -1;
+	}
+
+	device->stats.transactions++;
+	device->stats.messages += transaction->count;
+	for (i = 0; i < transaction->count; i++) {
+		if (transaction->msgs[i].flags & I2C_M_RD) {
+			device->stats.bytesRead += transaction->msgs[i].len;
+		} else {
+			device->stats.bytesWritten += transaction->msgs[i].len;
+		}
+	}
+
+	return 0;
+}
+
+int I2CWriteRegister(I2CDevice * device, int registerAddress, unsigned char value)
+{
+	I2CTransaction transaction;
+	unsigned char data[2] = { registerAddress, value };
+
+	I2CBegin(&transaction);
+	I2CAddWrite(&transaction, device, data, 2);
+
+	return I2CTransfer(device, &transaction);
+}
+
+int I2CReadRegisters(I2CDevice * device, int registerAddress, void * buffer, int length)
+{
+	I2CTransaction transaction;
+	unsigned char address = registerAddress;
+
+	// repeated start between the address write and the read
+	I2CBegin(&transaction);
+	I2CAddWrite(&transaction, device, &address, 1);
+	I2CAddRead(&transaction, device, buffer, length);
+
+	if (I2CTransfer(device, &transaction) < 0) {
+		return -1;
+	}
+
+	return length;
+}
+
+int I2CWrite(I2CDevice * device, void * data, int length)
+{
+	I2CTransaction transaction;
+	int sent = 0;
+	int chunk;
+
+	// long writes are split across messages, still one transaction
+	I2CBegin(&transaction);
+	while (sent < length) {
+		chunk = (length - sent > I2C_MAX_WRITE)?(I2C_MAX_WRITE):(length - sent);
+		if (I2CAddWrite(&transaction, device, (char *)data + sent, chunk) < 0) {
+			return -1;
+		}
+		sent += chunk;
+	}
+
+	if (I2CTransfer(device, &transaction) < 0) {
+		return -1;
+	}
+
+	return length;
+}
+
+int I2CRead(I2CDevice * device, void * buffer, int length)
+{
+	I2CTransaction transaction;
+
+	I2CBegin(&transaction);
+	I2CAddRead(&transaction, device, buffer, length);
+
+	if (I2CTransfer(device, &transaction) < 0) {
+		return -1;
+	}
+
+	return length;
+}
+
+void I2CGetStats(I2CDevice * device, I2CDeviceStats * stats)
+{
+	memcpy(stats, &device->stats, sizeof(I2CDeviceStats));
+}
+
+void I2CPrintStats(I2CDevice * device)
+{
+	I2CDeviceStats * stats = &device->stats;
+
+	printf("%s: %lu transactions, %lu msgs, %lu B read, %lu B written, %lu retries, %lu failures, "
+	       "avg %.1f us, max %.1f us\n",
+		device->name, stats->transactions, stats->messages, stats->bytesRead, stats->bytesWritten,
+		stats->retries, stats->failures,
+		(stats->transactions + stats->failures)?
+			((stats->busyNs / 1000.0) / (stats->transactions + stats->failures)):(0.0),
+		stats->maxNs / 1000.0);
+}
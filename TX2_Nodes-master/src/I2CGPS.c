@@ -13,6 +13,7 @@
 **/
 
 #include "../include/I2CGPS.h"
+#include "../include/Profile.h"
 
 /**
  * @brief I2C struct contains relevent information when reading and writing to XA1110 over I2C bus.
@@ -43,9 +44,9 @@ int nmeaBufferSize;
 int previousIndex;
 
 /**
- * @brief Internal file descriptor used by the I2CGPS.c functions.
+ * @brief The XA1110 on the I2C bus.
 **/
-int I2CFd;
+I2CDevice gpsDevice;
 
 /**
  * @brief Pointer for #I2C struct, used as an internal global for this library.
@@ -57,45 +58,74 @@ I2C * i2cData;
 **/
 int messageDisplayed = 0;
 
+/**
+ * @brief Bus and parser statistics, see #I2CGPSStats.
+**/
+I2CGPSStats gpsStats;
+
+/**
+ * @brief Set while a sentence is being assembled in #nmeaBuffer.
+**/
+int collectingSentence = 0;
+
+/**
+ * @brief Last character handed to #ParseNMEA, used to tell line endings from padding.
+**/
+char previousCharacter = 0;
+
+/**
+ * @brief Set once a complete, valid GNGLL fix has been parsed during the current drain.
+**/
+int fixAvailable;
+
+/**
+ * @brief Latitude, longitude and UTC time of the most recent fix parsed during the current drain.
+**/
+GpsMsg latestFix;
+
+/**
+ * @brief #ParseNMEA() calls, see Profile.h.
+**/
+ProfileRegion nmeaProfile = { .name = "nmea parse" };
+
+/**
+ * @brief File descriptor raw NMEA data is recorded to, see #I2CGPSRecord().
+**/
+int recordFd = -1;
+
 /**
  * @brief Internal I2C write function 
- * @details Internal I2C write function 
+ * @details Internal I2C write function. The XA1110 NACKs while it is busy, the retries and
+ *	    backoff are left to the #GPS_RETRY_POLICY of the device.
  * @param i2c #I2C struct whose data will be written to the I2C bus.
  * @return I2C write status
 **/
 int i2cWrite(I2C * i2c)
 {
-	int status;
-        do {
-		// try and write to GNSS device
-		status = write(I2CFd, i2c->gpsBuffer, i2c->bytes);
-		// if we try and write while device isn't ready, wait and try again
-		if (-1 == status) {
-			usleep(10000);
-		}
-        } while (-1 == status);
-	return status;
+	return I2CWrite(&gpsDevice, i2c->gpsBuffer, i2c->bytes);
 }
 
 /**
  * @brief Internal I2C read function 
- * @details Internal I2C read function 
- * @param i2c #I2C struct that will contain data read from the bus.
- * @return I2C read status
+ * @details Internal I2C read function. Performs a single sized read of #I2C_GPS_CHUNK_SIZE bytes
+ *	    from the XA1110 buffer.
+ * @param buffer Buffer of at least #I2C_GPS_CHUNK_SIZE bytes that will contain the data read.
+ * @return Number of bytes read, -1 on error.
 **/
-int i2cRead(I2C * i2c)
+int i2cRead(char * buffer)
 {
 	int status;
-	do {
-		// try and read from the GNSS device
-		status = read(I2CFd, i2c->gpsBuffer, sizeof(i2c->gpsBuffer));
-		// if we try and read while device isn't ready, wait and try again
-		if (-1 == status) {
-			usleep(10000);
-		}
-	} while (-1 == status);
-	// status contains the number of bytes read
-	i2c->bytes = status;
+
+	// one bus transaction per chunk
+	status = I2CRead(&gpsDevice, buffer, I2C_GPS_CHUNK_SIZE);
+	gpsStats.transactions++;
+
+	if (status > 0) {
+		gpsStats.bytesRead += status;
+	} else {
+		gpsStats.readErrors++;
+	}
+
 	return status;
 }
 
@@ -220,17 +250,19 @@ int GetIndexOfElement(char * gpsString, int elementIndex)
  *	    $GNGLL,3150.679234,N,11711.934544,E,032946.000,A,A*4C
  * 
  *	   </center>
+ *	    GNGGA packets carry the same coordinate format starting at the second element.
  * @param gpsString The NMEA packet we are extracting the coordinate from.
+ * @param element The element in the NMEA packet where latitude starts; 1 for GLL, 2 for GGA.
  * @param latitude A pointer to a float variable, used as an output.
  * @param longitude A pointer to a float variable, used as an output.
  * @return Returns 0 if successful, -1 if error.
 **/
-int GetLatLong(char * gpsString, float * latitude, float * longitude)
+int GetLatLong(char * gpsString, int element, float * latitude, float * longitude)
 {
 	float tempFloat;
 
-	// latitude is the first element in the NMEA packet
-        int index = GetIndexOfElement(gpsString, 1);
+	// latitude is the first element in a GLL packet
+        int index = GetIndexOfElement(gpsString, element);
 
 	// check for various conditions
         if (gpsString[index] == 'A') {
@@ -315,127 +347,301 @@ int GetLatLong(char * gpsString, float * latitude, float * longitude)
 int AppendChecksum(char * gpsCommand, I2C * i2c)
 {
 	int index;
-	sprintf(i2c->gpsBuffer, "%s%X\r\n", gpsCommand, CalculateChecksum(gpsCommand, &index));
+	sprintf(i2c->gpsBuffer, "%s%02X\r\n", gpsCommand, CalculateChecksum(gpsCommand, &index));
 	// accounts for checksum, carriage return, and line feed
 	i2c->bytes = index + 4;
 }
 
 int I2CGPSOpen() 
 {
-	char filename[32];
-	int deviceAddress = 0x10;
-
-	memset(filename, 0, sizeof(filename));
+	I2CRetryPolicy policy = GPS_RETRY_POLICY;
 
-	// linux device path
-	sprintf(filename, "%s", "/dev/i2c-1");
-
-	I2CFd = open(filename, O_RDWR);
-
-	if (I2CFd <= 0) {
+	if (I2COpen(&gpsDevice, GPS_I2C_BUS, GPS_ADDRESS, "XA1110") < 0) {
 		printf("Error opening I2C device\n");
 		return -1;
 	}
 
-	// attach I2C device slave address
-	if (ioctl(I2CFd, I2C_SLAVE, deviceAddress) < 0) {
-		printf("Error setting I2C address\n");
-		return -1;
-	}
+	I2CSetRetryPolicy(&gpsDevice, &policy);
 
 	// allocate memory for #I2C data struct
 	i2cData = malloc(sizeof(I2C));
 
 	memset(i2cData, 0, sizeof(I2C));
+	memset(&gpsStats, 0, sizeof(gpsStats));
 
 	previousIndex = 0;
+	collectingSentence = 0;
+	previousCharacter = 0;
 
-	return I2CFd;
+	return 0;
 }
 
 /**
- * @brief Internal function used to parse returned NMEA data to find the lat/lon data we desire.
- * @details Internal function used to parse returned NMEA data to find the lat/lon data we desire.
- * @param nmeaData The NMEA string we are parsing. If we find the packet is a GNGLL packet, return 1, else 0.
- * @return If packet is GNGLL, return 1, else 0
-**/ 
-int IsGNGLL(char * nmeaData)
+ * @brief Internal function used to check the sentence type of an NMEA packet.
+ * @details The talker (GP, GL, GN) is ignored, only the three character sentence type is compared.
+ * @param nmeaData The NMEA packet.
+ * @param type Sentence type, e.g. "GGA".
+ * @return 1 if the packet is of the given type, else 0.
+**/
+int IsSentenceType(char * nmeaData, char * type)
 {
-	int index;
-	int equal;
-	char * GNGLL = "$GNGLL";
-	// just look through first 6 characters of each string
-	for (index = 0; index < 6; index++) {
-		equal = (nmeaData[index] == GNGLL[index]);
-		// if not equal, we are done here
-		if (!equal) break;
+	return ('$' == nmeaData[0] && 0 == strncmp(&nmeaData[3], type, 3))?(1):(0);
+}
+
+/**
+ * @brief Internal function used to read a numeric NMEA element.
+ * @return The value of the element, 0 if the element is empty.
+**/
+float GetFloatElement(char * gpsString, int element)
+{
+	return atof(&gpsString[GetIndexOfElement(gpsString, element)]);
+}
+
+/**
+ * @brief Internal function used to extract the UTC time of a fix from an NMEA packet.
+ * @details The UTC time of the fix is held in hhmmss.sss format; element 5 of a GLL packet and
+ *	    element 1 of a GGA packet. The time is converted to milliseconds since midnight UTC.
+ * @param gpsString The NMEA packet.
+ * @param element The element holding the time.
+ * @return Milliseconds since midnight UTC, or 0 if the field is empty.
+**/
+unsigned int GetFixTime(char * gpsString, int element)
+{
+	int index = GetIndexOfElement(gpsString, element);
+	unsigned int hours, minutes, seconds, milliseconds;
+
+	if (',' == gpsString[index]) {
+		return 0;
 	}
 
-	return equal;
+	hours = ((gpsString[index] - '0') * 10) + (gpsString[index + 1] - '0');
+	minutes = ((gpsString[index + 2] - '0') * 10) + (gpsString[index + 3] - '0');
+	seconds = ((gpsString[index + 4] - '0') * 10) + (gpsString[index + 5] - '0');
+	milliseconds = 0;
+
+	// fractional seconds are optional
+	if ('.' == gpsString[index + 6]) {
+		milliseconds = ((gpsString[index + 7] - '0') * 100) +
+			       ((gpsString[index + 8] - '0') * 10) +
+			        (gpsString[index + 9] - '0');
+	}
+
+	return ((((hours * 60) + minutes) * 60) + seconds) * 1000 + milliseconds;
+}
+
+/**
+ * @brief Internal function called once a full sentence has been assembled in #nmeaBuffer.
+ * @details Checks the checksum and merges the sentence into #latestFix. A burst from the XA1110
+ *	    holds one sentence of each enabled type for the same epoch, so each type fills in its
+ *	    part of the fix:
+ *	    <br>
+ *	    GGA - position, fix quality, satellites in use, HDOP, altitude and correction age<br>
+ *	    GLL - position only, used when GGA output is disabled<br>
+ *	    VTG - course over ground and speed<br>
+**/
+void HandleSentence()
+{
+	int quality;
+
+	gpsStats.sentences++;
+
+	if (!IsSentenceType(nmeaBuffer, "GGA") &&
+	    !IsSentenceType(nmeaBuffer, "GLL") &&
+	    !IsSentenceType(nmeaBuffer, "VTG")) {
+		return;
+	}
+
+	if (0 != CompareChecksum(nmeaBuffer)) {
+		gpsStats.checksumErrors++;
+		return;
+	}
+
+	if (IsSentenceType(nmeaBuffer, "GGA")) {
+		// fix quality 0 means no fix, 1 GPS, 2 differential (SBAS)
+		quality = (int)GetFloatElement(nmeaBuffer, 6);
+		if (quality > 0 &&
+		    0 == GetLatLong(nmeaBuffer, 2, &latestFix.position.latitude, &latestFix.position.longitude)) {
+			latestFix.time = GetFixTime(nmeaBuffer, 1);
+			latestFix.fixQuality = quality;
+			latestFix.satellites = (int)GetFloatElement(nmeaBuffer, 7);
+			latestFix.hdop = GetFloatElement(nmeaBuffer, 8);
+			latestFix.altitude = GetFloatElement(nmeaBuffer, 9);
+			latestFix.correctionAge = (',' == nmeaBuffer[GetIndexOfElement(nmeaBuffer, 13)])?
+						  (-1.0f):(GetFloatElement(nmeaBuffer, 13));
+			fixAvailable = 1;
+		}
+	} else if (IsSentenceType(nmeaBuffer, "GLL")) {
+		if (0 == GetLatLong(nmeaBuffer, 1, &latestFix.position.latitude, &latestFix.position.longitude)) {
+			latestFix.time = GetFixTime(nmeaBuffer, 5);
+			fixAvailable = 1;
+		}
+	} else if (',' != nmeaBuffer[GetIndexOfElement(nmeaBuffer, 7)]) {
+		// VTG, speed is given in km/h in the seventh element
+		latestFix.heading = GetFloatElement(nmeaBuffer, 1);
+		latestFix.velocity = GetFloatElement(nmeaBuffer, 7) / 3.6f;
+	}
 }
 
 /**
  * @brief Internal function used to parse NMEA packets.
  * @details Internal function used to pares NMEA packets. As a read from the XA1110 module typically
  *	    returns a plethora of NMEA packets, we need to extract individual packets one at a time and
- *	    determine if they contain any information that we want.
- * @param input The NMEA string we are parsing
- * @return Returns 0 if we found a GNGLL packet, else returns -1. 
+ *	    determine if they contain any information that we want. Sentences are assembled character
+ *	    by character in #nmeaBuffer, so a sentence split across two reads is completed by the next
+ *	    read. When the XA1110 has nothing left to send it pads the read with bare line feeds; a
+ *	    line feed that does not follow a carriage return is therefore treated as padding.
+ * @param input The NMEA data we are parsing.
+ * @param length The number of bytes in input.
+ * @return Returns the index at which padding started (the module's buffer is empty), or length
+ *	   if the whole input was NMEA data.
 **/
-int ParseNMEA(char * input)
+int ParseNMEA(char * input, int length)
 {
-	int index = 0;
-	int endOfPacket = 0;
-
-	// loop through whole string if necessary
-	while (index < 255) {
-		nmeaBuffer[previousIndex] = input[index];
-		previousIndex++;
-		// mark end of packet
-		if (input[index] == '*') {
-			endOfPacket = 1;
+	int index;
+	char character;
+
+	for (index = 0; index < length; index++) {
+		character = input[index];
+
+		if (I2C_GPS_PADDING == character && '\r' != previousCharacter) {
+			// nothing buffered in the module past this point
+			gpsStats.paddingBytes += length - index;
+			previousCharacter = character;
+			break;
+		}
+
+		previousCharacter = character;
+
+		if ('$' == character) {
+			// start of a new sentence, anything partial is dropped
+			collectingSentence = 1;
+			previousIndex = 0;
+		}
+
+		if (!collectingSentence) {
+			continue;
+		}
+
+		if (previousIndex >= (int)sizeof(nmeaBuffer) - 1) {
+			// sentence too long to be anything we want
+			collectingSentence = 0;
+			previousIndex = 0;
+			continue;
 		}
 
-		// we have reached end of the input string
-		if (input[index++] == '\n') {
-			// do we have the data we need
-			if (endOfPacket && IsGNGLL(nmeaBuffer)) {
-				nmeaBufferSize = previousIndex;	
-				previousIndex = 0;
-				return 0;
-			 }	
+		nmeaBuffer[previousIndex++] = character;
+
+		// we have reached the end of the sentence
+		if ('\n' == character) {
+			nmeaBuffer[previousIndex] = '\0';
+			nmeaBufferSize = previousIndex;
+			if (NULL != strchr(nmeaBuffer, '*')) {
+				HandleSentence();
+			}
+			collectingSentence = 0;
 			previousIndex = 0;
-			endOfPacket = 0;
 		}
 	}
 
-	// data at the cutoff is important
-	if (index == 255 && IsGNGLL(nmeaBuffer) && !endOfPacket) {
-		//previousIndex = previousIndex - 1; // account for CR and LF 
-	} else {
-		// discard it entirley, should ever hit this.... use an assert
-		previousIndex = 0;
+	return index;
+}
+
+/**
+ * @brief Internal function used to start a new fix before a burst is parsed.
+ * @details GLL only output carries no quality information, so quality fields are cleared and
+ *	    left for GGA to fill in. So are the course and speed, left for VTG, a burst without
+ *	    it is not moving on with those of the burst before.
+**/
+void ResetFix()
+{
+	fixAvailable = 0;
+	latestFix.heading = 0.0f;
+	latestFix.velocity = 0.0f;
+	latestFix.fixQuality = 0;
+	latestFix.satellites = 0;
+	latestFix.hdop = 0.0f;
+	latestFix.altitude = 0.0f;
+	latestFix.correctionAge = -1.0f;
+}
+
+/**
+ * @brief Internal function used to copy a parsed fix to the caller.
+**/
+int ReturnFix(GpsMsg * fix)
+{
+	if (fixAvailable) {
+		memcpy(fix, &latestFix, sizeof(GpsMsg));
+		return GPS_READ_FIX;
 	}
-	return -1;		
+	return GPS_READ_NO_FIX;
 }
 
 int I2CGPSRead(Message * message)
 {
-	int parseStatus;
-	i2cRead(i2cData);
-
-	// read in NMEA data from XA1110 and parse
-	parseStatus = ParseNMEA(i2cData->gpsBuffer);
-
-	// if we found what we want, return 1
-	if (0 == parseStatus &&  // we have GNGLL data
-	    0 == CompareChecksum(nmeaBuffer) && // Checksum mathes
-	    0 == GetLatLong(nmeaBuffer, &message->gpsMsg.position.latitude, // lat lon correct
-		    			&message->gpsMsg.position.longitude)) {
-		return 1;
-	} else {
-		return 0;	// data, for whatever reason, isn't avialable
+	char chunk[I2C_GPS_CHUNK_SIZE];
+	int chunkCount;
+	int bytes;
+	int dataBytes;
+	int dataSeen = 0;
+	int recording = 0;
+
+	ResetFix();
+
+	// drain the module's buffer in sized reads, stop as soon as padding shows up
+	for (chunkCount = 0; chunkCount < I2C_GPS_MAX_CHUNKS; chunkCount++) {
+		bytes = i2cRead(chunk);
+
+		if (bytes <= 0) {
+			break;
+		}
+
+		// a chunk that starts with padding means the buffer was already empty
+		if (!(I2C_GPS_PADDING == chunk[0] && '\r' != previousCharacter)) {
+			dataSeen = 1;
+		}
+
+		PROFILE_BEGIN(&nmeaProfile);
+		dataBytes = ParseNMEA(chunk, bytes);
+		PROFILE_END(&nmeaProfile);
+
+		// record the data, each drain is started with a '#' line
+		if (recordFd >= 0 && dataBytes > 0) {
+			if (!recording) {
+				write(recordFd, "#\n", 2);
+				recording = 1;
+			}
+			write(recordFd, chunk, dataBytes);
+		}
+
+		if (dataBytes < bytes) {
+			break;
+		}
 	}
+
+	// if we found what we want, return it
+	if (fixAvailable) {
+		return ReturnFix(&message->gpsMsg);
+	}
+
+	return (dataSeen)?(GPS_READ_NO_FIX):(GPS_READ_EMPTY);
+}
+
+int I2CGPSParse(char * data, int length, GpsMsg * fix)
+{
+	ResetFix();
+	ParseNMEA(data, length);
+	return ReturnFix(fix);
+}
+
+void I2CGPSRecord(int fd)
+{
+	recordFd = fd;
+}
+
+void I2CGPSGetStats(I2CGPSStats * stats)
+{
+	I2CGetStats(&gpsDevice, &gpsStats.bus);
+	memcpy(stats, &gpsStats, sizeof(I2CGPSStats));
 }
 
 int I2CGPSWrite(char * command)
@@ -447,8 +653,26 @@ int I2CGPSWrite(char * command)
 	return 0;
 }
 
-void CloseI2C()
+int I2CGPSWriteRaw(uint8_t * data, int length)
+{
+	int chunk;
+	int written = 0;
+
+	while (written < length) {
+		chunk = (length - written > I2C_GPS_WRITE_CHUNK)?(I2C_GPS_WRITE_CHUNK):(length - written);
+		if (I2CWrite(&gpsDevice, (char *)data + written, chunk) < 0) {
+			gpsStats.writeErrors++;
+			return -1;
+		}
+		gpsStats.bytesWritten += chunk;
+		written += chunk;
+	}
+
+	return written;
+}
+
+void I2CGPSClose()
 {
-	close(I2CFd);
+	I2CClose(&gpsDevice);
 	free(i2cData);
 }
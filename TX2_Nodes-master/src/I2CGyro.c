@@ -7,100 +7,314 @@
 **/
 
 #include "../include/I2CGyro.h"
+#include "../include/Clock.h"
 
 /**
- * @brief Internal I2C file descriptor.
+ * @brief The LSM9DS1 on the I2C bus.
 **/
-int i2cFd;
+I2CDevice gyroDevice;
 
 /**
- * @brief Internal #I2C struct.
+ * @brief The LSM9DS1 magnetometer on the I2C bus.
 **/
-I2C i2cStruct;
+I2CDevice magDevice;
+
+/**
+ * @brief Set once the magnetometer has been opened and set up.
+**/
+int magAvailable = 0;
+
+/**
+ * @brief Internal FIFO reader counters.
+**/
+GyroStats gyroStats;
+
+/**
+ * @brief Measured sample period in seconds, see #GyroSamplePeriod().
+**/
+double samplePeriod = 1.0 / GYRO_ODR_HZ;
+
+/**
+ * @brief #ClockNowNs() time the sample period measurement started at, ns.
+**/
+long long periodStart;
+
+/**
+ * @brief Samples read since #periodStart.
+**/
+long long periodSamples;
+
+/**
+ * @brief Internal function that returns the time in nanoseconds, see #ClockNowNs().
+**/
+long long GyroNowNs()
+{
+	return ClockNowNs();
+}
 
 /**
  * @brief Internal function used to set internal gyroscope registers.
- * @details Internal function used to set internal gyroscope registers. As writing to the gyroscope requires
- *	    mixed write/read I2C commands, normal read/write system calls cannot be used. These smbus calls 
- *	    must be used for this very reason. Again, READ AND WRITE WILL NOT WORK.
  * @param registerAddress The internal gyro address whose value is being set.
  * @param value The value being placed in registerAddress.
 **/
-void SetRegister(int registerAddress, char value)
+int GyroSetRegister(int registerAddress, char value)
 {
-        i2c_smbus_write_byte_data(i2cFd, registerAddress, value);
+	if (I2CWriteRegister(&gyroDevice, registerAddress, value) < 0) {
+		gyroStats.errors++;
+		return -1;
+	}
+
+	return 0;
 }
 
 /**
- * @brief Internal function used to read from a gyroscope register.
- * @details Internal function used to read from a gyroscope register. Again, read and write do not work and
- *	    smbus functions must be used. Especially since this call in particular is a mixed write/read call.
- * @param i2c The #I2C struct whose values are being writtne to the I2C bus.
+ * @brief Internal function used to read consecutive gyroscope registers.
+ * @details Internal function used to read consecutive gyroscope registers. The register address
+ *	    write and the read are a single transaction with a repeated start.
+ * @param registerAddress The first register read.
+ * @param buffer Where the data is stored.
+ * @param bytes Number of bytes read.
 **/
-int i2cRead(I2C * i2c)
+int GyroReadRegisters(int registerAddress, char * buffer, int bytes)
 {
-        return i2c_smbus_read_i2c_block_data(i2cFd, i2c->registerAddress, i2c->bytes, i2c->Buffer);
+	if (I2CReadRegisters(&gyroDevice, registerAddress, buffer, bytes) < 0) {
+		gyroStats.errors++;
+		return -1;
+	}
+
+	return bytes;
 }
 
-int OpenI2C()
+/**
+ * @brief Internal function that opens and sets up the magnetometer.
+ * @return 0 on success, -1 on error.
+**/
+int MagOpen()
 {
-	I2C in = {.bytes = 1, .registerAddress = 0x0F };
-	char filename[20];
-	memset(filename, 0, sizeof(filename));
+	char whoAmI = 0;
 
-	// open I2C device
-        sprintf(filename, "%s", "/dev/i2c-0");
+	if (I2COpen(&magDevice, GYRO_I2C_BUS, MAG_ADDRESS, "LSM9DS1 mag") < 0) {
+		return -1;
+	}
 
-	i2cFd = open(filename, O_RDWR);
+	if (I2CReadRegisters(&magDevice, WHO_AM_I_M, &whoAmI, 1) < 0 || WHO_AM_I_M_VALUE != whoAmI) {
+		I2CClose(&magDevice);
+		return -1;
+	}
 
-	if (i2cFd <=  0) {
-	        printf("error opening i2c for gyro\n");
-	        return -1;
+	if (I2CWriteRegister(&magDevice, CTRL_1_M, CTRL_1_M_80HZ) < 0 ||
+	    I2CWriteRegister(&magDevice, CTRL_2_M, CTRL_2_M_4GAUSS) < 0 ||
+	    I2CWriteRegister(&magDevice, CTRL_4_M, CTRL_4_M_UHP) < 0 ||
+	    I2CWriteRegister(&magDevice, CTRL_5_M, CTRL_5_M_BDU) < 0 ||
+	    I2CWriteRegister(&magDevice, CTRL_3_M, CTRL_3_M_CONTINUOUS) < 0) {
+		I2CClose(&magDevice);
+		return -1;
 	}
 
-	// bind with slave address
-	if (ioctl(i2cFd, I2C_SLAVE, 0x6B) < 0) {
-	        printf("error setting i2c address\n");
+	return 0;
+}
+
+int I2CGyroOpen()
+{
+	char whoAmI;
+
+	if (I2COpen(&gyroDevice, GYRO_I2C_BUS, GYRO_ADDRESS, "LSM9DS1") < 0) {
+	        printf("error opening i2c for gyro\n");
 	        return -1;
 	}
 
+	memset(&gyroStats, 0, sizeof(gyroStats));
+
 	// initial setup for gyroscope
-	SetRegister(CTRL_6_X, ODR_238);
-	SetRegister(CTRL_1_G, ODR_238); // 100 Hz instead of 800
-	SetRegister(0x04, 0x80);
-	SetRegister(0x1E, 0x20);
+	GyroSetRegister(CTRL_6_X, ODR_238);
+	GyroSetRegister(CTRL_1_G, ODR_238);
+	GyroSetRegister(0x04, 0x80);
+	GyroSetRegister(CTRL_4, CTRL_4_XYZ_G);
+	GyroSetRegister(CTRL_8, CTRL_8_DEFAULT);
+
+	// the FIFO holds a gyro and accel sample per slot while both run
+	GyroSetRegister(CTRL_9, CTRL_9_FIFO_EN);
 
-	i2cRead(&in);
+	GyroReadRegisters(0x0F, &whoAmI, 1);
 
-	memset(&i2cStruct, 0, sizeof(i2cStruct));
+	if (GyroFifoFlush() < 0) {
+		printf("error starting gyro FIFO\n");
+		return -1;
+	}
 
-	// since we are really only concerned about the Z axis, setup struct 
-	// so we are only reading the 2 bytes associated with the Z axis.
-	i2cStruct.bytes = 2;
-	i2cStruct.registerAddress = 0x1C;
+	// the gyro is still usable without the magnetometer
+	magAvailable = (MagOpen() < 0)?(0):(1);
+	if (!magAvailable) {
+		printf("error opening magnetometer, continuing without it\n");
+	}
 
-	return i2cFd;	
+	return 0;
 }
 
 float GetAngularVelocity()
 {
+	char buffer[2];
 	short int z;
 	float zG;
 
-	// read in the Z axis registers
-	i2cRead(&i2cStruct);
+	// read in the Z axis registers, we are really only concerned about the Z axis
+	GyroReadRegisters(OUT_Z_G, buffer, 2);
 
 	// extract values
-	z = i2cStruct.Buffer[0];
-	z |= i2cStruct.Buffer[1] << 8;
+	z = (unsigned char)buffer[0];
+	z |= buffer[1] << 8;
 
 	// convert binary value to degrees/sec
-	zG = z * ((2.5f * 245.0f) / 65535.0f);
+	zG = z * GYRO_DPS_PER_LSB;
 
 	return zG;
 }
 
-void CloseI2C()
+int GyroFifoFlush()
 {
-	close(i2cFd);
+	// bypass mode discards the content of the FIFO
+	if (GyroSetRegister(FIFO_CTRL, FIFO_MODE_BYPASS) < 0 ||
+	    GyroSetRegister(FIFO_CTRL, FIFO_MODE_CONTINUOUS | GYRO_FIFO_THRESHOLD) < 0) {
+		return -1;
+	}
+
+	periodStart = GyroNowNs();
+	periodSamples = 0;
+
+	return 0;
+}
+
+int GyroFifoRead(GyroSample * samples, int maxSamples)
+{
+	char status;
+	char buffer[GYRO_FIFO_DEPTH * GYRO_SAMPLE_BYTES];
+	short int raw;
+	long long now;
+	long long period;
+	int count;
+	int i, axis;
+
+	// how many samples are waiting
+	if (GyroReadRegisters(FIFO_SRC, &status, 1) < 0) {
+		return -1;
+	}
+	now = GyroNowNs();
+
+	count = status & FIFO_SRC_FSS;
+	if (count > GYRO_FIFO_DEPTH) {
+		count = GYRO_FIFO_DEPTH;
+	}
+	if (count > maxSamples) {
+		count = maxSamples;
+	}
+	if (0 == count) {
+		return 0;
+	}
+
+	// the address wraps from the last accel register back to OUT_X_G, and to the next
+	// slot in the FIFO, so the whole FIFO comes out of one read
+	if (GyroReadRegisters(OUT_X_G, buffer, count * GYRO_SAMPLE_BYTES) < 0) {
+		return -1;
+	}
+
+	gyroStats.reads++;
+	gyroStats.samples += count;
+
+	// measure the rate the device is actually sampling at
+	periodSamples += count;
+	if (now - periodStart > 1000000000LL) {
+		samplePeriod = ((now - periodStart) / 1000000000.0) / periodSamples;
+		if (samplePeriod > (1.0 + GYRO_ODR_TOLERANCE) / GYRO_ODR_HZ) {
+			samplePeriod = (1.0 + GYRO_ODR_TOLERANCE) / GYRO_ODR_HZ;
+		} else if (samplePeriod < (1.0 - GYRO_ODR_TOLERANCE) / GYRO_ODR_HZ) {
+			samplePeriod = (1.0 - GYRO_ODR_TOLERANCE) / GYRO_ODR_HZ;
+		}
+	}
+
+	// samples were lost, the count since periodStart is no longer complete
+	if (status & FIFO_SRC_OVRN) {
+		gyroStats.overruns++;
+		periodStart = now;
+		periodSamples = 0;
+	}
+
+	period = (long long)(samplePeriod * 1000000000.0);
+
+	for (i = 0; i < count; i++) {
+		for (axis = 0; axis < 3; axis++) {
+			raw = (unsigned char)buffer[(i * GYRO_SAMPLE_BYTES) + (axis * 2)];
+			raw |= buffer[(i * GYRO_SAMPLE_BYTES) + (axis * 2) + 1] << 8;
+			samples[i].rate[axis] = raw * GYRO_DPS_PER_LSB;
+
+			raw = (unsigned char)buffer[(i * GYRO_SAMPLE_BYTES) + 6 + (axis * 2)];
+			raw |= buffer[(i * GYRO_SAMPLE_BYTES) + 6 + (axis * 2) + 1] << 8;
+			samples[i].accel[axis] = raw * ACCEL_G_PER_LSB;
+		}
+
+		// the newest sample was taken on average half a period before the status read
+		samples[i].time = now - (period / 2) - ((count - 1 - i) * period);
+	}
+
+	return count;
+}
+
+double GyroSamplePeriod()
+{
+	return samplePeriod;
+}
+
+long long GyroFifoPeriodNs()
+{
+	return (long long)(samplePeriod * GYRO_FIFO_THRESHOLD * 1000000000.0);
+}
+
+int MagRead(MagSample * sample)
+{
+	char buffer[6];
+	short int raw;
+	int axis;
+
+	if (!magAvailable) {
+		return -1;
+	}
+
+	if (I2CReadRegisters(&magDevice, OUT_X_M | AUTO_INC_M, buffer, 6) < 0) {
+		gyroStats.errors++;
+		return -1;
+	}
+
+	sample->time = GyroNowNs();
+	gyroStats.magReads++;
+
+	for (axis = 0; axis < 3; axis++) {
+		raw = (unsigned char)buffer[axis * 2];
+		raw |= buffer[(axis * 2) + 1] << 8;
+		sample->field[axis] = raw * MAG_GAUSS_PER_LSB;
+	}
+
+	// the magnetometer X axis is reversed with respect to the accelerometer and gyroscope
+	sample->field[0] = -sample->field[0];
+
+	return 0;
+}
+
+void GyroGetStats(GyroStats * stats)
+{
+	I2CGetStats(&gyroDevice, &gyroStats.bus);
+	if (magAvailable) {
+		I2CGetStats(&magDevice, &gyroStats.magBus);
+	}
+	memcpy(stats, &gyroStats, sizeof(GyroStats));
+}
+
+void I2CGyroClose()
+{
+	// leave the FIFO off
+	GyroSetRegister(FIFO_CTRL, FIFO_MODE_BYPASS);
+	I2CClose(&gyroDevice);
+
+	if (magAvailable) {
+		I2CClose(&magDevice);
+		magAvailable = 0;
+	}
 }
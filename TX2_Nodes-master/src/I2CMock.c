@@ -0,0 +1,761 @@
+/**
+ * @file I2CMock.c
+ * @brief Function definitions for the I2CMock library.
+ * @details Function definitions for the I2CMock library.
+**/
+
+#include "../include/I2CMock.h"
+#include "../include/I2CBus.h"
+#include "../include/I2CGyro.h"
+#include "../include/Orientation.h"
+#include "../include/Hal.h"
+#include "../include/Parameters.h"
+#include "../include/Simulation.h"
+
+#define MOCK_GPS_ADDRESS 0x10
+#define MOCK_GYRO_ADDRESS 0x6B
+#define MOCK_MAG_ADDRESS 0x1E
+#define MOCK_WHO_AM_I 0x0F
+#define MOCK_WHO_AM_I_VALUE 0x68
+
+/**
+ * @brief Models the I2CMock library has.
+**/
+typedef enum _MockType {
+	MockGps,
+	MockGyro,
+	MockMag
+} MockType;
+
+/**
+ * @brief Z rate profile shared by the LSM9DS1 gyroscope and magnetometer models.
+**/
+typedef struct _MockProfile {
+	double time[MOCK_PROFILE_STEPS];
+	double rate[MOCK_PROFILE_STEPS];
+	int steps;
+} MockProfile;
+
+/**
+ * @brief Internal state of the XA1110 model.
+**/
+typedef struct _MockGpsState {
+	char * script;			// recording, NULL if bursts are generated
+	long scriptLength;
+	long scriptPosition;
+	char output[MOCK_GPS_BUFFER];	// data waiting to be read
+	int outputLength;
+	int outputPosition;
+	long long nextBurst;
+	unsigned long commands;
+	SimShared * sim;		// rover reported, NULL if not simulated
+	unsigned int seed;
+	long long opened;
+	long long ttff;			// unassisted time to first fix, ns
+	int aidedPosition;		// PMTK741 seen
+	int epoSatellites;		// PMTK721 seen
+	long long lastRtcm;		// when corrections were last written, 0 if never
+	unsigned long rtcmBytes;
+} MockGpsState;
+
+/**
+ * @brief Internal state of the LSM9DS1 model.
+**/
+typedef struct _MockGyroState {
+	unsigned char registers[128];
+	unsigned char fifo[GYRO_FIFO_DEPTH][GYRO_SAMPLE_BYTES];
+	unsigned char latest[GYRO_SAMPLE_BYTES];	// newest sample, for direct output register reads
+	int fifoHead;
+	int fifoCount;
+	int overrun;
+	int pointer;				// register the next read byte comes from
+	long long opened;
+	long long fifoStart;
+	long long generated;			// samples generated since fifoStart
+	MockProfile profile;
+	SimShared * sim;			// rover reported, NULL if not simulated
+	unsigned int seed;
+} MockGyroState;
+
+/**
+ * @brief Internal state of the LSM9DS1 magnetometer model.
+**/
+typedef struct _MockMagState {
+	unsigned char registers[128];
+	unsigned char output[6];		// X, Y, Z taken when OUT_X_M is read
+	int pointer;
+	long long opened;
+	MockProfile profile;
+	SimShared * sim;			// rover reported, NULL if not simulated
+} MockMagState;
+
+/**
+ * @brief Internal state common to all models.
+**/
+typedef struct _Mock {
+	MockType type;
+	int failPercent;
+	long busHz;
+	unsigned int seed;
+	union {
+		MockGpsState gps;
+		MockGyroState gyro;
+		MockMagState mag;
+	};
+} Mock;
+
+/**
+ * @brief Internal function that returns the time in nanoseconds, see #ClockNowNs().
+**/
+long long MockNowNs()
+{
+	return ClockNowNs();
+}
+
+/**
+ * @brief Internal function that reads a whole file into memory.
+ * @return The data, NULL if the file could not be read.
+**/
+char * MockLoadFile(char * fileName, long * length)
+{
+	FILE * file;
+	char * data;
+
+	file = fopen(fileName, "r");
+	if (NULL == file) {
+		return NULL;
+	}
+
+	fseek(file, 0, SEEK_END);
+	*length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	data = malloc(*length + 1);
+	if (NULL != data && fread(data, 1, *length, file) != (size_t)*length) {
+		free(data);
+		data = NULL;
+	}
+
+	fclose(file);
+	return data;
+}
+
+/**
+ * @brief Internal function that appends data to the XA1110 output buffer, dropping the oldest data once full.
+**/
+void MockGpsOutput(MockGpsState * gps, char * data, int length)
+{
+	// compact what has been read already
+	if (gps->outputPosition > 0) {
+		memmove(gps->output, gps->output + gps->outputPosition, gps->outputLength - gps->outputPosition);
+		gps->outputLength -= gps->outputPosition;
+		gps->outputPosition = 0;
+	}
+
+	if (length > MOCK_GPS_BUFFER) {
+		data += length - MOCK_GPS_BUFFER;
+		length = MOCK_GPS_BUFFER;
+	}
+
+	// the module loses the oldest data
+	if (gps->outputLength + length > MOCK_GPS_BUFFER) {
+		memmove(gps->output, gps->output + (gps->outputLength + length - MOCK_GPS_BUFFER),
+			MOCK_GPS_BUFFER - length);
+		gps->outputLength = MOCK_GPS_BUFFER - length;
+	}
+
+	memcpy(gps->output + gps->outputLength, data, length);
+	gps->outputLength += length;
+}
+
+/**
+ * @brief Internal function that appends an NMEA sentence, checksum and line ending included.
+**/
+void MockGpsSentence(MockGpsState * gps, char * body)
+{
+	char sentence[128];
+	unsigned char checksum = 0;
+	int i;
+
+	for (i = 0; body[i]; i++) {
+		checksum ^= body[i];
+	}
+
+	i = snprintf(sentence, sizeof(sentence), "$%s*%02X\r\n", body, checksum);
+	MockGpsOutput(gps, sentence, i);
+}
+
+/**
+ * @brief Internal function that writes the fix quality and differential fields of a GGA sentence.
+ * @return 1 if the fix is differential, else 0.
+**/
+int MockGpsDifferential(MockGpsState * gps, char * quality, int qualitySize, char * age, int ageSize)
+{
+	long long since = MockNowNs() - gps->lastRtcm;
+
+	if (0 == gps->lastRtcm || since > MOCK_GPS_RTCM_AGE * CLOCK_SECOND) {
+		snprintf(quality, qualitySize, "1");
+		snprintf(age, ageSize, ",");
+		return 0;
+	}
+
+	snprintf(quality, qualitySize, "2");
+	snprintf(age, ageSize, "%.1f,0000", since / (double)CLOCK_SECOND);
+	return 1;
+}
+
+/**
+ * @brief Internal function that releases a GGA/VTG burst with the fix of the simulated rover.
+ * @details The UTC time of the fix runs on simulated time as well, so the fixes are a second
+ *	    apart to the estimator however fast the simulation runs.
+**/
+void MockGpsSimulated(MockGpsState * gps)
+{
+	char body[128];
+	char quality[4], age[24];
+	struct timespec real, monotonic;
+	long long utcNs;
+	double latitude, longitude, x, y;
+	double noise;
+	time_t now;
+	struct tm utc;
+	SimPose pose;
+
+	SimulationGetPose(gps->sim, &pose);
+
+	// uniform error on each axis, less with corrections
+	noise = gps->sim->gpsNoise * ((MockGpsDifferential(gps, quality, sizeof(quality), age, sizeof(age)))?
+				      (MOCK_GPS_RTCM_NOISE):(1.0));
+	x = pose.x + (((rand_r(&gps->seed) / (double)RAND_MAX) * 2.0 - 1.0) * noise);
+	y = pose.y + (((rand_r(&gps->seed) / (double)RAND_MAX) * 2.0 - 1.0) * noise);
+	SimulationLatLon(gps->sim, x, y, &latitude, &longitude);
+
+	clock_gettime(CLOCK_REALTIME, &real);
+	clock_gettime(CLOCK_MONOTONIC, &monotonic);
+	utcNs = ((long long)real.tv_sec * 1000000000LL) + real.tv_nsec + MockNowNs() -
+		(((long long)monotonic.tv_sec * 1000000000LL) + monotonic.tv_nsec);
+	now = utcNs / 1000000000LL;
+	gmtime_r(&now, &utc);
+
+	snprintf(body, sizeof(body), "GNGGA,%02d%02d%02d.%03d,%02d%09.6f,%c,%03d%09.6f,%c,%s,8,1.00,300.0,M,-32.0,M,%s",
+		 utc.tm_hour, utc.tm_min, utc.tm_sec, (int)((utcNs / 1000000LL) % 1000),
+		 (int)fabs(latitude), (fabs(latitude) - (int)fabs(latitude)) * 60.0, (latitude < 0.0)?('S'):('N'),
+		 (int)fabs(longitude), (fabs(longitude) - (int)fabs(longitude)) * 60.0, (longitude < 0.0)?('W'):('E'),
+		 quality, age);
+	MockGpsSentence(gps, body);
+
+	snprintf(body, sizeof(body), "GNVTG,%.2f,T,,M,%.2f,N,%.2f,K,A", pose.heading,
+		 fabs(pose.speed) * 1.943844, fabs(pose.speed) * 3.6);
+	MockGpsSentence(gps, body);
+}
+
+/**
+ * @brief Internal function that returns when the XA1110 model gets its first fix.
+**/
+long long MockGpsFirstFix(MockGpsState * gps)
+{
+	double scale = 1.0;
+
+	if (gps->aidedPosition) {
+		scale = (gps->epoSatellites > 0)?(MOCK_GPS_TTFF_EPO):(MOCK_GPS_TTFF_AIDED);
+	}
+
+	return gps->opened + (long long)(gps->ttff * scale);
+}
+
+/**
+ * @brief Internal function that releases the next burst of the XA1110 model.
+**/
+void MockGpsBurst(MockGpsState * gps)
+{
+	char body[128];
+	char quality[4], age[24];
+	long start, end;
+	time_t now;
+	struct tm utc;
+
+	// still searching, sentences without a fix
+	if (MockNowNs() < MockGpsFirstFix(gps)) {
+		now = time(NULL);
+		gmtime_r(&now, &utc);
+		snprintf(body, sizeof(body), "GNGGA,%02d%02d%02d.000,,,,,0,0,,,M,,M,,", utc.tm_hour, utc.tm_min, utc.tm_sec);
+		MockGpsSentence(gps, body);
+		MockGpsSentence(gps, "GNVTG,,T,,M,,N,,K,N");
+		return;
+	}
+
+	if (NULL != gps->sim) {
+		MockGpsSimulated(gps);
+		return;
+	}
+
+	if (NULL == gps->script) {
+		// a fixed fix, stamped with the current UTC time
+		now = time(NULL);
+		gmtime_r(&now, &utc);
+		MockGpsDifferential(gps, quality, sizeof(quality), age, sizeof(age));
+		snprintf(body, sizeof(body), "GNGGA,%02d%02d%02d.000,3403.000000,N,11723.000000,W,%s,8,1.00,300.0,M,-32.0,M,%s",
+			 utc.tm_hour, utc.tm_min, utc.tm_sec, quality, age);
+		MockGpsSentence(gps, body);
+		MockGpsSentence(gps, "GNVTG,0.00,T,,M,0.00,N,0.00,K,A");
+		return;
+	}
+
+	// skip the '#' line that starts the burst
+	start = gps->scriptPosition;
+	if (start < gps->scriptLength && '#' == gps->script[start]) {
+		while (start < gps->scriptLength && '\n' != gps->script[start]) {
+			start++;
+		}
+		start++;
+	}
+
+	// the burst runs until the next '#' line
+	end = start;
+	while (end < gps->scriptLength && !('#' == gps->script[end] && (end == 0 || '\n' == gps->script[end - 1]))) {
+		end++;
+	}
+
+	if (end > start) {
+		MockGpsOutput(gps, gps->script + start, end - start);
+	}
+
+	// loop at the end of the recording
+	gps->scriptPosition = (end >= gps->scriptLength)?(0):(end);
+}
+
+/**
+ * @brief Internal function that returns the fields of a command after its name, up to the checksum.
+**/
+int MockCommandFields(struct i2c_msg * msg)
+{
+	int fields = 0;
+	int i;
+
+	for (i = 0; i < msg->len && '*' != msg->buf[i]; i++) {
+		fields += (',' == msg->buf[i]);
+	}
+
+	return fields;
+}
+
+/**
+ * @brief Internal function that performs one message against the XA1110 model.
+**/
+void MockGpsMessage(MockGpsState * gps, struct i2c_msg * msg)
+{
+	int available;
+	int i;
+
+	if (!(msg->flags & I2C_M_RD)) {
+		gps->commands++;
+		if (msg->len >= 8 && 0 == strncmp((char *)msg->buf, "$PMTK741", 8)) {
+			gps->aidedPosition = 1;
+		} else if (msg->len >= 8 && 0 == strncmp((char *)msg->buf, "$PMTK721", 8)) {
+			// the satellite and its record
+			gps->epoSatellites += (1 + MOCK_GPS_EPO_WORDS == MockCommandFields(msg));
+		} else if (msg->len > 0 && '$' != msg->buf[0]) {
+			// anything but a command is corrections, RTCM frames are binary
+			gps->lastRtcm = MockNowNs();
+			gps->rtcmBytes += msg->len;
+		}
+		return;
+	}
+
+	// buffered data, then padding
+	available = gps->outputLength - gps->outputPosition;
+	for (i = 0; i < msg->len; i++) {
+		if (i < available) {
+			msg->buf[i] = gps->output[gps->outputPosition++];
+		} else {
+			msg->buf[i] = '\n';
+		}
+	}
+}
+
+/**
+ * @brief Internal function that returns the profile Z rate at a time after the model was opened.
+**/
+double MockProfileRate(MockProfile * profile, double seconds)
+{
+	double rate = 0.0;
+	int i;
+
+	for (i = 0; i < profile->steps && profile->time[i] <= seconds; i++) {
+		rate = profile->rate[i];
+	}
+
+	return rate;
+}
+
+/**
+ * @brief Internal function that returns the angle turned by the profile, degrees, positive for left turns.
+**/
+double MockProfileAngle(MockProfile * profile, double seconds)
+{
+	double angle = 0.0;
+	double end;
+	int i;
+
+	for (i = 0; i < profile->steps && profile->time[i] < seconds; i++) {
+		end = (i + 1 < profile->steps && profile->time[i + 1] < seconds)?(profile->time[i + 1]):(seconds);
+		angle += profile->rate[i] * (end - profile->time[i]);
+	}
+
+	return angle;
+}
+
+/**
+ * @brief Internal function that packs a 16 bit little endian output value.
+**/
+void MockPack(unsigned char * out, double value)
+{
+	short int raw;
+
+	if (value > 32767.0) {
+		value = 32767.0;
+	} else if (value < -32768.0) {
+		value = -32768.0;
+	}
+
+	raw = (short int)value;
+	out[0] = raw & 0xFF;
+	out[1] = (raw >> 8) & 0xFF;
+}
+
+/**
+ * @brief Internal function that generates the samples the LSM9DS1 would have taken by now.
+**/
+void MockGyroUpdate(MockGyroState * gyro)
+{
+	long long due;
+	double seconds, rate, noise;
+	SimPose pose;
+	int slot;
+
+	// the FIFO only runs in continuous mode
+	if (FIFO_MODE_CONTINUOUS != (gyro->registers[FIFO_CTRL] & 0xE0)) {
+		gyro->fifoStart = MockNowNs();
+		gyro->generated = 0;
+		return;
+	}
+
+	due = (long long)((MockNowNs() - gyro->fifoStart) * (GYRO_ODR_HZ / 1000000000.0));
+
+	// the simulated rover turns at one rate over the samples of a read
+	if (NULL != gyro->sim) {
+		SimulationGetPose(gyro->sim, &pose);
+	}
+
+	while (gyro->generated < due) {
+		seconds = ((gyro->fifoStart - gyro->opened) / 1000000000.0) + (gyro->generated / GYRO_ODR_HZ);
+		noise = ((rand_r(&gyro->seed) / (double)RAND_MAX) * 2.0 - 1.0) * MOCK_GYRO_NOISE;
+		rate = ((NULL != gyro->sim)?(pose.rate):(MockProfileRate(&gyro->profile, seconds))) + MOCK_GYRO_BIAS + noise;
+
+		memset(gyro->latest, 0, sizeof(gyro->latest));
+		MockPack(&gyro->latest[4], rate / GYRO_DPS_PER_LSB);
+		MockPack(&gyro->latest[10], 1.0 / ACCEL_G_PER_LSB);
+
+		// a full FIFO overwrites its oldest sample
+		if (gyro->fifoCount == GYRO_FIFO_DEPTH) {
+			gyro->fifoHead = (gyro->fifoHead + 1) % GYRO_FIFO_DEPTH;
+			gyro->fifoCount--;
+			gyro->overrun = 1;
+		}
+		slot = (gyro->fifoHead + gyro->fifoCount) % GYRO_FIFO_DEPTH;
+		memcpy(gyro->fifo[slot], gyro->latest, GYRO_SAMPLE_BYTES);
+		gyro->fifoCount++;
+		gyro->generated++;
+	}
+}
+
+/**
+ * @brief Internal function that returns the next byte read from the LSM9DS1 model.
+**/
+unsigned char MockGyroReadByte(MockGyroState * gyro)
+{
+	unsigned char * sample;
+	unsigned char value;
+	int reg = gyro->pointer;
+
+	if (FIFO_SRC == reg) {
+		value = gyro->fifoCount | ((gyro->overrun)?(FIFO_SRC_OVRN):(0));
+		if (gyro->fifoCount >= GYRO_FIFO_THRESHOLD) {
+			value |= 0x80;
+		}
+		gyro->pointer++;
+		return value;
+	}
+
+	if ((reg >= OUT_X_G && reg < OUT_X_G + 6) || (reg >= 0x28 && reg < 0x2E)) {
+		sample = (gyro->fifoCount)?(gyro->fifo[gyro->fifoHead]):(gyro->latest);
+		value = sample[(reg < 0x28)?(reg - OUT_X_G):(6 + reg - 0x28)];
+
+		// gyro rolls over to accel, accel rolls back to gyro and the next FIFO slot
+		if (OUT_X_G + 5 == reg) {
+			gyro->pointer = 0x28;
+		} else if (0x2D == reg) {
+			gyro->pointer = OUT_X_G;
+			if (gyro->fifoCount) {
+				gyro->fifoHead = (gyro->fifoHead + 1) % GYRO_FIFO_DEPTH;
+				gyro->fifoCount--;
+				gyro->overrun = 0;
+			}
+		} else {
+			gyro->pointer++;
+		}
+		return value;
+	}
+
+	value = (MOCK_WHO_AM_I == reg)?(MOCK_WHO_AM_I_VALUE):(gyro->registers[reg & 0x7F]);
+	gyro->pointer = (reg + 1) & 0x7F;
+	return value;
+}
+
+/**
+ * @brief Internal function that performs one message against the LSM9DS1 model.
+**/
+void MockGyroMessage(MockGyroState * gyro, struct i2c_msg * msg)
+{
+	int i;
+
+	MockGyroUpdate(gyro);
+
+	if (msg->flags & I2C_M_RD) {
+		for (i = 0; i < msg->len; i++) {
+			msg->buf[i] = MockGyroReadByte(gyro);
+		}
+		return;
+	}
+
+	// first byte is the register, the rest are written from there on
+	if (msg->len > 0) {
+		gyro->pointer = msg->buf[0] & 0x7F;
+	}
+	for (i = 1; i < msg->len; i++) {
+		gyro->registers[gyro->pointer] = msg->buf[i];
+
+		// bypass mode empties the FIFO
+		if (FIFO_CTRL == gyro->pointer && FIFO_MODE_BYPASS == (msg->buf[i] & 0xE0)) {
+			gyro->fifoCount = 0;
+			gyro->overrun = 0;
+		}
+		gyro->pointer = (gyro->pointer + 1) & 0x7F;
+	}
+}
+
+/**
+ * @brief Internal function that takes the magnetometer output for the current heading.
+ * @details The rover is level, facing #MOCK_MAG_HEADING when opened and turning with the profile,
+ *	    or facing the magnetic heading of the simulated rover. The field is turned into the magnetometer's axes, X reversed, and the hard iron offset
+ *	    of the rover is added.
+**/
+void MockMagUpdate(MockMagState * mag)
+{
+	double seconds, heading;
+	SimPose pose;
+
+	seconds = (MockNowNs() - mag->opened) / 1000000000.0;
+
+	// compass headings go clockwise, left turns are positive
+	if (NULL != mag->sim) {
+		SimulationGetPose(mag->sim, &pose);
+		heading = (pose.heading - HalGetParameters()->magDeclination) * (M_PI / 180.0);
+	} else {
+		heading = (MOCK_MAG_HEADING - MockProfileAngle(&mag->profile, seconds)) * (M_PI / 180.0);
+	}
+
+	// X forward, Y left, Z up
+	MockPack(&mag->output[0], (-(MOCK_MAG_HORIZONTAL * cos(heading)) + MOCK_MAG_OFFSET_X) / MAG_GAUSS_PER_LSB);
+	MockPack(&mag->output[2], ((MOCK_MAG_HORIZONTAL * sin(heading)) + MOCK_MAG_OFFSET_Y) / MAG_GAUSS_PER_LSB);
+	MockPack(&mag->output[4], (MOCK_MAG_VERTICAL + MOCK_MAG_OFFSET_Z) / MAG_GAUSS_PER_LSB);
+}
+
+/**
+ * @brief Internal function that performs one message against the LSM9DS1 magnetometer model.
+**/
+void MockMagMessage(MockMagState * mag, struct i2c_msg * msg)
+{
+	int reg;
+	int i;
+
+	if (msg->flags & I2C_M_RD) {
+		for (i = 0; i < msg->len; i++) {
+			reg = mag->pointer;
+			if (OUT_X_M == reg) {
+				MockMagUpdate(mag);
+			}
+
+			if (reg >= OUT_X_M && reg < OUT_X_M + 6) {
+				msg->buf[i] = mag->output[reg - OUT_X_M];
+			} else if (WHO_AM_I_M == reg) {
+				msg->buf[i] = WHO_AM_I_M_VALUE;
+			} else if (STATUS_M == reg) {
+				msg->buf[i] = 0x0F;	// new X, Y, Z data
+			} else {
+				msg->buf[i] = mag->registers[reg];
+			}
+			mag->pointer = (reg + 1) & 0x7F;
+		}
+		return;
+	}
+
+	// first byte is the register, the auto increment bit is not modelled, it always increments
+	if (msg->len > 0) {
+		mag->pointer = msg->buf[0] & 0x7F;
+	}
+	for (i = 1; i < msg->len; i++) {
+		mag->registers[mag->pointer] = msg->buf[i];
+		mag->pointer = (mag->pointer + 1) & 0x7F;
+	}
+}
+
+/**
+ * @brief Internal function that loads a Z rate profile.
+**/
+void MockLoadProfile(MockProfile * profile, char * fileName)
+{
+	FILE * file;
+	char line[128];
+
+	file = fopen(fileName, "r");
+	if (NULL == file) {
+		printf("error opening gyro profile %s\n", fileName);
+		return;
+	}
+
+	while (profile->steps < MOCK_PROFILE_STEPS && NULL != fgets(line, sizeof(line), file)) {
+		if (2 == sscanf(line, "%lf %lf", &profile->time[profile->steps], &profile->rate[profile->steps])) {
+			profile->steps++;
+		}
+	}
+
+	fclose(file);
+}
+
+void * I2CMockOpen(char * name, int address)
+{
+	Mock * mock;
+	SimShared * sim = NULL;
+	char * setting;
+
+	mock = calloc(1, sizeof(Mock));
+	if (NULL == mock) {
+		return NULL;
+	}
+
+	setting = getenv(MOCK_FAIL_ENV);
+	mock->failPercent = (NULL != setting)?(atoi(setting)):(0);
+	setting = getenv(MOCK_BUS_HZ_ENV);
+	mock->busHz = (NULL != setting)?(atol(setting)):(MOCK_BUS_HZ);
+	mock->seed = address;
+
+	// the models report the rover of roverSim.c instead of the recordings
+	if (I2CSourceSim == HalGetConfig()->i2c) {
+		sim = SimulationOpen();
+		if (NULL == sim) {
+			printf("roverSim is not running, %s is not simulated\n", name);
+		}
+	}
+
+	switch (address) {
+		case MOCK_GPS_ADDRESS:
+			mock->type = MockGps;
+			setting = getenv(MOCK_NMEA_ENV);
+			if (NULL != setting) {
+				mock->gps.script = MockLoadFile(setting, &mock->gps.scriptLength);
+				if (NULL == mock->gps.script) {
+					printf("error loading NMEA recording %s\n", setting);
+				}
+			}
+			mock->gps.nextBurst = MockNowNs();
+			mock->gps.sim = sim;
+			mock->gps.seed = address;
+			mock->gps.opened = MockNowNs();
+			setting = getenv(MOCK_GPS_TTFF_ENV);
+			mock->gps.ttff = (NULL != setting)?((long long)(atof(setting) * CLOCK_SECOND)):(0);
+			break;
+		case MOCK_GYRO_ADDRESS:
+			mock->type = MockGyro;
+			mock->gyro.opened = mock->gyro.fifoStart = MockNowNs();
+			mock->gyro.seed = address;
+			mock->gyro.sim = sim;
+			setting = getenv(MOCK_GYRO_ENV);
+			if (NULL != setting) {
+				MockLoadProfile(&mock->gyro.profile, setting);
+			}
+			break;
+		case MOCK_MAG_ADDRESS:
+			mock->type = MockMag;
+			mock->mag.opened = MockNowNs();
+			mock->mag.sim = sim;
+			setting = getenv(MOCK_GYRO_ENV);
+			if (NULL != setting) {
+				MockLoadProfile(&mock->mag.profile, setting);
+			}
+			break;
+		default:
+			free(mock);
+			return NULL;
+	}
+
+	printf("%s (0x%02X) on mock I2C\n", name, address);
+	return mock;
+}
+
+void I2CMockClose(void * mock)
+{
+	Mock * model = mock;
+
+	if (NULL == model) {
+		return;
+	}
+
+	if (MockGps == model->type) {
+		free(model->gps.script);
+	}
+	free(model);
+}
+
+int I2CMockTransfer(void * mock, struct i2c_msg * msgs, int count)
+{
+	Mock * model = mock;
+	long long bits = 0;
+	long long now;
+	int i;
+
+	// injected bus errors
+	if (model->failPercent > 0 && (rand_r(&model->seed) % 100) < model->failPercent) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	// release XA1110 bursts that are due
+	if (MockGps == model->type) {
+		now = MockNowNs();
+		while (now >= model->gps.nextBurst) {
+			MockGpsBurst(&model->gps);
+			model->gps.nextBurst += MOCK_GPS_PERIOD_MS * 1000000LL;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		if (MockGps == model->type) {
+			MockGpsMessage(&model->gps, &msgs[i]);
+		} else if (MockGyro == model->type) {
+			MockGyroMessage(&model->gyro, &msgs[i]);
+		} else {
+			MockMagMessage(&model->mag, &msgs[i]);
+		}
+
+		// start/address byte plus 9 clocks per data byte
+		bits += 10 + (9 * msgs[i].len);
+	}
+
+	// take as long as the bus would
+	if (model->busHz > 0) {
+		ClockSleep((bits * CLOCK_SECOND) / model->busHz);
+	}
+
+	return count;
+}
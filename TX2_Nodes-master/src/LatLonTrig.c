@@ -87,6 +87,34 @@ float DegreeTurnAndDirection(Position currentPosition,
 	return sign*(PI - DegreeTurn(dTraveled, dCurrentToDestination, dPreviousToDestination))*(180.0f/PI);
 }
 
+float Bearing(Position from, Position to)
+{
+	float longitudeDelta = TO_RAD(to.longitude - from.longitude);
+	float bearing;
+
+	bearing = atan2(sin(longitudeDelta) * cos(TO_RAD(to.latitude)),
+			(cos(TO_RAD(from.latitude)) * sin(TO_RAD(to.latitude))) -
+			(sin(TO_RAD(from.latitude)) * cos(TO_RAD(to.latitude)) * cos(longitudeDelta)));
+
+	bearing *= 180.0f / PI;
+
+	return (bearing < 0.0f)?(bearing + 360.0f):(bearing);
+}
+
+float HeadingTurn(float heading, float bearing)
+{
+	float turn = fmod(bearing - heading, 360.0f);
+
+	// take the short way round
+	if (turn > 180.0f) {
+		turn -= 360.0f;
+	} else if (turn <= -180.0f) {
+		turn += 360.0f;
+	}
+
+	return turn;
+}
+
 void PrintPosition(Position * position)
 {
 	printf("Latitude = %.6f, Longitude = %.6f\n", position->latitude, position->longitude);
@@ -0,0 +1,231 @@
+/**
+ * @file MaskClean.c
+ * @brief Function definitions for the MaskClean library.
+ * @details Function definitions for the MaskClean library.
+**/
+
+#include "../include/MaskClean.h"
+#include "../include/Clock.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MASK_SIMD 16					/**< Pixels per vector. */
+typedef uint8x16_t MaskVector;
+#define VECTOR_LOAD(p) vld1q_u8(p)
+#define VECTOR_STORE(p, v) vst1q_u8((p), (v))
+#define VECTOR_MIN(a, b) vminq_u8((a), (b))
+#define VECTOR_MAX(a, b) vmaxq_u8((a), (b))
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define MASK_SIMD 16					/**< Pixels per vector. */
+typedef __m128i MaskVector;
+#define VECTOR_LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+#define VECTOR_STORE(p, v) _mm_storeu_si128((__m128i *)(p), (v))
+#define VECTOR_MIN(a, b) _mm_min_epu8((a), (b))
+#define VECTOR_MAX(a, b) _mm_max_epu8((a), (b))
+#else
+#define MASK_SIMD 0					/**< No vectors, plain C. */
+#endif
+
+/**
+ * @brief Internal function that takes the minimum or maximum of size pixels along each row.
+ * @details Each row is first copied into row with its edge pixels repeated radius times on
+ *	    either side, so every output pixel is the same run of loads.
+**/
+void RowPass(uint8_t * in, uint8_t * out, uint8_t * row, int width, int rows, int radius, int dilate)
+{
+	uint8_t * source;
+	uint8_t * target;
+	uint8_t value;
+	int size = (2 * radius) + 1;
+	int x, y, j;
+#if MASK_SIMD
+	MaskVector vector;
+#endif
+
+	for (y = 0; y < rows; y++) {
+		source = in + ((long)y * width);
+		target = out + ((long)y * width);
+
+		memset(row, source[0], radius);
+		memcpy(row + radius, source, width);
+		memset(row + radius + width, source[width - 1], radius);
+
+		x = 0;
+#if MASK_SIMD
+		for (; x + MASK_SIMD <= width; x += MASK_SIMD) {
+			vector = VECTOR_LOAD(row + x);
+			if (dilate) {
+				for (j = 1; j < size; j++) {
+					vector = VECTOR_MAX(vector, VECTOR_LOAD(row + x + j));
+				}
+			} else {
+				for (j = 1; j < size; j++) {
+					vector = VECTOR_MIN(vector, VECTOR_LOAD(row + x + j));
+				}
+			}
+			VECTOR_STORE(target + x, vector);
+		}
+#endif
+		// what is left of the row
+		for (; x < width; x++) {
+			value = row[x];
+			for (j = 1; j < size; j++) {
+				if ((dilate && row[x + j] > value) || (!dilate && row[x + j] < value)) {
+					value = row[x + j];
+				}
+			}
+			target[x] = value;
+		}
+	}
+}
+
+/**
+ * @brief Internal function that takes the minimum or maximum of size pixels down each column.
+ * @details Rows are contiguous, so a vector holds 16 columns of one row.
+**/
+void ColumnPass(uint8_t * in, uint8_t * out, int width, int rows, int radius, int dilate)
+{
+	uint8_t * lines[(2 * MASK_MAX_KERNEL) + 1];
+	uint8_t * target;
+	uint8_t value;
+	int size = (2 * radius) + 1;
+	int x, y, j, line;
+#if MASK_SIMD
+	MaskVector vector;
+#endif
+
+	for (y = 0; y < rows; y++) {
+		// the rows around this one, the edge rows repeated
+		for (j = 0; j < size; j++) {
+			line = y - radius + j;
+			line = (line < 0)?(0):((line >= rows)?(rows - 1):(line));
+			lines[j] = in + ((long)line * width);
+		}
+		target = out + ((long)y * width);
+
+		x = 0;
+#if MASK_SIMD
+		for (; x + MASK_SIMD <= width; x += MASK_SIMD) {
+			vector = VECTOR_LOAD(lines[0] + x);
+			if (dilate) {
+				for (j = 1; j < size; j++) {
+					vector = VECTOR_MAX(vector, VECTOR_LOAD(lines[j] + x));
+				}
+			} else {
+				for (j = 1; j < size; j++) {
+					vector = VECTOR_MIN(vector, VECTOR_LOAD(lines[j] + x));
+				}
+			}
+			VECTOR_STORE(target + x, vector);
+		}
+#endif
+		for (; x < width; x++) {
+			value = lines[0][x];
+			for (j = 1; j < size; j++) {
+				if ((dilate && lines[j][x] > value) || (!dilate && lines[j][x] < value)) {
+					value = lines[j][x];
+				}
+			}
+			target[x] = value;
+		}
+	}
+}
+
+void MaskMorph(uint8_t * in, uint8_t * out, uint8_t * temp, uint8_t * row, int width, int rows, int radius, int dilate)
+{
+	RowPass(in, temp, row, width, rows, radius, dilate);
+	ColumnPass(temp, out, width, rows, radius, dilate);
+}
+
+int MaskCleanInit(MaskClean * clean, int width, int height)
+{
+	memset(clean, 0, sizeof(MaskClean));
+	clean->width = width;
+	clean->height = height;
+
+	clean->buffers[0] = malloc((size_t)width * height);
+	clean->buffers[1] = malloc((size_t)width * height);
+	clean->row = malloc(width + MASK_MAX_KERNEL);
+
+	if (NULL == clean->buffers[0] || NULL == clean->buffers[1] || NULL == clean->row) {
+		printf("out of memory for mask cleanup\n");
+		MaskCleanClose(clean);
+		return -1;
+	}
+
+	return 0;
+}
+
+void MaskCleanSetSizes(MaskClean * clean, int openSize, int closeSize)
+{
+	openSize = (openSize > MASK_MAX_KERNEL)?(MASK_MAX_KERNEL):(openSize);
+	closeSize = (closeSize > MASK_MAX_KERNEL)?(MASK_MAX_KERNEL):(closeSize);
+
+	clean->openRadius = (openSize > 1)?(openSize / 2):(0);
+	clean->closeRadius = (closeSize > 1)?(closeSize / 2):(0);
+}
+
+uint8_t * MaskCleanApply(MaskClean * clean, uint8_t * mask, int firstRow)
+{
+	uint8_t * a;
+	uint8_t * b;
+	uint8_t * in;
+	long long start;
+	long long elapsed;
+	long offset;
+	int rows;
+	int first;
+
+	if (0 == clean->openRadius && 0 == clean->closeRadius) {
+		return mask;
+	}
+
+	start = ClockMonotonicNs();
+
+	// each pass spreads the rows it repeats at its top edge by its radius
+	first = firstRow - (2 * clean->openRadius) - (2 * clean->closeRadius);
+	first = (first < 0)?(0):(first);
+	rows = clean->height - first;
+	offset = (long)first * clean->width;
+
+	a = clean->buffers[0] + offset;
+	b = clean->buffers[1] + offset;
+	in = mask + offset;
+
+	// every step ends in b
+	if (clean->openRadius) {
+		MaskMorph(in, b, a, clean->row, clean->width, rows, clean->openRadius, 0);
+		MaskMorph(b, b, a, clean->row, clean->width, rows, clean->openRadius, 1);
+		in = b;
+	}
+
+	if (clean->closeRadius) {
+		MaskMorph(in, b, a, clean->row, clean->width, rows, clean->closeRadius, 1);
+		MaskMorph(b, b, a, clean->row, clean->width, rows, clean->closeRadius, 0);
+	}
+
+	elapsed = ClockMonotonicNs() - start;
+	clean->stats.masks++;
+	clean->stats.cleanNs += elapsed;
+	if (elapsed > clean->stats.maxNs) {
+		clean->stats.maxNs = elapsed;
+	}
+
+	return clean->buffers[1];
+}
+
+void MaskCleanGetStats(MaskClean * clean, MaskCleanStats * stats)
+{
+	memcpy(stats, &clean->stats, sizeof(MaskCleanStats));
+}
+
+void MaskCleanClose(MaskClean * clean)
+{
+	free(clean->buffers[0]);
+	free(clean->buffers[1]);
+	free(clean->row);
+	clean->buffers[0] = NULL;
+	clean->buffers[1] = NULL;
+	clean->row = NULL;
+}
@@ -0,0 +1,505 @@
+/**
+ * @file MaskKernel.c
+ * @brief Function definitions for the MaskKernel library.
+ * @details Function definitions for the MaskKernel library.
+**/
+
+#include <unistd.h>
+#include <fcntl.h>
+#include "../include/MaskKernel.h"
+#include "../include/Clock.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MASK_KERNEL_SIMD 16				/**< Pixels per vector. */
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define MASK_KERNEL_SIMD 16				/**< Pixels per vector. */
+#else
+#define MASK_KERNEL_SIMD 0				/**< No vectors, spans-simd is no candidate. */
+#endif
+
+#define MASK_KERNEL_LINE 256		/**< Longest cache line. */
+#define MASK_KERNEL_LINES 64		/**< Cache lines kept, the oldest are dropped. */
+#define MASK_KERNEL_BATCH 8		/**< Masks timed at once. */
+#define MASK_KERNEL_TOLERANCE 1e-4	/**< Difference from scalar a candidate may have, relative. */
+
+/**
+ * @brief Names of the #MaskKernelId values, as in the cache.
+**/
+char * maskKernelNames[MaskKernelCount] = { "scalar", "fused", "spans", "spans-simd" };
+
+/**
+ * @brief Internal function that reads the model of the board, or of the CPU where there is no device tree.
+**/
+void MaskKernelReadCpu(char * cpu)
+{
+	char line[256];
+	char * value;
+	FILE * file;
+	int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int length;
+
+	strcpy(cpu, "unknown");
+
+	// the TX2 and the Pi name themselves here, "NVIDIA Jetson TX2" for one
+	file = fopen("/proc/device-tree/model", "r");
+	if (NULL != file) {
+		length = fread(line, 1, sizeof(line) - 1, file);
+		line[(length > 0)?(length):(0)] = '\0';
+		fclose(file);
+		if (length > 0) {
+			snprintf(cpu, MASK_KERNEL_CPU - 16, "%.*s", MASK_KERNEL_CPU - 17, line);
+		}
+	} else if (NULL != (file = fopen("/proc/cpuinfo", "r"))) {
+		while (NULL != fgets(line, sizeof(line), file)) {
+			value = strchr(line, ':');
+			if (NULL != value && (0 == strncmp(line, "model name", 10) || 0 == strncmp(line, "CPU part", 8))) {
+				value += strspn(value + 1, " \t") + 1;
+				snprintf(cpu, MASK_KERNEL_CPU - 16, "%.*s", MASK_KERNEL_CPU - 17, value);
+				break;
+			}
+		}
+		fclose(file);
+	}
+
+	// one line, and the number of cores, a board with fewer enabled is another board here
+	cpu[strcspn(cpu, "\r\n")] = '\0';
+	length = strlen(cpu);
+	snprintf(cpu + length, MASK_KERNEL_CPU - length, " x%d", cpus);
+}
+
+/**
+ * @brief Internal function that breaks a filter into runs of one weight, zeros left out.
+ * @return The number of runs, -1 if out of memory.
+**/
+int MaskKernelFindSpans(FILTER_TYPE * filter, int length, MaskSpan ** spans)
+{
+	MaskSpan * grown;
+	int count = 0, size = 64;
+	int index = 0, end;
+
+	*spans = malloc(size * sizeof(MaskSpan));
+	if (NULL == *spans) {
+		return -1;
+	}
+
+	while (index < length) {
+		if (0 == filter[index]) {
+			index++;
+			continue;
+		}
+
+		for (end = index + 1; end < length && filter[end] == filter[index]; end++);
+
+		if (count == size) {
+			// *spans is kept on failure, freed with the rest
+			grown = realloc(*spans, 2 * size * sizeof(MaskSpan));
+			if (NULL == grown) {
+				return -1;
+			}
+			*spans = grown;
+			size *= 2;
+		}
+		(*spans)[count].start = index;
+		(*spans)[count].length = end - index;
+		(*spans)[count].weight = filter[index];
+		count++;
+		index = end;
+	}
+
+	return count;
+}
+
+/**
+ * @brief Internal function, a pass over the half mask for each filter.
+**/
+void KernelScalar(MaskKernels * kernels, uint8_t * half, FILTER_TYPE * dots)
+{
+	FILTER_TYPE dotProduct;
+	FILTER_TYPE * filter;
+	int index, i;
+
+	for (i = 0; i < MASK_KERNEL_FILTERS; i++) {
+		filter = kernels->filters[i];
+		dotProduct = 0;
+		for (index = 0; index < kernels->length; index++) {
+			dotProduct += half[index] * filter[index];
+		}
+		dots[i] = dotProduct;
+	}
+}
+
+/**
+ * @brief Internal function, one pass taking the three dot products.
+**/
+void KernelFused(MaskKernels * kernels, uint8_t * half, FILTER_TYPE * dots)
+{
+	FILTER_TYPE * first = kernels->filters[0];
+	FILTER_TYPE * second = kernels->filters[1];
+	FILTER_TYPE * third = kernels->filters[2];
+	FILTER_TYPE a = 0, b = 0, c = 0;
+	int index;
+
+	for (index = 0; index < kernels->length; index++) {
+		a += half[index] * first[index];
+		b += half[index] * second[index];
+		c += half[index] * third[index];
+	}
+
+	dots[0] = a;
+	dots[1] = b;
+	dots[2] = c;
+}
+
+/**
+ * @brief Internal function, the pixels of each run summed and multiplied by its weight.
+**/
+void KernelSpans(MaskKernels * kernels, uint8_t * half, FILTER_TYPE * dots)
+{
+	MaskSpan * span;
+	uint8_t * pixels;
+	unsigned int sum;
+	double dot;
+	int i, j, k;
+
+	for (i = 0; i < MASK_KERNEL_FILTERS; i++) {
+		dot = 0.0;
+		for (j = 0; j < kernels->spanCount[i]; j++) {
+			span = &kernels->spans[i][j];
+			pixels = half + span->start;
+			sum = 0;
+			for (k = 0; k < span->length; k++) {
+				sum += pixels[k];
+			}
+			dot += (double)span->weight * sum;
+		}
+		dots[i] = (FILTER_TYPE)dot;
+	}
+}
+
+/**
+ * @brief Internal function, as #KernelSpans() with the pixels summed 16 at a time.
+**/
+void KernelSpansSimd(MaskKernels * kernels, uint8_t * half, FILTER_TYPE * dots)
+{
+#if MASK_KERNEL_SIMD
+	MaskSpan * span;
+	uint8_t * pixels;
+	unsigned int sum;
+	double dot;
+	int i, j, k;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+	uint16x8_t wide;
+	uint64x2_t total;
+	int n;
+#else
+	__m128i zero = _mm_setzero_si128();
+	__m128i total;
+#endif
+
+	for (i = 0; i < MASK_KERNEL_FILTERS; i++) {
+		dot = 0.0;
+		for (j = 0; j < kernels->spanCount[i]; j++) {
+			span = &kernels->spans[i][j];
+			pixels = half + span->start;
+			k = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+			// pairs of pixels into 16 bits, 128 vectors before a lane could overflow
+			sum = 0;
+			while (k + MASK_KERNEL_SIMD <= span->length) {
+				wide = vdupq_n_u16(0);
+				for (n = 0; n < 128 && k + MASK_KERNEL_SIMD <= span->length; n++, k += MASK_KERNEL_SIMD) {
+					wide = vpadalq_u8(wide, vld1q_u8(pixels + k));
+				}
+				total = vpaddlq_u32(vpaddlq_u16(wide));
+				sum += (unsigned int)(vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1));
+			}
+#else
+			// sums of absolute differences from 0, two 64 bit sums of 8 pixels each
+			total = zero;
+			for (; k + MASK_KERNEL_SIMD <= span->length; k += MASK_KERNEL_SIMD) {
+				total = _mm_add_epi64(total, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(pixels + k)), zero));
+			}
+			sum = _mm_cvtsi128_si32(total) + _mm_cvtsi128_si32(_mm_srli_si128(total, 8));
+#endif
+			// what is left of the run
+			for (; k < span->length; k++) {
+				sum += pixels[k];
+			}
+			dot += (double)span->weight * sum;
+		}
+		dots[i] = (FILTER_TYPE)dot;
+	}
+#else
+	KernelSpans(kernels, half, dots);
+#endif
+}
+
+/**
+ * @brief Internal function that makes the synthetic mask the kernels are timed on.
+ * @details Runs of classes of random lengths, the same every time, so nothing can be skipped.
+**/
+void MaskKernelSynthetic(uint8_t * mask, int size)
+{
+	unsigned int state = 12345;
+	uint8_t value = 0;
+	int run = 0;
+	int i;
+
+	for (i = 0; i < size; i++) {
+		if (0 == run) {
+			state = (state * 1103515245) + 12345;
+			value = (state >> 16) % 21;
+			run = 1 + ((state >> 8) % 32);
+		}
+		mask[i] = value;
+		run--;
+	}
+}
+
+/**
+ * @brief Internal function that times the candidates and chooses the fastest.
+**/
+void MaskKernelTime(MaskKernels * kernels)
+{
+	FILTER_TYPE reference[MASK_KERNEL_FILTERS];
+	FILTER_TYPE dots[MASK_KERNEL_FILTERS];
+	uint8_t * mask;
+	long long start, end, elapsed, best;
+	int kernel, i, n;
+	int agrees;
+
+	mask = malloc((long)kernels->width * kernels->height);
+	if (NULL == mask) {
+		kernels->kernel = MaskKernelScalar;
+		return;
+	}
+	MaskKernelSynthetic(mask, kernels->width * kernels->height);
+	MaskKernelApplyWith(kernels, MaskKernelScalar, mask, reference);
+
+	kernels->kernel = MaskKernelScalar;
+	for (kernel = 0; kernel < MaskKernelCount; kernel++) {
+		kernels->stats.kernelNs[kernel] = 0;
+		if (MaskKernelSpansSimd == kernel && !MASK_KERNEL_SIMD) {
+			continue;
+		}
+
+		// a kernel that gets other dot products is no candidate
+		MaskKernelApplyWith(kernels, kernel, mask, dots);
+		agrees = 1;
+		for (i = 0; i < MASK_KERNEL_FILTERS; i++) {
+			agrees &= fabs(dots[i] - reference[i]) <= MASK_KERNEL_TOLERANCE * (fabs(reference[i]) + 1.0);
+		}
+		if (!agrees) {
+			printf("MASK KERNEL %s DISAGREES WITH %s\n", maskKernelNames[kernel], maskKernelNames[MaskKernelScalar]);
+			continue;
+		}
+
+		// the best batch, what the kernel does when nothing gets in its way
+		best = 0;
+		start = ClockMonotonicNs();
+		end = start + MASK_KERNEL_TUNE_NS;
+		do {
+			elapsed = ClockMonotonicNs();
+			for (n = 0; n < MASK_KERNEL_BATCH; n++) {
+				MaskKernelApplyWith(kernels, kernel, mask, dots);
+			}
+			elapsed = (ClockMonotonicNs() - elapsed) / MASK_KERNEL_BATCH;
+			best = (0 == best || elapsed < best)?(elapsed):(best);
+		} while (ClockMonotonicNs() < end);
+
+		kernels->stats.kernelNs[kernel] = (best > 0)?(best):(1);
+		if (best < kernels->stats.kernelNs[kernels->kernel] || 0 == kernels->stats.kernelNs[kernels->kernel]) {
+			kernels->kernel = kernel;
+		}
+	}
+
+	free(mask);
+}
+
+/**
+ * @brief Internal function that reads the kernel chosen for this resolution and CPU.
+ * @return The #MaskKernelId, -1 if there is none.
+**/
+int MaskKernelLoad(MaskKernels * kernels, char * cacheFile)
+{
+	char line[MASK_KERNEL_LINE];
+	char name[32];
+	FILE * file;
+	long long ns;
+	int version, width, height, offset;
+	int kernel = -1;
+	int i;
+
+	file = fopen(cacheFile, "r");
+	if (NULL == file) {
+		return -1;
+	}
+
+	// "version width height kernel ns cpu"
+	while (NULL != fgets(line, sizeof(line), file)) {
+		line[strcspn(line, "\r\n")] = '\0';
+		if (5 != sscanf(line, "%d %d %d %31s %lld %n", &version, &width, &height, name, &ns, &offset) ||
+		    MASK_KERNEL_VERSION != version || width != kernels->width || height != kernels->height ||
+		    0 != strcmp(line + offset, kernels->cpu)) {
+			continue;
+		}
+		for (i = 0; i < MaskKernelCount; i++) {
+			if (0 == strcmp(name, maskKernelNames[i]) && (MaskKernelSpansSimd != i || MASK_KERNEL_SIMD)) {
+				kernel = i;
+				kernels->stats.kernelNs[i] = ns;
+			}
+		}
+	}
+
+	fclose(file);
+	return kernel;
+}
+
+/**
+ * @brief Internal function that keeps the choice, replacing the line of the same resolution and CPU.
+**/
+void MaskKernelSave(MaskKernels * kernels, char * cacheFile)
+{
+	char lines[MASK_KERNEL_LINES][MASK_KERNEL_LINE];
+	char temporary[512];
+	char line[MASK_KERNEL_LINE];
+	char name[32];
+	FILE * file;
+	long long ns;
+	int version, width, height, offset;
+	int count = 0;
+	int i;
+
+	// the other lines, as they are
+	file = fopen(cacheFile, "r");
+	while (NULL != file && NULL != fgets(line, sizeof(line), file)) {
+		line[strcspn(line, "\r\n")] = '\0';
+		if (5 == sscanf(line, "%d %d %d %31s %lld %n", &version, &width, &height, name, &ns, &offset) &&
+		    width == kernels->width && height == kernels->height && 0 == strcmp(line + offset, kernels->cpu)) {
+			continue;
+		}
+		if ('\0' != line[0]) {
+			if (MASK_KERNEL_LINES - 1 == count) {
+				memmove(lines[0], lines[1], (count - 1) * MASK_KERNEL_LINE);
+				count--;
+			}
+			strcpy(lines[count++], line);
+		}
+	}
+	if (NULL != file) {
+		fclose(file);
+	}
+
+	// written whole and renamed over the old one, nav can be killed at any time
+	snprintf(temporary, sizeof(temporary), "%s.new", cacheFile);
+	file = fopen(temporary, "w");
+	if (NULL == file) {
+		printf("MASK KERNEL CACHE %s COULD NOT BE WRITTEN\n", cacheFile);
+		return;
+	}
+	for (i = 0; i < count; i++) {
+		fprintf(file, "%s\n", lines[i]);
+	}
+	fprintf(file, "%d %d %d %s %lld %s\n", MASK_KERNEL_VERSION, kernels->width, kernels->height,
+		maskKernelNames[kernels->kernel], kernels->stats.kernelNs[kernels->kernel], kernels->cpu);
+	fclose(file);
+	rename(temporary, cacheFile);
+}
+
+int MaskKernelInit(MaskKernels * kernels, int width, int height, FILTER_TYPE ** filters)
+{
+	int i;
+
+	memset(kernels, 0, sizeof(MaskKernels));
+	kernels->width = width;
+	kernels->height = height;
+	kernels->offset = (width * height) / 2;
+	kernels->length = (width * height) / 2;
+	kernels->kernel = MaskKernelScalar;
+
+	for (i = 0; i < MASK_KERNEL_FILTERS; i++) {
+		kernels->filters[i] = filters[i];
+		kernels->spanCount[i] = MaskKernelFindSpans(filters[i], kernels->length, &kernels->spans[i]);
+		if (kernels->spanCount[i] < 0) {
+			return -1;
+		}
+	}
+
+	MaskKernelReadCpu(kernels->cpu);
+
+	return 0;
+}
+
+int MaskKernelTune(MaskKernels * kernels, char * cacheFile, int force)
+{
+	long long start = ClockMonotonicNs();
+	int kernel = -1;
+
+	force = force || NULL != getenv(MASK_KERNEL_RETUNE_ENV);
+	if (NULL != cacheFile && !force) {
+		kernel = MaskKernelLoad(kernels, cacheFile);
+	}
+
+	kernels->stats.cached = (kernel >= 0);
+	if (kernel >= 0) {
+		kernels->kernel = kernel;
+	} else {
+		MaskKernelTime(kernels);
+		if (NULL != cacheFile) {
+			MaskKernelSave(kernels, cacheFile);
+		}
+	}
+
+	kernels->stats.tuneNs = ClockMonotonicNs() - start;
+
+	return kernels->kernel;
+}
+
+void MaskKernelApply(MaskKernels * kernels, uint8_t * mask, FILTER_TYPE * dots)
+{
+	MaskKernelApplyWith(kernels, kernels->kernel, mask, dots);
+}
+
+void MaskKernelApplyWith(MaskKernels * kernels, int kernel, uint8_t * mask, FILTER_TYPE * dots)
+{
+	// only the lower half, anything above the horizon isn't going to tell us where to drive
+	uint8_t * half = mask + kernels->offset;
+
+	switch (kernel) {
+		case MaskKernelFused:
+			KernelFused(kernels, half, dots);
+			break;
+		case MaskKernelSpans:
+			KernelSpans(kernels, half, dots);
+			break;
+		case MaskKernelSpansSimd:
+			KernelSpansSimd(kernels, half, dots);
+			break;
+		default:
+			KernelScalar(kernels, half, dots);
+			break;
+	}
+}
+
+char * MaskKernelName(int kernel)
+{
+	return (kernel >= 0 && kernel < MaskKernelCount)?(maskKernelNames[kernel]):("unknown");
+}
+
+void MaskKernelGetStats(MaskKernels * kernels, MaskKernelStats * stats)
+{
+	memcpy(stats, &kernels->stats, sizeof(MaskKernelStats));
+}
+
+void MaskKernelClose(MaskKernels * kernels)
+{
+	int i;
+
+	for (i = 0; i < MASK_KERNEL_FILTERS; i++) {
+		free(kernels->spans[i]);
+		kernels->spans[i] = NULL;
+		kernels->spanCount[i] = 0;
+	}
+}
@@ -7,6 +7,7 @@
 **/
 
 #include "../include/Messages.h"
+#include "../include/Clock.h"
 
 /**
  * @brief Internal array for library to keep track of file descriptors
@@ -23,11 +24,6 @@ int maxFileDescriptor;
 **/
 int fdCount;
 
-/**
- * @brief Struct for defining timeouts.
-**/
-struct timespec timeout;
-
 void SetupSetAndWait(int * fd, int count)
 {
 	int i;
@@ -79,6 +75,12 @@ void CopyMessage(Message * destination, Message * source)
 }
 
 int SetAndWait(fd_set * rdfs, long seconds, long nanoSeconds)
+{
+	// the timeout is on the clock, which may not be the wall
+	return SetAndWaitUntil(rdfs, ClockNowNs() + (seconds * CLOCK_SECOND) + nanoSeconds);
+}
+
+int SetAndWaitUntil(fd_set * rdfs, long long when)
 {
 	int i;
 		
@@ -90,10 +92,32 @@ int SetAndWait(fd_set * rdfs, long seconds, long nanoSeconds)
 		FD_SET(fileDescriptors[i], rdfs);
 	}
 
-	// set timeout values
-	timeout.tv_sec  = seconds;
-	timeout.tv_nsec = nanoSeconds;
-
 	// block here until we either timeout or a file descriptor becomes available to read.
-	return pselect(maxFileDescriptor + 1, rdfs, NULL, NULL, &timeout, NULL);	
+	return ClockWait(maxFileDescriptor, rdfs, when);
+}
+
+int SendMessage(int fd, Message * message)
+{
+	int status;
+
+	// counted until it is read, see Clock.h. First, the reader may be quicker than us
+	ClockMessageSent();
+
+	status = write(fd, message, sizeof(Message));
+	if (sizeof(Message) != status) {
+		ClockMessageReceived();
+	}
+
+	return status;
+}
+
+int ReceiveMessage(int fd, Message * message)
+{
+	int status = read(fd, message, sizeof(Message));
+
+	if (sizeof(Message) == status) {
+		ClockMessageReceived();
+	}
+
+	return status;
 }
@@ -0,0 +1,90 @@
+/**
+ * @file NavCheckpoint.c
+ * @brief Function definitions for the NavCheckpoint library.
+ * @details Function definitions for the NavCheckpoint library.
+**/
+
+#include "../include/NavCheckpoint.h"
+
+void NavCheckpointReset(NavCheckpoint * checkpoint, NavState * state, long long now)
+{
+	// the magic last, a nav killed before then leaves nothing to take over
+	memset(checkpoint, 0, sizeof(NavCheckpoint));
+	checkpoint->version = NAV_CHECKPOINT_VERSION;
+	checkpoint->size = sizeof(NavState);
+	checkpoint->time = now;
+	memcpy(&checkpoint->state, state, sizeof(NavState));
+	__sync_synchronize();
+	checkpoint->magic = NAV_CHECKPOINT_MAGIC;
+	checkpoint->sequence = 2;
+}
+
+int NavCheckpointRestore(NavCheckpoint * checkpoint, NavState * state)
+{
+	unsigned int sequence;
+
+	if (NAV_CHECKPOINT_MAGIC != checkpoint->magic || NAV_CHECKPOINT_VERSION != checkpoint->version ||
+	    sizeof(NavState) != checkpoint->size) {
+		return -1;
+	}
+
+	// the writer is dead, an odd sequence is a save it never finished
+	sequence = checkpoint->sequence;
+	if (sequence & 1) {
+		printf("nav checkpoint torn, sequence %u\n", sequence);
+		return -1;
+	}
+
+	__sync_synchronize();
+	memcpy(state, &checkpoint->state, sizeof(NavState));
+	__sync_synchronize();
+
+	if (sequence != checkpoint->sequence) {
+		return -1;
+	}
+
+	checkpoint->stats.restores++;
+
+	return 0;
+}
+
+int NavCheckpointSave(NavCheckpoint * checkpoint, NavState * state, long long now)
+{
+	uint8_t * from = (uint8_t *)state;
+	uint8_t * to = (uint8_t *)&checkpoint->state;
+	int offset;
+	int length;
+	int blocks = 0;
+
+	checkpoint->stats.saves++;
+
+	for (offset = 0; offset < (int)sizeof(NavState); offset += NAV_CHECKPOINT_BLOCK) {
+		length = ((int)sizeof(NavState) - offset < NAV_CHECKPOINT_BLOCK)?((int)sizeof(NavState) - offset):(NAV_CHECKPOINT_BLOCK);
+		if (0 == memcmp(from + offset, to + offset, length)) {
+			continue;
+		}
+
+		// odd from the first block written
+		if (0 == blocks) {
+			checkpoint->sequence++;
+			__sync_synchronize();
+		}
+		memcpy(to + offset, from + offset, length);
+		blocks++;
+	}
+
+	if (blocks) {
+		checkpoint->time = now;
+		__sync_synchronize();
+		checkpoint->sequence++;
+		checkpoint->stats.writes++;
+		checkpoint->stats.blocks += blocks;
+	}
+
+	return blocks;
+}
+
+void NavCheckpointGetStats(NavCheckpoint * checkpoint, NavCheckpointStats * stats)
+{
+	memcpy(stats, &checkpoint->stats, sizeof(NavCheckpointStats));
+}
@@ -0,0 +1,349 @@
+/**
+ * @file Obstacles.c
+ * @brief Function definitions for the Obstacles library.
+ * @details Function definitions for the Obstacles library.
+**/
+
+#include "../include/Obstacles.h"
+#include "../include/Clock.h"
+
+#define GROUND_CALIBRATION_ROWS 64	/**< Most "row" lines read from a calibration file. */
+
+/**
+ * @brief Internal function that works out the row to distance table of the default camera.
+ * @details The ray through the middle of each row, pitched down by the tilt, meets flat ground
+ *	    #OBSTACLE_CAMERA_MOUNT below the camera, as SimulationRender() draws it.
+**/
+void DefaultGround(ObstacleFinder * finder)
+{
+	double tilt = OBSTACLE_CAMERA_TILT * (M_PI / 180.0);
+	double v, down, forward;
+	int row;
+
+	finder->focal = (finder->width / 2.0) / tan((OBSTACLE_CAMERA_FOV / 2.0) * (M_PI / 180.0));
+
+	for (row = 0; row < finder->height; row++) {
+		v = (row + 0.5 - (finder->height / 2.0)) / finder->focal;
+		down = sin(tilt) + (cos(tilt) * v);
+		forward = cos(tilt) - (sin(tilt) * v);
+		finder->rowDistance[row] = (down > 0.0)?(OBSTACLE_CAMERA_MOUNT * forward / down):(-1.0f);
+	}
+}
+
+/**
+ * @brief Internal function that reads the row to distance table from a calibration file.
+ * @details Rows between two "row" lines are interpolated in 1 / meters, rows past the first or
+ *	    last line are extrapolated from the two nearest lines, up to the horizon.
+ * @return 0 on success, 1 if the file is missing, -1 if it is unusable.
+**/
+int LoadGround(ObstacleFinder * finder, char * fileName)
+{
+	FILE * file;
+	char line[128];
+	int rows[GROUND_CALIBRATION_ROWS];
+	double inverse[GROUND_CALIBRATION_ROWS];
+	double fov = OBSTACLE_CAMERA_FOV;
+	double meters, value;
+	int count = 0;
+	int row, i, j;
+
+	file = fopen(fileName, "r");
+	if (NULL == file) {
+		return 1;
+	}
+
+	while (NULL != fgets(line, sizeof(line), file)) {
+		if (1 == sscanf(line, "fov %lf", &fov)) {
+			continue;
+		}
+		if (2 != sscanf(line, "row %d %lf", &row, &meters)) {
+			continue;
+		}
+		if (row < 0 || row >= finder->height || meters <= 0.0 || count == GROUND_CALIBRATION_ROWS) {
+			printf("%s: skipping %s", fileName, line);
+			continue;
+		}
+
+		// keep them in row order
+		for (i = count; i > 0 && rows[i - 1] > row; i--) {
+			rows[i] = rows[i - 1];
+			inverse[i] = inverse[i - 1];
+		}
+		rows[i] = row;
+		inverse[i] = 1.0 / meters;
+		count++;
+	}
+
+	fclose(file);
+
+	if (count < 2 || fov <= 0.0 || fov >= 180.0) {
+		printf("%s needs a fov and two rows\n", fileName);
+		return -1;
+	}
+
+	finder->focal = (finder->width / 2.0) / tan((fov / 2.0) * (M_PI / 180.0));
+
+	for (row = 0, j = 0; row < finder->height; row++) {
+		// the two lines around row, or the two nearest
+		while (j < count - 2 && rows[j + 1] < row) {
+			j++;
+		}
+		if (rows[j + 1] == rows[j]) {
+			value = inverse[j];
+		} else {
+			value = inverse[j] + ((inverse[j + 1] - inverse[j]) * (row - rows[j]) / (rows[j + 1] - rows[j]));
+		}
+		finder->rowDistance[row] = (value > 0.0)?(1.0 / value):(-1.0f);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Internal function that finds the component of a run, halving the path on the way.
+**/
+int FindRoot(ObstacleRun * runs, int run)
+{
+	while (runs[run].parent != run) {
+		runs[run].parent = runs[runs[run].parent].parent;
+		run = runs[run].parent;
+	}
+	return run;
+}
+
+/**
+ * @brief Internal function that joins the components of two runs.
+ * @details The root is always the lower run, so a parent comes before its runs.
+**/
+void JoinRuns(ObstacleRun * runs, int a, int b)
+{
+	a = FindRoot(runs, a);
+	b = FindRoot(runs, b);
+
+	if (a < b) {
+		runs[b].parent = a;
+	} else if (b < a) {
+		runs[a].parent = b;
+	}
+}
+
+/**
+ * @brief Internal function that orders obstacles nearest first, those with no distance last.
+**/
+int CompareObstacles(const void * a, const void * b)
+{
+	const Obstacle * first = (const Obstacle *)a;
+	const Obstacle * second = (const Obstacle *)b;
+
+	if ((first->distance < 0.0f) != (second->distance < 0.0f)) {
+		return (first->distance < 0.0f)?(1):(-1);
+	}
+	if (first->distance != second->distance) {
+		return (first->distance < second->distance)?(-1):(1);
+	}
+	return second->area - first->area;
+}
+
+int ObstacleFinderInit(ObstacleFinder * finder, int width, int height, char * calibrationFile)
+{
+	int label, status;
+
+	memset(finder, 0, sizeof(ObstacleFinder));
+	finder->width = width;
+	finder->height = height;
+
+	for (label = 0; label < 32; label++) {
+		finder->classes[label] = (OBSTACLE_CLASSES >> label) & 1;
+	}
+
+	// a run needs a gap after it, so a row has at most (width + 1) / 2
+	finder->maxRuns = ((width + 1) / 2) * height;
+	finder->rowDistance = malloc(height * sizeof(float));
+	finder->runs = malloc(finder->maxRuns * sizeof(ObstacleRun));
+	finder->components = malloc(finder->maxRuns * sizeof(Obstacle));
+
+	if (NULL == finder->rowDistance || NULL == finder->runs || NULL == finder->components) {
+		printf("out of memory for obstacles\n");
+		ObstacleFinderClose(finder);
+		return -1;
+	}
+
+	status = LoadGround(finder, calibrationFile);
+	if (status < 0) {
+		ObstacleFinderClose(finder);
+		return -1;
+	} else if (status > 0) {
+		DefaultGround(finder);
+	}
+
+	return 0;
+}
+
+void ObstacleSetMinArea(ObstacleFinder * finder, int minArea)
+{
+	finder->minArea = minArea;
+}
+
+int ObstacleFind(ObstacleFinder * finder, uint8_t * mask, int firstRow, long long time, ObstacleList * list)
+{
+	ObstacleRun * runs = finder->runs;
+	Obstacle * components = finder->components;
+	Obstacle * component;
+	uint8_t * line;
+	long long start;
+	long long elapsed;
+	int above, aboveEnd;
+	int count = 0;
+	int found = 0;
+	int x, y, i, j, root;
+
+	start = ClockMonotonicNs();
+
+	firstRow = (firstRow < 0)?(0):(firstRow);
+	above = aboveEnd = 0;
+
+	for (y = firstRow; y < finder->height; y++) {
+		line = mask + ((long)y * finder->width);
+		i = count;
+
+		for (x = 0; x < finder->width; x++) {
+			if (!finder->classes[line[x]]) {
+				continue;
+			}
+
+			runs[count].start = x;
+			while (x + 1 < finder->width && finder->classes[line[x + 1]]) {
+				x++;
+			}
+			runs[count].end = x;
+			runs[count].row = y;
+			runs[count].parent = count;
+
+			// join the runs of the row above it touches, corners included
+			while (above < aboveEnd && runs[above].end < runs[count].start - 1) {
+				above++;
+			}
+			for (j = above; j < aboveEnd && runs[j].start <= runs[count].end + 1; j++) {
+				JoinRuns(runs, count, j);
+			}
+
+			count++;
+		}
+
+		// this row is the row above the next
+		above = i;
+		aboveEnd = count;
+	}
+
+	// every parent comes first, so one pass takes each run to its root and adds it up
+	for (i = 0; i < count; i++) {
+		root = runs[i].parent = runs[runs[i].parent].parent;
+		component = &components[root];
+
+		if (root == i) {
+			component->left = runs[i].start;
+			component->right = runs[i].end;
+			component->top = runs[i].row;
+			component->bottom = -1;
+			component->area = 0;
+		}
+
+		component->area += runs[i].end - runs[i].start + 1;
+		component->left = (runs[i].start < component->left)?(runs[i].start):(component->left);
+		component->right = (runs[i].end > component->right)?(runs[i].end):(component->right);
+
+		// runs come in row then column order
+		if (runs[i].row > component->bottom) {
+			component->bottom = runs[i].row;
+			component->contactLeft = runs[i].start;
+			component->label = mask[((long)runs[i].row * finder->width) + runs[i].start];
+		}
+		component->contactRight = runs[i].end;
+	}
+
+	// large enough roots, moved to the front
+	for (i = 0; i < count; i++) {
+		component = &components[i];
+		if (runs[i].parent != i || component->area < finder->minArea) {
+			continue;
+		}
+
+		component->contact = (component->contactLeft + component->contactRight) / 2;
+		component->bearing = atan2(component->contact + 0.5 - (finder->width / 2.0), finder->focal) * (180.0 / M_PI);
+		component->distance = finder->rowDistance[component->bottom];
+		if (component->distance > 0.0f) {
+			// the table is straight ahead
+			component->distance /= cos(component->bearing * (M_PI / 180.0));
+		}
+
+		memmove(&components[found], component, sizeof(Obstacle));
+		found++;
+	}
+
+	qsort(components, found, sizeof(Obstacle), CompareObstacles);
+
+	list->frame = finder->frame++;
+	list->time = time;
+	list->width = finder->width;
+	list->height = finder->height;
+	list->found = found;
+	list->count = (found > OBSTACLE_MAX)?(OBSTACLE_MAX):(found);
+	memcpy(list->obstacles, components, list->count * sizeof(Obstacle));
+
+	elapsed = ClockMonotonicNs() - start;
+	finder->stats.masks++;
+	finder->stats.runs += count;
+	finder->stats.findNs += elapsed;
+	if (elapsed > finder->stats.maxNs) {
+		finder->stats.maxNs = elapsed;
+	}
+
+	return found;
+}
+
+float ObstacleRowDistance(ObstacleFinder * finder, int row)
+{
+	return (row < 0 || row >= finder->height)?(-1.0f):(finder->rowDistance[row]);
+}
+
+void ObstacleGetStats(ObstacleFinder * finder, ObstacleStats * stats)
+{
+	memcpy(stats, &finder->stats, sizeof(ObstacleStats));
+}
+
+void ObstacleFinderClose(ObstacleFinder * finder)
+{
+	free(finder->rowDistance);
+	free(finder->runs);
+	free(finder->components);
+	finder->rowDistance = NULL;
+	finder->runs = NULL;
+	finder->components = NULL;
+}
+
+void PublishObstacles(ObstacleShared * shared, ObstacleList * list)
+{
+	// odd while writing
+	shared->sequence++;
+	__sync_synchronize();
+	memcpy(&shared->list, list, sizeof(ObstacleList) - ((OBSTACLE_MAX - list->count) * sizeof(Obstacle)));
+	__sync_synchronize();
+	shared->sequence++;
+}
+
+int GetObstacles(ObstacleShared * shared, ObstacleList * list)
+{
+	unsigned int sequence;
+
+	do {
+		sequence = shared->sequence;
+		if (0 == sequence) {
+			return -1;
+		}
+		__sync_synchronize();
+		memcpy(list, &shared->list, sizeof(ObstacleList));
+		__sync_synchronize();
+	} while ((sequence & 1) || sequence != shared->sequence);
+
+	return 0;
+}
@@ -0,0 +1,297 @@
+/**
+ * @file Orientation.c
+ * @brief Function definitions for the Orientation library.
+ * @details Function definitions for the Orientation library. The filter is the Mahony
+ *	    complementary filter on a quaternion. The magnetometer part differs from the usual
+ *	    one: it only corrects the heading, by the angle between the horizontal field and north,
+ *	    so disturbances in the field do not tilt the estimate and the correction does not
+ *	    weaken with the dip of the field.
+**/
+
+#include "../include/Orientation.h"
+
+#define DEG_TO_RAD (3.14159265f / 180.0f)
+#define RAD_TO_DEG (180.0f / 3.14159265f)
+
+int LoadMagCalibration(char * fileName, MagCalibration * calibration)
+{
+	FILE * file;
+	char line[128];
+	int found = 0;
+
+	file = fopen(fileName, "r");
+	if (NULL == file) {
+		return -1;
+	}
+
+	while (NULL != fgets(line, sizeof(line), file)) {
+		if (3 == sscanf(line, "offset %f %f %f", &calibration->offset[0], &calibration->offset[1], &calibration->offset[2])) {
+			found |= 1;
+		} else if (3 == sscanf(line, "scale %f %f %f", &calibration->scale[0], &calibration->scale[1], &calibration->scale[2])) {
+			found |= 2;
+		}
+	}
+
+	fclose(file);
+
+	return (3 == found)?(0):(-1);
+}
+
+int SaveMagCalibration(char * fileName, MagCalibration * calibration)
+{
+	FILE * file;
+
+	file = fopen(fileName, "w");
+	if (NULL == file) {
+		return -1;
+	}
+
+	fprintf(file, "# LSM9DS1 magnetometer calibration, calibrated = (raw - offset) * scale\n");
+	fprintf(file, "offset %.5f %.5f %.5f\n", calibration->offset[0], calibration->offset[1], calibration->offset[2]);
+	fprintf(file, "scale %.5f %.5f %.5f\n", calibration->scale[0], calibration->scale[1], calibration->scale[2]);
+
+	return (0 == fclose(file))?(0):(-1);
+}
+
+void ApplyMagCalibration(MagCalibration * calibration, float * field, float * out)
+{
+	int axis;
+
+	for (axis = 0; axis < 3; axis++) {
+		out[axis] = (field[axis] - calibration->offset[axis]) * calibration->scale[axis];
+	}
+}
+
+void InitMagCalibrator(MagCalibrator * calibrator)
+{
+	memset(calibrator, 0, sizeof(MagCalibrator));
+}
+
+void AddMagCalibration(MagCalibrator * calibrator, float * field, double heading)
+{
+	int axis;
+
+	if (0 == calibrator->samples) {
+		memcpy(calibrator->min, field, sizeof(calibrator->min));
+		memcpy(calibrator->max, field, sizeof(calibrator->max));
+		calibrator->minHeading = calibrator->maxHeading = heading;
+	}
+
+	for (axis = 0; axis < 3; axis++) {
+		calibrator->min[axis] = (field[axis] < calibrator->min[axis])?(field[axis]):(calibrator->min[axis]);
+		calibrator->max[axis] = (field[axis] > calibrator->max[axis])?(field[axis]):(calibrator->max[axis]);
+	}
+
+	calibrator->minHeading = (heading < calibrator->minHeading)?(heading):(calibrator->minHeading);
+	calibrator->maxHeading = (heading > calibrator->maxHeading)?(heading):(calibrator->maxHeading);
+	calibrator->samples++;
+}
+
+int MagCalibrationReady(MagCalibrator * calibrator, MagCalibration * calibration)
+{
+	float span[3];
+	float average;
+	int axis;
+
+	for (axis = 0; axis < 3; axis++) {
+		span[axis] = calibrator->max[axis] - calibrator->min[axis];
+	}
+
+	if (calibrator->maxHeading - calibrator->minHeading < MAG_CAL_TURN ||
+	    span[0] < MAG_CAL_MIN_SPAN || span[1] < MAG_CAL_MIN_SPAN) {
+		return -1;
+	}
+
+	average = (span[0] + span[1]) / 2.0f;
+
+	for (axis = 0; axis < 2; axis++) {
+		calibration->offset[axis] = (calibrator->max[axis] + calibrator->min[axis]) / 2.0f;
+		calibration->scale[axis] = average / span[axis];
+	}
+
+	// Z only moves if the rover tilts
+	if (span[2] >= MAG_CAL_MIN_SPAN) {
+		calibration->offset[2] = (calibrator->max[2] + calibrator->min[2]) / 2.0f;
+		calibration->scale[2] = average / span[2];
+	} else {
+		calibration->offset[2] = 0.0f;
+		calibration->scale[2] = 1.0f;
+	}
+
+	return 0;
+}
+
+void InitOrientation(OrientationFilter * filter, float declination)
+{
+	memset(filter, 0, sizeof(OrientationFilter));
+	filter->declination = declination;
+	filter->q[0] = 1.0f;
+	filter->settleTime = ORIENTATION_SETTLE_TIME;
+}
+
+void UpdateOrientation(OrientationFilter * filter, GyroSample * sample, float * mag)
+{
+	float q0 = filter->q[0], q1 = filter->q[1], q2 = filter->q[2], q3 = filter->q[3];
+	float gx, gy, gz;
+	float ax, ay, az;
+	float mx, my, mz;
+	float vx, vy, vz;
+	float hx, hy;
+	float headingError;
+	float ex = 0.0f, ey = 0.0f, ez = 0.0f;
+	float norm, kp, dt;
+	float qa, qb, qc;
+
+	dt = (filter->lastTime)?((sample->time - filter->lastTime) / 1000000000.0f):(1.0f / GYRO_ODR_HZ);
+	if (dt <= 0.0f) {
+		dt = 1.0f / GYRO_ODR_HZ;
+	}
+	filter->lastTime = sample->time;
+
+	gx = sample->rate[0] * DEG_TO_RAD;
+	gy = sample->rate[1] * DEG_TO_RAD;
+	gz = sample->rate[2] * DEG_TO_RAD;
+
+	// up, as the current estimate sees it in the body frame
+	vx = 2.0f * ((q1 * q3) - (q0 * q2));
+	vy = 2.0f * ((q0 * q1) + (q2 * q3));
+	vz = (q0 * q0) - (q1 * q1) - (q2 * q2) + (q3 * q3);
+
+	// gravity, the accelerometer reads +1 g up when level
+	norm = (sample->accel[0] * sample->accel[0]) + (sample->accel[1] * sample->accel[1]) + (sample->accel[2] * sample->accel[2]);
+	if (norm > 0.0f) {
+		norm = 1.0f / sqrtf(norm);
+		ax = sample->accel[0] * norm;
+		ay = sample->accel[1] * norm;
+		az = sample->accel[2] * norm;
+
+		ex = (ay * vz) - (az * vy);
+		ey = (az * vx) - (ax * vz);
+		ez = (ax * vy) - (ay * vx);
+	}
+
+	filter->magUsed = 0;
+
+	if (NULL != mag) {
+		norm = sqrtf((mag[0] * mag[0]) + (mag[1] * mag[1]) + (mag[2] * mag[2]));
+
+		if (0.0f == filter->magStrength) {
+			filter->magStrength = norm;
+		}
+
+		// skip readings disturbed by motors or steel nearby
+		if (norm > 0.0f && fabsf(norm - filter->magStrength) < MAG_REJECT * filter->magStrength) {
+			filter->magStrength += (norm - filter->magStrength) * 0.01f;
+			filter->magUsed = 1;
+
+			mx = mag[0];
+			my = mag[1];
+			mz = mag[2];
+
+			// horizontal field in the earth frame, it points due north when the heading is right
+			hx = 2.0f * ((mx * (0.5f - (q2 * q2) - (q3 * q3))) + (my * ((q1 * q2) - (q0 * q3))) + (mz * ((q1 * q3) + (q0 * q2))));
+			hy = 2.0f * ((mx * ((q1 * q2) + (q0 * q3))) + (my * (0.5f - (q1 * q1) - (q3 * q3))) + (mz * ((q2 * q3) - (q0 * q1))));
+			norm = sqrtf((hx * hx) + (hy * hy));
+
+			if (norm > 0.0f) {
+				// sine of the heading error, saturated past 90 degrees so a reversed
+				// estimate still turns the right way
+				headingError = -hy / norm;
+				if (hx < 0.0f) {
+					headingError = (hy > 0.0f)?(-1.0f):(1.0f);
+				}
+
+				// correct about the vertical only, roll and pitch are left to gravity
+				ex += vx * headingError;
+				ey += vy * headingError;
+				ez += vz * headingError;
+			}
+		}
+	}
+
+	// converge quickly after a reset, then trust the gyro
+	if (filter->settleTime > 0.0) {
+		kp = ORIENTATION_SETTLE_KP;
+		filter->settleTime -= dt;
+	} else {
+		kp = ORIENTATION_KP;
+		filter->integral[0] += ORIENTATION_KI * ex * dt;
+		filter->integral[1] += ORIENTATION_KI * ey * dt;
+		filter->integral[2] += ORIENTATION_KI * ez * dt;
+	}
+
+	gx += (kp * ex) + filter->integral[0];
+	gy += (kp * ey) + filter->integral[1];
+	gz += (kp * ez) + filter->integral[2];
+
+	// integrate the quaternion rate
+	gx *= 0.5f * dt;
+	gy *= 0.5f * dt;
+	gz *= 0.5f * dt;
+	qa = q0;
+	qb = q1;
+	qc = q2;
+	q0 += (-qb * gx) - (qc * gy) - (q3 * gz);
+	q1 += (qa * gx) + (qc * gz) - (q3 * gy);
+	q2 += (qa * gy) - (qb * gz) + (q3 * gx);
+	q3 += (qa * gz) + (qb * gy) - (qc * gx);
+
+	norm = 1.0f / sqrtf((q0 * q0) + (q1 * q1) + (q2 * q2) + (q3 * q3));
+	filter->q[0] = q0 * norm;
+	filter->q[1] = q1 * norm;
+	filter->q[2] = q2 * norm;
+	filter->q[3] = q3 * norm;
+}
+
+void GetFilterOrientation(OrientationFilter * filter, int magValid, OrientationSample * out)
+{
+	float q0 = filter->q[0], q1 = filter->q[1], q2 = filter->q[2], q3 = filter->q[3];
+	float yaw;
+	float sinPitch;
+	int axis;
+
+	out->time = filter->lastTime;
+	memcpy(out->q, filter->q, sizeof(out->q));
+
+	out->roll = atan2f(2.0f * ((q0 * q1) + (q2 * q3)), 1.0f - (2.0f * ((q1 * q1) + (q2 * q2)))) * RAD_TO_DEG;
+	sinPitch = 2.0f * ((q0 * q2) - (q3 * q1));
+	sinPitch = (sinPitch > 1.0f)?(1.0f):((sinPitch < -1.0f)?(-1.0f):(sinPitch));
+	out->pitch = asinf(sinPitch) * RAD_TO_DEG;
+
+	// yaw is counter clockwise from magnetic north, headings go clockwise from true north
+	yaw = atan2f(2.0f * ((q1 * q2) + (q0 * q3)), 1.0f - (2.0f * ((q2 * q2) + (q3 * q3)))) * RAD_TO_DEG;
+	out->heading = fmodf(filter->declination - yaw + 720.0f, 360.0f);
+
+	for (axis = 0; axis < 3; axis++) {
+		out->bias[axis] = -filter->integral[axis] * RAD_TO_DEG;
+	}
+
+	out->magValid = magValid;
+}
+
+void PublishOrientation(OrientationShared * shared, OrientationSample * sample)
+{
+	// odd while writing
+	shared->sequence++;
+	__sync_synchronize();
+	memcpy(&shared->sample, sample, sizeof(OrientationSample));
+	__sync_synchronize();
+	shared->sequence++;
+}
+
+int GetOrientation(OrientationShared * shared, OrientationSample * sample)
+{
+	unsigned int sequence;
+
+	do {
+		sequence = shared->sequence;
+		if (0 == sequence) {
+			return -1;
+		}
+		__sync_synchronize();
+		memcpy(sample, &shared->sample, sizeof(OrientationSample));
+		__sync_synchronize();
+	} while ((sequence & 1) || sequence != shared->sequence);
+
+	return 0;
+}
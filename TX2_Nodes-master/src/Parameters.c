@@ -6,158 +6,438 @@
  * @details Function definitions for Parameters library.
 **/
 
+#include <ctype.h>
+#include <math.h>
 #include "../include/Parameters.h"
+#include "../include/FilterGen.h"
+#include "../include/MaskClean.h"
+#include "../include/Obstacles.h"
+#include "../include/Watchdog.h"
+#include "../include/Governor.h"
 
 /**
- * @brief Internal function used to read through file until next value is reached.
- * @details Internal function used to read through file until next value is reached.
- *	    The values in these viles are colon delimited, and are comprised of human 
- *	    readable ascii values. As an example, here is a snippet from Parameters.txt.
- *	    <br><br><center>
- *          centerDotProductValueCount     :1
- *	    turningWeight                  :0.70
- *	    distanceFromPreviousThreshold  :5.25
- *	    <br><br></center>
- *	    This function simply reads up to the next value.
- * @param fd The file descriptor for Parameters.txt.
+ * @brief Types a parameter can have.
 **/
-void GetToNextValue(int fd) {
-	char temp;
+typedef enum _ParameterType {
+	ParameterFloat,
+	ParameterInt,
+	ParameterFlag,		// int, 0 or 1
+	ParameterChoice		// int, the index of the name given in the choices list
+} ParameterType;
 
-	read(fd, &temp, 1);
+/**
+ * @brief Internal description of one parameter in Parameters.txt.
+**/
+typedef struct _ParameterInfo {
+	char * name;		// name in Parameters.txt, the same as in #Parameters
+	char * oldName;		// name used by older Parameters.txt files, NULL if none
+	ParameterType type;
+	size_t offset;		// offset of the value in #Parameters
+	double min;		// allowed range, inclusive
+	double max;
+	char ** choices;	// #ParameterChoice names, NULL terminated, the first is the default
+} ParameterInfo;
+
+/**
+ * @brief Names of the #CanBackend values.
+**/
+char * canBackendNames[] = { "socketcan", "vcan", "none", "sim", NULL };
+
+/**
+ * @brief Names of the #I2CSource values.
+**/
+char * i2cBackendNames[] = { "device", "mock", "replay", "sim", NULL };
 
-	// read until next value or EOF
-	while (!EOF || temp != ':') {
-		read(fd, &temp, 1);
-        }
+/**
+ * @brief Names of the #CameraBackend values.
+**/
+char * cameraBackendNames[] = { "jetson", "v4l2", "replay", "sim", NULL };
+
+/**
+ * @brief Names of the #ClockBackend values.
+**/
+char * clockBackendNames[] = { "monotonic", "boottime", "sim", "virtual", NULL };
+
+/**
+ * @brief Every parameter in Parameters.txt.
+**/
+ParameterInfo parameterTable[] = {
+	{ "distanceToGoThreshold", NULL, ParameterFloat, offsetof(Parameters, distanceToGoThreshold), 0.1, 1000.0, NULL },
+	{ "distanceFromStartThreshold", NULL, ParameterFloat, offsetof(Parameters, distanceFromStartThreshold), 0.0, 1000.0, NULL },
+	{ "angleToTurnThreshold", "angleToTurnThresholdi", ParameterFloat, offsetof(Parameters, angleToTurnThreshold), 0.0, 360.0, NULL },
+	{ "dotProductThreshold", "centerDPThreshold", ParameterFloat, offsetof(Parameters, dotProductThreshold), 0.0, 1000.0, NULL },
+	{ "sideDotProductValueCount", NULL, ParameterInt, offsetof(Parameters, sideDotProductValueCount), 1, VALUES_TO_AVG, NULL },
+	{ "centerDotProductValueCount", NULL, ParameterInt, offsetof(Parameters, centerDotProductValueCount), 1, VALUES_TO_AVG, NULL },
+	{ "turningWeight", NULL, ParameterFloat, offsetof(Parameters, turningWeight), 0.0, 1.0, NULL },
+	{ "distanceFromPreviousThreshold", NULL, ParameterFloat, offsetof(Parameters, distanceFromPreviousThreshold), 0.0, 1000.0, NULL },
+	{ "turningAngle", "turnAngle", ParameterFloat, offsetof(Parameters, turningAngle), 0.0, 360.0, NULL },
+	{ "multiTurnThreshold", "multiTurnThresh", ParameterFloat, offsetof(Parameters, multiTurnThreshold), 0.0, 100.0, NULL },
+	{ "usingGps", NULL, ParameterFlag, offsetof(Parameters, usingGps), 0, 1, NULL },
+	{ "manual", NULL, ParameterFlag, offsetof(Parameters, manual), 0, 1, NULL },
+	{ "maskOpenSize", NULL, ParameterInt, offsetof(Parameters, maskOpenSize), 0, MASK_MAX_KERNEL, NULL },
+	{ "maskCloseSize", NULL, ParameterInt, offsetof(Parameters, maskCloseSize), 0, MASK_MAX_KERNEL, NULL },
+	{ "obstacleMinArea", NULL, ParameterInt, offsetof(Parameters, obstacleMinArea), 0, OBSTACLE_MAX_AREA, NULL },
+	{ "walkwayLookahead", NULL, ParameterFloat, offsetof(Parameters, walkwayLookahead), 0.0, 100.0, NULL },
+	{ "watchdogMaskMs", NULL, ParameterInt, offsetof(Parameters, watchdogMaskMs), 0, WATCHDOG_MAX_DEADLINE, NULL },
+	{ "watchdogPoseMs", NULL, ParameterInt, offsetof(Parameters, watchdogPoseMs), 0, WATCHDOG_MAX_DEADLINE, NULL },
+	{ "watchdogGyroMs", NULL, ParameterInt, offsetof(Parameters, watchdogGyroMs), 0, WATCHDOG_MAX_DEADLINE, NULL },
+	{ "motorStop", NULL, ParameterFlag, offsetof(Parameters, motorStop), 0, 1, NULL },
+	{ "motorMoveMs", NULL, ParameterInt, offsetof(Parameters, motorMoveMs), 0, 10000, NULL },
+	{ "governorMinHz", NULL, ParameterFloat, offsetof(Parameters, governorMinHz), 0.5, GOVERNOR_MAX_HZ, NULL },
+	{ "governorMaxHz", NULL, ParameterFloat, offsetof(Parameters, governorMaxHz), 0.5, GOVERNOR_MAX_HZ, NULL },
+	{ "governorMetersPerMask", NULL, ParameterFloat, offsetof(Parameters, governorMetersPerMask), 0.0, 10.0, NULL },
+	{ "governorSpeed", NULL, ParameterFloat, offsetof(Parameters, governorSpeed), 0.0, 10.0, NULL },
+	{ "governorThrottleC", NULL, ParameterInt, offsetof(Parameters, governorThrottleC), 0, 150, NULL },
+	{ "governorCriticalC", NULL, ParameterInt, offsetof(Parameters, governorCriticalC), 0, 150, NULL },
+	{ "magDeclination", NULL, ParameterFloat, offsetof(Parameters, magDeclination), -180.0, 180.0, NULL },
+	{ "canBackend", NULL, ParameterChoice, offsetof(Parameters, hal.can), 0, 0, canBackendNames },
+	{ "i2cBackend", NULL, ParameterChoice, offsetof(Parameters, hal.i2c), 0, 0, i2cBackendNames },
+	{ "cameraBackend", NULL, ParameterChoice, offsetof(Parameters, hal.camera), 0, 0, cameraBackendNames },
+	{ "clockBackend", NULL, ParameterChoice, offsetof(Parameters, hal.clock), 0, 0, clockBackendNames }
+};
+
+/**
+ * @brief Number of entries in #parameterTable.
+**/
+#define PARAMETER_COUNT ((int)(sizeof(parameterTable) / sizeof(ParameterInfo)))
+
+/**
+ * @brief Internal function that stores the index of a #ParameterChoice name.
+ * @return 0 if the value was stored, 1 if it is not one of the choices.
+**/
+int SetChoice(char * fileName, int lineNumber, ParameterInfo * info, char * value, Parameters * parameters)
+{
+	int i;
+
+	for (i = 0; NULL != info->choices[i]; i++) {
+		if (0 == strcmp(value, info->choices[i])) {
+			*(int *)((char *)parameters + info->offset) = i;
+			return 0;
+		}
+	}
+
+	printf("%s:%d: %s is \"%s\", allowed", fileName, lineNumber, info->name, value);
+	for (i = 0; NULL != info->choices[i]; i++) {
+		printf(" %s", info->choices[i]);
+	}
+	printf("\n");
+
+	return 1;
 }
 
 /**
- * @brief Internal function used to convert from ASCII to float
- * @details Internal function used to convert from ASCII to float.
- * @param fd File descriptor for Parameters.txt.
- * @return Returns the converted float value.
- * @pre Expects the Parameters.txt read pointer to have been incremented 
- *	to a value that is a floating point value in ASCII format.
+ * @brief Internal function that checks and stores one value.
+ * @param fileName File name, for messages.
+ * @param lineNumber Line of the value, for messages.
+ * @param name Parameter name.
+ * @param value Value text.
+ * @param parameters Where the value is stored.
+ * @param seen Flags the parameters already given, indexed like #parameterTable.
+ * @return 0 if the value was stored, 1 if there was an error.
 **/
-float GetFloat(int fd)
+int SetParameter(char * fileName, int lineNumber, char * name, char * value, Parameters * parameters, int * seen)
 {
-	float floatTemp;
-	char tempChar;
-	float divider = 1.0f;
-	float sign;
+	ParameterInfo * info = NULL;
+	char * end;
+	double number;
+	int i;
 
-	floatTemp = 0.0f;
+	for (i = 0; i < PARAMETER_COUNT; i++) {
+		if (0 == strcmp(name, parameterTable[i].name) ||
+		    (NULL != parameterTable[i].oldName && 0 == strcmp(name, parameterTable[i].oldName))) {
+			info = &parameterTable[i];
+			break;
+		}
+	}
 
-	read(fd, &tempChar, 1);	
+	if (NULL == info) {
+		printf("%s:%d: unknown parameter %s\n", fileName, lineNumber, name);
+		return 1;
+	}
+
+	if (seen[i]) {
+		printf("%s:%d: %s is given twice\n", fileName, lineNumber, info->name);
+		return 1;
+	}
+
+	// given, even if the value is wrong, so it is not reported as missing as well
+	seen[i] = 1;
 
-	// is the value negative
-	if ('-' == tempChar) {
-		sign = -1.0f;
+	if (ParameterChoice == info->type) {
+		return SetChoice(fileName, lineNumber, info, value, parameters);
+	}
+
+	// the whole value must be a number
+	if (ParameterFloat == info->type) {
+		number = strtod(value, &end);
 	} else {
-		sign = 1.0f;
+		number = strtol(value, &end, 10);
+	}
+
+	if (end == value || '\0' != *end || !isfinite(number)) {
+		printf("%s:%d: %s needs %s value, not \"%s\"\n", fileName, lineNumber, info->name,
+		       (ParameterFloat == info->type)?("a number"):("an integer"), value);
+		return 1;
 	}
 
-	// get whatever is too the left of the decimal point
-	while (tempChar != '.') {
-		floatTemp += (floatTemp*10) + (tempChar - '0');
-		read(fd, &tempChar, 1);
+	if (number < info->min || number > info->max) {
+		printf("%s:%d: %s is %s, allowed %g to %g\n", fileName, lineNumber, info->name, value, info->min, info->max);
+		return 1;
 	}
 
-	read(fd, &tempChar, 1);
-	
-	// values are terminated via a new line character
-	// read in digits after the decimal point until this is reached.
-	while(tempChar != '\n') {
-		divider *= 0.1f;
-		floatTemp += divider*(tempChar - '0');
-		read(fd, &tempChar, 1);
+	if (ParameterFloat == info->type) {
+		*(float *)((char *)parameters + info->offset) = (float)number;
+	} else {
+		*(int *)((char *)parameters + info->offset) = (int)number;
 	}
 
-	// return converted value
-	return (sign*floatTemp);
+	return 0;
 }
 
 /**
- * @brief Internal function used to convert from ASCII to int. 
- * @details Internal function used to convert from ASCII to int.
- * @param fd File descriptor for Parameters.txt.
- * @return Returns the converted int value.
- * @pre Expects the Parameters.txt read pointer to have been incremented 
- *	to a value that is an integer value in ASCII format.
+ * @brief Internal function that copies a token, stopping at whitespace, ':', '=' or '#'.
+ * @return The position after the token.
 **/
-int GetInt(int fd)
+char * CopyToken(char * position, char * end, char * token, int size)
 {
-	int tempInt;
-	int sign;
-	char tempChar;
-
-	tempInt = 0;
+	int length = 0;
 
-	read(fd, &tempChar, 1);
-
-	// is the value negative?
-	if (tempChar == '-') {
-		sign = -1;
-		read(fd, &tempChar, 1);
-	} else {
-		sign = 1;
+	while (position < end && !isspace((unsigned char)*position) &&
+	       ':' != *position && '=' != *position && '#' != *position) {
+		if (length < size - 1) {
+			token[length++] = *position;
+		}
+		position++;
 	}
+	token[length] = '\0';
+
+	return position;
+}
 
-	// loop through until end of line and convert to binary
-	while(tempChar != '\n') {
-		tempInt = (tempInt * 10) + (tempChar - '0');
-		read(fd, &tempChar, 1);	
+/**
+ * @brief Internal function that skips spaces and tabs, but not the end of the line.
+**/
+char * SkipBlanks(char * position, char * end)
+{
+	while (position < end && (' ' == *position || '\t' == *position || '\r' == *position)) {
+		position++;
 	}
 
-	// return value
-	return (sign*tempInt);
+	return position;
 }
 
 int GetParameters(char * fileName, Parameters * parameters)
 {
+	Parameters values;
+	struct stat info;
+	char name[PARAMETER_NAME_LENGTH];
+	char value[32];
+	char * data;
+	char * position;
+	char * end;
+	int seen[PARAMETER_COUNT];
+	int lineNumber = 0;
+	int errors = 0;
 	int fd;
+	int i;
 
 	// open Parameters.txt
 	fd = open(fileName, O_RDONLY);
 
-	if (fd <= 0) {
+	if (fd < 0) {
 		return -1;
 	}
 
-	// Note that the values are expected to be in this order, and
-	// the order is not in any way validated. If something is out 
-	// of place, this will cease to work properly.
-	GetToNextValue(fd);
-	parameters->distanceToGoThreshold = GetFloat(fd);
-	GetToNextValue(fd);
-	parameters->distanceFromStartThreshold = GetFloat(fd);	
-	GetToNextValue(fd);
-	parameters->angleToTurnThreshold = GetFloat(fd);
-	GetToNextValue(fd);
-	parameters->dotProductThreshold = GetFloat(fd);
-	GetToNextValue(fd);
-	parameters->sideDotProductValueCount = GetInt(fd);
-	GetToNextValue(fd);
-	parameters->centerDotProductValueCount = GetInt(fd);
-	GetToNextValue(fd);
-	parameters->turningWeight = GetFloat(fd);
-	GetToNextValue(fd);
-	parameters->distanceFromPreviousThreshold = GetFloat(fd);
-	GetToNextValue(fd);
-	parameters->turningAngle = GetFloat(fd);
-	GetToNextValue(fd);
-	parameters->multiTurnThreshold = GetFloat(fd);
-	GetToNextValue(fd);
-	parameters->usingGps = GetInt(fd);
-	GetToNextValue(fd);
-	parameters->manual = GetInt(fd);
+	if (fstat(fd, &info) < 0 || 0 == info.st_size) {
+		close(fd);
+		return -1;
+	}
 
+	data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
 	close(fd);
 
+	if (MAP_FAILED == data) {
+		return -1;
+	}
+
+	memset(&values, 0, sizeof(values));
+	memset(seen, 0, sizeof(seen));
+
+	// one pass over the file, a line at a time
+	position = data;
+	end = data + info.st_size;
+
+	while (position < end) {
+		lineNumber++;
+		position = SkipBlanks(position, end);
+
+		// blank line or comment
+		if (position >= end || '\n' == *position || '#' == *position) {
+			while (position < end && '\n' != *position) {
+				position++;
+			}
+			position++;
+			continue;
+		}
+
+		position = CopyToken(position, end, name, sizeof(name));
+		position = SkipBlanks(position, end);
+
+		if (position >= end || (':' != *position && '=' != *position)) {
+			printf("%s:%d: expected \"name : value\"\n", fileName, lineNumber);
+			errors++;
+		} else {
+			position = SkipBlanks(position + 1, end);
+			position = CopyToken(position, end, value, sizeof(value));
+			position = SkipBlanks(position, end);
+
+			if (position < end && '\n' != *position && '#' != *position) {
+				printf("%s:%d: unexpected text after the value of %s\n", fileName, lineNumber, name);
+				errors++;
+			} else {
+				errors += SetParameter(fileName, lineNumber, name, value, &values, seen);
+			}
+		}
+
+		// on to the next line
+		while (position < end && '\n' != *position) {
+			position++;
+		}
+		position++;
+	}
+
+	munmap(data, info.st_size);
+
+	// choices left out keep the first one, memset above
+	for (i = 0; i < PARAMETER_COUNT; i++) {
+		if (!seen[i] && ParameterChoice != parameterTable[i].type) {
+			printf("%s: %s is missing\n", fileName, parameterTable[i].name);
+			errors++;
+		}
+	}
+
+	if (errors) {
+		return -1;
+	}
+
+	memcpy(parameters, &values, sizeof(Parameters));
+
+	return 0;
+}
+
+unsigned int PublishParameters(ParametersShared * shared, Parameters * parameters)
+{
+	ParameterSnapshot * snapshot;
+	unsigned int version = shared->version + 1;
+
+	// fill in the next slot, readers only use the slot of the current version
+	snapshot = &shared->snapshots[version % PARAMETER_SNAPSHOTS];
+	snapshot->version = version;
+	snapshot->loaded = time(NULL);
+	memcpy(&snapshot->values, parameters, sizeof(Parameters));
+
+	__sync_synchronize();
+	shared->version = version;
+
+	return version;
+}
+
+int ReloadParameters(ParametersShared * shared, char * fileName)
+{
+	Parameters parameters;
+	ParameterSnapshot current;
+
+	if (GetParameters(fileName, &parameters) < 0) {
+		return -1;
+	}
+
+	// saving the file without changes does not make a new version
+	if (0 == GetParameterSnapshot(shared, &current) &&
+	    0 == memcmp(&current.values, &parameters, sizeof(Parameters))) {
+		return 0;
+	}
+
+	PublishParameters(shared, &parameters);
+
+	return 1;
+}
+
+int GetParameterSnapshot(ParametersShared * shared, ParameterSnapshot * snapshot)
+{
+	unsigned int version;
+
+	do {
+		version = shared->version;
+		if (0 == version) {
+			return -1;
+		}
+
+		__sync_synchronize();
+		memcpy(snapshot, &shared->snapshots[version % PARAMETER_SNAPSHOTS], sizeof(ParameterSnapshot));
+		__sync_synchronize();
+
+	// the writer may have come all the way round to this slot while it was copied
+	} while (shared->version - version >= PARAMETER_SNAPSHOTS - 1 || snapshot->version != version);
+
 	return 0;
 }
 
+int WatchParameters(char * fileName)
+{
+	char directory[256];
+	char * slash;
+	int fd;
+
+	// watch the directory, editors often replace the file rather than write it
+	strncpy(directory, fileName, sizeof(directory) - 1);
+	directory[sizeof(directory) - 1] = '\0';
+	slash = strrchr(directory, '/');
+	if (NULL == slash) {
+		strcpy(directory, ".");
+	} else if (slash == directory) {
+		slash[1] = '\0';
+	} else {
+		*slash = '\0';
+	}
+
+	fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0) {
+		return -1;
+	}
+
+	if (inotify_add_watch(fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int ParametersChanged(int fd, char * fileName)
+{
+	char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	struct inotify_event * event;
+	char * baseName;
+	ssize_t length;
+	ssize_t i;
+	int changed = 0;
+
+	baseName = strrchr(fileName, '/');
+	baseName = (NULL == baseName)?(fileName):(baseName + 1);
+
+	// a save can cause several events, take them all at once
+	while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+		for (i = 0; i < length; i += sizeof(struct inotify_event) + event->len) {
+			event = (struct inotify_event *)(buffer + i);
+			if (event->len > 0 && 0 == strcmp(event->name, baseName)) {
+				changed = 1;
+			}
+		}
+	}
+
+	return changed;
+}
+
 void PrintParameters(Parameters * parameters)
 {
 	printf("dotProductThreshold = %.4f\n", parameters->dotProductThreshold);
@@ -172,4 +452,24 @@ void PrintParameters(Parameters * parameters)
 	printf("multiTurnThres = %.6f\n", parameters->multiTurnThreshold);
 	printf("usingGps = %s\n", (parameters->usingGps)?("True"):("False"));
 	printf("manual = %s\n", (parameters->manual)?("True"):("False"));
+	printf("maskOpenSize = %d\n", parameters->maskOpenSize);
+	printf("maskCloseSize = %d\n", parameters->maskCloseSize);
+	printf("obstacleMinArea = %d\n", parameters->obstacleMinArea);
+	printf("walkwayLookahead = %.6f\n", parameters->walkwayLookahead);
+	printf("watchdogMaskMs = %d\n", parameters->watchdogMaskMs);
+	printf("watchdogPoseMs = %d\n", parameters->watchdogPoseMs);
+	printf("watchdogGyroMs = %d\n", parameters->watchdogGyroMs);
+	printf("motorStop = %s\n", (parameters->motorStop)?("True"):("False"));
+	printf("motorMoveMs = %d\n", parameters->motorMoveMs);
+	printf("governorMinHz = %.6f\n", parameters->governorMinHz);
+	printf("governorMaxHz = %.6f\n", parameters->governorMaxHz);
+	printf("governorMetersPerMask = %.6f\n", parameters->governorMetersPerMask);
+	printf("governorSpeed = %.6f\n", parameters->governorSpeed);
+	printf("governorThrottleC = %d\n", parameters->governorThrottleC);
+	printf("governorCriticalC = %d\n", parameters->governorCriticalC);
+	printf("magDeclination = %.6f\n", parameters->magDeclination);
+	printf("canBackend = %s\n", canBackendNames[parameters->hal.can]);
+	printf("i2cBackend = %s\n", i2cBackendNames[parameters->hal.i2c]);
+	printf("cameraBackend = %s\n", cameraBackendNames[parameters->hal.camera]);
+	printf("clockBackend = %s\n", clockBackendNames[parameters->hal.clock]);
 }
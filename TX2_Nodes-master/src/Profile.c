@@ -0,0 +1,330 @@
+/**
+ * @file Profile.c
+ * @brief Function definitions for the Profile library.
+ * @details Function definitions for the Profile library.
+**/
+
+#include "../include/Profile.h"
+
+#define PROFILE_NOT_OPEN -2	/**< #profileGroup of a thread that has not opened its counters. */
+
+int profileOn = 0;
+
+/**
+ * @brief Name of the node, for printing.
+**/
+char profileNode[32];
+
+/**
+ * @brief Types and configs of the #ProfileCounter values.
+**/
+struct { int type; unsigned long long config; char * name; } profileEvents[ProfileCounters] = {
+	[ProfileTaskClock] = { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, "task-clock" },
+	[ProfileCycles] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles" },
+	[ProfileInstructions] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions" },
+	[ProfileCacheMisses] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache-misses" },
+	[ProfileBranchMisses] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch-misses" },
+	[ProfileContextSwitches] = { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "context-switches" }
+};
+
+/**
+ * @brief Counters that opened in the thread that called #ProfileInit().
+**/
+int profileAvailable[ProfileCounters];
+
+/**
+ * @brief The regions entered so far, in the order they were first entered.
+**/
+ProfileRegion * profileRegions[PROFILE_MAX_REGIONS];
+
+/**
+ * @brief Number of #profileRegions.
+**/
+volatile int profileRegionCount = 0;
+
+/**
+ * @brief Set by #PROFILE_DUMP_SIGNAL.
+**/
+volatile sig_atomic_t profileDumpRequested = 0;
+
+/**
+ * @brief Group leader of the calling thread's counters, -1 if they did not open.
+**/
+__thread int profileGroup = PROFILE_NOT_OPEN;
+
+/**
+ * @brief Where each #ProfileCounter is in a read of the calling thread's group, -1 if it did not open.
+**/
+__thread int profileSlots[ProfileCounters];
+
+/**
+ * @brief A read of a group, PERF_FORMAT_GROUP with both times.
+**/
+typedef struct _ProfileRead {
+	unsigned long long count;
+	unsigned long long enabled;
+	unsigned long long running;
+	unsigned long long values[ProfileCounters];
+} ProfileRead;
+
+/**
+ * @brief A region the calling thread is in.
+**/
+typedef struct _ProfileMark {
+	ProfileRegion * region;
+	unsigned long long start[ProfileCounters];	// read when the region was entered
+	unsigned long long startEnabled;		// the times the group was enabled and counting then
+	unsigned long long startRunning;
+} ProfileMark;
+
+/**
+ * @brief The regions the calling thread is in, the innermost last.
+**/
+__thread ProfileMark profileMarks[PROFILE_MAX_DEPTH];
+
+/**
+ * @brief Number of regions the calling thread is in, #profileMarks past #PROFILE_MAX_DEPTH.
+**/
+__thread int profileDepth = 0;
+
+/**
+ * @brief Internal function, perf_event_open(2) has no glibc wrapper.
+**/
+int ProfileOpenEvent(int counter, int group)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = profileEvents[counter].type;
+	attr.config = profileEvents[counter].config;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	// the node's own code, the software counters are counted by the kernel
+	attr.exclude_kernel = (PERF_TYPE_HARDWARE == attr.type);
+	attr.exclude_hv = 1;
+
+	// this thread, on any CPU, not left open in the nodes master starts
+	return syscall(SYS_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC);
+}
+
+/**
+ * @brief Internal function that opens the counters of the calling thread as one group.
+ * @return The number opened, 0 if not even the leader did.
+**/
+int ProfileOpenThread()
+{
+	int opened = 0;
+	int counter;
+	int fd;
+
+	for (counter = 0; counter < ProfileCounters; counter++) {
+		profileSlots[counter] = -1;
+	}
+
+	profileGroup = ProfileOpenEvent(ProfileTaskClock, -1);
+	if (profileGroup < 0) {
+		profileGroup = -1;
+		return 0;
+	}
+	profileSlots[ProfileTaskClock] = opened++;
+
+	for (counter = ProfileTaskClock + 1; counter < ProfileCounters; counter++) {
+		fd = ProfileOpenEvent(counter, profileGroup);
+		if (fd >= 0) {
+			profileSlots[counter] = opened++;
+		}
+	}
+
+	return opened;
+}
+
+/**
+ * @brief Internal function that reads the calling thread's group.
+ * @return 0 on success, -1 if it has no counters.
+**/
+int ProfileReadGroup(ProfileRead * values)
+{
+	if (PROFILE_NOT_OPEN == profileGroup) {
+		ProfileOpenThread();
+	}
+
+	if (profileGroup < 0 || read(profileGroup, values, sizeof(ProfileRead)) < (int)(3 * sizeof(unsigned long long))) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Internal function, the handler of #PROFILE_DUMP_SIGNAL. The regions are printed by the next #ProfileEnd().
+**/
+void ProfileDumpHandler(int signal)
+{
+	(void)signal;
+	profileDumpRequested = 1;
+}
+
+int ProfileInit(char * node)
+{
+	char * env = getenv(PROFILE_ENV);
+	char * match;
+	int length;
+	int counter;
+
+	if (NULL == env) {
+		return 0;
+	}
+
+	// the whole name, not a prefix of another
+	length = strlen(node);
+	match = strstr(env, node);
+	while (NULL != match && ((match != env && ',' != match[-1]) || ('\0' != match[length] && ',' != match[length]))) {
+		match = strstr(match + 1, node);
+	}
+	if (0 != strcmp(env, "all") && NULL == match) {
+		return 0;
+	}
+
+	snprintf(profileNode, sizeof(profileNode), "%s", node);
+
+	if (0 == ProfileOpenThread()) {
+		printf("profile %s: no performance counters, not profiled\n", profileNode);
+		return -1;
+	}
+
+	printf("profile %s:", profileNode);
+	for (counter = 0; counter < ProfileCounters; counter++) {
+		profileAvailable[counter] = (profileSlots[counter] >= 0);
+		printf(" %s%s", (profileAvailable[counter])?(""):("no "), profileEvents[counter].name);
+	}
+	printf("\n");
+
+	signal(PROFILE_DUMP_SIGNAL, ProfileDumpHandler);
+	atexit(ProfileDump);
+	profileOn = 1;
+
+	return 1;
+}
+
+void ProfileBegin(ProfileRegion * region)
+{
+	ProfileRead values;
+	ProfileMark * mark;
+	int counter;
+
+	// counted too deep, so the #ProfileEnd() of it still matches
+	if (profileDepth >= PROFILE_MAX_DEPTH) {
+		profileDepth++;
+		return;
+	}
+
+	mark = &profileMarks[profileDepth++];
+	mark->region = NULL;
+	if (ProfileReadGroup(&values) < 0) {
+		return;
+	}
+
+	// listed the first time, the regions of other threads too
+	if (!region->registered && __sync_bool_compare_and_swap(&region->registered, 0, 1)) {
+		counter = __sync_fetch_and_add(&profileRegionCount, 1);
+		if (counter < PROFILE_MAX_REGIONS) {
+			profileRegions[counter] = region;
+		}
+	}
+
+	mark->region = region;
+	for (counter = 0; counter < ProfileCounters; counter++) {
+		mark->start[counter] = (profileSlots[counter] >= 0)?(values.values[profileSlots[counter]]):(0);
+	}
+	mark->startEnabled = values.enabled;
+	mark->startRunning = values.running;
+}
+
+void ProfileEnd(ProfileRegion * region)
+{
+	ProfileRead values;
+	ProfileMark * mark;
+	unsigned long long enabled, running;
+	double scale;
+	int counter;
+
+	if (profileDepth <= 0) {
+		return;
+	}
+
+	// not counted, too deep, without counters or left out of order
+	profileDepth--;
+	if (profileDepth >= PROFILE_MAX_DEPTH) {
+		return;
+	}
+
+	mark = &profileMarks[profileDepth];
+	if (region != mark->region || ProfileReadGroup(&values) < 0) {
+		return;
+	}
+
+	// more groups than counters, the kernel takes turns and each counted part of the time
+	enabled = values.enabled - mark->startEnabled;
+	running = values.running - mark->startRunning;
+	scale = (running > 0 && running < enabled)?((double)enabled / running):(1.0);
+
+	// other threads may be adding to the same region
+	for (counter = 0; counter < ProfileCounters; counter++) {
+		if (profileSlots[counter] >= 0) {
+			__sync_fetch_and_add(&region->total[counter],
+					     (unsigned long long)((values.values[profileSlots[counter]] - mark->start[counter]) * scale));
+		}
+	}
+	__sync_fetch_and_add(&region->calls, 1);
+
+	if (profileDumpRequested) {
+		profileDumpRequested = 0;
+		ProfileDump();
+	}
+}
+
+/**
+ * @brief Internal function that prints a count per thousand instructions, "-" without both counters.
+**/
+void ProfilePerKilo(char * buffer, int size, ProfileRegion * region, int counter)
+{
+	if (!profileAvailable[counter] || !profileAvailable[ProfileInstructions] || 0 == region->total[ProfileInstructions]) {
+		snprintf(buffer, size, "-");
+	} else {
+		snprintf(buffer, size, "%.2f", 1000.0 * region->total[counter] / region->total[ProfileInstructions]);
+	}
+}
+
+void ProfileDump()
+{
+	ProfileRegion * region;
+	char ipc[16];
+	char cache[16];
+	char branch[16];
+	int count = (profileRegionCount < PROFILE_MAX_REGIONS)?(profileRegionCount):(PROFILE_MAX_REGIONS);
+	int i;
+
+	if (!profileOn) {
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		region = profileRegions[i];
+		if (0 == region->calls) {
+			continue;
+		}
+
+		if (profileAvailable[ProfileCycles] && profileAvailable[ProfileInstructions] && region->total[ProfileCycles] > 0) {
+			snprintf(ipc, sizeof(ipc), "%.2f", (double)region->total[ProfileInstructions] / region->total[ProfileCycles]);
+		} else {
+			snprintf(ipc, sizeof(ipc), "-");
+		}
+		ProfilePerKilo(cache, sizeof(cache), region, ProfileCacheMisses);
+		ProfilePerKilo(branch, sizeof(branch), region, ProfileBranchMisses);
+
+		printf("profile %s %s: %lu calls, %.1f us cpu/call, ipc %s, cache misses/k %s, branch misses/k %s, %.3f switches/call\n",
+			profileNode, region->name, region->calls, (region->total[ProfileTaskClock] / 1000.0) / region->calls,
+			ipc, cache, branch, (double)region->total[ProfileContextSwitches] / region->calls);
+	}
+	fflush(stdout);
+}
@@ -0,0 +1,451 @@
+/**
+ * @file Rtcm.c
+ * @brief Function definitions for the Rtcm library.
+ * @details Function definitions for the Rtcm library.
+**/
+
+#include "../include/Rtcm.h"
+#include "../include/Clock.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <termios.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+unsigned int RtcmCrc24q(uint8_t * data, int length)
+{
+	unsigned int crc = 0;
+	int i, bit;
+
+	for (i = 0; i < length; i++) {
+		crc ^= (unsigned int)data[i] << 16;
+		for (bit = 0; bit < 8; bit++) {
+			crc <<= 1;
+			if (crc & 0x1000000) {
+				crc ^= 0x1864CFB;
+			}
+		}
+	}
+
+	return crc & 0xFFFFFF;
+}
+
+int RtcmFrameLength(uint8_t * data, int length)
+{
+	if (length < 1) {
+		return 0;
+	}
+
+	// the 6 bits before the length are reserved, 0
+	if (RTCM_PREAMBLE != data[0] || (length > 1 && (data[1] & 0xFC))) {
+		return -1;
+	}
+
+	if (length < 3) {
+		return 0;
+	}
+
+	return (((data[1] & 0x03) << 8) | data[2]) + 6;
+}
+
+int RtcmMessageType(uint8_t * frame)
+{
+	return (frame[3] << 4) | (frame[4] >> 4);
+}
+
+/**
+ * @brief Internal function that queues a frame, dropping the oldest not being written if the queue is full.
+**/
+void RtcmQueue(RtcmStream * stream, uint8_t * frame, int length, long long now)
+{
+	RtcmFrame * slot;
+
+	if (RTCM_QUEUE_FRAMES == stream->queueCount) {
+		if (stream->written > 0) {
+			// the receiver has part of the head, the frame after it goes instead
+			memcpy(&stream->queue[(stream->queueHead + 1) % RTCM_QUEUE_FRAMES],
+			       &stream->queue[stream->queueHead], sizeof(RtcmFrame));
+		}
+		stream->queueHead = (stream->queueHead + 1) % RTCM_QUEUE_FRAMES;
+		stream->queueCount--;
+		stream->stats.dropped++;
+	}
+
+	slot = &stream->queue[(stream->queueHead + stream->queueCount) % RTCM_QUEUE_FRAMES];
+	memcpy(slot->data, frame, length);
+	slot->length = length;
+	slot->time = now;
+	stream->queueCount++;
+
+	stream->stats.frames++;
+	stream->stats.lastFrame = now;
+	stream->stats.lastType = RtcmMessageType(frame);
+}
+
+/**
+ * @brief Internal function that frames the bytes read.
+ * @return The frames queued.
+**/
+int RtcmFeed(RtcmStream * stream, uint8_t * data, int length, long long now)
+{
+	int frames = 0;
+	int used = 0;
+	int copy, frame, start;
+	unsigned int crc;
+
+	stream->stats.bytes += length;
+
+	while (used < length) {
+		copy = (int)sizeof(stream->pending) - stream->pendingLength;
+		copy = (copy > length - used)?(length - used):(copy);
+		memcpy(stream->pending + stream->pendingLength, data + used, copy);
+		stream->pendingLength += copy;
+		used += copy;
+
+		start = 0;
+		while (start < stream->pendingLength) {
+			frame = RtcmFrameLength(stream->pending + start, stream->pendingLength - start);
+			if (frame < 0) {
+				// resynchronize on the next preamble
+				stream->stats.skipped++;
+				start++;
+				continue;
+			}
+			if (0 == frame || start + frame > stream->pendingLength) {
+				break;
+			}
+
+			crc = (stream->pending[start + frame - 3] << 16) | (stream->pending[start + frame - 2] << 8) |
+			       stream->pending[start + frame - 1];
+			if (crc != RtcmCrc24q(stream->pending + start, frame - 3)) {
+				// a preamble in the data, or a damaged frame
+				stream->stats.crcErrors++;
+				stream->stats.skipped++;
+				start++;
+				continue;
+			}
+
+			RtcmQueue(stream, stream->pending + start, frame, now);
+			frames++;
+			start += frame;
+		}
+
+		memmove(stream->pending, stream->pending + start, stream->pendingLength - start);
+		stream->pendingLength -= start;
+	}
+
+	return frames;
+}
+
+/**
+ * @brief Internal function that returns the termios speed of a baud rate, 0 if there is none.
+**/
+speed_t RtcmSpeed(int baud)
+{
+	switch (baud) {
+		case 9600: return B9600;
+		case 19200: return B19200;
+		case 38400: return B38400;
+		case 57600: return B57600;
+		case 115200: return B115200;
+		case 230400: return B230400;
+		default: return 0;
+	}
+}
+
+/**
+ * @brief Internal function that connects a tcp or serial source, without blocking.
+ * @return 0 if it is connected or connecting, -1 if it failed.
+**/
+int RtcmConnect(RtcmStream * stream, long long now)
+{
+	struct sockaddr_in address;
+	struct termios settings;
+
+	stream->nextConnect = now + RTCM_RECONNECT_NS;
+
+	if (RtcmSourceTcp == stream->type) {
+		memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_port = htons(stream->port);
+		if (1 != inet_pton(AF_INET, stream->name, &address.sin_addr)) {
+			return -1;
+		}
+
+		stream->fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (stream->fd < 0) {
+			return -1;
+		}
+
+		// a refused connection shows up as a failed read
+		fcntl(stream->fd, F_SETFL, O_NONBLOCK);
+		if (connect(stream->fd, (struct sockaddr *)&address, sizeof(address)) < 0 && EINPROGRESS != errno) {
+			close(stream->fd);
+			stream->fd = -1;
+			return -1;
+		}
+	} else {
+		stream->fd = open(stream->name, O_RDONLY | O_NOCTTY | O_NONBLOCK);
+		if (stream->fd < 0) {
+			return -1;
+		}
+
+		if (0 == tcgetattr(stream->fd, &settings)) {
+			cfmakeraw(&settings);
+			cfsetspeed(&settings, RtcmSpeed(stream->port));
+			tcsetattr(stream->fd, TCSANOW, &settings);
+		}
+	}
+
+	stream->stats.connects++;
+	return 0;
+}
+
+/**
+ * @brief Internal function that drops the connection, the partial frame with it.
+**/
+void RtcmDisconnect(RtcmStream * stream)
+{
+	if (stream->fd >= 0) {
+		close(stream->fd);
+		stream->fd = -1;
+	}
+	stream->pendingLength = 0;
+}
+
+int RtcmOpen(RtcmStream * stream, char * source, long long now)
+{
+	struct in_addr address;
+	char * colon;
+	FILE * file;
+
+	memset(stream, 0, sizeof(RtcmStream));
+	stream->fd = -1;
+
+	if (0 == strncmp(source, "tcp:", 4) || 0 == strncmp(source, "serial:", 7)) {
+		stream->type = ('t' == source[0])?(RtcmSourceTcp):(RtcmSourceSerial);
+		snprintf(stream->name, sizeof(stream->name), "%s", strchr(source, ':') + 1);
+		colon = strrchr(stream->name, ':');
+		if (NULL == colon) {
+			printf("RTCM source %s has no %s\n", source, (RtcmSourceTcp == stream->type)?("port"):("baud"));
+			return -1;
+		}
+		*colon = '\0';
+		stream->port = atoi(colon + 1);
+
+		if (RtcmSourceSerial == stream->type && 0 == RtcmSpeed(stream->port)) {
+			printf("RTCM source %s has an unsupported baud\n", source);
+			return -1;
+		}
+
+		if (RtcmSourceTcp == stream->type && 1 != inet_pton(AF_INET, stream->name, &address)) {
+			printf("RTCM source %s is not an IPv4 address\n", source);
+			return -1;
+		}
+
+		// down is not an error, it is tried again
+		RtcmConnect(stream, now);
+		return 0;
+	}
+
+	if (0 != strncmp(source, "file:", 5)) {
+		printf("RTCM source %s is not tcp:, serial: or file:\n", source);
+		return -1;
+	}
+
+	stream->type = RtcmSourceFile;
+	snprintf(stream->name, sizeof(stream->name), "%s", source + 5);
+
+	file = fopen(stream->name, "rb");
+	if (NULL == file) {
+		printf("error opening RTCM file %s\n", stream->name);
+		return -1;
+	}
+
+	fseek(file, 0, SEEK_END);
+	stream->fileLength = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	stream->file = malloc(stream->fileLength + 1);
+	if (NULL == stream->file || fread(stream->file, 1, stream->fileLength, file) != (size_t)stream->fileLength) {
+		printf("error reading RTCM file %s\n", stream->name);
+		fclose(file);
+		free(stream->file);
+		stream->file = NULL;
+		return -1;
+	}
+	fclose(file);
+
+	stream->nextEpoch = now;
+	return 0;
+}
+
+int RtcmFd(RtcmStream * stream)
+{
+	return stream->fd;
+}
+
+long long RtcmNextDue(RtcmStream * stream)
+{
+	if (RtcmSourceFile == stream->type) {
+		return stream->nextEpoch;
+	}
+
+	return (stream->fd < 0)?(stream->nextConnect):(CLOCK_NEVER);
+}
+
+/**
+ * @brief Internal function that queues the next epoch of a file source, looping at the end.
+**/
+int RtcmFileEpoch(RtcmStream * stream, long long now)
+{
+	int types[RTCM_EPOCH_TYPES];
+	int typeCount = 0;
+	int frames = 0;
+	int looped = 0;
+	int length, type, i;
+
+	while (typeCount < RTCM_EPOCH_TYPES) {
+		// the end of the file ends an epoch, a file without a frame is not looped again
+		if (stream->filePosition >= stream->fileLength) {
+			stream->filePosition = 0;
+			if (frames > 0 || looped) {
+				break;
+			}
+			looped = 1;
+			continue;
+		}
+
+		length = RtcmFrameLength(stream->file + stream->filePosition, stream->fileLength - stream->filePosition);
+		if (length <= 0 || stream->filePosition + length > stream->fileLength) {
+			stream->filePosition += (length < 0)?(1):(stream->fileLength - stream->filePosition);
+			stream->stats.skipped++;
+			continue;
+		}
+
+		// the epoch ends where a type comes again
+		type = RtcmMessageType(stream->file + stream->filePosition);
+		for (i = 0; i < typeCount && types[i] != type; i++);
+		if (i < typeCount) {
+			break;
+		}
+		types[typeCount++] = type;
+
+		frames += RtcmFeed(stream, stream->file + stream->filePosition, length, now);
+		stream->filePosition += length;
+	}
+
+	return frames;
+}
+
+int RtcmService(RtcmStream * stream, long long now)
+{
+	uint8_t buffer[512];
+	int frames = 0;
+	int status;
+
+	if (RtcmSourceFile == stream->type) {
+		if (now >= stream->nextEpoch) {
+			frames = RtcmFileEpoch(stream, now);
+			stream->nextEpoch += RTCM_FILE_PERIOD_NS;
+			stream->nextEpoch = (stream->nextEpoch < now)?(now + RTCM_FILE_PERIOD_NS):(stream->nextEpoch);
+		}
+		return frames;
+	}
+
+	if (stream->fd < 0) {
+		if (now >= stream->nextConnect) {
+			RtcmConnect(stream, now);
+		}
+		return 0;
+	}
+
+	// everything buffered, the descriptor is non-blocking
+	while (1) {
+		status = read(stream->fd, buffer, sizeof(buffer));
+		if (status > 0) {
+			frames += RtcmFeed(stream, buffer, status, now);
+			continue;
+		}
+		if (status < 0 && (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno)) {
+			break;
+		}
+
+		// closed, or a connection that was refused
+		printf("RTCM source %s:%d down\n", stream->name, stream->port);
+		RtcmDisconnect(stream);
+		stream->nextConnect = now + RTCM_RECONNECT_NS;
+		return -1;
+	}
+
+	return frames;
+}
+
+int RtcmNextChunk(RtcmStream * stream, long long now, uint8_t ** data, int most)
+{
+	RtcmFrame * frame;
+	int length;
+
+	// a frame that was started is finished, however old
+	while (stream->queueCount > 0 && 0 == stream->written &&
+	       now - stream->queue[stream->queueHead].time > RTCM_STALE_NS) {
+		stream->queueHead = (stream->queueHead + 1) % RTCM_QUEUE_FRAMES;
+		stream->queueCount--;
+		stream->stats.dropped++;
+	}
+
+	if (0 == stream->queueCount) {
+		return 0;
+	}
+
+	frame = &stream->queue[stream->queueHead];
+	length = frame->length - stream->written;
+	*data = frame->data + stream->written;
+
+	return (length > most)?(most):(length);
+}
+
+void RtcmWritten(RtcmStream * stream, int bytes, long long now)
+{
+	RtcmFrame * frame = &stream->queue[stream->queueHead];
+
+	if (0 == stream->queueCount) {
+		return;
+	}
+
+	if (bytes < 0) {
+		stream->stats.writeErrors++;
+		stream->stats.dropped++;
+		stream->written = frame->length;
+	} else {
+		stream->written += bytes;
+		stream->stats.writtenBytes += bytes;
+	}
+
+	if (stream->written < frame->length) {
+		return;
+	}
+
+	if (bytes >= 0) {
+		stream->stats.written++;
+		stream->stats.lastWritten = now;
+	}
+
+	stream->queueHead = (stream->queueHead + 1) % RTCM_QUEUE_FRAMES;
+	stream->queueCount--;
+	stream->written = 0;
+}
+
+void RtcmGetStats(RtcmStream * stream, RtcmStats * stats)
+{
+	memcpy(stats, &stream->stats, sizeof(RtcmStats));
+}
+
+void RtcmClose(RtcmStream * stream)
+{
+	RtcmDisconnect(stream);
+	free(stream->file);
+	stream->file = NULL;
+}
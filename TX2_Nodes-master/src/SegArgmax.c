@@ -0,0 +1,364 @@
+/**
+ * @file SegArgmax.c
+ * @brief Function definitions for the SegArgmax library.
+ * @details Function definitions for the SegArgmax library.
+**/
+
+#include <float.h>
+#include "../include/SegArgmax.h"
+#include "../include/Clock.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SEG_ARGMAX_SIMD 4				/**< Cells per vector. */
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SEG_ARGMAX_SIMD 4				/**< Cells per vector. */
+#else
+#define SEG_ARGMAX_SIMD 0				/**< No vectors, simd is the scalar kernel. */
+#endif
+
+#define SEG_ARGMAX_BYTES 16		/**< Cells the simd kernel writes at once, a vector of bytes. */
+
+/**
+ * @brief Names of the #SegArgmaxKernel values.
+**/
+char * segArgmaxNames[SegArgmaxKernelCount] = { "scalar", "simd" };
+
+/**
+ * @brief Internal function that returns the first class that may be chosen.
+**/
+int SegArgmaxFirst(SegArgmax * argmax)
+{
+	return (0 == argmax->ignore)?(1):(0);
+}
+
+/**
+ * @brief Internal function that turns the best and second best score into a confidence.
+**/
+uint8_t SegArgmaxQuantize(SegArgmax * argmax, float best, float second)
+{
+	float value = (SegConfidenceMargin == argmax->confidence)?(best - second):(best);
+
+	value *= argmax->scale;
+	value = (value > 0.0f)?(value):(0.0f);
+	value = (value < 255.0f)?(value):(255.0f);
+
+	return (uint8_t)value;
+}
+
+/**
+ * @brief Internal function that makes the mask and confidence of one cell.
+ * @details Ties go to the lower class, as in segNet.
+**/
+void SegArgmaxCell(SegArgmax * argmax, float * scores, int cells, int cell, uint8_t * mask, uint8_t * confidence)
+{
+	int first = SegArgmaxFirst(argmax);
+	float best = scores[(long)first * cells + cell];
+	float second = -FLT_MAX;
+	float score;
+	int index = first;
+	int c;
+
+	for (c = first + 1; c < argmax->classes; c++) {
+		if (c == argmax->ignore) {
+			continue;
+		}
+		score = scores[(long)c * cells + cell];
+		if (score > best) {
+			second = best;
+			best = score;
+			index = c;
+		} else if (score > second) {
+			second = score;
+		}
+	}
+
+	*mask = (uint8_t)index;
+	*confidence = SegArgmaxQuantize(argmax, best, second);
+}
+
+/**
+ * @brief Internal function, the classes of each cell one after the other.
+**/
+void SegArgmaxKernelScalar(SegArgmax * argmax, float * scores, uint8_t * mask, uint8_t * confidence)
+{
+	int cells = argmax->gridWidth * argmax->gridHeight;
+	int cell;
+
+	for (cell = 0; cell < cells; cell++) {
+		SegArgmaxCell(argmax, scores, cells, cell, mask + cell, confidence + cell);
+	}
+}
+
+#if SEG_ARGMAX_SIMD
+/**
+ * @brief Internal function that takes one class into the best of a chunk, a vector at a time.
+**/
+void SegArgmaxSimdClass(float * best, float * second, uint32_t * index, float * plane, int c, int count)
+{
+	int i;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+	uint32x4_t chosen = vdupq_n_u32(c);
+	float32x4_t score, top, next;
+	uint32x4_t greater;
+
+	for (i = 0; i < count; i += SEG_ARGMAX_SIMD) {
+		score = vld1q_f32(plane + i);
+		top = vld1q_f32(best + i);
+		next = vld1q_f32(second + i);
+		greater = vcgtq_f32(score, top);
+		vst1q_f32(second + i, vbslq_f32(greater, top, vmaxq_f32(next, score)));
+		vst1q_f32(best + i, vbslq_f32(greater, score, top));
+		vst1q_u32(index + i, vbslq_u32(greater, chosen, vld1q_u32(index + i)));
+	}
+#else
+	__m128i chosen = _mm_set1_epi32(c);
+	__m128 score, top, next, greater;
+	__m128i mask;
+
+	for (i = 0; i < count; i += SEG_ARGMAX_SIMD) {
+		score = _mm_loadu_ps(plane + i);
+		top = _mm_loadu_ps(best + i);
+		next = _mm_loadu_ps(second + i);
+		greater = _mm_cmpgt_ps(score, top);
+		mask = _mm_castps_si128(greater);
+		_mm_storeu_ps(second + i, _mm_or_ps(_mm_and_ps(greater, top), _mm_andnot_ps(greater, _mm_max_ps(next, score))));
+		_mm_storeu_ps(best + i, _mm_or_ps(_mm_and_ps(greater, score), _mm_andnot_ps(greater, top)));
+		_mm_storeu_si128((__m128i *)(index + i), _mm_or_si128(_mm_and_si128(mask, chosen),
+					_mm_andnot_si128(mask, _mm_loadu_si128((__m128i *)(index + i)))));
+	}
+#endif
+}
+
+/**
+ * @brief Internal function that writes the classes and confidence of a chunk, #SEG_ARGMAX_BYTES at a time.
+**/
+void SegArgmaxSimdBytes(SegArgmax * argmax, float * best, float * second, uint32_t * index, int count,
+			uint8_t * mask, uint8_t * confidence)
+{
+	int margin = (SegConfidenceMargin == argmax->confidence);
+	int i, j;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+	float32x4_t scale = vdupq_n_f32(argmax->scale);
+	float32x4_t zero = vdupq_n_f32(0.0f);
+	float32x4_t most = vdupq_n_f32(255.0f);
+	float32x4_t value;
+	uint16x4_t classes[4], levels[4];
+
+	for (i = 0; i < count; i += SEG_ARGMAX_BYTES) {
+		for (j = 0; j < 4; j++) {
+			value = vld1q_f32(best + i + (j * SEG_ARGMAX_SIMD));
+			value = (margin)?(vsubq_f32(value, vld1q_f32(second + i + (j * SEG_ARGMAX_SIMD)))):(value);
+			value = vminq_f32(vmaxq_f32(vmulq_f32(value, scale), zero), most);
+			levels[j] = vmovn_u32(vcvtq_u32_f32(value));
+			classes[j] = vmovn_u32(vld1q_u32(index + i + (j * SEG_ARGMAX_SIMD)));
+		}
+		vst1q_u8(mask + i, vcombine_u8(vmovn_u16(vcombine_u16(classes[0], classes[1])),
+					       vmovn_u16(vcombine_u16(classes[2], classes[3]))));
+		vst1q_u8(confidence + i, vcombine_u8(vmovn_u16(vcombine_u16(levels[0], levels[1])),
+						     vmovn_u16(vcombine_u16(levels[2], levels[3]))));
+	}
+#else
+	__m128 scale = _mm_set1_ps(argmax->scale);
+	__m128 zero = _mm_setzero_ps();
+	__m128 most = _mm_set1_ps(255.0f);
+	__m128 value;
+	__m128i classes[4], levels[4];
+
+	for (i = 0; i < count; i += SEG_ARGMAX_BYTES) {
+		for (j = 0; j < 4; j++) {
+			value = _mm_loadu_ps(best + i + (j * SEG_ARGMAX_SIMD));
+			value = (margin)?(_mm_sub_ps(value, _mm_loadu_ps(second + i + (j * SEG_ARGMAX_SIMD)))):(value);
+			value = _mm_min_ps(_mm_max_ps(_mm_mul_ps(value, scale), zero), most);
+			levels[j] = _mm_cvttps_epi32(value);
+			classes[j] = _mm_loadu_si128((__m128i *)(index + i + (j * SEG_ARGMAX_SIMD)));
+		}
+		// 0 to 255 each, nothing saturates
+		_mm_storeu_si128((__m128i *)(mask + i), _mm_packus_epi16(_mm_packs_epi32(classes[0], classes[1]),
+									 _mm_packs_epi32(classes[2], classes[3])));
+		_mm_storeu_si128((__m128i *)(confidence + i), _mm_packus_epi16(_mm_packs_epi32(levels[0], levels[1]),
+									       _mm_packs_epi32(levels[2], levels[3])));
+	}
+#endif
+}
+#endif
+
+/**
+ * @brief Internal function, the classes of a chunk of cells one plane after the other, 4 cells at a time.
+**/
+void SegArgmaxKernelSimd(SegArgmax * argmax, float * scores, uint8_t * mask, uint8_t * confidence)
+{
+#if SEG_ARGMAX_SIMD
+	float best[SEG_ARGMAX_CHUNK];
+	float second[SEG_ARGMAX_CHUNK];
+	uint32_t index[SEG_ARGMAX_CHUNK];
+	int cells = argmax->gridWidth * argmax->gridHeight;
+	int first = SegArgmaxFirst(argmax);
+	int start, count, vectors;
+	float * plane;
+	int c, i;
+
+	for (start = 0; start < cells; start += SEG_ARGMAX_CHUNK) {
+		count = (cells - start < SEG_ARGMAX_CHUNK)?(cells - start):(SEG_ARGMAX_CHUNK);
+		vectors = count - (count % SEG_ARGMAX_BYTES);
+
+		plane = scores + ((long)first * cells) + start;
+		for (i = 0; i < vectors; i++) {
+			best[i] = plane[i];
+			second[i] = -FLT_MAX;
+			index[i] = first;
+		}
+
+		for (c = first + 1; c < argmax->classes; c++) {
+			if (c != argmax->ignore) {
+				SegArgmaxSimdClass(best, second, index, scores + ((long)c * cells) + start, c, vectors);
+			}
+		}
+
+		SegArgmaxSimdBytes(argmax, best, second, index, vectors, mask + start, confidence + start);
+
+		// the end of the grid
+		for (i = start + vectors; i < start + count; i++) {
+			SegArgmaxCell(argmax, scores, cells, i, mask + i, confidence + i);
+		}
+	}
+#else
+	SegArgmaxKernelScalar(argmax, scores, mask, confidence);
+#endif
+}
+
+int SegArgmaxInit(SegArgmax * argmax, int classes, int ignore, int gridWidth, int gridHeight,
+		  int width, int height, int confidence)
+{
+	int x;
+
+	memset(argmax, 0, sizeof(SegArgmax));
+
+	if (classes < 1 || classes > SEG_ARGMAX_MAX_CLASSES || (1 == classes && 0 == ignore) ||
+	    gridWidth <= 0 || gridHeight <= 0 || width <= 0 || height <= 0) {
+		printf("SEG ARGMAX CAN NOT MAKE %dx%d MASKS OF %d CLASSES AT %dx%d\n", width, height, classes,
+			gridWidth, gridHeight);
+		return -1;
+	}
+
+	argmax->classes = classes;
+	argmax->ignore = (ignore >= 0 && ignore < classes)?(ignore):(-1);
+	argmax->gridWidth = gridWidth;
+	argmax->gridHeight = gridHeight;
+	argmax->width = width;
+	argmax->height = height;
+	argmax->confidence = confidence;
+	argmax->scale = SEG_ARGMAX_SCALE;
+	argmax->kernel = (SEG_ARGMAX_SIMD)?(SegArgmaxSimd):(SegArgmaxScalar);
+
+	// the confidence is made even when it is not wanted, there is no pass without it
+	argmax->gridConfidence = malloc((long)gridWidth * gridHeight);
+	if (NULL == argmax->gridConfidence) {
+		return -1;
+	}
+	if (gridWidth == width && gridHeight == height) {
+		return 0;
+	}
+
+	// the grid is scaled up by the nearest cell, as segNet does
+	argmax->gridMask = malloc((long)gridWidth * gridHeight);
+	argmax->columns = malloc(width * sizeof(int));
+	if (NULL == argmax->gridMask || NULL == argmax->columns) {
+		SegArgmaxClose(argmax);
+		return -1;
+	}
+	for (x = 0; x < width; x++) {
+		argmax->columns[x] = (int)(((long)x * gridWidth) / width);
+	}
+
+	return 0;
+}
+
+void SegArgmaxSetScale(SegArgmax * argmax, float scale)
+{
+	argmax->scale = scale;
+}
+
+void SegArgmaxApply(SegArgmax * argmax, float * scores, uint8_t * mask, uint8_t * confidence)
+{
+	int scaling = (NULL != argmax->gridMask);
+	uint8_t * gridMask = (scaling)?(argmax->gridMask):(mask);
+	uint8_t * gridConfidence = (scaling || NULL == confidence)?(argmax->gridConfidence):(confidence);
+	uint8_t * maskRow;
+	uint8_t * confidenceRow;
+	long long start, scaled, end;
+	long row;
+	int x, y;
+
+	start = ClockMonotonicNs();
+	SegArgmaxApplyWith(argmax, argmax->kernel, scores, gridMask, gridConfidence);
+	scaled = ClockMonotonicNs();
+
+	for (y = 0; scaling && y < argmax->height; y++) {
+		row = ((long)y * argmax->gridHeight / argmax->height) * argmax->gridWidth;
+		maskRow = mask + ((long)y * argmax->width);
+		for (x = 0; x < argmax->width; x++) {
+			maskRow[x] = gridMask[row + argmax->columns[x]];
+		}
+		if (NULL != confidence) {
+			confidenceRow = confidence + ((long)y * argmax->width);
+			for (x = 0; x < argmax->width; x++) {
+				confidenceRow[x] = gridConfidence[row + argmax->columns[x]];
+			}
+		}
+	}
+
+	end = ClockMonotonicNs();
+	argmax->stats.masks++;
+	argmax->stats.argmaxNs += scaled - start;
+	argmax->stats.scaleNs += end - scaled;
+	argmax->stats.maxNs = (end - start > argmax->stats.maxNs)?(end - start):(argmax->stats.maxNs);
+}
+
+void SegArgmaxApplyWith(SegArgmax * argmax, int kernel, float * scores, uint8_t * mask, uint8_t * confidence)
+{
+	switch (kernel) {
+		case SegArgmaxSimd:
+			SegArgmaxKernelSimd(argmax, scores, mask, confidence);
+			break;
+		default:
+			SegArgmaxKernelScalar(argmax, scores, mask, confidence);
+			break;
+	}
+}
+
+float SegConfidenceSummary(uint8_t * confidence, int length, float * low)
+{
+	unsigned long sum = 0;
+	unsigned long below = 0;
+	int i;
+
+	for (i = 0; i < length; i++) {
+		sum += confidence[i];
+		below += (confidence[i] < SEG_ARGMAX_LOW);
+	}
+
+	*low = (length > 0)?((float)below / length):(0.0f);
+	return (length > 0)?((float)sum / length):(0.0f);
+}
+
+char * SegArgmaxName(int kernel)
+{
+	return (kernel >= 0 && kernel < SegArgmaxKernelCount)?(segArgmaxNames[kernel]):("unknown");
+}
+
+void SegArgmaxGetStats(SegArgmax * argmax, SegArgmaxStats * stats)
+{
+	memcpy(stats, &argmax->stats, sizeof(SegArgmaxStats));
+}
+
+void SegArgmaxClose(SegArgmax * argmax)
+{
+	free(argmax->gridMask);
+	free(argmax->gridConfidence);
+	free(argmax->columns);
+	argmax->gridMask = NULL;
+	argmax->gridConfidence = NULL;
+	argmax->columns = NULL;
+}
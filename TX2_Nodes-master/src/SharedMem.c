@@ -9,36 +9,35 @@
 #include "../include/SharedMem.h"
 
 /**
- * @brief Semantic segmentation shared memory file descriptor.
+ * @brief Shared memory file names, indexed by #SMType.
 **/
-int segFd;
-/**
- * @brief Angle data shared memory file descriptor.
-**/
-int angFd;
+const char * sharedMemNames[SMTypeCount] = {
+	[SegmentationData] = SHARED_SEG_NAME,
+	[HeadingData] = SHARED_HEAD_NAME,
+	[PositionData] = SHARED_POS_NAME,
+	[OrientationData] = SHARED_ORIENT_NAME,
+	[ParameterData] = SHARED_PARAM_NAME,
+	[SimulationData] = SHARED_SIM_NAME,
+	[BenchData] = SHARED_BENCH_NAME,
+	[ObstacleData] = SHARED_OBSTACLE_NAME,
+	[WalkwayData] = SHARED_WALKWAY_NAME,
+	[CheckpointData] = SHARED_CHECKPOINT_NAME,
+	[GovernorData] = SHARED_GOVERNOR_NAME
+};
+
 /**
- * @brief GNSS position shared memory file descriptor.
+ * @brief Shared memory file descriptors, indexed by #SMType.
 **/
-int posFd;
+int sharedMemFds[SMTypeCount];
 
 SharedMem * CreateSharedMemory(int size, SMType type)
 {
 	SharedMem * sharedMem;
 	int memFd;
 
-	// determine how to open the shared memory. In this case, the important thing
-	// is the file location
+	// the type determines the file location
 	// modes (3rd param) in usr/include/aarch64-linux-gnu/sys/stat.h
-	switch (type) {
-		case SegmentationData:
-			memFd = segFd = shm_open(SHARED_SEG_NAME, O_CREAT | O_RDWR, S_IRWXU);
-			break;
-		case AngleData:
-			memFd = angFd = shm_open(SHARED_ANG_NAME, O_CREAT | O_RDWR, S_IRWXU);
-			break;
-		case PositionData:
-			memFd = posFd = shm_open(SHARED_POS_NAME, O_CREAT | O_RDWR, S_IRWXU);
-	}
+	memFd = sharedMemFds[type] = shm_open(sharedMemNames[type], O_CREAT | O_RDWR, S_IRWXU);
 
 	if (memFd <= 0)
 	{
@@ -58,7 +57,7 @@ SharedMem * CreateSharedMemory(int size, SMType type)
 	// see man page for protections and flags
 	sharedMem = mmap(NULL, size + sizeof(SharedMem), PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
 
-	if (sharedMem == NULL)
+	if (sharedMem == MAP_FAILED)
 	{
 		printf("error mapping memory\n");
 		return NULL;
@@ -74,17 +73,7 @@ SharedMem * OpenSharedMemory(int size, SMType type)
 
 	// determine how to open shared memory
 	// semantic seg is read only, others are read write to set flags.
-	switch (type) {
-		case SegmentationData:
-			memFd = segFd = shm_open(SHARED_SEG_NAME, O_RDONLY, 0);
-			break;
-		case AngleData:
-			memFd = angFd = shm_open(SHARED_ANG_NAME, O_RDWR, 0);
-			break;
-		case PositionData:
-			memFd = posFd = shm_open(SHARED_POS_NAME, O_RDWR, 0);
-			break;
-	}
+	memFd = sharedMemFds[type] = shm_open(sharedMemNames[type], (SegmentationData == type)?(O_RDONLY):(O_RDWR), 0);
 
 	if (memFd <= 0)
 	{
@@ -92,18 +81,11 @@ SharedMem * OpenSharedMemory(int size, SMType type)
 		return NULL;
 	}
 
-	// determine how to map to pointer. This is shared between AngleData and PositionData
-	switch (type) {
-		case SegmentationData:
-			sharedMem = mmap(NULL, size + sizeof(SharedMem), PROT_READ, MAP_SHARED, memFd, 0);
-			break;
-		case AngleData:
-		case PositionData:
-			sharedMem = mmap(NULL, size + sizeof(SharedMem), PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
-			break;
-	}
+	// map with the same access the file was opened with
+	sharedMem = mmap(NULL, size + sizeof(SharedMem), (SegmentationData == type)?(PROT_READ):(PROT_READ | PROT_WRITE),
+			 MAP_SHARED, memFd, 0);
 
-	if (sharedMem == NULL)
+	if (sharedMem == MAP_FAILED)
 	{
 		printf("error mapping memory\n");
 		return NULL;
@@ -114,8 +96,13 @@ SharedMem * OpenSharedMemory(int size, SMType type)
 
 void CloseSharedMemory()
 {
+	int i;
+
 	// close everything
-	close(segFd);
-	close(angFd);
-	close(posFd);
+	for (i = 0; i < SMTypeCount; i++) {
+		if (sharedMemFds[i] > 0) {
+			close(sharedMemFds[i]);
+			sharedMemFds[i] = 0;
+		}
+	}
 }
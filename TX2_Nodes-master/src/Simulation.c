@@ -0,0 +1,208 @@
+/**
+ * @file Simulation.c
+ * @brief Function definitions for the Simulation library.
+ * @details Function definitions for the Simulation library.
+**/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "../include/Simulation.h"
+#include "../include/SharedMem.h"
+
+#define SIM_EARTH_RADIUS 6371000.0	/**< Meters, as #RADIUS_OF_EARTH. */
+#define SIM_RENDER_BLOCK 4		/**< Masks are traced once per block of this many pixels square. */
+
+/**
+ * @brief The world mapped by #SimulationOpen(), NULL until then.
+**/
+SimShared * simShared;
+
+SimShared * SimulationOpen()
+{
+	size_t size = sizeof(SharedMem) + sizeof(SimShared);
+	SharedMem * sharedMem;
+	int fd;
+
+	if (NULL != simShared) {
+		return simShared;
+	}
+
+	fd = shm_open(SHARED_SIM_NAME, O_RDWR, 0);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	sharedMem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (MAP_FAILED == sharedMem) {
+		return NULL;
+	}
+
+	simShared = (SimShared *)(sharedMem + 1);
+
+	return simShared;
+}
+
+void SimulationSetPose(SimShared * sim, SimPose * pose)
+{
+	// odd while writing
+	sim->sequence++;
+	__sync_synchronize();
+	memcpy(&sim->pose, pose, sizeof(SimPose));
+	__sync_synchronize();
+	sim->sequence++;
+}
+
+void SimulationGetPose(SimShared * sim, SimPose * pose)
+{
+	unsigned int sequence;
+
+	do {
+		sequence = sim->sequence;
+		__sync_synchronize();
+		memcpy(pose, &sim->pose, sizeof(SimPose));
+		__sync_synchronize();
+	} while ((sequence & 1) || sequence != sim->sequence);
+}
+
+int SimulationPushFrame(SimShared * sim, unsigned int id, unsigned char * data, int length)
+{
+	SimFrame * frame;
+
+	if (sim->frameHead - sim->frameTail >= SIM_FRAME_RING) {
+		sim->framesLost++;
+		return -1;
+	}
+
+	frame = &sim->frames[sim->frameHead % SIM_FRAME_RING];
+	frame->id = id;
+	frame->length = (length > 8)?(8):(length);
+	memcpy(frame->data, data, frame->length);
+
+	// the frame must be in place before it is counted
+	__sync_synchronize();
+	sim->frameHead++;
+
+	return 0;
+}
+
+int SimulationPopFrame(SimShared * sim, SimFrame * frame)
+{
+	if (sim->frameTail == sim->frameHead) {
+		return 0;
+	}
+
+	__sync_synchronize();
+	memcpy(frame, &sim->frames[sim->frameTail % SIM_FRAME_RING], sizeof(SimFrame));
+	__sync_synchronize();
+	sim->frameTail++;
+
+	return 1;
+}
+
+void SimulationLatLon(SimShared * sim, double x, double y, double * latitude, double * longitude)
+{
+	// a flat map is fine over the few hundred meters of a mission
+	*latitude = sim->latitude + ((y / SIM_EARTH_RADIUS) * (180.0 / M_PI));
+	*longitude = sim->longitude + ((x / (SIM_EARTH_RADIUS * cos(sim->latitude * (M_PI / 180.0)))) * (180.0 / M_PI));
+}
+
+/**
+ * @brief Internal function that returns the squared distance from a point to a #SimShape segment.
+**/
+double ShapeDistance2(SimShape * shape, double x, double y)
+{
+	double dx = shape->x2 - shape->x1;
+	double dy = shape->y2 - shape->y1;
+	double length2 = (dx * dx) + (dy * dy);
+	double t = 0.0;
+
+	if (length2 > 0.0) {
+		t = (((x - shape->x1) * dx) + ((y - shape->y1) * dy)) / length2;
+		t = (t < 0.0)?(0.0):((t > 1.0)?(1.0):(t));
+	}
+
+	dx = x - (shape->x1 + (t * dx));
+	dy = y - (shape->y1 + (t * dy));
+
+	return (dx * dx) + (dy * dy);
+}
+
+int SimulationLabel(SimShared * sim, double x, double y)
+{
+	int label = SIM_TERRAIN_LABEL;
+	int i;
+
+	for (i = 0; i < sim->shapeCount; i++) {
+		if (ShapeDistance2(&sim->shapes[i], x, y) > sim->shapes[i].radius * sim->shapes[i].radius) {
+			continue;
+		}
+
+		// obstacles stand on the walkways
+		if (SimObstacle == sim->shapes[i].type) {
+			return SIM_OBSTACLE_LABEL;
+		}
+		label = SIM_WALKWAY_LABEL;
+	}
+
+	return label;
+}
+
+int SimulationBlocked(SimShared * sim, double x, double y, double radius)
+{
+	double reach;
+	int i;
+
+	for (i = 0; i < sim->shapeCount; i++) {
+		reach = sim->shapes[i].radius + radius;
+		if (SimObstacle == sim->shapes[i].type && ShapeDistance2(&sim->shapes[i], x, y) <= reach * reach) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+void SimulationRender(SimShared * sim, SimPose * pose, uint8_t * mask, int width, int height)
+{
+	double focal = (width / 2.0) / tan((SIM_CAMERA_FOV / 2.0) * (M_PI / 180.0));
+	double tilt = SIM_CAMERA_TILT * (M_PI / 180.0);
+	double heading = pose->heading * (M_PI / 180.0);
+	double forwardX = sin(heading), forwardY = cos(heading);
+	double rightX = cos(heading), rightY = -sin(heading);
+	double u, v, down, forward, reach, right;
+	int row, column, block, rows, columns, label;
+	int i;
+
+	block = SIM_RENDER_BLOCK;
+
+	for (row = 0; row < height; row += block) {
+		rows = (row + block > height)?(height - row):(block);
+
+		// the ray through the middle of the block, pitched down by the tilt
+		v = (row + (rows / 2.0) - (height / 2.0)) / focal;
+		down = sin(tilt) + (cos(tilt) * v);
+		forward = cos(tilt) - (sin(tilt) * v);
+
+		for (column = 0; column < width; column += block) {
+			columns = (column + block > width)?(width - column):(block);
+
+			if (down <= 0.0) {
+				label = SIM_SKY_LABEL;
+			} else {
+				// where the ray meets the ground
+				u = (column + (columns / 2.0) - (width / 2.0)) / focal;
+				reach = SIM_CAMERA_MOUNT / down;
+				right = reach * u;
+				label = SimulationLabel(sim, pose->x + (reach * forward * forwardX) + (right * rightX),
+							     pose->y + (reach * forward * forwardY) + (right * rightY));
+			}
+
+			for (i = 0; i < rows; i++) {
+				memset(&mask[((row + i) * width) + column], label, columns);
+			}
+		}
+	}
+}
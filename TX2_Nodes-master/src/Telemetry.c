@@ -0,0 +1,767 @@
+/**
+ * @file Telemetry.c
+ * @brief Function definitions for the Telemetry library.
+ * @details Function definitions for the Telemetry library.
+**/
+
+#include "../include/Telemetry.h"
+#include "../include/Clock.h"
+
+#define TELEMETRY_VALUE_BYTES 10	/**< Most bytes a value takes encoded, a varint or 64 + 13 bits. */
+
+/**
+ * @brief Writes bits to a buffer, most significant first. The buffer starts zeroed.
+**/
+typedef struct _TelemetryBits {
+	unsigned char * data;
+	long long bits;			// written or read so far
+	long long size;			// bits there are to read
+} TelemetryBits;
+
+/**
+ * @brief Internal function that maps a signed value to an unsigned one, small either way stays small.
+**/
+unsigned long long ZigZag(long long value)
+{
+	return ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+}
+
+/**
+ * @brief Internal function, the reverse of #ZigZag().
+**/
+long long UnZigZag(unsigned long long value)
+{
+	return (long long)(value >> 1) ^ -(long long)(value & 1);
+}
+
+/**
+ * @brief Internal function that writes a varint, 7 bits a byte, low first.
+ * @return Bytes written.
+**/
+int PutVarint(unsigned char * data, unsigned long long value)
+{
+	int length = 0;
+
+	while (value >= 0x80) {
+		data[length++] = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	data[length++] = (unsigned char)value;
+
+	return length;
+}
+
+/**
+ * @brief Internal function that reads a varint.
+ * @return 0 on success, -1 if it runs past the end.
+**/
+int GetVarint(unsigned char * data, unsigned int size, unsigned int * position, unsigned long long * value)
+{
+	int shift = 0;
+
+	*value = 0;
+	while (*position < size && shift < 64) {
+		*value |= (unsigned long long)(data[*position] & 0x7F) << shift;
+		if (!(data[(*position)++] & 0x80)) {
+			return 0;
+		}
+		shift += 7;
+	}
+
+	return -1;
+}
+
+/**
+ * @brief Internal function that writes the low count bits of a value.
+**/
+void PutBits(TelemetryBits * bits, unsigned long long value, int count)
+{
+	int space;
+	int take;
+
+	while (count > 0) {
+		space = 8 - (bits->bits & 7);
+		take = (count < space)?(count):(space);
+		bits->data[bits->bits >> 3] |= ((value >> (count - take)) & ((1U << take) - 1)) << (space - take);
+		bits->bits += take;
+		count -= take;
+	}
+}
+
+/**
+ * @brief Internal function that reads count bits.
+ * @return 0 on success, -1 if there are not that many left.
+**/
+int GetBits(TelemetryBits * bits, int count, unsigned long long * value)
+{
+	int space;
+	int take;
+
+	if (bits->bits + count > bits->size) {
+		return -1;
+	}
+
+	*value = 0;
+	while (count > 0) {
+		space = 8 - (bits->bits & 7);
+		take = (count < space)?(count):(space);
+		*value = (*value << take) | ((bits->data[bits->bits >> 3] >> (space - take)) & ((1U << take) - 1));
+		bits->bits += take;
+		count -= take;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Internal function that encodes times as zigzag varints of the differences of their differences.
+ * @return Bytes written.
+**/
+unsigned int EncodeTimes(long long * times, int rows, unsigned char * data)
+{
+	long long previous = 0;
+	long long delta = 0;
+	unsigned int length = 0;
+	int i;
+
+	for (i = 0; i < rows; i++) {
+		length += PutVarint(&data[length], ZigZag((times[i] - previous) - delta));
+		delta = times[i] - previous;
+		previous = times[i];
+	}
+
+	return length;
+}
+
+/**
+ * @brief Internal function that encodes integers as zigzag varints of their differences.
+ * @return Bytes written.
+**/
+unsigned int EncodeInts(TelemetryValue * values, int rows, unsigned char * data)
+{
+	long long previous = 0;
+	unsigned int length = 0;
+	int i;
+
+	for (i = 0; i < rows; i++) {
+		length += PutVarint(&data[length], ZigZag(values[i].i - previous));
+		previous = values[i].i;
+	}
+
+	return length;
+}
+
+/**
+ * @brief Internal function that encodes floats XORed with the one before, the first whole.
+ * @details Each value is a 0 bit if it did not change. Otherwise a 1 bit, then a 0 bit and
+ *	    the bits within the window of the previous change if it fits, or a 1 bit, 5 bits of
+ *	    leading zeros, 6 bits of the number of bits that changed less one, and those bits.
+ * @return Bytes written.
+**/
+unsigned int EncodeFloats(TelemetryValue * values, int rows, unsigned char * data)
+{
+	TelemetryBits bits = { data, 0, 0 };
+	unsigned long long previous;
+	unsigned long long current;
+	unsigned long long changed;
+	int leading = -1;
+	int trailing = 0;
+	int lead, trail;
+	int i;
+
+	memcpy(&previous, &values[0].f, sizeof(previous));
+	PutBits(&bits, previous, 64);
+
+	for (i = 1; i < rows; i++) {
+		memcpy(&current, &values[i].f, sizeof(current));
+		changed = current ^ previous;
+		previous = current;
+
+		if (0 == changed) {
+			PutBits(&bits, 0, 1);
+			continue;
+		}
+		PutBits(&bits, 1, 1);
+
+		lead = __builtin_clzll(changed);
+		lead = (lead > 31)?(31):(lead);
+		trail = __builtin_ctzll(changed);
+
+		if (leading >= 0 && lead >= leading && trail >= trailing) {
+			PutBits(&bits, 0, 1);
+			PutBits(&bits, changed >> trailing, 64 - leading - trailing);
+		} else {
+			leading = lead;
+			trailing = trail;
+			PutBits(&bits, 1, 1);
+			PutBits(&bits, leading, 5);
+			PutBits(&bits, 64 - leading - trailing - 1, 6);
+			PutBits(&bits, changed >> trailing, 64 - leading - trailing);
+		}
+	}
+
+	return (bits.bits + 7) >> 3;
+}
+
+/**
+ * @brief Internal function that decodes #EncodeFloats().
+ * @return 0 on success, -1 if the column is cut short.
+**/
+int DecodeFloats(unsigned char * data, unsigned int size, int rows, TelemetryValue * values)
+{
+	TelemetryBits bits = { data, 0, (long long)size * 8 };
+	unsigned long long previous;
+	unsigned long long bit;
+	unsigned long long field;
+	int leading = 0;
+	int trailing = 0;
+	int length;
+	int i;
+
+	if (GetBits(&bits, 64, &previous) < 0) {
+		return -1;
+	}
+	memcpy(&values[0].f, &previous, sizeof(previous));
+
+	for (i = 1; i < rows; i++) {
+		if (GetBits(&bits, 1, &bit) < 0) {
+			return -1;
+		}
+
+		if (bit) {
+			if (GetBits(&bits, 1, &bit) < 0) {
+				return -1;
+			}
+			if (bit) {
+				if (GetBits(&bits, 5, &field) < 0) {
+					return -1;
+				}
+				leading = field;
+				if (GetBits(&bits, 6, &field) < 0) {
+					return -1;
+				}
+				trailing = 64 - leading - (field + 1);
+			}
+
+			length = 64 - leading - trailing;
+			if (length <= 0 || GetBits(&bits, length, &field) < 0) {
+				return -1;
+			}
+			previous ^= field << trailing;
+		}
+
+		memcpy(&values[i].f, &previous, sizeof(previous));
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Internal function that writes to the archive, giving up on it if that fails.
+ * @return 0 on success, -1 if it is no longer recorded.
+**/
+int TelemetryWrite(TelemetryWriter * writer, void * data, long long size)
+{
+	if (writer->fd < 0) {
+		return -1;
+	}
+
+	if (write(writer->fd, data, size) != size) {
+		printf("telemetry: writing %s failed, no longer recording\n", writer->fileName);
+		close(writer->fd);
+		writer->fd = -1;
+		return -1;
+	}
+
+	writer->offset += size;
+
+	return 0;
+}
+
+/**
+ * @brief Internal function that encodes the rows kept of a stream and writes them as a chunk.
+**/
+void TelemetryWriteChunk(TelemetryWriter * writer, TelemetryStream * stream)
+{
+	TelemetryBlock * block = (TelemetryBlock *)writer->buffer;
+	TelemetryChunk * chunk = (TelemetryChunk *)(block + 1);
+	TelemetryIndexEntry * entry;
+	unsigned char * data = (unsigned char *)(chunk + 1);
+	TelemetryValue * values;
+	long long start = ClockMonotonicNs();
+	long long offset = writer->offset;
+	unsigned int length = 0;
+	int column;
+
+	if (0 == stream->rows) {
+		return;
+	}
+
+	memset(writer->buffer, 0, sizeof(TelemetryBlock) + sizeof(TelemetryChunk) +
+	       (long long)stream->rows * TELEMETRY_VALUE_BYTES * (stream->info.columnCount + 1));
+
+	chunk->stream = stream->info.id;
+	chunk->rows = stream->rows;
+	chunk->first = stream->times[0];
+	chunk->last = stream->times[stream->rows - 1];
+
+	// one column after the other, each can be read on its own
+	chunk->sizes[0] = EncodeTimes(stream->times, stream->rows, data);
+	length = chunk->sizes[0];
+	for (column = 0; column < stream->info.columnCount; column++) {
+		values = &stream->values[column * TELEMETRY_CHUNK_ROWS];
+		if (TelemetryFloat == stream->info.columns[column].type) {
+			chunk->sizes[column + 1] = EncodeFloats(values, stream->rows, &data[length]);
+		} else {
+			chunk->sizes[column + 1] = EncodeInts(values, stream->rows, &data[length]);
+		}
+		length += chunk->sizes[column + 1];
+	}
+
+	block->type = TelemetryChunkBlock;
+	block->size = sizeof(TelemetryChunk) + length;
+	if (TelemetryWrite(writer, writer->buffer, sizeof(TelemetryBlock) + block->size) < 0) {
+		return;
+	}
+
+	// kept for the index written when the archive is closed
+	if (writer->indexCount == writer->indexSize) {
+		writer->indexSize = (writer->indexSize)?(writer->indexSize * 2):(256);
+		writer->index = realloc(writer->index, writer->indexSize * sizeof(TelemetryIndexEntry));
+	}
+	entry = &writer->index[writer->indexCount++];
+	entry->offset = offset;
+	entry->stream = chunk->stream;
+	entry->rows = chunk->rows;
+	entry->first = chunk->first;
+	entry->last = chunk->last;
+
+	writer->stats.chunks++;
+	writer->stats.rawBytes += (unsigned long long)stream->rows * 8 * (stream->info.columnCount + 1);
+	writer->stats.bytes += length;
+	writer->stats.encodeNs += ClockMonotonicNs() - start;
+	stream->rows = 0;
+}
+
+/**
+ * @brief Internal function that writes the rows kept of every stream.
+**/
+void TelemetryFlush(TelemetryWriter * writer)
+{
+	int i;
+
+	for (i = 0; i < writer->streamCount; i++) {
+		TelemetryWriteChunk(writer, &writer->streams[i]);
+	}
+}
+
+int TelemetryOpen(TelemetryWriter * writer, char * node, long long now)
+{
+	char * directory = getenv(TELEMETRY_ENV);
+	TelemetryHeader header;
+	struct timespec wall;
+	struct stat info;
+	struct tm local;
+	char date[32];
+	int attempt;
+
+	memset(writer, 0, sizeof(TelemetryWriter));
+	writer->fd = -1;
+
+	// recorded if the directory is there
+	directory = (NULL == directory)?(TELEMETRY_DIR):(directory);
+	if (stat(directory, &info) < 0 || !S_ISDIR(info.st_mode)) {
+		return 0;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &wall);
+	localtime_r(&wall.tv_sec, &local);
+	strftime(date, sizeof(date), "%Y%m%d-%H%M%S", &local);
+
+	// a node started again within the second gets its own file
+	for (attempt = 0; attempt < 100 && writer->fd < 0; attempt++) {
+		if (0 == attempt) {
+			snprintf(writer->fileName, sizeof(writer->fileName), "%s/%s-%s.tlm", directory, node, date);
+		} else {
+			snprintf(writer->fileName, sizeof(writer->fileName), "%s/%s-%s-%d.tlm", directory, node, date, attempt);
+		}
+		writer->fd = open(writer->fileName, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	}
+
+	if (writer->fd < 0) {
+		printf("telemetry: can't create %s\n", writer->fileName);
+		return -1;
+	}
+
+	writer->buffer = malloc(sizeof(TelemetryBlock) + sizeof(TelemetryChunk) +
+				TELEMETRY_CHUNK_ROWS * TELEMETRY_VALUE_BYTES * (TELEMETRY_MAX_COLUMNS + 1));
+	if (NULL == writer->buffer) {
+		close(writer->fd);
+		writer->fd = -1;
+		return -1;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TELEMETRY_MAGIC, sizeof(header.magic));
+	snprintf(header.node, sizeof(header.node), "%s", node);
+	header.startNs = now;
+	header.startUnixNs = ((long long)wall.tv_sec * 1000000000LL) + wall.tv_nsec;
+	writer->lastFlush = now;
+
+	if (TelemetryWrite(writer, &header, sizeof(header)) < 0) {
+		return -1;
+	}
+
+	printf("telemetry: recording to %s\n", writer->fileName);
+
+	return 1;
+}
+
+int TelemetryAddStream(TelemetryWriter * writer, char * name, TelemetryColumn * columns, int count)
+{
+	TelemetryStream * stream;
+	TelemetryBlock block;
+
+	if (writer->fd < 0 || writer->streamCount >= TELEMETRY_MAX_STREAMS || count > TELEMETRY_MAX_COLUMNS) {
+		return -1;
+	}
+
+	stream = &writer->streams[writer->streamCount];
+	memset(stream, 0, sizeof(TelemetryStream));
+	stream->info.id = writer->streamCount;
+	stream->info.columnCount = count;
+	snprintf(stream->info.name, sizeof(stream->info.name), "%s", name);
+	memcpy(stream->info.columns, columns, count * sizeof(TelemetryColumn));
+
+	stream->times = malloc(TELEMETRY_CHUNK_ROWS * sizeof(long long));
+	stream->values = malloc(TELEMETRY_CHUNK_ROWS * (count + 1) * sizeof(TelemetryValue));
+	if (NULL == stream->times || NULL == stream->values) {
+		free(stream->times);
+		free(stream->values);
+		return -1;
+	}
+
+	block.type = TelemetryStreamBlock;
+	block.size = sizeof(TelemetryStreamInfo);
+	if (TelemetryWrite(writer, &block, sizeof(block)) < 0 ||
+	    TelemetryWrite(writer, &stream->info, sizeof(TelemetryStreamInfo)) < 0) {
+		return -1;
+	}
+
+	return writer->streamCount++;
+}
+
+void TelemetryRecord(TelemetryWriter * writer, int stream, long long time, double * values)
+{
+	TelemetryStream * record;
+	int column;
+
+	if (writer->fd < 0 || stream < 0 || stream >= writer->streamCount) {
+		return;
+	}
+
+	record = &writer->streams[stream];
+	record->times[record->rows] = time;
+	for (column = 0; column < record->info.columnCount; column++) {
+		if (TelemetryFloat == record->info.columns[column].type) {
+			record->values[column * TELEMETRY_CHUNK_ROWS + record->rows].f = values[column];
+		} else {
+			record->values[column * TELEMETRY_CHUNK_ROWS + record->rows].i = llround(values[column]);
+		}
+	}
+	record->rows++;
+	writer->stats.rows++;
+
+	if (TELEMETRY_CHUNK_ROWS == record->rows) {
+		TelemetryWriteChunk(writer, record);
+	}
+
+	// what a killed node loses
+	if (time - writer->lastFlush >= TELEMETRY_FLUSH_NS) {
+		writer->lastFlush = time;
+		TelemetryFlush(writer);
+	}
+}
+
+void TelemetryClose(TelemetryWriter * writer)
+{
+	TelemetryBlock block;
+	TelemetryTrailer trailer;
+	int i;
+
+	TelemetryFlush(writer);
+
+	// the streams and where the chunks are, read without going through the file
+	if (writer->fd >= 0) {
+		memset(&trailer, 0, sizeof(trailer));
+		trailer.indexOffset = writer->offset;
+		trailer.chunks = writer->indexCount;
+		memcpy(trailer.magic, TELEMETRY_INDEX_MAGIC, sizeof(trailer.magic));
+
+		block.type = TelemetryIndexBlock;
+		block.size = sizeof(int) + writer->streamCount * sizeof(TelemetryStreamInfo) +
+			     writer->indexCount * sizeof(TelemetryIndexEntry);
+		TelemetryWrite(writer, &block, sizeof(block));
+		TelemetryWrite(writer, &writer->streamCount, sizeof(int));
+		for (i = 0; i < writer->streamCount; i++) {
+			TelemetryWrite(writer, &writer->streams[i].info, sizeof(TelemetryStreamInfo));
+		}
+		TelemetryWrite(writer, writer->index, writer->indexCount * sizeof(TelemetryIndexEntry));
+		TelemetryWrite(writer, &trailer, sizeof(trailer));
+	}
+
+	if (writer->fd >= 0) {
+		close(writer->fd);
+		writer->fd = -1;
+	}
+
+	for (i = 0; i < writer->streamCount; i++) {
+		free(writer->streams[i].times);
+		free(writer->streams[i].values);
+	}
+	writer->streamCount = 0;
+	free(writer->index);
+	writer->index = NULL;
+	free(writer->buffer);
+	writer->buffer = NULL;
+}
+
+void TelemetryGetStats(TelemetryWriter * writer, TelemetryStats * stats)
+{
+	memcpy(stats, &writer->stats, sizeof(TelemetryStats));
+}
+
+/**
+ * @brief Internal function that reads the index and streams written by #TelemetryClose().
+ * @return 0 on success, -1 if the archive has no index.
+**/
+int TelemetryReadIndex(TelemetryReader * reader)
+{
+	TelemetryTrailer trailer;
+	TelemetryBlock block;
+	long long offset;
+	int streams;
+
+	if (reader->size < (long long)(sizeof(TelemetryHeader) + sizeof(TelemetryBlock) + sizeof(int) + sizeof(TelemetryTrailer))) {
+		return -1;
+	}
+
+	memcpy(&trailer, reader->data + reader->size - sizeof(TelemetryTrailer), sizeof(TelemetryTrailer));
+	if (0 != memcmp(trailer.magic, TELEMETRY_INDEX_MAGIC, sizeof(trailer.magic)) ||
+	    trailer.indexOffset < (long long)sizeof(TelemetryHeader) || trailer.chunks < 0 ||
+	    trailer.indexOffset > reader->size - (long long)(sizeof(TelemetryBlock) + sizeof(int) + sizeof(TelemetryTrailer))) {
+		return -1;
+	}
+
+	offset = trailer.indexOffset;
+	memcpy(&block, reader->data + offset, sizeof(block));
+	memcpy(&streams, reader->data + offset + sizeof(block), sizeof(int));
+	if (TelemetryIndexBlock != block.type || streams < 0 || streams > TELEMETRY_MAX_STREAMS ||
+	    offset + (long long)(sizeof(block) + sizeof(TelemetryTrailer)) + block.size != reader->size ||
+	    block.size != sizeof(int) + streams * sizeof(TelemetryStreamInfo) + trailer.chunks * sizeof(TelemetryIndexEntry)) {
+		return -1;
+	}
+
+	offset += sizeof(block) + sizeof(int);
+	reader->streamCount = streams;
+	memcpy(reader->streams, reader->data + offset, streams * sizeof(TelemetryStreamInfo));
+	offset += streams * sizeof(TelemetryStreamInfo);
+
+	reader->indexCount = trailer.chunks;
+	reader->index = malloc((trailer.chunks + 1) * sizeof(TelemetryIndexEntry));
+	if (NULL == reader->index) {
+		return -1;
+	}
+	memcpy(reader->index, reader->data + offset, trailer.chunks * sizeof(TelemetryIndexEntry));
+	reader->indexed = 1;
+
+	return 0;
+}
+
+/**
+ * @brief Internal function that builds the index of an archive that was not closed, block by block.
+**/
+void TelemetryBuildIndex(TelemetryReader * reader)
+{
+	TelemetryBlock block;
+	TelemetryChunk chunk;
+	TelemetryIndexEntry * entry;
+	long long offset = sizeof(TelemetryHeader);
+	long long size = 0;
+
+	reader->streamCount = 0;
+	reader->indexCount = 0;
+
+	while (offset + (long long)sizeof(block) <= reader->size) {
+		memcpy(&block, reader->data + offset, sizeof(block));
+		// cut short, the node was killed while writing it
+		if (offset + (long long)sizeof(block) + block.size > reader->size) {
+			break;
+		}
+
+		if (TelemetryStreamBlock == block.type && sizeof(TelemetryStreamInfo) == block.size &&
+		    reader->streamCount < TELEMETRY_MAX_STREAMS) {
+			memcpy(&reader->streams[reader->streamCount++], reader->data + offset + sizeof(block), sizeof(TelemetryStreamInfo));
+		} else if (TelemetryChunkBlock == block.type && block.size >= sizeof(TelemetryChunk)) {
+			memcpy(&chunk, reader->data + offset + sizeof(block), sizeof(chunk));
+			if (reader->indexCount == size) {
+				size = (size)?(size * 2):(256);
+				reader->index = realloc(reader->index, size * sizeof(TelemetryIndexEntry));
+			}
+			entry = &reader->index[reader->indexCount++];
+			entry->offset = offset;
+			entry->stream = chunk.stream;
+			entry->rows = chunk.rows;
+			entry->first = chunk.first;
+			entry->last = chunk.last;
+		} else if (TelemetryIndexBlock != block.type) {
+			break;
+		}
+
+		offset += sizeof(block) + block.size;
+	}
+}
+
+int TelemetryMap(TelemetryReader * reader, char * fileName)
+{
+	struct stat info;
+	int fd;
+
+	memset(reader, 0, sizeof(TelemetryReader));
+
+	fd = open(fileName, O_RDONLY);
+	if (fd < 0) {
+		printf("can't open %s\n", fileName);
+		return -1;
+	}
+
+	if (fstat(fd, &info) < 0 || info.st_size < (long long)sizeof(TelemetryHeader)) {
+		printf("%s is not a telemetry archive\n", fileName);
+		close(fd);
+		return -1;
+	}
+
+	reader->size = info.st_size;
+	reader->data = mmap(NULL, reader->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (MAP_FAILED == reader->data) {
+		printf("can't map %s\n", fileName);
+		reader->data = NULL;
+		return -1;
+	}
+
+	memcpy(&reader->header, reader->data, sizeof(TelemetryHeader));
+	if (0 != memcmp(reader->header.magic, TELEMETRY_MAGIC, sizeof(reader->header.magic))) {
+		printf("%s is not a telemetry archive\n", fileName);
+		TelemetryUnmap(reader);
+		return -1;
+	}
+
+	if (TelemetryReadIndex(reader) < 0) {
+		TelemetryBuildIndex(reader);
+	}
+
+	return 0;
+}
+
+int TelemetryFindStream(TelemetryReader * reader, char * name)
+{
+	int i;
+
+	for (i = 0; i < reader->streamCount; i++) {
+		if (0 == strcmp(reader->streams[i].name, name)) {
+			return reader->streams[i].id;
+		}
+	}
+
+	return -1;
+}
+
+int TelemetryFindColumn(TelemetryReader * reader, int stream, char * name)
+{
+	TelemetryStreamInfo * info = &reader->streams[stream];
+	int i;
+
+	if (0 == strcmp(name, "time")) {
+		return 0;
+	}
+
+	for (i = 0; i < info->columnCount; i++) {
+		if (0 == strcmp(info->columns[i].name, name)) {
+			return i + 1;
+		}
+	}
+
+	return -1;
+}
+
+unsigned int TelemetryColumnBytes(TelemetryReader * reader, long long chunk, int column)
+{
+	TelemetryChunk header;
+
+	memcpy(&header, reader->data + reader->index[chunk].offset + sizeof(TelemetryBlock), sizeof(header));
+
+	return header.sizes[column];
+}
+
+int TelemetryDecode(TelemetryReader * reader, long long chunk, int column, TelemetryValue * values)
+{
+	TelemetryIndexEntry * entry = &reader->index[chunk];
+	TelemetryBlock block;
+	TelemetryChunk header;
+	unsigned char * data;
+	unsigned long long value;
+	unsigned int position = 0;
+	long long previous = 0;
+	long long delta = 0;
+	long long offset;
+	int i;
+
+	memcpy(&block, reader->data + entry->offset, sizeof(block));
+	memcpy(&header, reader->data + entry->offset + sizeof(block), sizeof(header));
+	if (header.rows <= 0 || header.rows > TELEMETRY_CHUNK_ROWS || header.stream < 0 ||
+	    header.stream >= reader->streamCount || column > reader->streams[header.stream].columnCount) {
+		return -1;
+	}
+
+	// the columns before it are skipped by their sizes
+	offset = sizeof(header);
+	for (i = 0; i < column; i++) {
+		offset += header.sizes[i];
+	}
+	if (offset + header.sizes[column] > block.size) {
+		return -1;
+	}
+	data = reader->data + entry->offset + sizeof(block) + offset;
+
+	if (column > 0 && TelemetryFloat == reader->streams[header.stream].columns[column - 1].type) {
+		return (DecodeFloats(data, header.sizes[column], header.rows, values) < 0)?(-1):(header.rows);
+	}
+
+	for (i = 0; i < header.rows; i++) {
+		if (GetVarint(data, header.sizes[column], &position, &value) < 0) {
+			return -1;
+		}
+
+		// times are the differences of their differences
+		if (0 == column) {
+			delta += UnZigZag(value);
+			previous += delta;
+		} else {
+			previous += UnZigZag(value);
+		}
+		values[i].i = previous;
+	}
+
+	return header.rows;
+}
+
+void TelemetryUnmap(TelemetryReader * reader)
+{
+	if (NULL != reader->data) {
+		munmap(reader->data, reader->size);
+		reader->data = NULL;
+	}
+	free(reader->index);
+	reader->index = NULL;
+}
@@ -0,0 +1,173 @@
+/**
+ * @file TimeSync.c
+ * @brief Function definitions for the TimeSync library.
+ * @details Function definitions for the TimeSync library.
+**/
+
+#include "../include/TimeSync.h"
+
+/**
+ * @brief Internal function that fits the drift to the samples used, least squares.
+**/
+void TimeSyncFitDrift(TimeSync * sync)
+{
+	TimeSyncSample * first = &sync->points[(sync->pointNext - sync->pointCount + TIMESYNC_POINTS) % TIMESYNC_POINTS];
+	TimeSyncSample * point;
+	double meanX = 0.0, meanY = 0.0;
+	double sxx = 0.0, sxy = 0.0;
+	double x, y;
+	int i;
+
+	if (sync->pointCount < 3 || sync->best.local - first->local < TIMESYNC_MIN_SPAN_NS) {
+		return;
+	}
+
+	// relative to the oldest, the clocks themselves are too big for a double's precision
+	for (i = 0; i < sync->pointCount; i++) {
+		point = &sync->points[i];
+		meanX += (double)(point->local - first->local);
+		meanY += (double)(point->offset - first->offset);
+	}
+	meanX /= sync->pointCount;
+	meanY /= sync->pointCount;
+
+	for (i = 0; i < sync->pointCount; i++) {
+		point = &sync->points[i];
+		x = (double)(point->local - first->local) - meanX;
+		y = (double)(point->offset - first->offset) - meanY;
+		sxx += x * x;
+		sxy += x * y;
+	}
+
+	if (sxx > 0.0) {
+		sync->drift = sxy / sxx;
+		sync->drift = (sync->drift > TIMESYNC_MAX_DRIFT)?(TIMESYNC_MAX_DRIFT):(sync->drift);
+		sync->drift = (sync->drift < -TIMESYNC_MAX_DRIFT)?(-TIMESYNC_MAX_DRIFT):(sync->drift);
+	}
+}
+
+void TimeSyncInit(TimeSync * sync)
+{
+	memset(sync, 0, sizeof(TimeSync));
+}
+
+void TimeSyncPing(TimeSync * sync, Message * message, long long now)
+{
+	long long error;
+
+	memset(message, 0, sizeof(Message));
+	message->messageType = TimeMessage;
+	message->destination = TX2Comm;
+	message->timeMsg.originate = now;
+	message->timeMsg.offset = TimeSyncOffset(sync, now, &error);
+
+	// 0 is no estimate, a perfect one is still 1 ns
+	error = (error > 0xFFFFFFFFLL)?(0xFFFFFFFFLL):(error);
+	message->timeMsg.error = (!sync->valid)?(0):((error < 1)?(1):((unsigned int)error));
+	message->timeMsg.drift = (float)(sync->drift * 1000000.0);
+
+	sync->lastPing = now;
+}
+
+int TimeSyncDue(TimeSync * sync, long long now)
+{
+	return 0 == sync->lastPing || now - sync->lastPing >= TIMESYNC_PERIOD_NS;
+}
+
+void TimeSyncAnswer(Message * message, long long receive, long long transmit)
+{
+	message->timeMsg.receive = receive;
+	message->timeMsg.transmit = transmit;
+}
+
+int TimeSyncAdd(TimeSync * sync, Message * message, long long now)
+{
+	TimeMsg * ping = &message->timeMsg;
+	TimeSyncStats * stats = &sync->stats;
+	TimeSyncSample sample;
+	TimeSyncSample * best;
+	long long offset;
+	long long up, down;
+	int i;
+
+	sample.local = ping->originate + (now - ping->originate) / 2;
+	sample.offset = ((ping->receive - ping->originate) + (ping->transmit - now)) / 2;
+	sample.delay = (now - ping->originate) - (ping->transmit - ping->receive);
+
+	// an answer from before we started, or clocks that went backwards
+	if (ping->originate > now || ping->originate < sync->lastPing - TIMESYNC_FILTER * TIMESYNC_PERIOD_NS ||
+	    sample.delay < 0) {
+		stats->rejected++;
+		return -1;
+	}
+
+	sync->filter[sync->filterNext] = sample;
+	sync->filterNext = (sync->filterNext + 1) % TIMESYNC_FILTER;
+	sync->filterCount += (sync->filterCount < TIMESYNC_FILTER)?(1):(0);
+
+	// the least delay of the newest, the newest of those that tie
+	best = &sync->filter[(sync->filterNext - 1 + TIMESYNC_FILTER) % TIMESYNC_FILTER];
+	for (i = 0; i < sync->filterCount; i++) {
+		if (sync->filter[i].delay < best->delay ||
+		    (sync->filter[i].delay == best->delay && sync->filter[i].local > best->local)) {
+			best = &sync->filter[i];
+		}
+	}
+
+	// used once, a sample staying the best is no new point for the drift
+	if (!sync->valid || best->local > sync->best.local) {
+		sync->best = *best;
+		sync->valid = 1;
+		sync->points[sync->pointNext] = *best;
+		sync->pointNext = (sync->pointNext + 1) % TIMESYNC_POINTS;
+		sync->pointCount += (sync->pointCount < TIMESYNC_POINTS)?(1):(0);
+		stats->used++;
+		TimeSyncFitDrift(sync);
+	}
+
+	// the one way latencies of this sample on the estimate, within its error
+	offset = TimeSyncOffset(sync, sample.local, NULL);
+	up = ping->receive - ping->originate - offset;
+	down = now - ping->transmit + offset;
+
+	if (0 == stats->samples) {
+		stats->minDelay = stats->maxDelay = sample.delay;
+		stats->upMin = stats->upMax = up;
+		stats->downMin = stats->downMax = down;
+	}
+	stats->samples++;
+	stats->minDelay = (sample.delay < stats->minDelay)?(sample.delay):(stats->minDelay);
+	stats->maxDelay = (sample.delay > stats->maxDelay)?(sample.delay):(stats->maxDelay);
+	stats->upMin = (up < stats->upMin)?(up):(stats->upMin);
+	stats->upMax = (up > stats->upMax)?(up):(stats->upMax);
+	stats->upSum += up;
+	stats->downMin = (down < stats->downMin)?(down):(stats->downMin);
+	stats->downMax = (down > stats->downMax)?(down):(stats->downMax);
+	stats->downSum += down;
+
+	return 0;
+}
+
+long long TimeSyncOffset(TimeSync * sync, long long local, long long * error)
+{
+	double since;
+
+	if (!sync->valid) {
+		if (NULL != error) {
+			*error = -1;
+		}
+		return 0;
+	}
+
+	since = (double)(local - sync->best.local);
+	if (NULL != error) {
+		*error = sync->best.delay / 2 + (long long)(TIMESYNC_WANDER * ((since < 0.0)?(-since):(since)));
+	}
+
+	return sync->best.offset + (long long)(sync->drift * since);
+}
+
+void TimeSyncGetStats(TimeSync * sync, TimeSyncStats * stats)
+{
+	memcpy(stats, &sync->stats, sizeof(TimeSyncStats));
+}
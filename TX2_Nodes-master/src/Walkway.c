@@ -0,0 +1,316 @@
+/**
+ * @file Walkway.c
+ * @brief Function definitions for the Walkway library.
+ * @details Function definitions for the Walkway library.
+**/
+
+#include "../include/Walkway.h"
+#include "../include/Clock.h"
+
+/**
+ * @brief Internal function that finds the path pixel of a row nearest a column.
+ * @return The column, -1 if the row has no path.
+**/
+int FindPath(Walkway * walkway, uint8_t * line, int column)
+{
+	int distance;
+
+	for (distance = 0; distance < walkway->width; distance++) {
+		if (column - distance >= 0 && walkway->classes[line[column - distance]]) {
+			return column - distance;
+		}
+		if (column + distance < walkway->width && walkway->classes[line[column + distance]]) {
+			return column + distance;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * @brief Internal function that follows a run of path from a column to its end.
+ * @param step -1 for the left end, 1 for the right.
+ * @return The last path column of the run.
+**/
+int RunEnd(Walkway * walkway, uint8_t * line, int column, int step)
+{
+	int edge = column;
+	int gap = 0;
+
+	for (column += step; column >= 0 && column < walkway->width; column += step) {
+		if (walkway->classes[line[column]]) {
+			edge = column;
+			gap = 0;
+		} else if (++gap > WALKWAY_GAP) {
+			break;
+		}
+	}
+
+	return edge;
+}
+
+/**
+ * @brief Internal function that fits column = line[0] + line[1] * row to the points of one edge.
+ * @param points Row, left and right column of each sampled row.
+ * @param count Number of sampled rows.
+ * @param side 1 for the left edge, 2 for the right.
+ * @param guide Points further than limit from it are left out, NULL for none.
+ * @param limit Pixels.
+ * @param line Output.
+ * @return The number of points used, -1 if too few to fit.
+**/
+int FitLine(float * points, int count, int side, double * guide, double limit, double * line)
+{
+	double sumRow = 0.0, sumColumn = 0.0, sumRowRow = 0.0, sumRowColumn = 0.0;
+	double row, column, denominator;
+	int used = 0;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		row = points[(3 * i)];
+		column = points[(3 * i) + side];
+		if (column < 0.0f) {
+			continue;
+		}
+		if (NULL != guide && fabs(column - (guide[0] + (guide[1] * row))) > limit) {
+			continue;
+		}
+
+		sumRow += row;
+		sumColumn += column;
+		sumRowRow += row * row;
+		sumRowColumn += row * column;
+		used++;
+	}
+
+	denominator = (used * sumRowRow) - (sumRow * sumRow);
+	if (used < WALKWAY_MIN_POINTS || denominator <= 0.0) {
+		return -1;
+	}
+
+	line[1] = ((used * sumRowColumn) - (sumRow * sumColumn)) / denominator;
+	line[0] = (sumColumn - (line[1] * sumRow)) / used;
+
+	return used;
+}
+
+/**
+ * @brief Internal function that fits one edge, keeping clear of outliers.
+ * @param previous The line of the masks before, NULL if there is none.
+ * @param fresh Output, 1 if previous was not used.
+ * @return The number of points used, -1 if the edge could not be fitted.
+**/
+int FitEdge(float * points, int count, int side, double * previous, double * line, int * fresh)
+{
+	double first[2];
+
+	*fresh = 0;
+	if (NULL == previous || FitLine(points, count, side, previous, WALKWAY_GATE, first) < 0) {
+		// too little near the old line, a new walkway
+		*fresh = 1;
+		if (FitLine(points, count, side, NULL, 0.0, first) < 0) {
+			return -1;
+		}
+	}
+
+	return FitLine(points, count, side, first, WALKWAY_OUTLIER, line);
+}
+
+/**
+ * @brief Internal function that returns meters to the side of the rover a line meets the ground at a row.
+**/
+double GroundLateral(Walkway * walkway, double * line, int row, double distance)
+{
+	return ((line[0] + (line[1] * row) + 0.5 - (walkway->width / 2.0)) / walkway->focal) * distance;
+}
+
+int WalkwayInit(Walkway * walkway, int width, int height, float * rowDistance, float focal)
+{
+	int label;
+
+	memset(walkway, 0, sizeof(Walkway));
+	walkway->width = width;
+	walkway->height = height;
+	walkway->rowDistance = rowDistance;
+	walkway->focal = focal;
+
+	for (label = 0; label < 32; label++) {
+		walkway->classes[label] = (WALKWAY_CLASSES >> label) & 1;
+	}
+
+	walkway->points = malloc((((height / WALKWAY_ROW_STEP) + 1) * 3) * sizeof(float));
+
+	if (NULL == walkway->points) {
+		printf("out of memory for walkway fitting\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+int WalkwayFit(Walkway * walkway, uint8_t * mask, int firstRow, long long time, WalkwayEstimate * estimate)
+{
+	float * points = walkway->points;
+	double line[2];
+	double nearLateral[2], farLateral[2], heading[2];
+	double nearDistance, farDistance, direction, width;
+	long long start;
+	long long elapsed;
+	uint8_t * row;
+	int nearRow, farRow;
+	int left, right, column;
+	int count = 0;
+	int edges, fresh;
+	int used[2];
+	int side, y;
+
+	start = ClockMonotonicNs();
+
+	memset(estimate, 0, sizeof(WalkwayEstimate));
+	estimate->frame = walkway->frame++;
+	estimate->time = time;
+
+	firstRow = (firstRow < 0)?(0):(firstRow);
+	nearRow = walkway->height - 1;
+	column = walkway->width / 2;
+
+	// the edges of the run of path above the middle of the one below, until there is no path
+	for (y = nearRow; y >= firstRow; y -= WALKWAY_ROW_STEP) {
+		row = mask + ((long)y * walkway->width);
+
+		column = FindPath(walkway, row, column);
+		if (column < 0) {
+			break;
+		}
+
+		left = RunEnd(walkway, row, column, -1);
+		right = RunEnd(walkway, row, column, 1);
+
+		points[(3 * count)] = y;
+		points[(3 * count) + 1] = (left > 0)?(left):(-1.0f);
+		points[(3 * count) + 2] = (right < walkway->width - 1)?(right):(-1.0f);
+		count++;
+
+		column = (left + right) / 2;
+	}
+
+	farRow = (count)?((int)points[3 * (count - 1)]):(nearRow);
+	nearDistance = walkway->rowDistance[nearRow];
+	farDistance = walkway->rowDistance[farRow];
+	edges = 0;
+
+	for (side = 0; side < 2; side++) {
+		used[side] = FitEdge(points, count, side + 1, (walkway->haveLine[side])?(walkway->lines[side]):(NULL),
+				     line, &fresh);
+		walkway->haveLine[side] = (used[side] > 0);
+		if (!walkway->haveLine[side]) {
+			// lost, the line of the masks before is not published as this one's
+			memset(walkway->lines[side], 0, sizeof(walkway->lines[side]));
+			continue;
+		}
+
+		if (!fresh) {
+			// blend into the line of the masks before
+			walkway->lines[side][0] += WALKWAY_SMOOTHING * (line[0] - walkway->lines[side][0]);
+			walkway->lines[side][1] += WALKWAY_SMOOTHING * (line[1] - walkway->lines[side][1]);
+		} else {
+			memcpy(walkway->lines[side], line, sizeof(line));
+		}
+
+		if (nearDistance <= 0.0f || farDistance <= nearDistance) {
+			continue;
+		}
+
+		// the edge on the ground
+		nearLateral[side] = GroundLateral(walkway, walkway->lines[side], nearRow, nearDistance);
+		farLateral[side] = GroundLateral(walkway, walkway->lines[side], farRow, farDistance);
+		heading[side] = atan2(farLateral[side] - nearLateral[side], farDistance - nearDistance);
+		edges |= 1 << side;
+	}
+
+	estimate->leftPoints = (used[0] > 0)?(used[0]):(0);
+	estimate->rightPoints = (used[1] > 0)?(used[1]):(0);
+	estimate->left[0] = walkway->lines[0][0];
+	estimate->left[1] = walkway->lines[0][1];
+	estimate->right[0] = walkway->lines[1][0];
+	estimate->right[1] = walkway->lines[1][1];
+
+	if (3 == edges) {
+		// halfway between the edges, the width across the walkway
+		direction = (heading[0] + heading[1]) / 2.0;
+		width = (nearLateral[1] - nearLateral[0]) * cos(direction);
+		if (width > 0.0) {
+			walkway->pathWidth = (walkway->pathWidth > 0.0)?
+					     (walkway->pathWidth + (WALKWAY_SMOOTHING * (width - walkway->pathWidth))):(width);
+			estimate->offset = (nearLateral[0] + nearLateral[1]) / 2.0;
+			estimate->heading = direction * (180.0 / M_PI);
+			estimate->valid = 1;
+		}
+	} else if (edges && walkway->pathWidth > 0.0) {
+		// half the width from the one edge there is
+		side = (2 == edges)?(1):(0);
+		direction = heading[side];
+		estimate->offset = nearLateral[side] + (((side)?(-0.5):(0.5)) * walkway->pathWidth / cos(direction));
+		estimate->heading = direction * (180.0 / M_PI);
+		estimate->valid = 1;
+	}
+	estimate->width = walkway->pathWidth;
+
+	elapsed = ClockMonotonicNs() - start;
+	walkway->stats.masks++;
+	walkway->stats.valid += estimate->valid;
+	walkway->stats.fitNs += elapsed;
+	if (elapsed > walkway->stats.maxNs) {
+		walkway->stats.maxNs = elapsed;
+	}
+
+	return (estimate->valid)?(0):(-1);
+}
+
+double WalkwayTurn(WalkwayEstimate * estimate, double lookahead)
+{
+	if (!estimate->valid || lookahead <= 0.0) {
+		return 0.0;
+	}
+
+	// the heading to line up with it and the angle to a point of it lookahead meters on
+	return estimate->heading + (atan2(estimate->offset, lookahead) * (180.0 / M_PI));
+}
+
+void WalkwayGetStats(Walkway * walkway, WalkwayStats * stats)
+{
+	memcpy(stats, &walkway->stats, sizeof(WalkwayStats));
+}
+
+void WalkwayClose(Walkway * walkway)
+{
+	free(walkway->points);
+	walkway->points = NULL;
+}
+
+void PublishWalkway(WalkwayShared * shared, WalkwayEstimate * estimate)
+{
+	// odd while writing
+	shared->sequence++;
+	__sync_synchronize();
+	memcpy(&shared->estimate, estimate, sizeof(WalkwayEstimate));
+	__sync_synchronize();
+	shared->sequence++;
+}
+
+int GetWalkway(WalkwayShared * shared, WalkwayEstimate * estimate)
+{
+	unsigned int sequence;
+
+	do {
+		sequence = shared->sequence;
+		if (0 == sequence) {
+			return -1;
+		}
+		__sync_synchronize();
+		memcpy(estimate, &shared->estimate, sizeof(WalkwayEstimate));
+		__sync_synchronize();
+	} while ((sequence & 1) || sequence != shared->sequence);
+
+	return 0;
+}
@@ -0,0 +1,142 @@
+/**
+ * @file Watchdog.c
+ * @brief Function definitions for the Watchdog library.
+ * @details Function definitions for the Watchdog library.
+**/
+
+#include "../include/Watchdog.h"
+
+/**
+ * @brief Names of the #WatchdogSource values, for logging.
+**/
+char * watchdogSourceNames[WatchdogSources] = { "mask", "pose", "gyro" };
+
+void WatchdogInit(Watchdog * watchdog, long long now)
+{
+	int source;
+
+	memset(watchdog, 0, sizeof(Watchdog));
+	watchdog->mode = WatchdogWaiting;
+	watchdog->level = WatchdogOk;
+
+	for (source = 0; source < WatchdogSources; source++) {
+		watchdog->since[source] = now;
+	}
+}
+
+void WatchdogSetDeadlines(Watchdog * watchdog, int maskMs, int poseMs, int gyroMs)
+{
+	int mode;
+
+	for (mode = 0; mode < WatchdogModes; mode++) {
+		// nav only asks for masks while driving
+		watchdog->deadline[mode][WatchdogMask] = (WatchdogDriving == mode)?(maskMs * 1000000LL):(0);
+		watchdog->deadline[mode][WatchdogPose] = poseMs * 1000000LL;
+		watchdog->deadline[mode][WatchdogGyro] = gyroMs * 1000000LL;
+	}
+}
+
+void WatchdogSetMode(Watchdog * watchdog, WatchdogMode mode)
+{
+	watchdog->mode = mode;
+}
+
+void WatchdogFeed(Watchdog * watchdog, WatchdogSource source, long long time)
+{
+	if (time > watchdog->since[source]) {
+		watchdog->since[source] = time;
+	}
+}
+
+WatchdogLevel WatchdogCheck(Watchdog * watchdog, long long now)
+{
+	WatchdogLevel level = WatchdogOk;
+	WatchdogLevel sourceLevel;
+	long long deadline;
+	long long age;
+	int source;
+
+	watchdog->stats.checks++;
+
+	for (source = 0; source < WatchdogSources; source++) {
+		deadline = watchdog->deadline[watchdog->mode][source];
+		age = now - watchdog->since[source];
+
+		if (0 == deadline || age <= deadline) {
+			if (watchdog->late[source] && 0 != deadline) {
+				printf("watchdog: %s back on time\n", watchdogSourceNames[source]);
+			}
+			watchdog->late[source] = 0;
+			continue;
+		}
+
+		// counted and logged once each time it goes past
+		if (!watchdog->late[source]) {
+			watchdog->late[source] = 1;
+			watchdog->stats.missed[source]++;
+			printf("watchdog: no %s for %.0f ms, deadline %.0f ms, missed %lu times\n", watchdogSourceNames[source],
+				age / 1000000.0, deadline / 1000000.0, watchdog->stats.missed[source]);
+		}
+		if (age > watchdog->stats.worstNs[source]) {
+			watchdog->stats.worstNs[source] = age;
+		}
+
+		if (age > WATCHDOG_MANUAL_FACTOR * deadline) {
+			sourceLevel = WatchdogHandOver;
+		} else if (age > WATCHDOG_STOP_FACTOR * deadline) {
+			sourceLevel = WatchdogStop;
+		} else {
+			sourceLevel = WatchdogSlow;
+		}
+		level = (sourceLevel > level)?(sourceLevel):(level);
+	}
+
+	// only a rover that is driving itself is degraded
+	if (WatchdogDriving != watchdog->mode) {
+		level = WatchdogOk;
+	}
+
+	if (level != watchdog->level && WatchdogOk != level) {
+		watchdog->stats.degraded[level]++;
+	}
+	watchdog->level = level;
+
+	return level;
+}
+
+long long WatchdogNextCheck(Watchdog * watchdog, long long now)
+{
+	long long factors[3] = { 1, WATCHDOG_STOP_FACTOR, WATCHDOG_MANUAL_FACTOR };
+	long long next = LLONG_MAX;
+	long long deadline;
+	long long when;
+	int source, i;
+
+	for (source = 0; source < WatchdogSources; source++) {
+		deadline = watchdog->deadline[watchdog->mode][source];
+		if (0 == deadline) {
+			continue;
+		}
+
+		// the first of the deadline and its multiples still to come, a nanosecond past it
+		for (i = 0; i < 3; i++) {
+			when = watchdog->since[source] + (factors[i] * deadline) + 1;
+			if (when > now) {
+				next = (when < next)?(when):(next);
+				break;
+			}
+		}
+	}
+
+	return next;
+}
+
+char * WatchdogSourceName(WatchdogSource source)
+{
+	return (source >= 0 && source < WatchdogSources)?(watchdogSourceNames[source]):("unknown");
+}
+
+void WatchdogGetStats(Watchdog * watchdog, WatchdogStats * stats)
+{
+	memcpy(stats, &watchdog->stats, sizeof(WatchdogStats));
+}
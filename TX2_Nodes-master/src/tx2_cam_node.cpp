@@ -12,6 +12,11 @@
  * 	    jetson-inference repository, there are instructions in the repo for how to 
  * 	    install. 
  * 	    <br><br>
+ * 	    The mask is made from segNet's class scores by SegArgmax.h on the CPU, with the
+ * 	    confidence of each pixel after it in the shared memory, in place of segNet's Mask().
+ * 	    A jetson-inference whose segNet has no accessors for the scores (see #SegScores())
+ * 	    still gets segNet's Mask(), with every pixel at #SEG_ARGMAX_CERTAIN.
+ * 	    <br><br>
  * 	    <center>LEAVE NVIDIA COPYRIGHT AS IS</center>
  * 	    <br><br>
 **/
@@ -55,12 +60,43 @@
 
 #define REL_LOC "../images/img%.3d.jpg"
 
+// uncomment to record the masks to CAMERA_REPLAY_FILE, for replay by tx2_host_cam_node.c
+//#define RECORD_MASKS
+
 // to access the Messages and SharedMem libraries, we must tell the
 // compiler that these are externally defined C functions, not C++. 
 // Without this tx2_cam_node.cpp will not compile.
 extern "C" {
 #include "../include/Messages.h"
 #include "../include/SharedMem.h"
+#include "../include/Camera.h"
+#include "../include/SegArgmax.h"
+}
+
+/**
+ * @brief Returns the class scores segNet keeps in its output layer after Process(), and their size.
+ * @details Only where the jetson-inference built against has tensorNet's GetOutputPtr() and
+ *	    segNet's GetNumClasses(), GetGridWidth() and GetGridHeight(), older versions keep the
+ *	    output layer to themselves. The buffer is allocated once, with the network.
+ * @return The scores, classes planes of gridWidth x gridHeight.
+**/
+template <typename Net>
+auto SegScores(Net * net, int * classes, int * gridWidth, int * gridHeight, int)
+	-> decltype(net->GetOutputPtr(0), net->GetNumClasses(), net->GetGridWidth(), net->GetGridHeight(), (float *)NULL)
+{
+	*classes = net->GetNumClasses();
+	*gridWidth = net->GetGridWidth();
+	*gridHeight = net->GetGridHeight();
+	return net->GetOutputPtr(0);
+}
+
+/**
+ * @brief Returns NULL, the jetson-inference built against has no accessors for the scores.
+**/
+template <typename Net>
+float * SegScores(Net *, int *, int *, int *, long)
+{
+	return NULL;
 }
 
 int main( int argc, char** argv )
@@ -74,6 +110,10 @@ int main( int argc, char** argv )
 	int imagesTaken;
 	int killMessageReceived;
 	SharedMem * sharedMem;
+	SegArgmax argmax;
+	SegArgmaxStats argmaxStats;
+	float * scores;
+	int classes, gridWidth, gridHeight;
 	Message message;
 
 	// make sure that pipes have been provided by master
@@ -109,8 +149,8 @@ int main( int argc, char** argv )
 	camWidth = camera->GetWidth();
 	camHeight = camera->GetHeight();
 
-	// create shared memory for semantic segmentation data
-	sharedMem = CreateSharedMemory((camWidth * camHeight), SegmentationData);
+	// create shared memory for semantic segmentation data, the mask and its confidence
+	sharedMem = CreateSharedMemory((camWidth * camHeight * SEG_ARGMAX_PLANES), SegmentationData);
 
 	if (NULL == sharedMem) {
 		printf("SHARED MEMORY ERROR IN CAM NODE\n");
@@ -126,10 +166,10 @@ int main( int argc, char** argv )
 	message.source = TX2Cam;
 	message.destination = TX2Nav;
 
-	sleep(5);
+	ClockSleep(5 * CLOCK_SECOND);
 
 	// signal nav node that shared mem is ready
-	write(masterWrite, &message, sizeof(message));
+	SendMessage(masterWrite, &message);
 
 	/*
 	 * create segmentation network
@@ -141,6 +181,17 @@ int main( int argc, char** argv )
 		return 0;
 	}
 
+	// the mask is made from the scores, segNet's 'void' is never chosen as its Mask() does
+	memset(&argmax, 0, sizeof(argmax));
+	scores = SegScores(sNet, &classes, &gridWidth, &gridHeight, 0);
+
+	if (NULL == scores) {
+		printf("segnet-camera:   no class scores in this jetson-inference, the mask is segNet's\n");
+	} else if (SegArgmaxInit(&argmax, classes, 0, gridWidth, gridHeight, camWidth, camHeight, SegConfidenceMargin) < 0) {
+		printf("segnet-camera:   failed to initialize the mask\n");
+		return 0;
+	}
+
 	/*
 	 * create recognition network
 	 */
@@ -187,6 +238,16 @@ int main( int argc, char** argv )
 	
 	// Patrick Henz
 	uint8_t * mask = (uint8_t *)(sharedMem + 1);
+	uint8_t * maskConfidence = mask + (camWidth * camHeight);
+
+	// segNet's own masks come without a confidence
+	if (NULL == scores) {
+		memset(maskConfidence, SEG_ARGMAX_CERTAIN, camWidth * camHeight);
+	}
+
+#ifdef RECORD_MASKS
+	int maskRecord = CameraRecordOpen(CAMERA_REPLAY_FILE, camWidth, camHeight);
+#endif
 
 	killMessageReceived = 0;
 
@@ -202,7 +263,7 @@ int main( int argc, char** argv )
 				continue;
 			}
 
-			read(readFds[i], &message, sizeof(message));
+			ReceiveMessage(readFds[i], &message);
 
 			// camera image request from controller
 			if (message.messageType == CamMessage) {
@@ -252,7 +313,7 @@ int main( int argc, char** argv )
 				message.destination = TX2Comm;
 
 				// write to master
-				write(masterWrite, &message, sizeof(message));
+				SendMessage(masterWrite, &message);
 			} else if (message.messageType == SharedMemory) {   // the message was for semantic segmentation data
 				float * imgRGBA = NULL;
 
@@ -268,20 +329,33 @@ int main( int argc, char** argv )
 				}
 
 				// this is where we get the array for the semantic segmentation data
-				if ( !sNet->Mask(mask, (int)camera->GetWidth(), (int)camera->GetHeight())) {
+				if (NULL == scores && !sNet->Mask(mask, (int)camera->GetWidth(), (int)camera->GetHeight())) {
 					printf("segnet-console: failed to process segmentation mask\n");
 					continue;
 				}
 
 				// we need the CPU to wait for the GPU cores to finish processing
 				CUDA(cudaDeviceSynchronize());
+
+				// or make it from the scores, with how sure of it segNet was. GetOutputPtr() is the
+				// CUDA pointer of the output layer, but segNet allocates the layer with
+				// cudaAllocMapped(), zero-copy memory the CPU and GPU of the Jetson share, and under
+				// unified virtual addressing the device pointer of mapped host memory is its host
+				// pointer, so once the GPU is done the CPU reads the scores where they are
+				if (NULL != scores) {
+					SegArgmaxApply(&argmax, scores, mask, maskConfidence);
+				}
+
+#ifdef RECORD_MASKS
+				CameraRecordMask(maskRecord, mask, camWidth * camHeight);
+#endif
 	
 				// prep message for navigation node, the shared memory location has fresh data
 				memset(&message, 0, sizeof(message));
 				message.messageType = SharedMemory;
 				message.source = TX2Cam;
 				message.destination = TX2Nav;
-				write(masterWrite, &message, sizeof(message));
+				SendMessage(masterWrite, &message);
 			} else if (message.messageType = KillMessage) { 
 				// we received a kill message. 
 				// close shared memory and pipes
@@ -297,6 +371,14 @@ int main( int argc, char** argv )
 	 * destroy resources
 	 */
 	printf("segnet-camera:  shutting down...\n");
+
+	if (NULL != scores) {
+		SegArgmaxGetStats(&argmax, &argmaxStats);
+		printf("segnet-camera:  %lu masks, %s argmax avg %.3f ms, scaling avg %.3f ms, max %.3f ms\n", argmaxStats.masks,
+			SegArgmaxName(argmax.kernel), (argmaxStats.masks)?((argmaxStats.argmaxNs / 1000000.0) / argmaxStats.masks):(0.0),
+			(argmaxStats.masks)?((argmaxStats.scaleNs / 1000000.0) / argmaxStats.masks):(0.0), argmaxStats.maxNs / 1000000.0);
+		SegArgmaxClose(&argmax);
+	}
 	
 	// clean up
 	SAFE_DELETE(camera);
@@ -7,12 +7,15 @@
  *          Refer to https://www.kernel.org/doc/Documentation/networking/can.txt for additional
  *          information in regards to socket CAN. This module intiializes the CAN controller and
  *          performs all communication too and from any devices that are attached to the CAN bus.
+ *          On a Linux host the CAN backend chosen in Parameters.txt (Hal.h) puts the frames on a
+ *          virtual CAN interface instead, or drops them.
 **/
 
 #define DEBUG /**< Definition compiles the CAN node in debug mode. */
 
 #include "../include/CanController.h"
 #include "../include/Messages.h"
+#include "../include/Hal.h"
 
 #include <stdio.h>
 
@@ -28,6 +31,7 @@ int main(int argc, char ** argv)
 	int masterWrite;
 	int nbytes;
 	int readFds[2];
+	int readCount;
 	int i; // for test
 	int killMessageReceived;
 
@@ -45,15 +49,25 @@ int main(int argc, char ** argv)
 	masterRead = atoi(argv[1]);
 	masterWrite = atoi(argv[2]);
 
+	// real or virtual CAN, as master's parameters say
+	HalInit(NULL);
+	HalPrintConfig("can");
+
 	// initialize CAN, capture fd so we can use it for
 	// SetAndWait
-	canSocket = InitializeCan();
+	canSocket = InitializeCan(HalGetConfig()->can);
+
+	if (canSocket < 0) {
+		printf("CAN INITIALIZATION FAILURE\n");
+	}
 
-	readFds[0] = canSocket;
-	readFds[1] = masterRead;
+	// without a socket only master is waited on
+	readFds[0] = masterRead;
+	readFds[1] = canSocket;
+	readCount = (canSocket > 0)?(2):(1);
 
 	// initialize SetAndWait
-	SetupSetAndWait(readFds, 2);
+	SetupSetAndWait(readFds, readCount);
 
 	killMessageReceived = 0;
 
@@ -64,7 +78,7 @@ int main(int argc, char ** argv)
 		}
 
 		// check fds
-		for (i = 0; i < 2; i++) {
+		for (i = 0; i < readCount; i++) {
 			if (!FD_ISSET(readFds[i], &rdfs)) {
 				continue;
 			}
@@ -79,11 +93,14 @@ int main(int argc, char ** argv)
 				// this functionality exists and works correctly, there
 				// just isn't anything to read from at the moment.
 			} else if (readFds[i] == masterRead) {
-				read(masterRead, &message, sizeof(message));
+				ReceiveMessage(masterRead, &message);
 				
 				// kill message
 				if (message.messageType == KillMessage) {
 					killMessageReceived = 1;
+					if (CanNone == HalGetConfig()->can || CanSim == HalGetConfig()->can) {
+						printf("%lu CAN frames dropped\n", CanDropped());
+					}
 					CloseCan();
 					close(masterRead);
 					close(masterWrite);
@@ -9,16 +9,33 @@
  *  	    are used to allow tx2_comm_node.c and conroller.c/logWriter.c to communicate with 
  *  	    one another. No other external libraries are used; only preexisting functionality
  *  	    within Linux. 
+ *  	    <br>
+ *  	    <br>
+ *  	    Clock offset pings (see TimeSync.h) are answered here rather than passed on, so they
+ *  	    take as little time on the rover as they can, and the estimate each carries is
+ *  	    recorded to the "sync" telemetry stream (see Telemetry.h).
 **/
 
 #include <stdio.h>
 #include "../include/Messages.h"
 #include "../include/CommController.h"
+#include "../include/Clock.h"
+#include "../include/TimeSync.h"
+#include "../include/Telemetry.h"
+#include "../include/Hal.h"
 #include <unistd.h>
 #include <signal.h>
 
-#define NOTHING_FROM_CLIENT_TIMEOUT 300 
-#define NOTHING_FROM_CLIENT_AFTER_SOCKET_CHECK_TIMEOUT 60
+#define NOTHING_FROM_CLIENT_TIMEOUT (300 * CLOCK_SECOND) /**< Quiet time before the socket is checked, ns. */
+#define NOTHING_FROM_CLIENT_AFTER_SOCKET_CHECK_TIMEOUT (60 * CLOCK_SECOND) /**< Quiet time after a check before
+										   the client is given up on, ns. */
+
+/**
+ * @brief Macro for the #ClockNowNs() time the client has been quiet for too long at.
+**/
+#define CLIENT_DEADLINE(lastHeard, socketCheckSent) ((lastHeard) + ((socketCheckSent)?\
+							(NOTHING_FROM_CLIENT_AFTER_SOCKET_CHECK_TIMEOUT):\
+							(NOTHING_FROM_CLIENT_TIMEOUT)))
 
 #define DEBUG /**< This compiles the program for debug mode. There are certain macros and print
 		   statements that are included when DEBUG is defined. Comment out for non-debug
@@ -28,6 +45,16 @@
 #define PORT 5000 /**< Port number used for communication */
 #define ADD_POR_REUSE (SO_REUSEADDR | SO_REUSEPORT)
 
+/**
+ * @brief Columns of the "sync" telemetry stream, the controller's estimate with each ping.
+**/
+TelemetryColumn syncColumns[] = {
+	{ "offset", TelemetryInt },	// rover minus controller clock, ns
+	{ "error", TelemetryInt },	// bound on it, ns
+	{ "drift", TelemetryFloat },	// ppm
+	{ "up", TelemetryInt }		// controller to rover latency of the ping, ns
+};
+
 #ifdef DEBUG
 #define WASD_PRESS(c) (c == 'w' || c == 'W' ||\
 		       c == 'a' || c == 'A' ||\
@@ -52,7 +79,12 @@ int main(int argc, char ** argv)
 	int i;
 	int killMessageReceived;
 	unsigned int socketCheckSent;
-	unsigned int wakeCount;
+	long long lastHeard;
+	long long received;
+	double values[4];
+	int syncStream;
+
+	TelemetryWriter telemetry;
 
 	Message commInMessage;
 	Message commOutMessage;
@@ -67,6 +99,10 @@ int main(int argc, char ** argv)
 	masterRead = atoi(argv[1]);
 	masterWrite = atoi(argv[2]);
 
+	// the clock of the other nodes, the pings are stamped and the client timed on it
+	HalInit(NULL);
+	HalPrintConfig("comm");
+
 	// initialize TCP socket, store as oldTcpSocket
 	// this is used in the scenario that the clinet disconnects
 	// and a new socket is needed.
@@ -81,13 +117,17 @@ int main(int argc, char ** argv)
 
 	socketCheckSent = 0;
 
+	// record telemetry if there is somewhere to put it
+	TelemetryOpen(&telemetry, "tx2_comm_node", ClockNowNs());
+	syncStream = TelemetryAddStream(&telemetry, "sync", syncColumns, sizeof(syncColumns) / sizeof(TelemetryColumn));
+
 	killMessageReceived = 0;
-	wakeCount = 0;
+	lastHeard = ClockNowNs();
 
 	//  main while loop
 	while(!killMessageReceived) {
-		// wait until fd is available or timeout has occured
-		if (SetAndWait(&rdfs, 1, 0) < 0 ) {
+		// wait until fd is available or the client has been quiet for too long
+		if (SetAndWaitUntil(&rdfs, CLIENT_DEADLINE(lastHeard, socketCheckSent)) < 0 ) {
 			printf("SET AND WAIT ERROR COMM\n");
 		}		
 
@@ -99,11 +139,12 @@ int main(int argc, char ** argv)
 
 			// new message from controller
 			if (readFds[i] == tcpSocket) {
-				// reset wake count, we know we are connected to the client
-				wakeCount = 0;
+				// we know we are connected to the client
+				lastHeard = ClockNowNs();
 
 				// read the incoming message
 				CommRead(&commInMessage);
+				received = ClockNowNs();
 
 				//  the only time this should happen if the client sent a 
 				//  request to the TX2 with the TX2 sending a socket check at 
@@ -112,6 +153,18 @@ int main(int argc, char ** argv)
 				if (commInMessage.messageType == OKMessage) {
 					socketCheckSent = 0;
 					printf("OK received, reseting alarm value\n");
+				} else if (commInMessage.messageType == TimeMessage) {
+					// straight back, the time it takes here counts against the estimate
+					TimeSyncAnswer(&commInMessage, received, ClockNowNs());
+					CommWrite(&commInMessage);
+
+					if (commInMessage.timeMsg.error > 0) {
+						values[0] = commInMessage.timeMsg.offset;
+						values[1] = commInMessage.timeMsg.error;
+						values[2] = commInMessage.timeMsg.drift;
+						values[3] = received - commInMessage.timeMsg.originate - commInMessage.timeMsg.offset;
+						TelemetryRecord(&telemetry, syncStream, received, values);
+					}
 				} else if (commInMessage.messageType == ClientDisconnect) {
 					// clinet has disconnected purposefully
 					printf("client requsting disconnect\n");
@@ -125,11 +178,11 @@ int main(int argc, char ** argv)
 					// another TX2 node. Send it of to master so it can figure out
 					// what to do with it.
 					commInMessage.source = TX2Comm;
-					write(masterWrite, &commInMessage, sizeof(commInMessage));
+					SendMessage(masterWrite, &commInMessage);
 				}
 			} else if (readFds[i] == masterRead) {
 				// the message is coming from master, not the controller
-				read(masterRead, &commOutMessage, sizeof(commOutMessage));
+				ReceiveMessage(masterRead, &commOutMessage);
 
 				// tx2_cam_node.cpp has a new picture for us to send over to the client
 				if (commOutMessage.messageType == CamMessage) {
@@ -151,32 +204,30 @@ int main(int argc, char ** argv)
 			}
 		}
 
-		// since the SetAndWait function at the top is set to wakeup every second if no message is available, using
-		// this counter as a way to figure out how many times we have woke up without messages from the client/controller.
-		wakeCount++;
-
 		// at this point, client has likely disconnected, the socket check has been set and we havent
 		// received anything from the controller. We should assume the client has disconnected and listen
 		// for a new incoming request to re-establish communication.
-		if (wakeCount == NOTHING_FROM_CLIENT_AFTER_SOCKET_CHECK_TIMEOUT && socketCheckSent == 1) {
+		if (ClockNowNs() >= CLIENT_DEADLINE(lastHeard, socketCheckSent) && socketCheckSent == 1) {
 			printf("client disconnected\n");
 			// get new socket
 			tcpSocket = EstablishSocket();
 			// modify SetAndWait array
 			ModifySetAndWait(oldTcpSocket, tcpSocket);
 			oldTcpSocket = tcpSocket;
-			wakeCount = 0;
+			lastHeard = ClockNowNs();
 			socketCheckSent = 0;
-		} else if (wakeCount == NOTHING_FROM_CLIENT_TIMEOUT) {
+		} else if (ClockNowNs() >= CLIENT_DEADLINE(lastHeard, socketCheckSent)) {
 			// we havent heard from client in a while, send a socket check
 			printf("checking socket\n");
 			SocketCheck();
-			// reset so we can start counting from 9
-			wakeCount = 0;
+			// start counting the time the client has to answer in
+			lastHeard = ClockNowNs();
 			socketCheckSent = 1;
 		}
 	}
 
+	TelemetryClose(&telemetry);
+
 	printf("killing comm node\n");
 	return 0;
 }
@@ -1,5 +1,3 @@
-#define WITH_AVERAGING
-
 /**
  * @file tx2_gps_node.c
  * @author Patrick Henz
@@ -10,6 +8,28 @@
  *          this node (use example at line 165) to wake it up and write a new position to 
  *          shared memory. Shared memory macros #GET_SHARED_POSITION and #SET_SHARED_POSITION
  *          are used to set these locations in memory accordingly.
+ *          <br>
+ *          <br>
+ *          Reads are scheduled on the clock (Clock.h) rather than polled. The XA1110 emits a burst of
+ *          sentences once per fix (1-10 Hz), so the node learns that output period from the
+ *          bursts it sees and times its wait to end just after the next burst is expected.
+ *          Until the period is learned, or after it is lost, the node falls back to polling
+ *          every #GPS_SEARCH_PERIOD_MS.
+ *          <br>
+ *          <br>
+ *          Fixes are passed through the GpsEstimator library, which weights them by quality,
+ *          rejects outliers and publishes a #PositionEstimate (position and accuracy) to shared
+ *          memory with every accepted fix.
+ *          <br>
+ *          <br>
+ *          The last fix is kept on disk and given back to the XA1110 at the next start, with the
+ *          time and the EPO data of a local file, so it hot starts (GnssAssist.h). The time to
+ *          the first fix is printed on every start.
+ *          <br>
+ *          <br>
+ *          If #RTCM_SOURCE_ENV names a source of RTCM corrections the XA1110 is put in RTCM
+ *          differential mode and the corrections are written to it between reads (Rtcm.h). The
+ *          fix type and correction age are published with the estimate.
  */
 
 // these macros are for command packets for the GNSS module. The majority are not in use.
@@ -38,83 +58,339 @@
 #define SEARCH_GPS_GLONASS "$PMTK353,1,1,0,0,0*"
 
                  //         0 1 2 3 4 5 6 7 8 9 A B C D E F G 0 1 2
-#define MIN_PRINT "$PMTK314,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*"
+#define MIN_PRINT "$PMTK314,1,0,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*" // GLL, VTG, GGA
+
+/**
+ * @brief Uncomment to record the raw NMEA output to #NMEA_RECORD_FILE, for use with gpsReplay.c.
+**/
+//#define RECORD_NMEA
+#define NMEA_RECORD_FILE "../gps_record.nmea"
 
 /**
  * @brief Converts from miliseconds to nanoseconds.
 **/
-#define MS_TO_NS(x) ((x) * 1000000) // convert ms to ns
+#define MS_TO_NS(x) ((x) * 1000000LL) // convert ms to ns
 		 
 #include <stdio.h>
 #include "../include/Messages.h"
 #include "../include/I2CGPS.h"
+#include "../include/GpsEstimator.h"
+#include "../include/GnssAssist.h"
+#include "../include/Rtcm.h"
 #include "../include/SharedMem.h"
+#include "../include/Hal.h"
+#include "../include/Profile.h"
 #include <unistd.h>
 #include <signal.h>
 #include <stdint.h>
+#include <time.h>
 
 
-#define GPS_AVERAGE_COUNT 5 
+/**
+ * @brief Converts from nanoseconds to miliseconds.
+**/
+#define NS_TO_MS(x) ((x) / 1000000)
+
+#define GPS_SEARCH_PERIOD_MS 50		/**< Poll period while the output cadence is unknown. */
+#define GPS_BURST_GUARD_MS 20		/**< How long after an expected burst the read is scheduled. */
+#define GPS_RETRY_MS 10			/**< Re-read interval when a burst is late. */
+#define GPS_MAX_RETRIES 8		/**< Late reads allowed before the cadence is considered lost. */
+#define GPS_MIN_PERIOD_MS 90		/**< Fastest output period accepted (10 Hz plus margin). */
+#define GPS_MAX_PERIOD_MS 1100		/**< Slowest output period accepted (1 Hz plus margin). */
+#define GPS_LOCK_COUNT 3		/**< Consistent intervals needed to lock onto a period. */
+#define GPS_REPORT_COUNT 100		/**< Fixes between latency/bus reports in debug mode. */
+#define GPS_FIX_TYPES 9			/**< GGA fix qualities, 0 none, 1 GPS, 2 differential, ... */
 
 #define DEBUG /**< This compiles the program for debug mode. There are certain macros and print
 		   statements that are included when DEBUG is defined. Comment out for non-debug
 		   commpilation. */
 
 /**
- * @brief Internal struct used to keep track of a moving #Position average.
+ * @brief Internal struct used to learn the XA1110 output cadence.
+ * @details Burst times are monotonic nanoseconds. While unlocked, candidatePeriod holds the last
+ *	    interval seen and consistentCount how many intervals in a row agreed with it.
+**/
+typedef struct _Cadence {
+	long long lastBurst;		// estimated time of the last burst
+	long long period;		// learned output period, valid when locked
+	long long candidatePeriod;	// interval being tested while unlocked
+	int consistentCount;
+	int locked;
+	int retries;			// late reads since the burst was expected
+	int outliers;			// consecutive intervals that did not fit the period
+} Cadence;
+
+/**
+ * @brief Internal struct used to measure fix-to-publication latency, bus use and the fix types.
+**/
+typedef struct _GpsLatency {
+	unsigned long fixes;
+	long long sum;			// sum of fix-to-publication latency, ms
+	long long min;
+	long long max;
+	long long readToPublish;	// sum of burst read to publication time, ns
+	unsigned long fixesSinceReport;
+	unsigned long fixTypes[GPS_FIX_TYPES];	// fixes read, by GGA quality
+	unsigned long corrected;	// fixes read with a correction age
+	double correctionAgeSum;	// seconds
+	float correctionAgeMax;
+} GpsLatency;
+
+/**
+ * @brief Returns the current time of the specified clock in nanoseconds.
+**/
+long long NowNs(clockid_t clock)
+{
+	struct timespec now;
+	clock_gettime(clock, &now);
+	return ((long long)now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
+
+/**
+ * @brief Feeds an observed burst into the #Cadence estimate.
+ * @details An interval that is close to a whole multiple of the learned period is treated as
+ *	    missed bursts and divided down, anything else counts as an outlier. Once locked, the
+ *	    period follows the observed intervals with a 1/8 gain. Three outliers in a row (the
+ *	    update rate was changed, or the module restarted) drop the lock.
+ * @param cadence The #Cadence being updated.
+ * @param burst Estimated monotonic time of the burst in nanoseconds.
+**/
+void UpdateCadence(Cadence * cadence, long long burst)
+{
+	long long interval = burst - cadence->lastBurst;
+	long long multiple;
+	long long error;
+
+	cadence->retries = 0;
+
+	if (0 == cadence->lastBurst || 
+	    interval < MS_TO_NS(GPS_MIN_PERIOD_MS) ||
+	    interval > MS_TO_NS(GPS_MAX_PERIOD_MS) * 4) {
+		// first burst, or one we can't make sense of
+		cadence->lastBurst = burst;
+		return;
+	}
+
+	cadence->lastBurst = burst;
+
+	if (cadence->locked) {
+		// account for bursts we did not see
+		multiple = (interval + (cadence->period / 2)) / cadence->period;
+		if (multiple < 1) {
+			multiple = 1;
+		}
+		error = (interval / multiple) - cadence->period;
+
+		if (error < cadence->period / 4 && error > -(cadence->period / 4)) {
+			cadence->period += error / 8;
+			cadence->outliers = 0;
+		} else if (++cadence->outliers >= 3) {
+			printf("GPS cadence lost\n");
+			cadence->locked = 0;
+			cadence->candidatePeriod = interval;
+			cadence->consistentCount = 0;
+		}
+		return;
+	}
+
+	if (interval > MS_TO_NS(GPS_MAX_PERIOD_MS)) {
+		cadence->consistentCount = 0;
+		return;
+	}
+
+	// unlocked, look for a run of agreeing intervals
+	error = interval - cadence->candidatePeriod;
+	if (error < cadence->candidatePeriod / 4 && error > -(cadence->candidatePeriod / 4)) {
+		cadence->candidatePeriod += error / 2;
+		if (++cadence->consistentCount >= GPS_LOCK_COUNT) {
+			cadence->locked = 1;
+			cadence->period = cadence->candidatePeriod;
+			cadence->outliers = 0;
+			printf("GPS cadence locked, period %lld ms\n", NS_TO_MS(cadence->period));
+		}
+	} else {
+		cadence->candidatePeriod = interval;
+		cadence->consistentCount = 0;
+	}
+}
+
+/**
+ * @brief Determines when the next read should happen.
+ * @param cadence The #Cadence estimate.
+ * @param now Current monotonic time in nanoseconds.
+ * @param lastReadEmpty Set if the read that just happened found the module's buffer empty.
+ * @return Absolute monotonic time of the next read in nanoseconds.
+**/
+long long NextReadTime(Cadence * cadence, long long now, int lastReadEmpty)
+{
+	long long next;
+
+	if (!cadence->locked) {
+		return now + MS_TO_NS(GPS_SEARCH_PERIOD_MS);
+	}
+
+	if (lastReadEmpty && now > cadence->lastBurst + cadence->period) {
+		// the burst is late, look again shortly
+		if (++cadence->retries > GPS_MAX_RETRIES) {
+			printf("GPS bursts stopped, searching\n");
+			cadence->locked = 0;
+			cadence->consistentCount = 0;
+			cadence->retries = 0;
+			return now + MS_TO_NS(GPS_SEARCH_PERIOD_MS);
+		}
+		return now + MS_TO_NS(GPS_RETRY_MS);
+	}
+
+	// just after the next expected burst
+	next = cadence->lastBurst + cadence->period + MS_TO_NS(GPS_BURST_GUARD_MS);
+	while (next <= now) {
+		next += cadence->period;
+	}
+
+	return next;
+}
+
+/**
+ * @brief Records the latency between a fix and its publication to shared memory.
+ * @details The fix time reported by the XA1110 is UTC, so the fix-to-publication latency is
+ *	    only meaningful when the system clock is synchronized; values outside of 0-5 s are
+ *	    ignored. The time between reading the burst and publishing is always recorded.
+ * @param latency The #GpsLatency accumulator.
+ * @param fixTime UTC fix time in milliseconds since midnight.
+ * @param readTime Monotonic time the burst was read, in nanoseconds.
 **/
-typedef struct _Positions {
-	Position position[GPS_AVERAGE_COUNT];
-	int head;
-	int positionCount;
-} Positions;
+void RecordLatency(GpsLatency * latency, unsigned int fixTime, long long readTime)
+{
+	long long nowMs = NS_TO_MS(NowNs(CLOCK_REALTIME)) % 86400000LL;
+	long long delta = nowMs - fixTime;
+
+	// fix just before midnight, published after
+	if (delta < -43200000LL) {
+		delta += 86400000LL;
+	}
+
+	latency->readToPublish += ClockNowNs() - readTime;
+	latency->fixesSinceReport++;
+
+	if (0 == fixTime || delta < 0 || delta > 5000) {
+		return;
+	}
+
+	if (0 == latency->fixes || delta < latency->min) {
+		latency->min = delta;
+	}
+	if (0 == latency->fixes || delta > latency->max) {
+		latency->max = delta;
+	}
+	latency->sum += delta;
+	latency->fixes++;
+}
 
 /**
- * @brief Function adds a new position to the #Positions struct.
- * @details Function adds a new position to the #Positions struct. The #Position array  witin
- * 	    #Positions is used as a ring buffer, each new #Position overwrites the oldest value
- * 	    in the array.
- * @param positions A pointer to the #Positions struct being modified.
- * @param p1 The new #Position being added to the array in #Positions.
+ * @brief Counts the type and correction age of a fix read.
+ * @param fix The fix, NULL for a burst without one.
 **/
-void AddPosition(Positions * positions, Position * p1)
+void RecordFixType(GpsLatency * latency, GpsMsg * fix)
 {
-	// add position at current location of head
-	positions->position[positions->head].latitude = p1->latitude;
-	positions->position[positions->head].longitude = p1->longitude;
+	if (NULL == fix) {
+		latency->fixTypes[0]++;
+		return;
+	}
+
+	// GLL only output has no quality, it is a GPS fix
+	latency->fixTypes[(fix->fixQuality > 0 && fix->fixQuality < GPS_FIX_TYPES)?(fix->fixQuality):(1)]++;
 
-	// increment head, ring buffer fashion
-	positions->head = (positions->head + 1) % GPS_AVERAGE_COUNT;
+	if (fix->correctionAge >= 0.0f) {
+		latency->corrected++;
+		latency->correctionAgeSum += fix->correctionAge;
+		latency->correctionAgeMax = (fix->correctionAge > latency->correctionAgeMax)?(fix->correctionAge):(latency->correctionAgeMax);
+	}
+}
+
+/**
+ * @brief Writes the RTCM frames waiting to the XA1110, in the slot after a read.
+ * @details At most #RTCM_SLOT_BYTES are written, and nothing once the next read is less than
+ *	    #GPS_RETRY_MS away, so the bursts are read when they would be without corrections.
+ * @param nextRead #ClockNowNs() time of the next read.
+ * @return #ClockNowNs() time of the next slot, #CLOCK_NEVER if it can wait for the next read.
+**/
+long long WriteCorrections(RtcmStream * rtcm, long long nextRead)
+{
+	long long now = ClockNowNs();
+	long long last = nextRead - MS_TO_NS(GPS_RETRY_MS);
+	int budget = RTCM_SLOT_BYTES;
+	uint8_t * data;
+	int bytes;
+
+	while (budget > 0 && now < last && (bytes = RtcmNextChunk(rtcm, now, &data, budget)) > 0) {
+		bytes = I2CGPSWriteRaw(data, bytes);
+		RtcmWritten(rtcm, bytes, now);
+		budget -= (bytes > 0)?(bytes):(budget);
+		now = ClockNowNs();
+	}
 
-	// only increment count until we have all locations filled
-	if (positions->positionCount < GPS_AVERAGE_COUNT) {
-		positions->positionCount++;
+	// more waiting, another slot if it fits before the read
+	if (RtcmNextChunk(rtcm, now, &data, 1) > 0 && now + RTCM_SLOT_NS < last) {
+		return now + RTCM_SLOT_NS;
 	}
+
+	return CLOCK_NEVER;
+}
+
+/**
+ * @brief Waits on master's pipe and the RTCM source, if it is connected.
+**/
+void SetupReadFds(int * readFds, int masterRead, int rtcmFd)
+{
+	readFds[0] = masterRead;
+	readFds[1] = rtcmFd;
+	SetupSetAndWait(readFds, (rtcmFd >= 0)?(2):(1));
 }
 
 /**
- * @brief Function calculates the moving average for the positions in #Positions struct.
- * @details Function calculates the moving average for the positions in #Positions struct.
- * 	    It should be noted that this function assumes that the positions array is full
- * 	    of current values. If there arent #GPS_AVERAGE_COUNT values in the array, the 
- * 	    behavior of this function is unpredictable.
+ * @brief Prints latency, bus, fix type and RTCM statistics, then resets the latency accumulator.
+ * @param rtcm The corrections, NULL if there is no source.
 **/
-void GetPositionAverage(Positions * positions, Position * average)
+void ReportLatency(GpsLatency * latency, Cadence * cadence, RtcmStream * rtcm)
 {
+	I2CGPSStats stats;
+	RtcmStats rtcmStats;
+	unsigned long other = 0;
 	int i;
 
-	// zero out average
-	memset(average, 0, sizeof(Position));
+	I2CGPSGetStats(&stats);
+
+	printf("GPS period %lld ms (%s), read-to-publish avg %.3f ms\n",
+		NS_TO_MS(cadence->period), (cadence->locked)?("locked"):("searching"),
+		(latency->readToPublish / 1000000.0) / latency->fixesSinceReport);
+
+	if (latency->fixes) {
+		printf("GPS fix-to-publish avg %lld ms min %lld ms max %lld ms over %lu fixes\n",
+			latency->sum / latency->fixes, latency->min, latency->max, latency->fixes);
+	}
+
+	printf("GPS bus: %lu reads, %lu bytes, %lu padding, %lu errors, %lu retries, %lu sentences\n",
+		stats.transactions, stats.bytesRead, stats.paddingBytes,
+		stats.readErrors, stats.bus.retries, stats.sentences);
+
+	for (i = 3; i < GPS_FIX_TYPES; i++) {
+		other += latency->fixTypes[i];
+	}
 
-	// accumulate
-	for (i = 0; i < GPS_AVERAGE_COUNT; i++) {
-		average->latitude += positions->position[i].latitude;
-		average->longitude += positions->position[i].longitude;
+	printf("GPS bursts: %lu without a fix, %lu gps, %lu differential, %lu other, correction age avg %.1f s max %.1f s\n",
+		latency->fixTypes[0], latency->fixTypes[1], latency->fixTypes[2], other,
+		(latency->corrected)?(latency->correctionAgeSum / latency->corrected):(0.0), latency->correctionAgeMax);
+
+	if (NULL != rtcm) {
+		RtcmGetStats(rtcm, &rtcmStats);
+		printf("GPS RTCM: %lu frames, %lu bytes, %lu CRC errors, %lu dropped, %lu written, %lu write errors, "
+		       "newest type %d %.1f s ago\n",
+			rtcmStats.frames, rtcmStats.bytes, rtcmStats.crcErrors, rtcmStats.dropped, rtcmStats.written,
+			stats.writeErrors, rtcmStats.lastType,
+			(rtcmStats.lastFrame)?((ClockNowNs() - rtcmStats.lastFrame) / 1000000000.0):(-1.0));
 	}
 
-	// calculate average
-	average->latitude /= GPS_AVERAGE_COUNT;
-	average->longitude /= GPS_AVERAGE_COUNT;
+	memset(latency, 0, sizeof(GpsLatency));
 }
 
 int main(int argc, char ** argv)
@@ -128,19 +404,38 @@ int main(int argc, char ** argv)
 	int masterRead;
 	int masterWrite;
 	int readFds[2];
-	int i;
-	int I2CGPSFd;
+	int readStatus;
+	long long nextRead;
+	long long readTime;
 	int killMessageReceived;
 	Position previousPosition = { .latitude = 0.0f, .longitude = 0.0f};
-	Position positionAverage;
+	PositionEstimate positionEstimate;
 	int positionsTaken;
 	int navigationCalibrationComplete;
 	SharedMem * sharedPosition;
 	int newAverage;
+	long long startTime;
+	long long firstFixTime;
+	long long lastSave;
+	char assistNames[32];
+	char * rtcmSource;
+	int rtcmOpen;
+	int rtcmFd;
+	long long nextWrite;
+	long long wake;
 
 	Message message;
 
-	Positions positions = { .head = 0, .positionCount = 0 };
+	GpsEstimator estimator;
+	Cadence cadence;
+	GpsLatency latency;
+	GnssAssistState assistState;
+	GnssAssistReport assistReport;
+	RtcmStream rtcm;
+
+	InitEstimator(&estimator);
+	memset(&cadence, 0, sizeof(cadence));
+	memset(&latency, 0, sizeof(latency));
 
 	// make sure master has given use correct number of pipes
 	if (argc != 3) {
@@ -151,23 +446,37 @@ int main(int argc, char ** argv)
 	masterRead = atoi(argv[1]);
 	masterWrite = atoi(argv[2]);
 
-	// open i2c fd for XA1110
-	I2CGPSFd = I2CGPSOpen();
+	// real or mock XA1110, and the clock, as master's parameters say
+	HalInit(NULL);
+	HalPrintConfig("gps");
+	ProfileInit("tx2_gps_node");
+
+	// the time to first fix is from here, where the node is started at boot
+	startTime = ClockNowNs();
+	firstFixTime = 0;
+	lastSave = 0;
 
-	if (0 >= I2CGPSFd) {
+	// open the XA1110
+	if (I2CGPSOpen() < 0) {
 		printf("I2C FAILURE\n");
 	}
 
-	readFds[0] = masterRead;
-	readFds[1] = I2CGPSFd;
+	// corrections, if there is a source
+	rtcmSource = getenv(RTCM_SOURCE_ENV);
+	rtcmOpen = (NULL != rtcmSource && 0 == RtcmOpen(&rtcm, rtcmSource, ClockNowNs()));
+	rtcmFd = (rtcmOpen)?(RtcmFd(&rtcm)):(-1);
+	nextWrite = CLOCK_NEVER;
+	if (rtcmOpen) {
+		printf("GPS RTCM corrections from %s\n", rtcmSource);
+	}
 
-	// setup SetAndWait
-	SetupSetAndWait(readFds,2);
+	// reads are timed by the wait, the I2C fd itself is always "readable"
+	SetupReadFds(readFds, masterRead, rtcmFd);
 
 	killMessageReceived = 0;
 
 	// create shared memory location to share with  tx2_nav_node.c
-	sharedPosition = CreateSharedMemory(sizeof(Position), PositionData);
+	sharedPosition = CreateSharedMemory(sizeof(PositionEstimate), PositionData);
 
 	if (sharedPosition == NULL) {
 		printf("error creating shared memory for position\n");
@@ -179,10 +488,10 @@ int main(int argc, char ** argv)
 	message.source = TX2Gps;
 	message.destination = TX2Nav;
 
-	sleep(5);
+	ClockSleep(5 * CLOCK_SECOND);
 
 	// notify nav node that shared memory is available
-	write(masterWrite, &message, sizeof(message));
+	SendMessage(masterWrite, &message);
 
 	// clear data valid flag
 	sharedPosition->dataAvailableFlag = 0;
@@ -213,69 +522,148 @@ int main(int argc, char ** argv)
         I2CGPSWrite(MIN_PRINT);		 // print only positional information
 	I2CGPSWrite(MIN_SAT);	         // min satellite count
 	I2CGPSWrite(GNSS_SBAS_EN);	 // enable sbas
-	I2CGPSWrite(DGPS_SBAS);		 // set to use sbas
+	I2CGPSWrite((rtcmOpen)?(RTCM_MODE):(DGPS_SBAS)); // set to use rtcm corrections, or sbas
 	I2CGPSWrite(AIC_MODE);		 // active interference correction
 	I2CGPSWrite(FITNESS_MODE);	 // fitness mode, supposed to work better at slow speeds
+
+	// where and when the last fix was, and the satellites' orbits, for a hot start
+	GnssAssistLoad(&assistState, GNSS_ASSIST_STATE_FILE);
+	GnssAssistInject(&assistState, GNSS_ASSIST_EPO_FILE, GnssAssistUtcNs(), &assistReport);
+	GnssAssistFlagNames(assistReport.flags, assistNames, sizeof(assistNames));
+	if (assistReport.flags) {
+		printf("GPS assisted with %s, state %lld s old, %d EPO satellites\n",
+			assistNames, assistReport.age, assistReport.epoSatellites);
+	} else {
+		printf("GPS not assisted, %s\n", assistReport.reason);
+	}
 	
 	printf("GPS unit initialized\n");
 
+#ifdef RECORD_NMEA
+	I2CGPSRecord(open(NMEA_RECORD_FILE, O_WRONLY | O_CREAT | O_APPEND, 0644));
+#endif
+
 	navigationCalibrationComplete = 0;
 
+	// first read right away, cadence is learned from there
+	nextRead = ClockNowNs() + MS_TO_NS(GPS_SEARCH_PERIOD_MS);
+
 	//  main while loop
 	while(!killMessageReceived) {
-		// wait for fds to become available, or timeout to get GNSS data
-		if (SetAndWait(&rdfs, 0, MS_TO_NS(50)) < 0) {
+		// wait for a message from master, corrections or the next read
+		wake = nextRead;
+		if (rtcmOpen) {
+			wake = (RtcmNextDue(&rtcm) < wake)?(RtcmNextDue(&rtcm)):(wake);
+			wake = (nextWrite < wake)?(nextWrite):(wake);
+		}
+		if (SetAndWaitUntil(&rdfs, wake) < 0) {
 			printf("SET AND WAIT ERROR GPS\n");
 		}
 
-		// check fds
-		for (i = 0; i < 2; i++) {
-			if (!FD_ISSET(readFds[i], &rdfs)) {
-				continue;
+		newAverage = 0;
+
+		if (FD_ISSET(masterRead, &rdfs)) {
+			// read the message from master
+			ReceiveMessage(masterRead, &message);
+
+			// kill message
+			if (message.messageType == KillMessage) {
+				killMessageReceived = 1;
+				GnssAssistSave(&assistState, GNSS_ASSIST_STATE_FILE);
+				if (rtcmOpen) {
+					RtcmClose(&rtcm);
+				}
+				I2CGPSClose();
+				close(masterRead);
+				close(masterWrite);
+				break;
+			} else if (CalibrationCompleteMessage == message.messageType && TX2Nav == message.source) {
+				// wait for nav node to finish calibration before sending messages
+				printf("GPS Received complete from Nav\n\n");
+				navigationCalibrationComplete = 1;
 			}
+		}
 
-			// I don't know that this would every happen... I'm guessing the device
-			// needs to be polled to retrieve data...
-			if (readFds[i] == I2CGPSFd) {
-				I2CGPSRead(&message);
-			} else if (readFds[i] == masterRead) {
-				// read the message from master
-				read(readFds[i], &message, sizeof(message));
-
-				// kill message
-				if (message.messageType == KillMessage) {
-					killMessageReceived = 1;
-					CloseI2C();
-					close(masterRead);
-					close(masterWrite);
-					break;
-				} else if (CalibrationCompleteMessage == message.messageType && TX2Nav == message.source) {
-					// wait for nav node to finish calibration before sending messages
-					printf("GPS Received complete from Nav\n\n");
-					navigationCalibrationComplete = 1;
-				} 
-				
+		// frames from the source, or a reconnect or an epoch of a file that is due
+		if (rtcmOpen && ((rtcmFd >= 0 && FD_ISSET(rtcmFd, &rdfs)) || ClockNowNs() >= RtcmNextDue(&rtcm))) {
+			if (RtcmService(&rtcm, ClockNowNs()) > 0 && CLOCK_NEVER == nextWrite) {
+				nextWrite = ClockNowNs();
+			}
+			if (RtcmFd(&rtcm) != rtcmFd) {
+				rtcmFd = RtcmFd(&rtcm);
+				SetupReadFds(readFds, masterRead, rtcmFd);
 			}
 		}
 
-		newAverage = 0;
+		if (ClockNowNs() >= nextRead) {
+			// drain whatever the XA1110 has buffered. If new position data has
+			// been acquired, feed it to the estimator
+			readTime = ClockNowNs();
+			readStatus = I2CGPSRead(&message);
+
+			if (GPS_READ_EMPTY != readStatus) {
+				// data is read at most a guard time after it was written,
+				// unless we are searching or retrying
+				UpdateCadence(&cadence, (cadence.locked && 0 == cadence.retries)?
+							(readTime - MS_TO_NS(GPS_BURST_GUARD_MS)):
+							(readTime));
+			}
+
+			if (GPS_READ_FIX == readStatus && 0 == firstFixTime) {
+				firstFixTime = ClockNowNs();
+				printf("GPS first fix %.1f s after start, assisted with %s\n",
+					(firstFixTime - startTime) / 1000000000.0, assistNames);
+				GnssAssistRecordTtff(GNSS_ASSIST_TTFF_FILE, GnssAssistUtcNs(),
+						     firstFixTime - startTime, assistReport.flags);
+			}
+
+			if (GPS_READ_FIX == readStatus) {
+				RecordFixType(&latency, &message.gpsMsg);
+				newAverage = UpdateEstimator(&estimator, &message.gpsMsg, &positionEstimate);
+			} else if (GPS_READ_NO_FIX == readStatus) {
+				RecordFixType(&latency, NULL);
+			}
+
+			nextRead = NextReadTime(&cadence, ClockNowNs(), GPS_READ_EMPTY == readStatus);
+
+			// the burst is read, the bus is free until the next one
+			nextWrite = ClockNowNs();
+		}
 
-		// ping XA1110. If data new position data has been acquired, add it
-		// to the Positions struct
-		if (I2CGPSRead(&message)) {
-			AddPosition(&positions, &message.gpsMsg.position);
-			newAverage = 1;
+		if (rtcmOpen && ClockNowNs() >= nextWrite) {
+			nextWrite = WriteCorrections(&rtcm, nextRead);
 		}
 
-		// if we have enough GNSS positions and a new value has been acquired
-		if (positions.positionCount == GPS_AVERAGE_COUNT && newAverage) {
-			// calculate the averge
-			GetPositionAverage(&positions, &positionAverage);
+		// a new fix was accepted, publish the estimate
+		if (newAverage) {
 			// set shared memory
-			SET_SHARED_POSITION(sharedPosition, positionAverage);
+			SET_SHARED_ESTIMATE(sharedPosition, positionEstimate);
+			RecordLatency(&latency, message.gpsMsg.time, readTime);
+
+			// kept for the next start
+			GnssAssistUpdate(&assistState, &message.gpsMsg, &positionEstimate.position, GnssAssistUtcNs());
+			if (ClockNowNs() - lastSave >= GNSS_ASSIST_SAVE_NS) {
+				GnssAssistSave(&assistState, GNSS_ASSIST_STATE_FILE);
+				lastSave = ClockNowNs();
+			}
+#ifdef DEBUG
+			if (latency.fixesSinceReport >= GPS_REPORT_COUNT) {
+				ReportLatency(&latency, &cadence, (rtcmOpen)?(&rtcm):(NULL));
+			}
+#endif
 		}
 	}
 
+#ifdef DEBUG
+	if (latency.fixesSinceReport) {
+		ReportLatency(&latency, &cadence, (rtcmOpen)?(&rtcm):(NULL));
+	}
+#endif
+
+	if (0 == firstFixTime) {
+		printf("GPS no fix %.1f s after start\n", (ClockNowNs() - startTime) / 1000000000.0);
+	}
+
 	printf("killing gps node\n");
 	return 0;
 }
@@ -3,47 +3,195 @@
  * @author Patrick Henz
  * @date 12-1-2019
  * @brief Gyro node for TX2.
- * @details Gyro node for the TX2. Uses the LSMDS1 module for gyro functionality. This node only
- * 	    reads in values from the gyroscope and calculates angular velocity (degs/sec) if it
- * 	    has received a request to do so. Otherwise this node sits idle, waiting for a request
- * 	    to perfom some action. This node also makes use of shared memory to communicate with
- * 	    the navigation node (tx2_nav_node.c) in situations where sending a #Message over a pipe
- * 	    wouldn't work correctly.
+ * @details Gyro node for the TX2. Uses the LSMDS1 module for gyro functionality. A sampling
+ * 	    thread reads the gyroscope continuously, integrates the yaw rate into a heading with
+ * 	    the gyro bias removed, and publishes every sample to shared memory (#HeadingData). See
+ * 	    Heading.h for how other nodes, mainly the navigation node (tx2_nav_node.c), read the
+ * 	    heading and measure turns from it. The main thread only listens to master, so the node
+ * 	    stays responsive while sampling.
+ * 	    <br>
+ * 	    <br>
+ * 	    Samples are collected by the LSM9DS1's FIFO. The sampling thread wakes up every
+ * 	    #GYRO_FIFO_THRESHOLD samples and reads the whole FIFO in one burst. Each sample is
+ * 	    integrated over the time since the previous sample, using the timestamps given by
+ * 	    #GyroFifoRead(), rather than an assumed sleep time.
+ * 	    <br>
+ * 	    <br>
+ * 	    The same samples, with the magnetometer read once per FIFO read, drive the orientation
+ * 	    filter (Orientation.h), which is published to shared memory (#OrientationData) after
+ * 	    every FIFO read. If there is no #MAG_CALIBRATION_FILE the calibration is learned the
+ * 	    first time the rover turns through a full circle, and saved.
  */
 
 #include <stdio.h>
 #include "../include/Messages.h"
 #include "../include/I2CGyro.h"
+#include "../include/Heading.h"
+#include "../include/Orientation.h"
 #include "../include/SharedMem.h"
+#include "../include/Hal.h"
+#include "../include/Parameters.h"
+#include "../include/Profile.h"
 #include <unistd.h>
 #include <signal.h>
 #include <stdint.h>
+#include <time.h>
+#include <pthread.h>
 
-#define SEC_COUNT(s) ((s) * 238)
+#define REPORT_PERIOD_NS 10000000000LL	/**< How often sampling statistics are printed in debug mode. */
 
 #define DEBUG /**< This compiles the program for debug mode. There are certain macros and print
 		   statements that are included when DEBUG is defined. Comment out for non-debug
 		   commpilation. */
 
+/**
+ * @brief Cleared by the main thread to stop the sampling thread.
+**/
+volatile int sampling = 1;
+
+/**
+ * @brief Published heading, the data area of the #HeadingData shared memory.
+**/
+HeadingShared * heading;
+
+/**
+ * @brief Published orientation, the data area of the #OrientationData shared memory.
+**/
+OrientationShared * orientation;
+
+/**
+ * @brief The FIFO and magnetometer reads of #SampleGyro(), see Profile.h.
+**/
+ProfileRegion readProfile = { .name = "gyro read" };
+
+/**
+ * @brief The heading and orientation updates of #SampleGyro().
+**/
+ProfileRegion filterProfile = { .name = "gyro filter" };
+
+/**
+ * @brief Sampling thread, reads the FIFO every #GYRO_FIFO_THRESHOLD samples and publishes the heading.
+**/
+void * SampleGyro(void * arg)
+{
+	GyroSample samples[GYRO_FIFO_DEPTH];
+	HeadingSample sample;
+	HeadingIntegrator integrator;
+	MagSample mag;
+	MagCalibration calibration;
+	MagCalibrator calibrator;
+	OrientationFilter filter;
+	OrientationSample attitude;
+	float field[3];
+	long long next;
+	int sampleCount;
+	int calibrated;
+	int magOk;
+	int i;
+#ifdef DEBUG
+	GyroStats stats;
+	long long nextReport;
+	long long filterStart;
+	long long filterNs = 0;
+	unsigned long filterSamples = 0;
+#endif
+
+	InitHeading(&integrator);
+	InitOrientation(&filter, HalGetParameters()->magDeclination);
+	InitMagCalibrator(&calibrator);
+	memset(&attitude, 0, sizeof(attitude));
+
+	calibrated = (LoadMagCalibration(MAG_CALIBRATION_FILE, &calibration) < 0)?(0):(1);
+	if (!calibrated) {
+		printf("no magnetometer calibration, turn the rover through a full circle to learn one\n");
+	}
+
+	next = HeadingNowNs() + GyroFifoPeriodNs();
+#ifdef DEBUG
+	nextReport = next + REPORT_PERIOD_NS;
+#endif
+
+	while (sampling) {
+		// sleep until the FIFO has filled up to the threshold
+		ClockSleepUntil(next);
+
+		PROFILE_BEGIN(&readProfile);
+		sampleCount = GyroFifoRead(samples, GYRO_FIFO_DEPTH);
+
+		// the magnetometer has no FIFO, its newest reading is used for the whole batch
+		magOk = (MagRead(&mag) < 0)?(0):(1);
+		PROFILE_END(&readProfile);
+
+		if (magOk && calibrated) {
+			ApplyMagCalibration(&calibration, mag.field, field);
+		} else if (magOk) {
+			AddMagCalibration(&calibrator, mag.field, integrator.heading);
+			if (0 == MagCalibrationReady(&calibrator, &calibration)) {
+				if (SaveMagCalibration(MAG_CALIBRATION_FILE, &calibration) < 0) {
+					printf("error saving magnetometer calibration\n");
+				}
+				calibrated = 1;
+
+				// settle onto the magnetic heading
+				InitOrientation(&filter, HalGetParameters()->magDeclination);
+			}
+		}
+
+		PROFILE_BEGIN(&filterProfile);
+		for (i = 0; i < sampleCount; i++) {
+			IntegrateHeading(&integrator, &samples[i], &sample);
+			PublishHeading(heading, &sample);
+
+#ifdef DEBUG
+			filterStart = HeadingNowNs();
+#endif
+			UpdateOrientation(&filter, &samples[i], (magOk && calibrated)?(field):(NULL));
+#ifdef DEBUG
+			filterNs += HeadingNowNs() - filterStart;
+			filterSamples++;
+#endif
+		}
+
+		if (sampleCount > 0) {
+			GetFilterOrientation(&filter, magOk && calibrated, &attitude);
+			PublishOrientation(orientation, &attitude);
+		}
+		PROFILE_END(&filterProfile);
+
+		// keep to the schedule, unless we have fallen behind it
+		next += GyroFifoPeriodNs();
+		if (next < HeadingNowNs()) {
+			next = HeadingNowNs() + GyroFifoPeriodNs();
+		}
+
+#ifdef DEBUG
+		if (next > nextReport) {
+			GyroGetStats(&stats);
+			printf("gyro: %lu samples in %lu reads, %lu overruns, period %.6f s, heading %.2f, bias %.3f\n",
+				stats.samples, stats.reads, stats.overruns, GyroSamplePeriod(),
+				integrator.heading, integrator.bias);
+			printf("orientation: roll %.1f pitch %.1f heading %.1f%s, %lu mag reads, filter %.2f us/sample\n",
+				attitude.roll, attitude.pitch, attitude.heading, (attitude.magValid)?(""):(" (relative)"),
+				stats.magReads, (filterSamples)?((filterNs / 1000.0) / filterSamples):(0.0));
+			nextReport += REPORT_PERIOD_NS;
+		}
+#endif
+	}
+
+	ClockLeave();
+	return NULL;
+}
+
 int main(int argc, char ** argv)
 {
 	fd_set rdfs;
-	int status;
 	int masterRead;
 	int masterWrite;
-	int nbytes;
-	int readFds[2];
-	int i;
-	int I2CGyroFd;
+	int readFds[1];
 	int killMessageReceived;
-	int positionCount = 0;
-	int sampleCount;
-	int noSampleCount;
-	int lowCount;
-	int sampling;
-	float zVelocity;
-	float angleTurned;
-	SharedMem * sharedAngle;
+	pthread_t sampleThread;
+	SharedMem * sharedHeading;
+	SharedMem * sharedOrientation;
 
 	Message message;
 	memset(&message, 0, sizeof(message));
@@ -55,8 +203,16 @@ int main(int argc, char ** argv)
 		return -1;
 	}
 
-	// open I2C fd for gyro
-	I2CGyroFd = OpenI2C();
+	// real or mock LSM9DS1, and the clock, as master's parameters say
+	HalInit(NULL);
+	HalPrintConfig("gyro");
+	ProfileInit("tx2_gyro_node");
+
+	// open the gyro
+	if (I2CGyroOpen() < 0) {
+		printf("error opening gyro\n");
+		return -1;
+	}
 
 	masterRead = atoi(argv[1]);
 	masterWrite = atoi(argv[2]);
@@ -64,30 +220,47 @@ int main(int argc, char ** argv)
 	readFds[0] = masterRead;
 
 	// initialize SetAndWait
-	SetupSetAndWait(readFds,1);
+	SetupSetAndWait(readFds, 1);
 
 	// create shared memory
-	sharedAngle = CreateSharedMemory(sizeof(float), AngleData);
+	sharedHeading = CreateSharedMemory(sizeof(HeadingShared), HeadingData);
 
-	if (sharedAngle == NULL) {
-		printf("error creating shared memory for angle\n");
+	if (sharedHeading == NULL) {
+		printf("error creating shared memory for heading\n");
 		return -1;
 	}
 
-	sharedAngle->dataAvailableFlag = 0;
+	heading = (HeadingShared *)(sharedHeading + 1);
+	memset(heading, 0, sizeof(HeadingShared));
+
+	sharedOrientation = CreateSharedMemory(sizeof(OrientationShared), OrientationData);
+
+	if (sharedOrientation == NULL) {
+		printf("error creating shared memory for orientation\n");
+		return -1;
+	}
+
+	orientation = (OrientationShared *)(sharedOrientation + 1);
+	memset(orientation, 0, sizeof(OrientationShared));
+
+	// start sampling, the bias is learned while the rover sits still at startup
+	ClockExpect(0);
+	if (pthread_create(&sampleThread, NULL, SampleGyro, NULL) != 0) {
+		printf("error starting gyro sampling thread\n");
+		return -1;
+	}
 
 	// setup shared mem message for TX2Nav
 	message.messageType = SharedMemory;
 	message.source = TX2Gyro;
 	message.destination = TX2Nav;
 
-	sleep(5);
+	ClockSleep(5 * CLOCK_SECOND);
 
 	// signal nav node that shared mem is ready
-	write(masterWrite, &message, sizeof(message));
+	SendMessage(masterWrite, &message);
 
 	killMessageReceived = 0;
-	sampling = 0;
 
 	//  main while loop
 	while(!killMessageReceived) {
@@ -102,58 +275,26 @@ int main(int argc, char ** argv)
 		}
 
 		// read new message from master
-		read(masterRead, &message, sizeof(message));
+		ReceiveMessage(masterRead, &message);
 
 		// kill message
 		if (message.messageType == KillMessage) {
 			killMessageReceived = 1;
-			CloseI2C();
-			close(masterRead);
-			close(masterWrite);
 			break;
-		} else if (message.messageType == GyroMessage && message.source == TX2Nav) {
-			// we have a request for gyro data
-			noSampleCount = 0;
-
-			// sit in while loop and collect turning data
-			while (sharedAngle->dataAvailableFlag == 0 && noSampleCount < SEC_COUNT(2)) {
-				// get angular velocity sample
-				zVelocity = GetAngularVelocity();
-
-				// trigger to start sampling
-				if (!sampling && (zVelocity > 20 || zVelocity < -20)) {
-					angleTurned = 0;
-					sampleCount = 1;
-					sampling = 1;
-					lowCount = 0;
-					angleTurned += (zVelocity * SAMPLE_T);
-				} else if (sampling && (zVelocity > 10 || zVelocity < -10)) {
-					// keep sampling while turning is happening
-					sampleCount++;
-					angleTurned += (zVelocity * SAMPLE_T);
-				} else if (sampling && lowCount++ < 25) {
-					// used to account for noise during turn, keep
-					// sampling until we are mostly sure that turn 
-					// has completed
-					sampleCount++;
-				} else if (sampling && sampleCount >= 75) {
-					// we have good turning data, set shared memory
-					SET_SHARED_ANGLE(sharedAngle, angleTurned);
-					sampling = 0;
-				} else {
-					// reset
-					sampling = 0;
-					noSampleCount++;
-				}
-				// sleep so we are at a ~238 HZ sampling frequency
-				usleep(USEC_238HZ);
-			}
 		}
 	}
 
 	printf("killing gyro node\n");
 
-	CloseI2C();
+	sampling = 0;
+	ClockIdle();
+	pthread_join(sampleThread, NULL);
+	ClockBusy();
+
+	I2CGyroClose();
+	CloseSharedMemory();
+	close(masterRead);
+	close(masterWrite);
 
 	return 0;
 }
@@ -0,0 +1,145 @@
+/**
+ * @file tx2_host_cam_node.c
+ * @brief Camera node for Linux hosts.
+ * @details Camera node for machines without the Jetson camera and jetson-inference, started by
+ * 	    tx2_master.c in place of tx2_cam_node.cpp when cameraBackend in Parameters.txt is
+ * 	    "v4l2", "replay" or "sim". It talks to the other nodes exactly as tx2_cam_node.cpp does: it
+ * 	    creates the #SegmentationData shared memory and tells tx2_nav_node.c its size, fills it
+ * 	    with a new mask for every #SharedMemory request, and saves a picture for every
+ * 	    #CamMessage, answering master even if it could not. Where the masks come from is described in Camera.h. None of them has
+ * 	    scores, their confidence is #SEG_ARGMAX_CERTAIN throughout.
+**/
+
+#define DEBUG /**< Used to compile the camera node in debug mode. */
+
+#include "../include/Messages.h"
+#include "../include/SharedMem.h"
+#include "../include/Camera.h"
+#include "../include/SegArgmax.h"
+#include "../include/Hal.h"
+
+#include <stdio.h>
+
+#define IMAGE_LOCATION "../images/img%.3d.%s"	/**< Pictures, numbered like those of tx2_cam_node.cpp. */
+
+int main(int argc, char ** argv)
+{
+	fd_set rdfs;
+	int masterRead;
+	int masterWrite;
+	int readFds[1];
+	int imagesTaken = 0;
+	int killMessageReceived;
+	SharedMem * sharedMem;
+	uint8_t * mask;
+	Camera camera;
+	CameraStats stats;
+	Message message;
+
+	// make sure that pipes have been provided by master
+	if (argc != 3) {
+		printf("Error starting Camera Node\n");
+		return -1;
+	}
+
+	masterRead = atoi(argv[1]);
+	masterWrite = atoi(argv[2]);
+
+	readFds[0] = masterRead;
+
+	// initialize SetAndWait functionality
+	SetupSetAndWait(readFds, 1);
+
+	HalInit(NULL);
+	HalPrintConfig("camera");
+
+	if (CameraOpen(&camera, HalGetConfig()->camera) < 0) {
+		printf("CAMERA FAILURE\n");
+		return -1;
+	}
+
+	// create shared memory for semantic segmentation data, the mask and its confidence
+	sharedMem = CreateSharedMemory(camera.width * camera.height * SEG_ARGMAX_PLANES, SegmentationData);
+
+	if (NULL == sharedMem) {
+		printf("SHARED MEMORY ERROR IN CAM NODE\n");
+		return -1;
+	}
+
+	mask = (uint8_t *)(sharedMem + 1);
+	memset(mask + (camera.width * camera.height), SEG_ARGMAX_CERTAIN, camera.width * camera.height);
+
+	// signal nav node that shared mem is ready
+	memset(&message, 0, sizeof(message));
+	message.messageType = SharedMemory;
+	message.shMem.width = camera.width;
+	message.shMem.height = camera.height;
+	message.source = TX2Cam;
+	message.destination = TX2Nav;
+	SendMessage(masterWrite, &message);
+
+	printf("\n\nINITIALIZATION OF HOST CAMERA NODE COMPLETE (%dx%d)\n\n", camera.width, camera.height);
+
+	killMessageReceived = 0;
+
+	while (!killMessageReceived) {
+		// wait for master or timeout
+		if (SetAndWait(&rdfs, 1, 0) < 0) {
+			printf("SET AND WAIT ERROR CAM\n");
+		}
+
+		if (!FD_ISSET(masterRead, &rdfs)) {
+			continue;
+		}
+
+		ReceiveMessage(masterRead, &message);
+
+		if (CamMessage == message.messageType) {
+			// picture for the controller
+			memset(&message, 0, sizeof(message));
+			sprintf(message.camMsg.fileLocation, IMAGE_LOCATION, imagesTaken,
+				(CameraV4L2 == camera.backend)?("ppm"):("pgm"));
+
+			// master waits for the answer, a failed picture goes to master only
+			if (CameraSaveImage(&camera, message.camMsg.fileLocation) < 0) {
+				printf("error saving %s\n", message.camMsg.fileLocation);
+				message.destination = TX2Master;
+			} else {
+				imagesTaken++;
+				message.destination = TX2Comm;
+			}
+
+			message.messageType = CamMessage;
+			message.source = TX2Cam;
+			SendMessage(masterWrite, &message);
+		} else if (SharedMemory == message.messageType) {
+			// new mask for the nav node
+			if (CameraMask(&camera, mask) < 0) {
+				printf("camera capture failed\n");
+				continue;
+			}
+
+			memset(&message, 0, sizeof(message));
+			message.messageType = SharedMemory;
+			message.source = TX2Cam;
+			message.destination = TX2Nav;
+			SendMessage(masterWrite, &message);
+		} else if (KillMessage == message.messageType) {
+			killMessageReceived = 1;
+		}
+	}
+
+#ifdef DEBUG
+	CameraGetStats(&camera, &stats);
+	printf("camera: %lu masks, %lu failures, avg %.2f ms max %.2f ms\n", stats.frames, stats.failures,
+		(stats.frames)?((stats.captureNs / 1000000.0) / stats.frames):(0.0), stats.maxNs / 1000000.0);
+#endif
+
+	CameraClose(&camera);
+	CloseSharedMemory();
+	close(masterRead);
+	close(masterWrite);
+
+	printf("Killing camera node\n");
+	return 0;
+}
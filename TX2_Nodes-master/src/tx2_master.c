@@ -8,26 +8,69 @@
  * 	    from creating the other nodes, the TX2 master node aslo acts as a routing mechanism for
  * 	    the other  nodes to pass messages around between one another. If a node wishes to send
  * 	    a #Message to another node, it must go through master; no pipes exist between child nodes.
- * 	    The only exception for interporcess communication is shared memory, but master has nothing
- * 	    to do with the creation or maintentance of shared memory.
+ * 	    The only exception for interporcess communication is shared memory, which master has
+ * 	    nothing to do with, apart from the parameters.
+ * 	    <br>
+ * 	    <br>
+ * 	    Master loads Parameters.txt before it starts the child nodes and publishes it to shared
+ * 	    memory (#ParameterData) for all of them, see Parameters.h. The file is reloaded when it is
+ * 	    saved, or when a #ParametersMessage arrives, and tx2_nav_node.c is sent a
+ * 	    #ParametersMessage whenever a new version is published.
+ * 	    <br>
+ * 	    <br>
+ * 	    The parameters also choose the hardware backends (Hal.h). Master starts
+ * 	    tx2_host_cam_node.c instead of tx2_cam_node.cpp unless cameraBackend is "jetson", the
+ * 	    other nodes pick their backends themselves. With the virtual clock (Clock.h) master
+ * 	    starts virtual time before the child nodes, which join it. Another parameters file can be given on the
+ * 	    command line, one set up for a Linux host for example:
+ * 	    <br>
+ * 	    <br>
+ * 	    Usage: ./tx2_master [parameters file]
+ * 	    <br>
+ * 	    <br>
+ * 	    If tx2_nav_node.c dies master starts it again, up to #NAV_MAX_RESTARTS times, and sends
+ * 	    it the #SharedMemory messages the first one had from the other nodes, then the messages
+ * 	    the old one never read (up to #NAV_REPLAY_COUNT). The new nav takes
+ * 	    over the state the old one left in shared memory, see NavCheckpoint.h, which master
+ * 	    removes when it starts. Any other node that dies is only logged and left out.
  * 	    <br>
  * 	    <br>
  * 	    The master node is also responsible for maintaining a command queue via the Command.h library.
  * 	    This gives master the ability to send commands to child nodes to have them execute a specific
  * 	    type of functionality. When a child node finishes executing the command, it sends a request to
  * 	    master to pop the command queue and send out another command to the appropriate node.
+ * 	    A #Survey command queues the waypoints of a whole survey at once (see Coverage.h), with
+ * 	    a #CameraCommand after each waypoint a picture is taken at. The camera node answers a
+ * 	    picture with the #CamMessage it sends the comm node, and master only goes on to the
+ * 	    next command then, or after #SURVEY_CAPTURE_TIMEOUT, so the rover does not drive off
+ * 	    while the picture is taken.
+ * 	    <br>
+ * 	    <br>
+ * 	    Every message master routes is recorded to its telemetry archive, CAN frames with
+ * 	    their id, command and count, and once a second how many messages each node sent (see
+ * 	    Telemetry.h).
  */
 
 #define DEBUG /**< Used to compile the master node in debug mode. */
 
 #include "../include/Messages.h"
 #include "../include/Command.h"
+#include "../include/SharedMem.h"
+#include "../include/Parameters.h"
+#include "../include/Clock.h"
+#include "../include/Profile.h"
+#include "../include/Coverage.h"
+#include "../include/Telemetry.h"
+#include "../include/Hal.h"
 
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/ioctl.h>
 
 // when pipe is called, index 0 is a read, index 1 is a write
 #define READ 0
@@ -38,6 +81,16 @@
 **/
 #define CHILD_COUNT 6
 
+/**
+ * @brief Times tx2_nav_node.c is started again after dying.
+**/
+#define NAV_MAX_RESTARTS 3
+
+/**
+ * @brief Newest messages to tx2_nav_node.c kept, for those a dead nav never read.
+**/
+#define NAV_REPLAY_COUNT 16
+
 /**
  * @brief Calls to execute child nodes.
 **/
@@ -74,20 +127,104 @@ int ChildIdentifiers[CHILD_COUNT] = {
 	TX2Gyro
 };
 
+/**
+ * @brief Child node pids, indexed by #ChildIdentifiers.
+**/
+pid_t ChildPids[CHILD_COUNT];
+
+/**
+ * @brief The first #SharedMemory message nav was sent by each node, a restarted nav is sent them again.
+**/
+Message NavSharedMemory[CHILD_COUNT];
+
+/**
+ * @brief Whether #NavSharedMemory holds a message from that source.
+**/
+int NavSharedMemorySent[CHILD_COUNT];
+
+/**
+ * @brief The newest #NAV_REPLAY_COUNT messages sent to nav, a ring indexed by #NavSentCount.
+**/
+Message NavSent[NAV_REPLAY_COUNT];
+
+/**
+ * @brief Messages sent to nav.
+**/
+unsigned long NavSentCount = 0;
+
+/**
+ * @brief #ClockNowNs() time master stops waiting for the picture the camera node is taking, 0 if none.
+**/
+long long captureDeadline = 0;
+
+/**
+ * @brief Routing the messages of one wait, see Profile.h.
+**/
+ProfileRegion routeProfile = { .name = "route" };
+
+/**
+ * @brief Archive of the messages routed, see Telemetry.h.
+**/
+TelemetryWriter telemetry;
+
+/**
+ * @brief Columns of the #messageStream, a #Message and its CAN frame.
+**/
+TelemetryColumn messageColumns[] = {
+	{ "source", TelemetryInt },
+	{ "destination", TelemetryInt },
+	{ "type", TelemetryInt },
+	{ "sid", TelemetryInt },	// the CAN frame, 0 for other messages
+	{ "command", TelemetryInt },
+	{ "writeCount", TelemetryInt }
+};
+
+/**
+ * @brief Columns of the #nodeStream, a row for each node each second.
+**/
+TelemetryColumn nodeColumns[] = {
+	{ "node", TelemetryInt },	// as the source of a #Message
+	{ "messages", TelemetryInt }	// sent to master in that second
+};
+
+/**
+ * @brief #telemetry stream of the messages routed.
+**/
+int messageStream;
+
+/**
+ * @brief #telemetry stream of the messages from each node.
+**/
+int nodeStream;
+
+/**
+ * @brief Messages read from each node since #NodeMessagesTime.
+**/
+unsigned long NodeMessages[CHILD_COUNT];
+
+/**
+ * @brief #ClockNowNs() #NodeMessages were last recorded.
+**/
+long long NodeMessagesTime = 0;
+
+/**
+ * @brief Camera node started when cameraBackend is not "jetson".
+**/
+#define HOST_CAM_COMMAND "./tx2_host_cam_node"
+
 /**
  * @brief Macro used to determine if node is child node or parent.
 **/
 #define IS_CHILD_NODE(p) (0 == (p))
 
 /**
- * @brief Internal function used to create child nodes and pipes.
- * @details Internal function used by TX2 master to create child nodes
- * 	    and the pipes needed to communicate with those nodes.
+ * @brief Internal function used to create a child node and its pipes.
+ * @param i Index of the node in #ExecuteCommands.
  * @param readPipes A pointer to the pipes that master reads from.
  * @param writePipes A pointer to the pipes that master writes to.
  * @return Returns 0 if success, -1 if error.
 **/
-int InitializeTX2Nodes(int * readPipes, int * writePipes)
+int StartTX2Node(int i, int * readPipes, int * writePipes)
 {
 	int tempReadPipe[2];
 	int tempWritePipe[2];
@@ -97,45 +234,305 @@ int InitializeTX2Nodes(int * readPipes, int * writePipes)
 	char param1[16];
 	char param2[16];
 
+	// wipe old data
+	memset(tempReadPipe, 0, sizeof(tempReadPipe));
+	memset(tempWritePipe, 0, sizeof(tempWritePipe));
+	memset(param1, 0, sizeof(param1));
+	memset(param2, 0, sizeof(param2));
+
+	// create pipes
+	if(pipe(tempReadPipe) | pipe(tempWritePipe)) {
+		printf("Error creating %s Pipes\n", ChildNames[i]);
+		return -1;
+	}
+	
+	// create child node process
+	tempChildPid = fork();
+
+	// is this the child? If so, take care of pipes and call #ExecuteCommands 
+	if(IS_CHILD_NODE(tempChildPid)) {
+		close(tempReadPipe[READ]);
+		close(tempWritePipe[WRITE]);
+		sprintf(param1, "%d", tempWritePipe[READ]); // CAN read
+		sprintf(param2, "%d", tempReadPipe[WRITE]); // CAN write
+		signal(SIGPIPE, SIG_DFL);
+		execl(ExecuteCommands[i], ChildNames[i], param1, param2, (char *)NULL);
+		exit(-1);
+	}
+
+	// on the virtual clock time waits for the child to start
+	ClockExpect(tempChildPid);
+
+	// this is master node, close appropriate pipes
+	close(tempReadPipe[WRITE]);
+	close(tempWritePipe[READ]);
+
+	// retain read and write pipes
+	readPipes[ChildIdentifiers[i]] = tempReadPipe[READ];
+	writePipes[ChildIdentifiers[i]] = tempWritePipe[WRITE];
+	ChildPids[ChildIdentifiers[i]] = tempChildPid;
+
+	return 0;
+}
+
+/**
+ * @brief Internal function used to create child nodes and pipes.
+ * @details Internal function used by TX2 master to create child nodes
+ * 	    and the pipes needed to communicate with those nodes.
+ * @param readPipes A pointer to the pipes that master reads from.
+ * @param writePipes A pointer to the pipes that master writes to.
+ * @return Returns 0 if success, -1 if error.
+**/
+int InitializeTX2Nodes(int * readPipes, int * writePipes)
+{
 	int i; // loop variable
 	
 	for (i = 0; i < CHILD_COUNT; i++) {
-		// wipe old data
-		memset(tempReadPipe, 0, sizeof(tempReadPipe));
-		memset(tempWritePipe, 0, sizeof(tempWritePipe));
-		memset(param1, 0, sizeof(param1));
-		memset(param2, 0, sizeof(param2));
-
-		// create pipes
-		if(pipe(tempReadPipe) | pipe(tempWritePipe)) {
-			printf("Error creating %s Pipes\n", ChildNames[i]);
+		if (StartTX2Node(i, readPipes, writePipes) < 0) {
 			return -1;
 		}
-		
-		// create child node process
-		tempChildPid = fork();
-
-		// is this the child? If so, take care of pipes and call #ExecuteCommands 
-		if(IS_CHILD_NODE(tempChildPid)) {
-			close(tempReadPipe[READ]);
-			close(tempWritePipe[WRITE]);
-			sprintf(param1, "%d", tempWritePipe[READ]); // CAN read
-			sprintf(param2, "%d", tempReadPipe[WRITE]); // CAN write
-			execl(ExecuteCommands[i], ChildNames[i], param1, param2, (char *)NULL);
-		} else {
-			// this is master node, close appropriate pipes
-			close(tempReadPipe[WRITE]);
-			close(tempWritePipe[READ]);
-
-			// retain read and write pipes
-			readPipes[ChildIdentifiers[i]] = tempReadPipe[READ];
-			writePipes[ChildIdentifiers[i]] = tempWritePipe[WRITE];
-		}
 	}
 
 	return 0;
 }
 
+/**
+ * @brief Internal function that sends a message to its destination, keeping those to nav.
+**/
+void RouteMessage(int * writePipes, Message * message)
+{
+	double values[6];
+
+	values[0] = message->source;
+	values[1] = message->destination;
+	values[2] = message->messageType;
+	values[3] = (CANMessage == message->messageType)?(message->canMsg.SId):(0);
+	values[4] = (CANMessage == message->messageType)?(message->canMsg.Message[0]):(0);
+	values[5] = (CANMessage == message->messageType)?(message->canMsg.writeCount):(0);
+	TelemetryRecord(&telemetry, messageStream, ClockNowNs(), values);
+
+	if (TX2Nav == message->destination) {
+		memcpy(&NavSent[NavSentCount % NAV_REPLAY_COUNT], message, sizeof(Message));
+		NavSentCount++;
+	}
+
+	SendMessage(writePipes[message->destination], message);
+}
+
+/**
+ * @brief Internal function that sends the command after a picture, the picture taken or given up on.
+**/
+void CaptureDone(int * writePipes)
+{
+	Message message;
+
+	captureDeadline = 0;
+	printf("\n\nPOPING COMMAND QUEUE\n\n");
+	if (GetNextCommand(&message)) {
+		if (CamMessage == message.messageType) {
+			captureDeadline = ClockNowNs() + SURVEY_CAPTURE_TIMEOUT;
+		}
+		RouteMessage(writePipes, &message);
+	}
+}
+
+/**
+ * @brief Internal function that records how many messages each node sent, once a second.
+**/
+void RecordNodeMessages()
+{
+	long long now = ClockNowNs();
+	double values[2];
+	int i;
+
+	if (now - NodeMessagesTime < CLOCK_SECOND) {
+		return;
+	}
+
+	for (i = 0; i < CHILD_COUNT; i++) {
+		values[0] = i;
+		values[1] = NodeMessages[i];
+		TelemetryRecord(&telemetry, nodeStream, now, values);
+		NodeMessages[i] = 0;
+	}
+	NodeMessagesTime = now;
+}
+
+/**
+ * @brief Internal function that sets up SetAndWait with the pipes of the live nodes and the parameters watch.
+**/
+void SetupWait(int * waitFds, int * readPipes, int parametersWatch)
+{
+	int count = 0;
+	int i;
+
+	for (i = 0; i < CHILD_COUNT; i++) {
+		if (readPipes[i] >= 0) {
+			waitFds[count++] = readPipes[i];
+		}
+	}
+	if (parametersWatch >= 0) {
+		waitFds[count++] = parametersWatch;
+	}
+
+	SetupSetAndWait(waitFds, count);
+}
+
+/**
+ * @brief Internal function that cleans up after a node that died, and starts nav again.
+ * @details The pipe of a dead node reads end of file. Its messages to the node are never read,
+ *	    they are taken off the virtual clock with the node, see #ClockReap().
+ * @param node #NodeName of the node.
+ * @param restarts Times nav has been started again, counted.
+ * @return 1 if nav was started again, 0 if the node is left out.
+**/
+int ChildExited(int node, int * readPipes, int * writePipes, int * restarts)
+{
+	Message replay[NAV_REPLAY_COUNT];
+	int replayCount;
+	int unread = 0;
+	int status = 0;
+	int i;
+
+	for (i = 0; i < CHILD_COUNT; i++) {
+		if (node == ChildIdentifiers[i]) {
+			break;
+		}
+	}
+
+	waitpid(ChildPids[node], &status, 0);
+	ioctl(writePipes[node], FIONREAD, &unread);
+	unread /= sizeof(Message);
+	ClockReap(ChildPids[node], unread);
+
+	if (WIFSIGNALED(status)) {
+		printf("%s killed by signal %d, %d messages unread\n", ChildNames[i], WTERMSIG(status), unread);
+	} else {
+		printf("%s exited with %d, %d messages unread\n", ChildNames[i], WEXITSTATUS(status), unread);
+	}
+
+	close(readPipes[node]);
+	close(writePipes[node]);
+	readPipes[node] = -1;
+	writePipes[node] = -1;
+
+	if (TX2Nav != node || *restarts >= NAV_MAX_RESTARTS) {
+		return 0;
+	}
+
+	(*restarts)++;
+	printf("restarting %s, %d of %d\n", ChildNames[i], *restarts, NAV_MAX_RESTARTS);
+
+	if (StartTX2Node(i, readPipes, writePipes) < 0) {
+		return 0;
+	}
+
+	// the unread messages are the newest, copied before sending adds to the ring
+	replayCount = (unread < NAV_REPLAY_COUNT)?(unread):(NAV_REPLAY_COUNT);
+	replayCount = (replayCount < (int)NavSentCount)?(replayCount):((int)NavSentCount);
+	for (i = 0; i < replayCount; i++) {
+		memcpy(&replay[i], &NavSent[(NavSentCount - replayCount + i) % NAV_REPLAY_COUNT], sizeof(Message));
+	}
+	if (unread > replayCount) {
+		printf("%d messages to nav lost\n", unread - replayCount);
+	}
+
+	// nav waits for the other nodes' shared memory before anything else
+	for (i = 0; i < CHILD_COUNT; i++) {
+		if (NavSharedMemorySent[i]) {
+			RouteMessage(writePipes, &NavSharedMemory[i]);
+		}
+	}
+
+	for (i = 0; i < replayCount; i++) {
+		RouteMessage(writePipes, &replay[i]);
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Internal function that reloads the parameters and tells the nav node about a new version.
+**/
+void UpdateParameters(ParametersShared * parameters, char * parametersFile, int * writePipes)
+{
+	Message message;
+
+	switch (ReloadParameters(parameters, parametersFile)) {
+		case 1:
+			printf("parameters version %u published\n", parameters->version);
+			memset(&message, 0, sizeof(message));
+			message.messageType = ParametersMessage;
+			message.source = TX2Master;
+			message.destination = TX2Nav;
+			RouteMessage(writePipes, &message);
+			break;
+		case 0:
+			printf("parameters unchanged\n");
+			break;
+		default:
+			printf("parameters rejected, keeping version %u\n", parameters->version);
+			break;
+	}
+}
+
+/**
+ * @brief Internal function that plans the survey of #SURVEY_FILE, or #SURVEY_ENV, and queues it.
+ * @param message Output, the first waypoint for nav if the queue was empty.
+ * @return What #InsertCommands() returned, -1 if there is no plan.
+**/
+int PlanSurvey(Message * message)
+{
+	CoverageArea area;
+	CoverageStats stats;
+	CoverageWaypoint * waypoints;
+	CmdMsg * commands;
+	char * fileName = getenv(SURVEY_ENV);
+	double latitude, longitude;
+	int insertion = -1;
+	int count = -1;
+	int i, j;
+
+	fileName = (NULL != fileName)?(fileName):(SURVEY_FILE);
+	if (CoverageReadArea(fileName, &area) < 0) {
+		return -1;
+	}
+
+	// a waypoint and a picture each at most
+	waypoints = malloc(sizeof(CoverageWaypoint) * SURVEY_MAX_WAYPOINTS);
+	commands = calloc(SURVEY_MAX_WAYPOINTS * 2, sizeof(CmdMsg));
+	if (NULL != waypoints && NULL != commands) {
+		count = CoveragePlan(&area, waypoints, SURVEY_MAX_WAYPOINTS, &stats);
+	}
+
+	if (count > 0) {
+		for (i = 0, j = 0; i < count; i++) {
+			CoverageLatLon(&area, waypoints[i].x, waypoints[i].y, &latitude, &longitude);
+			commands[j].commandType = PositionCommand;
+			commands[j].commandOperation = Create;
+			commands[j].position.latitude = latitude;
+			commands[j].position.longitude = longitude;
+			j++;
+
+			// taken once nav is at the waypoint
+			if (waypoints[i].photo) {
+				commands[j].commandType = CameraCommand;
+				commands[j].commandOperation = Create;
+				j++;
+			}
+		}
+
+		insertion = InsertCommands(commands, j, message);
+		printf("\n\nSURVEY %s: %d LANES, %d CELLS, %d WAYPOINTS, %d PHOTOS, %.0f M, %d COMMANDS QUEUED\n\n",
+		       fileName, stats.lanes, stats.cells, stats.waypoints, stats.photos, stats.length, CountCommands());
+	}
+
+	free(waypoints);
+	free(commands);
+
+	return insertion;
+}
+
 int main(int argc, char ** argv)
 {
 #ifdef DEBUG
@@ -148,12 +545,80 @@ int main(int argc, char ** argv)
 	int readPipes[CHILD_COUNT];
 	int writePipes[CHILD_COUNT];
 
+	// the pipes and the parameters file watch
+	int waitFds[CHILD_COUNT + 1];
+	int parametersWatch;
+
+	SharedMem * sharedParameters;
+	ParametersShared * parameters;
+	Parameters initialParameters;
+	char * parametersFile = PARAMETERS_FILE;
+
 	int status;
 	int killMessageReceived;
+	int navRestarts = 0;
 	int i;
 
 	Message message;
 	unsigned int messageOkToSend;
+	CommandOperation operation;
+
+	if (argc > 1) {
+		parametersFile = argv[1];
+	}
+
+	// a node that dies closes its pipe, writing to it must not take master down too
+	signal(SIGPIPE, SIG_IGN);
+	ProfileInit("tx2_master");
+
+	// the parameters have to be in place before the child nodes start
+	if (GetParameters(parametersFile, &initialParameters) < 0) {
+		printf("ERROR READING PARAMETERS FILE\n");
+		return -1;
+	}
+
+	sharedParameters = CreateSharedMemory(sizeof(ParametersShared), ParameterData);
+
+	if (NULL == sharedParameters) {
+		printf("ERROR CREATING PARAMETERS SHARED MEMORY\n");
+		return -1;
+	}
+
+	parameters = (ParametersShared *)(sharedParameters + 1);
+	memset(parameters, 0, sizeof(ParametersShared));
+	PublishParameters(parameters, &initialParameters);
+
+	// no Jetson, masks come from a V4L2 camera or a recording
+	if (CameraJetson != initialParameters.hal.camera) {
+		for (i = 0; i < CHILD_COUNT; i++) {
+			if (TX2Cam == ChildIdentifiers[i]) {
+				ExecuteCommands[i] = HOST_CAM_COMMAND;
+			}
+		}
+	}
+
+	// virtual time starts here, unless roverSim.c has started it, and the child nodes follow
+	if (ClockVirtual == initialParameters.hal.clock && !ClockIsVirtual()) {
+		ClockUseVirtual(1);
+	}
+
+	// the other clocks, from the parameters just published, as the child nodes will
+	HalInit(NULL);
+	HalPrintConfig("master");
+
+	// a nav state left by an earlier master is not for these nodes
+	shm_unlink(SHARED_CHECKPOINT_NAME);
+
+	// on the clock the nodes stamp their samples with
+	TelemetryOpen(&telemetry, "tx2_master", ClockNowNs());
+	messageStream = TelemetryAddStream(&telemetry, "messages", messageColumns, sizeof(messageColumns) / sizeof(TelemetryColumn));
+	nodeStream = TelemetryAddStream(&telemetry, "nodes", nodeColumns, sizeof(nodeColumns) / sizeof(TelemetryColumn));
+	NodeMessagesTime = ClockNowNs();
+
+	parametersWatch = WatchParameters(parametersFile);
+	if (parametersWatch < 0) {
+		printf("not watching parameters file, reload with a parameters message\n");
+	}
 	
 	// create the child nodes and the pipes needed to 
 	// communicate with them
@@ -165,7 +630,7 @@ int main(int argc, char ** argv)
 	}
 
 	// initialize set and wait
-	SetupSetAndWait(readPipes, CHILD_COUNT);
+	SetupWait(waitFds, readPipes, parametersWatch);
 
 	killMessageReceived = 0;	
 
@@ -175,14 +640,26 @@ int main(int argc, char ** argv)
 			printf("\n\nERROR\n\n)");
 		}		
 
+		// Parameters.txt was saved
+		if (parametersWatch >= 0 && FD_ISSET(parametersWatch, &rdfs) &&
+		    ParametersChanged(parametersWatch, parametersFile)) {
+			UpdateParameters(parameters, parametersFile, writePipes);
+		}
+
 		// check each fd to see if message is available
+		PROFILE_BEGIN(&routeProfile);
 		for (i = 0; i < CHILD_COUNT; i++) {
-			if (!FD_ISSET(readPipes[i], &rdfs)) {
+			if (readPipes[i] < 0 || !FD_ISSET(readPipes[i], &rdfs)) {
 				continue;
 			}
 
-			// read the message
-			read(readPipes[i], &message, sizeof(message));
+			// read the message, there is none once the node has died
+			if (sizeof(Message) != ReceiveMessage(readPipes[i], &message)) {
+				ChildExited(i, readPipes, writePipes, &navRestarts);
+				SetupWait(waitFds, readPipes, parametersWatch);
+				break;
+			}
+			NodeMessages[i]++;
 
 			// manual needs to go through nav
 			if (TX2Comm == message.source && TX2Can == message.destination) {
@@ -191,23 +668,43 @@ int main(int argc, char ** argv)
 				// kill received
 				killMessageReceived = 1;
 				break;
+			} else if (ParametersMessage == message.messageType) {
+				// reload, nav is told if there is a new version
+				UpdateParameters(parameters, parametersFile, writePipes);
+				continue;
 			} else if (CommandMessage == message.messageType && 
 				   message.destination == TX2Master &&
 				   message.source == TX2Nav) {
 				// nav is done with current command, pop the queue
 				printf("\n\nPOPING COMMAND QUEUE\n\n");
 				messageOkToSend = GetNextCommand(&message);
+				// pictures are taken where nav stopped, the next waypoint waits for the camera
+				if (messageOkToSend && CamMessage == message.messageType) {
+					captureDeadline = ClockNowNs() + SURVEY_CAPTURE_TIMEOUT;
+				}
 				// if we don't need to send another command, continue so there is no write
 				if (!messageOkToSend) {
 					continue;
 				}	
+			} else if (CamMessage == message.messageType && TX2Cam == message.source) {
+				// the picture is taken, or failed if it is for master, on to the next command
+				if (captureDeadline > 0) {
+					CaptureDone(writePipes);
+				}
+				if (TX2Master == message.destination) {
+					continue;
+				}
 			} else if (CommandMessage == message.messageType && message.source == TX2Comm) {
 				// this is where we either Create, Update, or Delete a command. Incoming
 				// messages from the comm node are interpreted here
-				switch (message.cmdMsg.commandOperation) {
+				operation = message.cmdMsg.commandOperation;
+				switch (operation) {
 					case Create:
 						InsertCommand(&message.cmdMsg, &message);
 						break;
+					case Survey:
+						PlanSurvey(&message);
+						break;
 					case Update:
 						// this will be implemented as an update and delete
 						break;
@@ -218,31 +715,62 @@ int main(int argc, char ** argv)
 						printf("unkown command message operation");
 						break;
 				}
-				PrintCommands();
+				// a survey is too long to print
+				if (Survey != operation) {
+					PrintCommands();
+				}
 				// if we don't need to write the new command to the nav node, continue
 				if (message.destination != TX2Nav) {
 					continue;
 				}
 			}
 
+			// the first holds the sizes, the camera's later ones only say there is a new mask
+			if (SharedMemory == message.messageType && TX2Nav == message.destination && message.source < CHILD_COUNT &&
+			    !NavSharedMemorySent[message.source]) {
+				memcpy(&NavSharedMemory[message.source], &message, sizeof(Message));
+				NavSharedMemorySent[message.source] = 1;
+			}
+
 			// send message to destination
-			write(writePipes[message.destination], &message, sizeof(message));
+			RouteMessage(writePipes, &message);
 		}
+		PROFILE_END(&routeProfile);
+
+		// the camera node never answered, the survey goes on without the picture
+		if (captureDeadline > 0 && ClockNowNs() > captureDeadline) {
+			printf("\n\nNO PICTURE FROM THE CAMERA NODE, GOING ON\n\n");
+			CaptureDone(writePipes);
+		}
+
+		RecordNodeMessages();
 	}
 
 
 	printf("killing child processes\n");
 
+	// the nodes stop reading their pipes, the virtual clock can't wait for them anymore
+	ClockRelease();
+
 	// loop through each child process and send kill message
 	for (i = 0; i < CHILD_COUNT; i++) {
+		if (writePipes[i] < 0) {
+			continue;
+		}
 		memset(&message, 0, sizeof(message));
 		message.messageType = KillMessage;
-		write(writePipes[i], &message, sizeof(message));
+		SendMessage(writePipes[i], &message);
 		printf("closing %d\n", i);
 		close(readPipes[i]);
 		close(writePipes[i]);
 	}	
 
+	if (parametersWatch >= 0) {
+		close(parametersWatch);
+	}
+	CloseSharedMemory();
+	TelemetryClose(&telemetry);
+
 	printf("master signing off...\n");
 
 	return 0;
@@ -5,15 +5,33 @@
  * @brief Navigation node for TX2.
  * @details Navigation node for the TX2 rover. This node handles all naviagtion related
  * 	    decision making and utilizes shared memory from tx2_cam_node.cpp, tx2_gps_node.c,
- * 	    and tx2_gyro_node.c.   
+ * 	    and tx2_gyro_node.c. The scores and decision of each mask and every new position
+ * 	    estimate are recorded to its telemetry archive, see Telemetry.h. The dot products
+ * 	    of the masks with the filters are taken by the kernel chosen for the board, see
+ * 	    MaskKernel.h. How sure the segmentation network was of the lower half of each mask,
+ * 	    from the confidence after it in the shared memory (see SegArgmax.h), is recorded
+ * 	    with it.
  */
 
 #include <stdio.h>
 #include "../include/Messages.h"
 #include "../include/SharedMem.h"
+#include "../include/Heading.h"
+#include "../include/Orientation.h"
 #include "../include/LatLonTrig.h"
 #include "../include/FilterGen.h"
+#include "../include/MaskClean.h"
+#include "../include/MaskKernel.h"
+#include "../include/SegArgmax.h"
+#include "../include/Obstacles.h"
+#include "../include/Walkway.h"
+#include "../include/Watchdog.h"
+#include "../include/Governor.h"
+#include "../include/Telemetry.h"
+#include "../include/NavCheckpoint.h"
+#include "../include/Profile.h"
 #include "../include/Parameters.h"
+#include "../include/Hal.h"
 #include "../include/protocol.h"
 #include <unistd.h>
 #include <signal.h>
@@ -28,6 +46,8 @@
 **/
 #define NO_VALUE -1
 
+#define GPS_DROPOUT_NS 5000000000LL	/**< No new fix for this long is a GPS dropout. */
+
 /**
  * @brief Checks CAN message in #Message; returns true if equal to #NO_VALUE, else false.
 **/
@@ -138,11 +158,66 @@ PreviousValues rightValues;
 **/
 PreviousValues centerValues;
 
+/**
+ * @brief Opening and closing of the segmentation mask before the dot products, see MaskClean.h.
+**/
+MaskClean maskClean;
+
+/**
+ * @brief The dot products of the masks with the filters, see MaskKernel.h.
+**/
+MaskKernels maskKernels;
+
+/**
+ * @brief Finds the obstacles in each cleaned mask, see Obstacles.h.
+**/
+ObstacleFinder obstacleFinder;
+
+/**
+ * @brief Obstacles of the newest mask, published to #obstacles.
+**/
+ObstacleList obstacleList;
+
+/**
+ * @brief #SharedMem for the obstacles, created by this node.
+**/
+SharedMem * sharedObstacles;
+
+/**
+ * @brief Obstacles published for the other nodes, the data area of #sharedObstacles.
+**/
+ObstacleShared * obstacles;
+
+/**
+ * @brief Fits the walkway edges in each cleaned mask, see Walkway.h.
+**/
+Walkway walkway;
+
+/**
+ * @brief Where the walkway is in the newest mask, published to #walkwayShared.
+**/
+WalkwayEstimate walkwayEstimate;
+
+/**
+ * @brief #SharedMem for the walkway, created by this node.
+**/
+SharedMem * sharedWalkway;
+
+/**
+ * @brief Walkway published for the other nodes, the data area of #sharedWalkway.
+**/
+WalkwayShared * walkwayShared;
+
 /**
  * @brief Current position of rover.
 **/
 Position currentPosition;
 
+/**
+ * @brief Latest #PositionEstimate from tx2_gps_node.c, includes the accuracy of #currentPosition.
+**/
+PositionEstimate positionEstimate;
+
 /**
  * @brief Destination position of current command.
 **/
@@ -168,6 +243,21 @@ double trueTurningAngle;
 **/
 Parameters parameters;
 
+/**
+ * @brief #SharedMem with tx2_master.c for the parameters.
+**/
+SharedMem * sharedParameters;
+
+/**
+ * @brief Parameters published by tx2_master.c, the data area of #sharedParameters.
+**/
+ParametersShared * parameterStore;
+
+/**
+ * @brief Version of the #ParameterSnapshot #parameters was copied from.
+**/
+unsigned int parametersVersion;
+
 /**
  * @brief Width of image/semantic segmentation array.
 **/
@@ -181,7 +271,39 @@ int imageHeight;
 /**
  * @brief #SharedMem with tx2_gyro_node.c.
 **/
-SharedMem * sharedAngle;
+SharedMem * sharedHeading;
+
+/**
+ * @brief Heading published by tx2_gyro_node.c, the data area of #sharedHeading.
+**/
+HeadingShared * heading;
+
+/**
+ * @brief #SharedMem with tx2_gyro_node.c for the orientation.
+**/
+SharedMem * sharedOrientation;
+
+/**
+ * @brief Orientation published by tx2_gyro_node.c, the data area of #sharedOrientation.
+**/
+OrientationShared * orientation;
+
+/**
+ * @brief Set when the rover should point itself at the destination with the compass.
+ * @details Set at startup, on a new destination and after a GPS dropout, when there is no
+ *	    course from #previousPosition to turn by. Cleared once a compass or GPS turn is made.
+**/
+int compassTurnNeeded = 1;
+
+/**
+ * @brief UTC time of the last new #PositionEstimate, used to notice GPS dropouts.
+**/
+unsigned int lastFixTime;
+
+/**
+ * @brief #ClockNowNs() ns #lastFixTime was received at.
+**/
+long long lastFixReceived;
 
 /**
  * @brief #SharedMem with tx2_gps_node.c.
@@ -207,29 +329,220 @@ int TurningLookupTableCount = 0;
 int segmentationRequestSent = 0;
 
 /**
- * @brief Internal function used by nav node to perform semantic segmentation dot product.
- * @details Internal function used by nav node to perform semantic segmentation dot product.
- * 	    Currently, this function splits the seg data in half and only performs the dot 
- * 	    product with the lower half of the image. The idea is that anything above the 
- * 	    horizon isn't going to give us meaningful navigation information. This will
- * 	    likely, and probably should, account for the whole image at some point.
- * @param mask The semantic segmentation array.
- * @param filter The semantic segmentation filter produced with #FilterGen.h.
+ * @brief Ages of the masks, poses and gyro samples nav drives on, see Watchdog.h.
 **/
-FILTER_TYPE ApplyFilter(uint8_t * mask, FILTER_TYPE * filter)
+Watchdog watchdog;
+
+/**
+ * @brief UTC time of the newest #PositionEstimate #watchdog has been fed.
+**/
+unsigned int watchdogFixTime;
+
+/**
+ * @brief Flips with every move forward while #watchdog slows the rover down, every other one is left out.
+**/
+int slowSkip = 0;
+
+/**
+ * @brief Picks how often masks are asked for, see Governor.h.
+**/
+Governor governor;
+
+/**
+ * @brief #ClockNowNs() the next mask may be asked for, from #governor.
+**/
+long long nextMaskRequest = 0;
+
+/**
+ * @brief A mask is to be asked for at #nextMaskRequest.
+**/
+int maskRequestPending = 0;
+
+/**
+ * @brief Archive of the masks and poses, see Telemetry.h.
+**/
+TelemetryWriter telemetry;
+
+/**
+ * @brief Columns of the #maskStream, a row for each mask.
+**/
+TelemetryColumn maskColumns[] = {
+	{ "left", TelemetryFloat },		// the new value of each filter
+	{ "center", TelemetryFloat },
+	{ "right", TelemetryFloat },
+	{ "state", TelemetryInt },		// #currentState after the mask
+	{ "command", TelemetryInt },		// sent to the CAN node, #NO_VALUE for none
+	{ "count", TelemetryInt },		// times it was sent
+	{ "nearest", TelemetryFloat },		// meters to the nearest obstacle, negative for none
+	{ "rate", TelemetryFloat },		// masks/sec the governor asked for
+	{ "maskNs", TelemetryInt },		// #MoveRover() took
+	{ "confidence", TelemetryFloat },	// average of the lower half, 0-255, see SegArgmax.h
+	{ "lowConfidence", TelemetryFloat }	// fraction of the lower half below #SEG_ARGMAX_LOW
+};
+
+/**
+ * @brief Columns of the #poseStream, a row for each new #PositionEstimate.
+**/
+TelemetryColumn poseColumns[] = {
+	{ "latitude", TelemetryFloat },
+	{ "longitude", TelemetryFloat },
+	{ "accuracy", TelemetryFloat },
+	{ "hdop", TelemetryFloat },
+	{ "satellites", TelemetryInt },
+	{ "fixQuality", TelemetryInt },		// GGA, 2 differential
+	{ "correctionAge", TelemetryFloat }	// seconds, -1 if not differential
+};
+
+/**
+ * @brief #telemetry stream of the masks.
+**/
+int maskStream;
+
+/**
+ * @brief #telemetry stream of the poses.
+**/
+int poseStream;
+
+/**
+ * @brief #SharedMem for the mask rate, created by this node.
+**/
+SharedMem * sharedGovernor;
+
+/**
+ * @brief Mask rate published for the other nodes, the data area of #sharedGovernor.
+**/
+GovernorShared * governorShared;
+
+/**
+ * @brief The left, center and right filters of #MoveRover(), see Profile.h.
+**/
+ProfileRegion filterProfile = { .name = "filters" };
+
+/**
+ * @brief Everything nav does with a mask, #MoveRover().
+**/
+ProfileRegion maskProfile = { .name = "mask" };
+
+/**
+ * @brief Shared memory holding #checkpoint.
+**/
+SharedMem * sharedCheckpoint;
+
+/**
+ * @brief Copy of the nav state that outlives the process, see NavCheckpoint.h.
+**/
+NavCheckpoint * checkpoint;
+
+/**
+ * @brief Applies the newest #ParameterSnapshot, if it is newer than the one in use.
+ * @details The snapshot is copied into #parameters in one go between messages, and the moving
+ *	    averages are restarted with the new value counts.
+ * @return 1 if new parameters were applied, 0 if there are none, -1 if none have been published.
+**/
+int ApplyParameters()
+{
+	ParameterSnapshot snapshot;
+
+	if (GetParameterSnapshot(parameterStore, &snapshot) < 0) {
+		return -1;
+	}
+
+	if (snapshot.version == parametersVersion) {
+		return 0;
+	}
+
+	memcpy(&parameters, &snapshot.values, sizeof(Parameters));
+	parametersVersion = snapshot.version;
+
+	// print to screen for verification of new values
+	printf("PARAMETERS VERSION %u\n", parametersVersion);
+	PrintParameters(&parameters);
+
+	// set new values for previous values structs
+	SetMaxCount(&centerValues, parameters.centerDotProductValueCount);
+	SetMaxCount(&leftValues, parameters.sideDotProductValueCount);
+	SetMaxCount(&rightValues, parameters.sideDotProductValueCount);
+	ClearValues(&centerValues);
+	ClearValues(&leftValues);
+	ClearValues(&rightValues);
+
+	MaskCleanSetSizes(&maskClean, parameters.maskOpenSize, parameters.maskCloseSize);
+	ObstacleSetMinArea(&obstacleFinder, parameters.obstacleMinArea);
+
+	// without GPS there are no poses to wait for
+	WatchdogSetDeadlines(&watchdog, parameters.watchdogMaskMs, (parameters.usingGps)?(parameters.watchdogPoseMs):(0),
+			     parameters.watchdogGyroMs);
+
+	GovernorSetLimits(&governor, parameters.governorMinHz, parameters.governorMaxHz, parameters.governorMetersPerMask,
+			  parameters.governorSpeed, parameters.governorThrottleC, parameters.governorCriticalC,
+			  parameters.motorMoveMs);
+
+	return 1;
+}
+
+/**
+ * @brief Internal function that gathers what #checkpoint keeps.
+**/
+void GetNavState(NavState * state, OpMode opMode)
 {
-	int index;
-	// zero out accumulator
-	FILTER_TYPE dotProduct = 0;
-	// cut the image in half
-	uint8_t * half_mask = &mask[(imageWidth*imageHeight)/2];
+	memset(state, 0, sizeof(NavState));
+
+	state->imageWidth = imageWidth;
+	state->imageHeight = imageHeight;
+	state->trueTurningAngle = trueTurningAngle;
+	memcpy(state->turningTable, TurningLookupTable, sizeof(TurningLookupTable));
+	state->turningTableCount = TurningLookupTableCount;
+	state->opMode = opMode;
+	state->state = currentState;
+	state->atDestination = atDestination;
+	state->compassTurnNeeded = compassTurnNeeded;
+	state->maskRequested = segmentationRequestSent;
+	COPY_POS(state->current, currentPosition);
+	COPY_POS(state->previous, previousPosition);
+	COPY_POS(state->destination, destinationPosition);
+	memcpy(&state->left, &leftValues, sizeof(PreviousValues));
+	memcpy(&state->center, &centerValues, sizeof(PreviousValues));
+	memcpy(&state->right, &rightValues, sizeof(PreviousValues));
+}
 
-	// perform the dot product
-	for (index = 0; index < ((imageWidth*imageHeight)/2); index++) {
-		dotProduct += half_mask[index]*filter[index];
+/**
+ * @brief Internal function that puts a restored #NavState back, after #ApplyParameters().
+**/
+void SetNavState(NavState * state, OpMode * opMode)
+{
+	trueTurningAngle = state->trueTurningAngle;
+	memcpy(TurningLookupTable, state->turningTable, sizeof(TurningLookupTable));
+	TurningLookupTableCount = state->turningTableCount;
+	*opMode = (OpMode)state->opMode;
+	currentState = (NavigationStates)state->state;
+	atDestination = state->atDestination;
+	compassTurnNeeded = state->compassTurnNeeded;
+	segmentationRequestSent = state->maskRequested;
+	COPY_POS(currentPosition, state->current);
+	COPY_POS(previousPosition, state->previous);
+	COPY_POS(destinationPosition, state->destination);
+
+	// the averages only if the parameters still take as many values
+	if (state->left.maxCount == leftValues.maxCount) {
+		memcpy(&leftValues, &state->left, sizeof(PreviousValues));
+	}
+	if (state->center.maxCount == centerValues.maxCount) {
+		memcpy(&centerValues, &state->center, sizeof(PreviousValues));
+	}
+	if (state->right.maxCount == rightValues.maxCount) {
+		memcpy(&rightValues, &state->right, sizeof(PreviousValues));
 	}
+}
+
+/**
+ * @brief Internal function that saves what has changed to #checkpoint.
+**/
+void SaveCheckpoint(OpMode opMode)
+{
+	NavState state;
 
-	return dotProduct;
+	GetNavState(&state, opMode);
+	NavCheckpointSave(checkpoint, &state, ClockNowNs());
 }
 
 /**
@@ -280,38 +593,156 @@ int GetTurnCount(double angle)
 	return (i + 1);
 }
 
+/**
+ * @brief Internal function that tells #governor what the rover is doing.
+**/
+GovernorMotion GetMotion()
+{
+	if (atDestination || Stopped == currentState || watchdog.level >= WatchdogStop) {
+		return GovernorStill;
+	}
+
+	return (MovingForward == currentState)?(GovernorForward):(GovernorTurning);
+}
+
 /**
  * @brief Sends request to tx2_cam_node.cpp for more semantic segmentation data.
+ * @details The request waits until #nextMaskRequest if #governor wants the masks further apart,
+ *	    the main loop sends it then.
  * @param masterWrite The fd for the masterWrite pipe.
 **/
 void RequestSemSegData(int masterWrite)
 {
 	Message message;
+	long long now = ClockNowNs();
+	float nearest;
+
+	// not due yet, the camera is not late until its deadline after then
+	if (now < nextMaskRequest) {
+		maskRequestPending = 1;
+		WatchdogFeed(&watchdog, WatchdogMask, nextMaskRequest);
+		return;
+	}
 
+	maskRequestPending = 0;
 	segmentationRequestSent = 1;
 
+	// the camera has until the deadline from now
+	WatchdogFeed(&watchdog, WatchdogMask, now);
+
+	// the obstacles are nearest first
+	nearest = (obstacleList.count > 0)?(obstacleList.obstacles[0].distance):(-1.0);
+	nextMaskRequest = now + GovernorUpdate(&governor, GetMotion(), nearest, now);
+	PublishGovernor(governorShared, &governor.state);
+
 	// notify cam module that we are ready for data
 	memset(&message, 0, sizeof(message));
 	message.messageType = SharedMemory;
 	message.source = TX2Nav;
 	message.destination = TX2Cam;
-	write(masterWrite, &message, sizeof(message));
+	SendMessage(masterWrite, &message);
 }
 
 /**
- * @brief Sends request to tx2_gyro_node.cpp for turning data.
+ * @brief Flushes the motor controller queue, stopping the rover.
+ * @details Only a motor controller that knows #STOP (motorStop in Parameters.txt) is sent one.
+ *	    Any other command queues a direction, so otherwise nothing is sent and the rover
+ *	    stops once the moves already queued have run out, nav sends no more while stopped.
  * @param masterWrite The fd for the masterWrite pipe.
 **/
-void RequestGyroData(int masterWrite)
+void StopRover(int masterWrite)
 {
 	Message message;
 
-	// notify gyro module we are ready for data
-	memset(&message, 0, sizeof(message));
-	message.messageType = GyroMessage;
-	message.source =TX2Nav;
-	message.destination = TX2Gyro;
-	write(masterWrite, &message, sizeof(message));
+	if (!parameters.motorStop) {
+		return;
+	}
+
+	memset(&message, 0, sizeof(Message));
+	message.messageType = CANMessage;
+	message.destination = TX2Can;
+	message.source = TX2Nav;
+	message.canMsg.SId = 0x123;
+	message.canMsg.Bytes = 1;
+	message.canMsg.writeCount = 1;
+
+	// the flush bit itself, #FLUSH does not survive SET_CMD()
+	message.canMsg.Message[0] = SET_CMD(1, STOP, STOP_NO_DIRECTION);
+	SendMessage(masterWrite, &message);
+}
+
+/**
+ * @brief Feeds #watchdog the newest pose and gyro sample and degrades the rover if anything is late.
+ * @details Called every time nav wakes up, see Watchdog.h. The rover is stopped when it gets
+ *	    to #WatchdogStop and also handed over to manual control at #WatchdogHandOver.
+ *	    MoveRover() does the slowing down.
+ * @param masterWrite The fd for the masterWrite pipe.
+ * @param opMode The operating mode, set to #Manual on a hand over.
+**/
+void CheckWatchdog(int masterWrite, OpMode * opMode)
+{
+	HeadingSample sample;
+	WatchdogLevel previous = watchdog.level;
+	WatchdogLevel level;
+	long long now = ClockNowNs();
+	double values[7];
+
+	// gyro samples are stamped, a new position estimate is stamped when it is first seen
+	if (0 == GetLatestHeading(heading, &sample)) {
+		WatchdogFeed(&watchdog, WatchdogGyro, sample.time);
+	}
+	if (parameters.usingGps) {
+		GET_SHARED_ESTIMATE(sharedPosition, positionEstimate);
+		if (positionEstimate.time != watchdogFixTime) {
+			watchdogFixTime = positionEstimate.time;
+			WatchdogFeed(&watchdog, WatchdogPose, now);
+			GovernorFeedPosition(&governor, positionEstimate.position, positionEstimate.accuracy, now);
+			values[0] = positionEstimate.position.latitude;
+			values[1] = positionEstimate.position.longitude;
+			values[2] = positionEstimate.accuracy;
+			values[3] = positionEstimate.hdop;
+			values[4] = positionEstimate.satellites;
+			values[5] = positionEstimate.fixQuality;
+			values[6] = positionEstimate.correctionAge;
+			TelemetryRecord(&telemetry, poseStream, now, values);
+		}
+	}
+
+	if (Manual == *opMode) {
+		WatchdogSetMode(&watchdog, WatchdogManual);
+	} else if (atDestination || (parameters.usingGps && (!NOT_GULF_OF_GUINEA(currentPosition) ||
+						       !NOT_GULF_OF_GUINEA(destinationPosition)))) {
+		WatchdogSetMode(&watchdog, WatchdogWaiting);
+	} else {
+		WatchdogSetMode(&watchdog, WatchdogDriving);
+	}
+
+	level = WatchdogCheck(&watchdog, now);
+	if (level == previous) {
+		return;
+	}
+
+	switch (level) {
+		case WatchdogOk:
+			printf("WATCHDOG: BACK TO NORMAL\n");
+			break;
+		case WatchdogSlow:
+			printf("WATCHDOG: SLOWING DOWN\n");
+			break;
+		case WatchdogStop:
+			if (previous < WatchdogStop) {
+				printf("WATCHDOG: STOPPING\n");
+				StopRover(masterWrite);
+			}
+			break;
+		case WatchdogHandOver:
+			printf("WATCHDOG: STOPPING, SWITCHING TO MANUAL\n");
+			StopRover(masterWrite);
+			*opMode = Manual;
+			WatchdogSetMode(&watchdog, WatchdogManual);
+			watchdog.level = WatchdogOk;
+			break;
+	}
 }
 
 /**
@@ -373,11 +804,18 @@ void MoveRover(uint8_t * mask, int masterWrite)
 	double absTurn;
 	double adjustedWeight;
 	double angleTurned;
+	double walkwayTurn;
+	float turnAngle;
+	long long turnStart;
+	OrientationSample attitude;
 	int canIMove;
 	unsigned int multiTurnAttempts;
 	int i;
 
 	int directionCount;
+	double values[11];
+	float lowConfidence;
+	FILTER_TYPE dots[MASK_KERNEL_FILTERS];
 
 	// we only send messages, if at all, to the CAN node
 	// prep for this
@@ -397,15 +835,49 @@ void MoveRover(uint8_t * mask, int masterWrite)
 
 	FILTER_TYPE centerAverage, leftAverage, rightAverage;
 
+	// how sure the network was of the half the filters use, the confidence follows the mask
+	values[9] = SegConfidenceSummary(mask + (imageWidth * imageHeight) + maskKernels.offset, maskKernels.length,
+					 &lowConfidence);
+	values[10] = lowConfidence;
+
+	// clean up speckles in the half of the mask the filters use
+	mask = MaskCleanApply(&maskClean, mask, imageHeight / 2);
+
+	// the obstacles in the same half, for the other nodes
+	ObstacleFind(&obstacleFinder, mask, imageHeight / 2, ClockNowNs(), &obstacleList);
+	PublishObstacles(obstacles, &obstacleList);
+
+	// and where the walkway is
+	WalkwayFit(&walkway, mask, imageHeight / 2, obstacleList.time, &walkwayEstimate);
+	PublishWalkway(walkwayShared, &walkwayEstimate);
+
 	//  apply dot product and enter new value into values arrays	
-	EnterNewValue(&centerValues, (ApplyFilter(mask, centerFilter) / centerFilterArea));
-	EnterNewValue(&leftValues, (ApplyFilter(mask, leftFilter) / leftFilterArea));
-	EnterNewValue(&rightValues, (ApplyFilter(mask, rightFilter) / rightFilterArea));
+	PROFILE_BEGIN(&filterProfile);
+	MaskKernelApply(&maskKernels, mask, dots);
+	values[0] = dots[0] / leftFilterArea;
+	values[1] = dots[1] / centerFilterArea;
+	values[2] = dots[2] / rightFilterArea;
+	EnterNewValue(&centerValues, values[1]);
+	EnterNewValue(&leftValues, values[0]);
+	EnterNewValue(&rightValues, values[2]);
+	PROFILE_END(&filterProfile);
 
 	// are we using gps?
 	if (parameters.usingGps) {
 		// get the most up to date position form the gps node
-		GET_SHARED_POSITION(sharedPosition, currentPosition);
+		GET_SHARED_ESTIMATE(sharedPosition, positionEstimate);
+		COPY_POS(currentPosition, positionEstimate.position);
+
+		// after a dropout the course since previousPosition is meaningless
+		if (positionEstimate.time != lastFixTime) {
+			if (lastFixReceived && HeadingNowNs() - lastFixReceived > GPS_DROPOUT_NS) {
+				printf("GPS BACK AFTER DROPOUT\n");
+				COPY_POS(previousPosition, currentPosition);
+				compassTurnNeeded = 1;
+			}
+			lastFixTime = positionEstimate.time;
+			lastFixReceived = HeadingNowNs();
+		}
 
 		// if we need to initialize previousDestination, do that now
 		if (!NOT_GULF_OF_GUINEA(previousPosition)) {
@@ -444,12 +916,19 @@ void MoveRover(uint8_t * mask, int masterWrite)
 		// if we are using GPS and have traveled far enough, calculate a new turning angle to point
 		// us in the right direction to reach destination
 		if (parameters.usingGps && distanceFromPrevious > parameters.distanceFromPreviousThreshold){
-			printf("DISTANCE FROM PREVIOUS %.4f\n", distanceFromPrevious);
+			printf("DISTANCE FROM PREVIOUS %.4f (+/- %.2f)\n", distanceFromPrevious, positionEstimate.accuracy);
 			// calculate new turning angle
 			turn = DegreeTurnAndDirection(currentPosition, 
 						      previousPosition, 
 						      destinationPosition);
 			printf("\n\n\nGNSS TURN ANGLE = %.4f\n\n\n", turn);
+			compassTurnNeeded = 0;
+		} else if (parameters.usingGps && compassTurnNeeded &&
+			   0 == GetOrientation(orientation, &attitude) && attitude.magValid) {
+			// no course yet, point at the destination with the compass
+			turn = HeadingTurn(attitude.heading, Bearing(currentPosition, destinationPosition));
+			printf("\n\n\nCOMPASS TURN ANGLE = %.4f (heading %.1f)\n\n\n", turn, attitude.heading);
+			compassTurnNeeded = 0;
 		}
 
 		// get the absolute value
@@ -477,6 +956,14 @@ void MoveRover(uint8_t * mask, int masterWrite)
 			rightAverage *= (1 + (1 - parameters.turningWeight));
 			leftAverage *= (1 + (1 - parameters.turningWeight));
 			directionCount = 1;
+
+			// unless the middle of the walkway is further off than a turn, then pull that side down
+			walkwayTurn = WalkwayTurn(&walkwayEstimate, parameters.walkwayLookahead);
+			if (IS_LEFT_TURN(walkwayTurn) && -walkwayTurn > trueTurningAngle) {
+				leftAverage *= parameters.turningWeight;
+			} else if (IS_RIGHT_TURN(walkwayTurn) && walkwayTurn > trueTurningAngle) {
+				rightAverage *= parameters.turningWeight;
+			}
 		}
 
 		// this switch statement determines how the rover is going to move. Essentially, the lower a value is
@@ -539,6 +1026,17 @@ void MoveRover(uint8_t * mask, int masterWrite)
 				break;
 		}
 
+		// held back by the watchdog: nothing while stopped, one step at a time and every other
+		// move forward while slowed down
+		if (watchdog.level >= WatchdogStop) {
+			DIRECTION_MESSAGE(NO_FLUSH, message, NO_VALUE);
+		} else if (WatchdogSlow == watchdog.level) {
+			directionCount = 1;
+			if (DIRECTION_MESSAGE_EQUALS(message, MOVE_FORWARD) && (slowSkip = !slowSkip)) {
+				DIRECTION_MESSAGE(NO_FLUSH, message, NO_VALUE);
+			}
+		}
+
 		// if we have turned, we need to clear old values and save currentPosition as previousPosition for
 		// turning to work properly
 		if (DIRECTION_MESSAGE_EQUALS(message, MOVE_LEFT) || DIRECTION_MESSAGE_EQUALS(message, MOVE_RIGHT)) {
@@ -548,16 +1046,16 @@ void MoveRover(uint8_t * mask, int masterWrite)
 			COPY_POS(previousPosition, currentPosition);
 		}
 
-		// just a single move command, write it to master
+		// just a single move command, write it to master. Forward as far as the governor's
+		// rate wants driven per mask, the motor controller flushes it on the next turn.
 		if (!DIRECTION_MESSAGE_EQUALS(message, NO_VALUE) && directionCount == 1) {
-			message.canMsg.writeCount = 1;
-			write(masterWrite, &message, sizeof(message));
+			message.canMsg.writeCount = (DIRECTION_MESSAGE_EQUALS(message, MOVE_FORWARD) && WatchdogOk == watchdog.level)?
+						    (GovernorForwardCount(&governor)):(1);
+			SendMessage(masterWrite, &message);
 		} else if (DIRECTION_MESSAGE_EQUALS(message, MOVE_LEFT) || DIRECTION_MESSAGE_EQUALS(message, MOVE_RIGHT)) {
 			multiTurnAttempts = 0;
 			// keep trying to get to the angle we need to get to
 			do {
-				// request the gyro node wake up and start recording
-				RequestGyroData(masterWrite);
 				// this should already be set first time through, but for 
 				// multiturn will potentially need to be set
 				if (turn > trueTurningAngle || turn < -trueTurningAngle) {
@@ -568,9 +1066,6 @@ void MoveRover(uint8_t * mask, int masterWrite)
 					}
 				}
 
-				// this is just to clear the data available flag
-				sharedAngle->dataAvailableFlag = 0;
-
 				// print what we want to turn
 				printf("turning %f\n", turn);
 
@@ -586,10 +1081,12 @@ void MoveRover(uint8_t * mask, int masterWrite)
 				// send turn command to CAN node
 				printf("directionCount %d\n", directionCount);
 				message.canMsg.writeCount = directionCount;
-				write(masterWrite, &message, sizeof(message));
+				turnStart = HeadingNowNs();
+				SendMessage(masterWrite, &message);
 
-				// get the shared memory angle reading from gyro node
-				GET_SHARED_ANGLE(sharedAngle, angleTurned);
+				// measure the turn from the heading the gyro node publishes
+				MeasureTurn(heading, turnStart, &turnAngle);
+				angleTurned = turnAngle;
 				printf("after multiturn I turned %f\n", angleTurned);
 
 				// add angle turned to turn. The gyro turning convention is opposite of
@@ -609,6 +1106,15 @@ void MoveRover(uint8_t * mask, int masterWrite)
 		}
 	}
 	
+	// what was made of the mask, nothing sent has a count of 0
+	values[3] = currentState;
+	values[4] = message.canMsg.Message[0];
+	values[5] = message.canMsg.writeCount;
+	values[6] = (obstacleList.count > 0)?(obstacleList.obstacles[0].distance):(-1.0);
+	values[7] = governor.state.rate;
+	values[8] = ClockNowNs() - obstacleList.time;
+	TelemetryRecord(&telemetry, maskStream, obstacleList.time, values);
+
 	if (!atDestination) {
 		// only request new seg data if we are current navigating
 		RequestSemSegData(masterWrite);
@@ -621,7 +1127,7 @@ void MoveRover(uint8_t * mask, int masterWrite)
 		printf("\n\n!!!AT DESTINATION!!!\n");
 		printf("REQUESTING NEW COMMAND\n\n");
 
-		write(masterWrite, &message, sizeof(message));
+		SendMessage(masterWrite, &message);
 	} 
 }
 
@@ -639,6 +1145,8 @@ void CalibrateTurning(int masterWrite)
 	double singleRight;
 	double multiRight;
 	double singleLeft;
+	float turnAngle;
+	long long turnStart;
 	double multiLeft;
 	int turncount;
 	int i;
@@ -663,20 +1171,17 @@ void CalibrateTurning(int masterWrite)
 
 	// loop through array
 	for (i = 1; i < 11; i++ ){
-		// wake gyro up
-		RequestGyroData(masterWrite);
-		// this is just to clear the data available flag
-		sharedAngle->dataAvailableFlag = 0;
-
 		// set turn count
 		message.canMsg.writeCount = i;
 
 		// execute turn
-		write(masterWrite, &message, sizeof(message));	
+		turnStart = HeadingNowNs();
+		SendMessage(masterWrite, &message);	
 
 		printf("\n\nSENDING TURN COMMAND\n\n");
 		// get single right turn angle
-		GET_SHARED_ANGLE(sharedAngle, singleLeft);	
+		MeasureTurn(heading, turnStart, &turnAngle);
+		singleLeft = turnAngle;
 
 		printf("%d turn = %f\n", i, singleLeft);
 
@@ -709,7 +1214,7 @@ void CalibrateTurning(int masterWrite)
 	message.destination = TX2Gps;
 
 	// notify gps node that calibration is complete
-	write(masterWrite, &message, sizeof(message));
+	SendMessage(masterWrite, &message);
 
 	printf("calibration complete\n");
 }
@@ -736,7 +1241,18 @@ int main(int argc, char ** argv)
 	int receivedSegMem = 0;
 	int receivedAngMem = 0;
 	int receivedPosMem = 0;
+	int staleMask = 0;
 	double tempAngle; //for testing
+	FILTER_TYPE * filters[MASK_KERNEL_FILTERS];
+	MaskCleanStats cleanStats;
+	ObstacleStats obstacleStats;
+	WalkwayStats walkwayStats;
+	WatchdogStats watchdogStats;
+	GovernorStats governorStats;
+	NavCheckpointStats checkpointStats;
+	NavState navState;
+	int restored;
+	long long wake;
 
 	Message message;
 
@@ -751,6 +1267,10 @@ int main(int argc, char ** argv)
 
 	readFds[0] = masterRead;
 
+	// turn timing uses the same clock as the gyro node
+	HalInit(NULL);
+	ProfileInit("tx2_nav_node");
+
 	// initialize SetAndWait
 	SetupSetAndWait(readFds,1);
 
@@ -769,9 +1289,12 @@ int main(int argc, char ** argv)
 			}
 
 			// read message, should just be from master
-			read(readFds[i], &message, sizeof(message));
+			ReceiveMessage(readFds[i], &message);
 			
-			if (message.messageType == SharedMemory && message.source == TX2Cam) {
+			if (message.messageType == SharedMemory && message.source == TX2Cam && 0 == message.shMem.width) {
+				// a mask asked for by the nav node before this one
+				staleMask = 1;
+			} else if (message.messageType == SharedMemory && message.source == TX2Cam) {
 				// camera node shared memory ready
 				imageWidth = message.shMem.width;
 				imageHeight = message.shMem.height;
@@ -791,24 +1314,36 @@ int main(int argc, char ** argv)
 		}
 	} while(!receivedSegMem || !receivedAngMem || !receivedPosMem);
 
-	// open shared memory for semantic segmentation
-	sharedMem = OpenSharedMemory((imageWidth * imageHeight), SegmentationData);
+	// open shared memory for semantic segmentation, the mask and its confidence
+	sharedMem = OpenSharedMemory((imageWidth * imageHeight * SEG_ARGMAX_PLANES), SegmentationData);
 
 	if (NULL == sharedMem) {
 		printf("SEGMENTATION SHARED MEMORY ERROR IN NAV NODE\n");
 		pause();
 	}
 
-	// open shared memory for angle data
-	sharedAngle = OpenSharedMemory(sizeof(float), AngleData);
+	// open shared memory for heading data
+	sharedHeading = OpenSharedMemory(sizeof(HeadingShared), HeadingData);
 
-	if (NULL == sharedAngle) {
-		printf("ANGLE SHARED MEMORY ERROR IN NAV NODE\n");
+	if (NULL == sharedHeading) {
+		printf("HEADING SHARED MEMORY ERROR IN NAV NODE\n");
 		pause();
 	}
 
+	heading = (HeadingShared *)(sharedHeading + 1);
+
+	// open shared memory for orientation data
+	sharedOrientation = OpenSharedMemory(sizeof(OrientationShared), OrientationData);
+
+	if (NULL == sharedOrientation) {
+		printf("ORIENTATION SHARED MEMORY ERROR IN NAV NODE\n");
+		pause();
+	}
+
+	orientation = (OrientationShared *)(sharedOrientation + 1);
+
 	// open shared memory for position data
-	sharedPosition = OpenSharedMemory(sizeof(Position), PositionData);
+	sharedPosition = OpenSharedMemory(sizeof(PositionEstimate), PositionData);
 
 	if (NULL == sharedPosition) {
 		printf("POSITION SHARED MEMORY ERROR IN NAV NODE\n");
@@ -820,29 +1355,85 @@ int main(int argc, char ** argv)
 	// get the starting memory address of the semantic segmentation data 
         mask = (uint8_t *)(sharedMem + 1);
 
-	// open the parameters file
-	status = GetParameters(PARAMETERS_FILE, &parameters);
+	// the parameters are published by master before it starts the nodes
+	sharedParameters = OpenSharedMemory(sizeof(ParametersShared), ParameterData);
 
-	if (-1 == status) {
-		printf("ERROR OPENING PARAMETERS FILE\n");
+	if (NULL == sharedParameters) {
+		printf("PARAMETERS SHARED MEMORY ERROR IN NAV NODE\n");
 		return -1;
 	}
 
-	// print values to terminal
-	PrintParameters(&parameters);
+	parameterStore = (ParametersShared *)(sharedParameters + 1);
 
-	// set the value counts we store for moving averages
-	SetMaxCount(&centerValues, parameters.centerDotProductValueCount);
-	SetMaxCount(&leftValues, parameters.sideDotProductValueCount);
-	SetMaxCount(&rightValues, parameters.sideDotProductValueCount);
+	// the mask cleanup takes its kernel sizes from the parameters
+	if (MaskCleanInit(&maskClean, imageWidth, imageHeight) < 0) {
+		return -1;
+	}
 
-	// initialize by clearing
-	ClearValues(&centerValues);
-	ClearValues(&leftValues);
-	ClearValues(&rightValues);
+	// so does the obstacle size, the distances come from the ground calibration
+	if (ObstacleFinderInit(&obstacleFinder, imageWidth, imageHeight, GROUND_CALIBRATION_FILE) < 0) {
+		return -1;
+	}
+
+	// obstacles are published next to the mask
+	sharedObstacles = CreateSharedMemory(sizeof(ObstacleShared), ObstacleData);
+
+	if (NULL == sharedObstacles) {
+		printf("OBSTACLE SHARED MEMORY ERROR IN NAV NODE\n");
+		return -1;
+	}
+
+	obstacles = (ObstacleShared *)(sharedObstacles + 1);
+	obstacles->sequence = 0;
+
+	// the walkway is put on the ground with the same distances
+	if (WalkwayInit(&walkway, imageWidth, imageHeight, obstacleFinder.rowDistance, obstacleFinder.focal) < 0) {
+		return -1;
+	}
+
+	sharedWalkway = CreateSharedMemory(sizeof(WalkwayShared), WalkwayData);
+
+	if (NULL == sharedWalkway) {
+		printf("WALKWAY SHARED MEMORY ERROR IN NAV NODE\n");
+		return -1;
+	}
+
+	walkwayShared = (WalkwayShared *)(sharedWalkway + 1);
+	walkwayShared->sequence = 0;
+
+	// the parameters set the deadlines
+	WatchdogInit(&watchdog, ClockNowNs());
+
+	// and the mask rates, the temperatures are the SoC's
+	status = GovernorInit(&governor, ClockNowNs());
+	printf("GOVERNOR: %d THERMAL ZONES\n", status);
+
+	sharedGovernor = CreateSharedMemory(sizeof(GovernorShared), GovernorData);
+
+	if (NULL == sharedGovernor) {
+		printf("GOVERNOR SHARED MEMORY ERROR IN NAV NODE\n");
+		return -1;
+	}
+
+	governorShared = (GovernorShared *)(sharedGovernor + 1);
+	governorShared->sequence = 0;
+
+	// a restarted nav starts an archive of its own
+	TelemetryOpen(&telemetry, "tx2_nav_node", ClockNowNs());
+	maskStream = TelemetryAddStream(&telemetry, "masks", maskColumns, sizeof(maskColumns) / sizeof(TelemetryColumn));
+	poseStream = TelemetryAddStream(&telemetry, "poses", poseColumns, sizeof(poseColumns) / sizeof(TelemetryColumn));
+
+	// copy the parameters and set the value counts we store for moving averages
+	status = ApplyParameters();
+
+	if (status < 0) {
+		printf("NO PARAMETERS PUBLISHED\n");
+		return -1;
+	}
 
 	// set initial positions to gulf of guinea
 	memset(&currentPosition, 0, sizeof(Position));
+	memset(&positionEstimate, 0, sizeof(PositionEstimate));
 	memset(&previousPosition, 0, sizeof(Position));
 	memset(&destinationPosition, 0, sizeof(Position));
 
@@ -851,6 +1442,17 @@ int main(int argc, char ** argv)
 	rightFilterArea = CreateRightFilter(&rightFilter, (imageWidth/2), (imageHeight/2), imageWidth, (imageHeight/2));
 	centerFilterArea = CreateCenterFilter(&centerFilter, (int)((double)imageWidth*(0.75f))/2, (int)((double)imageWidth*(0.75f)), (imageHeight/2), imageWidth, (imageHeight/2));	
 
+	// the fastest way to apply them on this board, timed on the first start
+	filters[0] = leftFilter;
+	filters[1] = centerFilter;
+	filters[2] = rightFilter;
+	if (MaskKernelInit(&maskKernels, imageWidth, imageHeight, filters) < 0) {
+		return -1;
+	}
+	MaskKernelTune(&maskKernels, MASK_KERNEL_CACHE_FILE, 0);
+	printf("MASK KERNEL %s, %s IN %.3f MS\n", MaskKernelName(maskKernels.kernel),
+		(maskKernels.stats.cached)?("CACHED"):("TUNED"), maskKernels.stats.tuneNs / 1000000.0);
+
 	currentState = Stopped;
 
 	// kill flag
@@ -861,13 +1463,43 @@ int main(int argc, char ** argv)
 	// put in manual or automatic
 	opMode = (parameters.manual)?(Manual):(Automatic);
 
+	// a nav restarted by master drives on from where the one before it was
+	sharedCheckpoint = CreateSharedMemory(sizeof(NavCheckpoint), CheckpointData);
+
+	if (NULL == sharedCheckpoint) {
+		printf("CHECKPOINT SHARED MEMORY ERROR IN NAV NODE\n");
+		return -1;
+	}
+
+	checkpoint = (NavCheckpoint *)(sharedCheckpoint + 1);
+	restored = (0 == NavCheckpointRestore(checkpoint, &navState) &&
+		    imageWidth == navState.imageWidth && imageHeight == navState.imageHeight);
+
+	if (restored) {
+		SetNavState(&navState, &opMode);
+		segmentationRequestSent = (staleMask)?(0):(segmentationRequestSent);
+		printf("\n\n\nRESTORED NAV CHECKPOINT, %.0f MS OLD, %d TURNS CALIBRATED\n\n\n",
+			(ClockNowNs() - checkpoint->time) / 1000000.0, TurningLookupTableCount);
+	} else {
+		GetNavState(&navState, opMode);
+		NavCheckpointReset(checkpoint, &navState, ClockNowNs());
+	}
+
 	// calibrate turning
 	//CalibrateTurning(masterWrite);
 
-	// request data if in automatic mode
+	// the simulated rover always has room to, and turning needs the table
+	if (CanSim == HalGetConfig()->can && 0 == TurningLookupTableCount) {
+		CalibrateTurning(masterWrite);
+		SaveCheckpoint(opMode);
+	}
+
+	// request data if in automatic mode, unless the nav node before this one is still waiting for it
 	if (Automatic == opMode) {
 		printf("\n\n\nSTARTING IN AUTOMATIC MODE\n\n\n");
-		RequestSemSegData(masterWrite);
+		if (!segmentationRequestSent) {
+			RequestSemSegData(masterWrite);
+		}
 	} else {
 		printf("\n\n\nSTARTING IN MANUAL MODE\n\n\n");
 	}
@@ -875,11 +1507,30 @@ int main(int argc, char ** argv)
 	//  main while loop
 	while(!killMessageReceived)
 	{
-		// wait for message from master
-		if (SetAndWait(&rdfs, 1, 0) < 0) {
+		// wait for message from master, no longer than until the watchdog has to look again
+		// or the next mask is due
+		wake = WatchdogNextCheck(&watchdog, ClockNowNs());
+		if (maskRequestPending && nextMaskRequest < wake) {
+			wake = nextMaskRequest;
+		}
+		if (wake > ClockNowNs() + CLOCK_SECOND) {
+			wake = ClockNowNs() + CLOCK_SECOND;
+		}
+		if (SetAndWaitUntil(&rdfs, wake) < 0) {
 			printf("SET AND WAIT ERROR 2 status = %d\n", status);
 		}
 
+		// see if anything nav drives on is late
+		CheckWatchdog(masterWrite, &opMode);
+
+		// the mask the governor held back, still only while driving
+		if (maskRequestPending && ClockNowNs() >= nextMaskRequest) {
+			maskRequestPending = 0;
+			if (Automatic == opMode && !atDestination && !segmentationRequestSent) {
+				RequestSemSegData(masterWrite);
+			}
+		}
+
 		// check to see if new data available from master
 		for (i = 0; i < 1; i++) {
 			if (!FD_ISSET(readFds[i], &rdfs)) {
@@ -887,13 +1538,18 @@ int main(int argc, char ** argv)
 			}
 
 			// read message
-			read(readFds[i], &message, sizeof(message));
+			ReceiveMessage(readFds[i], &message);
 
 			// new semantic segmentation data is available
 			if (message.source == TX2Cam && opMode == Automatic && message.messageType == SharedMemory) {
 				//printf("\n\nNEW SEG DAT\n\n");
 				segmentationRequestSent = 0;
+				WatchdogFeed(&watchdog, WatchdogMask, ClockNowNs());
+				// a nav node restarted halfway through the move asks for a mask again
+				SaveCheckpoint(opMode);
+				PROFILE_BEGIN(&maskProfile);
 				MoveRover(mask, masterWrite);
+				PROFILE_END(&maskProfile);
 			} else if (message.messageType == OperationMode) {
 				// switch operating modes
 				switch(opMode) {
@@ -910,6 +1566,7 @@ int main(int argc, char ** argv)
 							printf("switching to automatic\n");
 							opMode = Automatic;
 							COPY_POS(previousPosition, currentPosition);
+							compassTurnNeeded = 1;
 							RequestSemSegData(masterWrite);
 						}
 						break;
@@ -922,7 +1579,7 @@ int main(int argc, char ** argv)
 					message.source = TX2Nav;
 					message.destination = TX2Can;
 					message.canMsg.writeCount = 1;
-					write(masterWrite, &message, sizeof(message));
+					SendMessage(masterWrite, &message);
 				} else {
 					// we are in automatic mode, don't do anything with message
 					printf("attempting manual control when rover is in automatic mode\n");
@@ -930,6 +1587,7 @@ int main(int argc, char ** argv)
 			} else if (message.messageType == PositionMessage && (message.source == TX2Comm || message.source == TX2Master)) {
 				printf("setting destination position\n");
 				COPY_POS(destinationPosition, message.positionMsg.position);
+				compassTurnNeeded = 1;
 				//memset(&currentPosition, 0, sizeof(Position));
 				//COPY_POS(previousPosition, currentPosition);
 				atDestination = 0;
@@ -937,22 +1595,8 @@ int main(int argc, char ** argv)
 					RequestSemSegData(masterWrite);
 				}
 			} else if (message.messageType == ParametersMessage) {
-				printf("READING NEW PARAMETERS\n");
-				// we received command to re populate parameters struct
-				status = GetParameters(PARAMETERS_FILE, &parameters);
-				if (-1 == status) {
-					printf("ERROR OPENING PARAMETERS FILE\n");
-					return -1;
-				}
-				// print to screen for verification of new values
-				PrintParameters(&parameters);
-				// set new values for previous values structs
-				SetMaxCount(&centerValues, parameters.centerDotProductValueCount);
-				SetMaxCount(&leftValues, parameters.sideDotProductValueCount);
-				SetMaxCount(&rightValues, parameters.sideDotProductValueCount);
-				ClearValues(&centerValues);
-				ClearValues(&leftValues);
-				ClearValues(&rightValues);
+				// master has published new parameters
+				ApplyParameters();
 			}
 			else if (message.messageType == KillMessage) {
 				// we received a kill message
@@ -962,8 +1606,44 @@ int main(int argc, char ** argv)
 				close(masterWrite);
 			}
 		}
+
+		// the checkpoint is left behind on the way out too, master removes it
+		SaveCheckpoint(opMode);
 	}
 
+#ifdef DEBUG
+	MaskCleanGetStats(&maskClean, &cleanStats);
+	printf("mask cleanup: %lu masks, avg %.3f ms max %.3f ms\n", cleanStats.masks,
+		(cleanStats.masks)?((cleanStats.cleanNs / 1000000.0) / cleanStats.masks):(0.0), cleanStats.maxNs / 1000000.0);
+	ObstacleGetStats(&obstacleFinder, &obstacleStats);
+	printf("obstacles: %lu masks, %lu runs, avg %.3f ms max %.3f ms\n", obstacleStats.masks, obstacleStats.runs,
+		(obstacleStats.masks)?((obstacleStats.findNs / 1000000.0) / obstacleStats.masks):(0.0), obstacleStats.maxNs / 1000000.0);
+	WatchdogGetStats(&watchdog, &watchdogStats);
+	printf("watchdog: %lu checks, missed mask %lu (worst %.0f ms) pose %lu (%.0f ms) gyro %lu (%.0f ms), slowed %lu stopped %lu handed over %lu\n",
+		watchdogStats.checks, watchdogStats.missed[WatchdogMask], watchdogStats.worstNs[WatchdogMask] / 1000000.0,
+		watchdogStats.missed[WatchdogPose], watchdogStats.worstNs[WatchdogPose] / 1000000.0,
+		watchdogStats.missed[WatchdogGyro], watchdogStats.worstNs[WatchdogGyro] / 1000000.0,
+		watchdogStats.degraded[WatchdogSlow], watchdogStats.degraded[WatchdogStop], watchdogStats.degraded[WatchdogHandOver]);
+	NavCheckpointGetStats(checkpoint, &checkpointStats);
+	printf("nav checkpoint: %lu saves, %lu written, %lu blocks of %d bytes, %lu restores\n", checkpointStats.saves,
+		checkpointStats.writes, checkpointStats.blocks, NAV_CHECKPOINT_BLOCK, checkpointStats.restores);
+	WalkwayGetStats(&walkway, &walkwayStats);
+	printf("walkway: %lu masks, %lu found, avg %.3f ms max %.3f ms\n", walkwayStats.masks, walkwayStats.valid,
+		(walkwayStats.masks)?((walkwayStats.fitNs / 1000000.0) / walkwayStats.masks):(0.0), walkwayStats.maxNs / 1000000.0);
+	GovernorGetStats(&governor, &governorStats);
+	printf("governor: %lu masks asked for, avg %.2f Hz, idle %lu speed %lu obstacle %lu turn %lu off %lu, throttled %lu (%lu events, max %.1f C)\n",
+		governorStats.updates, (governorStats.updates)?(governorStats.rateSum / governorStats.updates):(0.0),
+		governorStats.reasons[GovernorIdle], governorStats.reasons[GovernorSpeed], governorStats.reasons[GovernorObstacle],
+		governorStats.reasons[GovernorTurn], governorStats.reasons[GovernorOff], governorStats.throttled,
+		governorStats.throttleEvents, governorStats.maxTemperature);
+#endif
+	MaskCleanClose(&maskClean);
+	MaskKernelClose(&maskKernels);
+	WalkwayClose(&walkway);
+	GovernorClose(&governor);
+	TelemetryClose(&telemetry);
+	ObstacleFinderClose(&obstacleFinder);
+
 	printf("killing nav node\n");
 	return 0;
 }
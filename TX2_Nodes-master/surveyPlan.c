@@ -0,0 +1,98 @@
+/**
+ * @file surveyPlan.c
+ * @brief surveyPlan tool.
+ * @details The surveyPlan tool plans a survey file the way tx2_master.c does when a #Survey
+ * 	    command comes in (see Coverage.h) and prints how many lanes, cells, waypoints and
+ * 	    pictures it came to, how far the rover drives and how long the planning took, the
+ * 	    best of #SURVEY_PLAN_RUNS runs. The spacing and heading of the file can be given on
+ * 	    the command line, a small spacing over a big area shows how planning time grows with
+ * 	    the lanes. With -w every waypoint is printed too, meters and latitude/longitude, for a
+ * 	    look at the plan before it is sent.
+ * 	    <br>
+ * 	    <br>
+ * 	    Usage: ./surveyPlan survey [spacing heading] [-w]
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "include/Coverage.h"
+
+#define SURVEY_PLAN_RUNS 10		/**< Plans timed, the fastest is printed. */
+#define SURVEY_PLAN_WAYPOINTS 1000000	/**< Waypoints planned at most. */
+
+/**
+ * @brief Returns CLOCK_MONOTONIC in nanoseconds.
+**/
+long long NowNs()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((long long)now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
+
+int main(int argc, char ** argv)
+{
+	CoverageArea area;
+	CoverageStats stats;
+	CoverageWaypoint * waypoints;
+	double latitude, longitude;
+	long long start, best = -1;
+	int print = 0;
+	int count = 0;
+	int run, i;
+
+	if (argc > 1 && 0 == strcmp(argv[argc - 1], "-w")) {
+		print = 1;
+		argc--;
+	}
+
+	if (argc != 2 && argc != 4) {
+		printf("usage: ./surveyPlan survey [spacing heading] [-w]\n");
+		return -1;
+	}
+
+	if (CoverageReadArea(argv[1], &area) < 0) {
+		return -1;
+	}
+	if (argc > 3) {
+		area.spacing = atof(argv[2]);
+		area.heading = atof(argv[3]);
+	}
+	if (area.spacing <= 0.0) {
+		printf("spacing must be positive\n");
+		return -1;
+	}
+
+	waypoints = malloc(sizeof(CoverageWaypoint) * SURVEY_PLAN_WAYPOINTS);
+	if (NULL == waypoints) {
+		return -1;
+	}
+
+	for (run = 0; run < SURVEY_PLAN_RUNS; run++) {
+		start = NowNs();
+		count = CoveragePlan(&area, waypoints, SURVEY_PLAN_WAYPOINTS, &stats);
+		start = NowNs() - start;
+		if (count < 0) {
+			return -1;
+		}
+		best = (best < 0 || start < best)?(start):(best);
+	}
+
+	if (print) {
+		for (i = 0; i < count; i++) {
+			CoverageLatLon(&area, waypoints[i].x, waypoints[i].y, &latitude, &longitude);
+			printf("%8.2f %8.2f %.7f %.7f%s\n", waypoints[i].x, waypoints[i].y, latitude, longitude,
+			       (waypoints[i].photo)?(" photo"):(""));
+		}
+	}
+
+	printf("%s: spacing %g m heading %g, %d lanes, %d segments, %d cells, %d waypoints, %d photos, "
+	       "%.1f m driven, planned in %.3f ms\n", argv[1], area.spacing, area.heading, stats.lanes, stats.segments,
+	       stats.cells, stats.waypoints, stats.photos, stats.length, best / 1000000.0);
+
+	free(waypoints);
+
+	return 0;
+}
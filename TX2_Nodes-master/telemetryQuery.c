@@ -0,0 +1,455 @@
+/**
+ * @file telemetryQuery.c
+ * @brief telemetryQuery tool.
+ * @details The telemetryQuery tool reads the telemetry archives the nodes write (see
+ * 	    Telemetry.h). Given only an archive it prints its streams: the columns, rows,
+ * 	    chunks, the time they span and the bytes each column takes against 8 a value.
+ * 	    <br>
+ * 	    <br>
+ * 	    Given a stream it prints its rows as CSV, the time in seconds from when the archive
+ * 	    was started (-utc for seconds since 1970). -from and -to keep the rows of a time range,
+ * 	    -where the rows a column compares to a value with <, <=, >, >=, == or != (up to
+ * 	    #QUERY_MAX_WHERE, all have to hold), -columns the columns printed, -every n every nth
+ * 	    row left and -step ms no more than one row every ms. -count only counts the rows and
+ * 	    prints how long that took. The archive is mapped and only the chunks in the time range
+ * 	    are looked at, of those only the columns printed or compared are decoded.
+ * 	    <br>
+ * 	    <br>
+ * 	    -sync takes the archive of tx2_comm_node.c and prints the times on the controller's clock
+ * 	    instead, seconds since 1970 for logWriter.c: each row is moved by the clock offset the
+ * 	    controller had estimated at the time (see TimeSync.h), the newest before it and its drift.
+ * 	    Rows of the rover and of the controller can then be put side by side.
+ * 	    <br>
+ * 	    <br>
+ * 	    Usage: ./telemetryQuery archive [stream [-from s] [-to s] [-columns a,b] [-where column<value]
+ * 	    [-every n] [-step ms] [-utc] [-sync archive] [-count]]
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "include/Telemetry.h"
+#include "include/Clock.h"
+
+#define QUERY_MAX_WHERE 8		/**< Comparisons a row has to pass. */
+
+/**
+ * @brief A comparison of -where.
+**/
+typedef struct _QueryWhere {
+	int column;
+	char op[3];
+	double value;
+} QueryWhere;
+
+/**
+ * @brief The clock offsets of a "sync" stream, for -sync.
+**/
+typedef struct _QuerySync {
+	long long * times;		// rover clock
+	long long * offsets;		// rover minus controller clock, ns
+	double * drifts;		// ppm
+	long long count;
+} QuerySync;
+
+/**
+ * @brief Prints the streams of an archive.
+**/
+void PrintSummary(TelemetryReader * reader)
+{
+	TelemetryStreamInfo * info;
+	unsigned long long bytes[TELEMETRY_MAX_COLUMNS + 1];
+	unsigned long long total, raw;
+	unsigned long rows;
+	long long first, last;
+	long long chunk;
+	int chunks;
+	int stream, column;
+
+	printf("%s, %.1f MB, %lld chunks, index %s\n", reader->header.node, reader->size / 1000000.0,
+	       reader->indexCount, (reader->indexed)?("read"):("built, the archive was not closed"));
+
+	for (stream = 0; stream < reader->streamCount; stream++) {
+		info = &reader->streams[stream];
+		memset(bytes, 0, sizeof(bytes));
+		rows = 0;
+		chunks = 0;
+		first = last = 0;
+
+		for (chunk = 0; chunk < reader->indexCount; chunk++) {
+			if (reader->index[chunk].stream != info->id) {
+				continue;
+			}
+			first = (0 == chunks)?(reader->index[chunk].first):(first);
+			last = reader->index[chunk].last;
+			rows += reader->index[chunk].rows;
+			chunks++;
+			for (column = 0; column <= info->columnCount; column++) {
+				bytes[column] += TelemetryColumnBytes(reader, chunk, column);
+			}
+		}
+
+		total = 0;
+		for (column = 0; column <= info->columnCount; column++) {
+			total += bytes[column];
+		}
+		raw = (unsigned long long)rows * 8 * (info->columnCount + 1);
+
+		printf("\n%s: %lu rows, %d chunks, %.1f s to %.1f s, %llu bytes (%.1f%% of %llu)\n", info->name, rows, chunks,
+		       (first - reader->header.startNs) / 1e9, (last - reader->header.startNs) / 1e9, total,
+		       (raw)?(100.0 * total / raw):(0.0), raw);
+		printf("  %-16s %-6s %.2f bytes/row\n", "time", "int", (rows)?((double)bytes[0] / rows):(0.0));
+		for (column = 0; column < info->columnCount; column++) {
+			printf("  %-16s %-6s %.2f bytes/row\n", info->columns[column].name,
+			       (TelemetryFloat == info->columns[column].type)?("float"):("int"),
+			       (rows)?((double)bytes[column + 1] / rows):(0.0));
+		}
+	}
+}
+
+/**
+ * @brief Parses a -where, "column<value".
+ * @return 0 on success, -1 if it is not one.
+**/
+int ParseWhere(TelemetryReader * reader, int stream, char * text, QueryWhere * where)
+{
+	char name[TELEMETRY_NAME];
+	int length = strcspn(text, "<>=!");
+
+	if (length <= 0 || length >= TELEMETRY_NAME || '\0' == text[length]) {
+		printf("not a comparison: %s\n", text);
+		return -1;
+	}
+
+	memcpy(name, text, length);
+	name[length] = '\0';
+	where->column = TelemetryFindColumn(reader, stream, name);
+	if (where->column < 0) {
+		printf("no column %s\n", name);
+		return -1;
+	}
+
+	where->op[0] = text[length];
+	where->op[1] = ('=' == text[length + 1])?('='):('\0');
+	where->op[2] = '\0';
+	if (0 == strcmp(where->op, "=") || 0 == strcmp(where->op, "!")) {
+		printf("not a comparison: %s\n", text);
+		return -1;
+	}
+	where->value = atof(&text[length + strlen(where->op)]);
+
+	return 0;
+}
+
+/**
+ * @brief Returns a value of a column as a double.
+**/
+double ColumnValue(TelemetryReader * reader, int stream, int column, TelemetryValue value)
+{
+	if (column > 0 && TelemetryFloat == reader->streams[stream].columns[column - 1].type) {
+		return value.f;
+	}
+
+	return (0 == column)?((value.i - reader->header.startNs) / 1e9):((double)value.i);
+}
+
+/**
+ * @brief Returns whether a value passes a -where.
+**/
+int Compare(QueryWhere * where, double value)
+{
+	switch (where->op[0]) {
+		case '<':
+			return ('=' == where->op[1])?(value <= where->value):(value < where->value);
+		case '>':
+			return ('=' == where->op[1])?(value >= where->value):(value > where->value);
+		case '!':
+			return value != where->value;
+		default:
+			return value == where->value;
+	}
+}
+
+/**
+ * @brief Reads the "sync" stream of a tx2_comm_node.c archive.
+ * @return 0 on success, -1 if there are no offsets in it.
+**/
+int LoadSync(char * fileName, QuerySync * sync)
+{
+	TelemetryReader reader;
+	TelemetryValue * values[4];
+	int columns[4];
+	long long chunk;
+	int stream, rows, row;
+	int i;
+
+	memset(sync, 0, sizeof(QuerySync));
+	if (TelemetryMap(&reader, fileName) < 0) {
+		return -1;
+	}
+
+	stream = TelemetryFindStream(&reader, "sync");
+	columns[0] = 0;
+	columns[1] = (stream < 0)?(-1):(TelemetryFindColumn(&reader, stream, "offset"));
+	columns[2] = (stream < 0)?(-1):(TelemetryFindColumn(&reader, stream, "drift"));
+	if (stream < 0 || columns[1] < 0 || columns[2] < 0) {
+		printf("no clock offsets in %s\n", fileName);
+		TelemetryUnmap(&reader);
+		return -1;
+	}
+
+	sync->times = malloc(sizeof(long long) * (reader.indexCount * TELEMETRY_CHUNK_ROWS + 1));
+	sync->offsets = malloc(sizeof(long long) * (reader.indexCount * TELEMETRY_CHUNK_ROWS + 1));
+	sync->drifts = malloc(sizeof(double) * (reader.indexCount * TELEMETRY_CHUNK_ROWS + 1));
+	for (i = 0; i < 3; i++) {
+		values[i] = malloc(TELEMETRY_CHUNK_ROWS * sizeof(TelemetryValue));
+	}
+	if (NULL == sync->times || NULL == sync->offsets || NULL == sync->drifts ||
+	    NULL == values[0] || NULL == values[1] || NULL == values[2]) {
+		return -1;
+	}
+
+	// a stream's chunks are in time order
+	for (chunk = 0; chunk < reader.indexCount; chunk++) {
+		if (reader.index[chunk].stream != stream) {
+			continue;
+		}
+		rows = TelemetryDecode(&reader, chunk, 0, values[0]);
+		for (i = 1; i < 3 && rows > 0; i++) {
+			rows = (TelemetryDecode(&reader, chunk, columns[i], values[i]) == rows)?(rows):(-1);
+		}
+		for (row = 0; row < rows; row++) {
+			sync->times[sync->count] = values[0][row].i;
+			sync->offsets[sync->count] = values[1][row].i;
+			sync->drifts[sync->count] = values[2][row].f;
+			sync->count++;
+		}
+	}
+
+	for (i = 0; i < 3; i++) {
+		free(values[i]);
+	}
+	TelemetryUnmap(&reader);
+
+	if (0 == sync->count) {
+		printf("no clock offsets in %s\n", fileName);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Returns a rover time on the controller's clock, in seconds.
+**/
+double SyncTime(QuerySync * sync, long long time)
+{
+	long long low = 0, high = sync->count - 1, middle;
+
+	// the newest offset at or before the time, the first if there is none
+	while (low < high) {
+		middle = (low + high + 1) / 2;
+		if (sync->times[middle] <= time) {
+			low = middle;
+		} else {
+			high = middle - 1;
+		}
+	}
+
+	return (time - sync->offsets[low] - sync->drifts[low] * 1e-6 * (time - sync->times[low])) / 1e9;
+}
+
+int main(int argc, char ** argv)
+{
+	TelemetryReader reader;
+	QuerySync sync;
+	QueryWhere where[QUERY_MAX_WHERE];
+	TelemetryValue * values[TELEMETRY_MAX_COLUMNS + 1];
+	int needed[TELEMETRY_MAX_COLUMNS + 1];
+	int printed[TELEMETRY_MAX_COLUMNS + 1];
+	int printedCount = 0;
+	int whereCount = 0;
+	char * columns = NULL;
+	char * syncFile = NULL;
+	char * name;
+	double from = -1e300, to = 1e300;
+	double seconds;
+	long long every = 1, step = 0;
+	long long fromNs, toNs, nextNs;
+	long long matched = 0, kept = 0;
+	long long chunk, chunksRead = 0;
+	long long start;
+	int utc = 0, count = 0;
+	int stream, column, rows, row;
+	int i, pass;
+
+	if (argc < 2) {
+		printf("usage: ./telemetryQuery archive [stream [-from s] [-to s] [-columns a,b] [-where column<value] "
+		       "[-every n] [-step ms] [-utc] [-sync archive] [-count]]\n");
+		return -1;
+	}
+
+	start = ClockMonotonicNs();
+	if (TelemetryMap(&reader, argv[1]) < 0) {
+		return -1;
+	}
+
+	if (argc < 3) {
+		PrintSummary(&reader);
+		TelemetryUnmap(&reader);
+		return 0;
+	}
+
+	stream = TelemetryFindStream(&reader, argv[2]);
+	if (stream < 0) {
+		printf("no stream %s\n", argv[2]);
+		return -1;
+	}
+
+	for (i = 3; i < argc; i++) {
+		if (0 == strcmp(argv[i], "-utc")) {
+			utc = 1;
+		} else if (0 == strcmp(argv[i], "-count")) {
+			count = 1;
+		} else if (i + 1 >= argc) {
+			printf("%s needs a value\n", argv[i]);
+			return -1;
+		} else if (0 == strcmp(argv[i], "-from")) {
+			from = atof(argv[++i]);
+		} else if (0 == strcmp(argv[i], "-to")) {
+			to = atof(argv[++i]);
+		} else if (0 == strcmp(argv[i], "-columns")) {
+			columns = argv[++i];
+		} else if (0 == strcmp(argv[i], "-every")) {
+			every = atoll(argv[++i]);
+			every = (every < 1)?(1):(every);
+		} else if (0 == strcmp(argv[i], "-step")) {
+			step = (long long)(atof(argv[++i]) * 1000000.0);
+		} else if (0 == strcmp(argv[i], "-sync")) {
+			syncFile = argv[++i];
+		} else if (0 == strcmp(argv[i], "-where") && whereCount < QUERY_MAX_WHERE) {
+			if (ParseWhere(&reader, stream, argv[++i], &where[whereCount++]) < 0) {
+				return -1;
+			}
+		} else {
+			printf("unknown option %s\n", argv[i]);
+			return -1;
+		}
+	}
+
+	if (NULL != syncFile && LoadSync(syncFile, &sync) < 0) {
+		return -1;
+	}
+
+	// the columns printed, all of them if not given
+	memset(needed, 0, sizeof(needed));
+	if (NULL == columns) {
+		for (column = 1; column <= reader.streams[stream].columnCount; column++) {
+			printed[printedCount++] = column;
+		}
+	} else {
+		for (name = strtok(columns, ","); NULL != name; name = strtok(NULL, ",")) {
+			column = TelemetryFindColumn(&reader, stream, name);
+			if (column <= 0) {
+				printf("no column %s\n", name);
+				return -1;
+			}
+			printed[printedCount++] = column;
+		}
+	}
+	for (i = 0; i < printedCount; i++) {
+		needed[printed[i]] = 1;
+	}
+	for (i = 0; i < whereCount; i++) {
+		needed[where[i].column] = 1;
+	}
+
+	for (column = 0; column <= reader.streams[stream].columnCount; column++) {
+		values[column] = malloc(TELEMETRY_CHUNK_ROWS * sizeof(TelemetryValue));
+		if (NULL == values[column]) {
+			return -1;
+		}
+	}
+
+	if (!count) {
+		printf("time");
+		for (i = 0; i < printedCount; i++) {
+			printf(",%s", reader.streams[stream].columns[printed[i] - 1].name);
+		}
+		printf("\n");
+	}
+
+	fromNs = (from < -1e15)?(0):(reader.header.startNs + (long long)(from * 1e9));
+	toNs = (to > 1e15)?(0x7FFFFFFFFFFFFFFFLL):(reader.header.startNs + (long long)(to * 1e9));
+	nextNs = fromNs;
+
+	for (chunk = 0; chunk < reader.indexCount; chunk++) {
+		// the index says which chunks have rows in the range without looking at them
+		if (reader.index[chunk].stream != stream || reader.index[chunk].last < fromNs || reader.index[chunk].first > toNs) {
+			continue;
+		}
+		chunksRead++;
+
+		rows = TelemetryDecode(&reader, chunk, 0, values[0]);
+		for (column = 1; column <= reader.streams[stream].columnCount && rows > 0; column++) {
+			if (needed[column] && TelemetryDecode(&reader, chunk, column, values[column]) != rows) {
+				rows = -1;
+			}
+		}
+		if (rows < 0) {
+			printf("chunk %lld is damaged, skipped\n", chunk);
+			continue;
+		}
+
+		for (row = 0; row < rows; row++) {
+			if (values[0][row].i < fromNs || values[0][row].i > toNs) {
+				continue;
+			}
+
+			pass = 1;
+			for (i = 0; i < whereCount && pass; i++) {
+				pass = Compare(&where[i], ColumnValue(&reader, stream, where[i].column, values[where[i].column][row]));
+			}
+			if (!pass || 0 != (matched++ % every) || values[0][row].i < nextNs) {
+				continue;
+			}
+			nextNs = (step > 0)?(values[0][row].i + step):(nextNs);
+			kept++;
+
+			if (count) {
+				continue;
+			}
+
+			seconds = ColumnValue(&reader, stream, 0, values[0][row]);
+			if (NULL != syncFile) {
+				printf("%.6f", SyncTime(&sync, values[0][row].i));
+			} else if (utc) {
+				printf("%.6f", (reader.header.startUnixNs / 1e9) + seconds);
+			} else {
+				printf("%.6f", seconds);
+			}
+			for (i = 0; i < printedCount; i++) {
+				printf(",%.10g", ColumnValue(&reader, stream, printed[i], values[printed[i]][row]));
+			}
+			printf("\n");
+		}
+	}
+
+	if (count) {
+		printf("%lld rows, %lld kept, %lld of %lld chunks read, %.3f ms\n", matched, kept, chunksRead,
+		       reader.indexCount, (ClockMonotonicNs() - start) / 1000000.0);
+	}
+
+	for (column = 0; column <= reader.streams[stream].columnCount; column++) {
+		free(values[column]);
+	}
+	if (NULL != syncFile) {
+		free(sync.times);
+		free(sync.offsets);
+		free(sync.drifts);
+	}
+	TelemetryUnmap(&reader);
+
+	return 0;
+}